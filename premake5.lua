@@ -12,6 +12,8 @@ workspace "Renderer"
         systemversion "latest"
         defines { "_WINDOWS", "WIN32_LEAN_AND_MEAN", "NOMINMAX", "GLEW_STATIC", "_GLFW_WIN32" }
         links(winlibs)
+    filter "system:linux"
+        defines { "GLEW_STATIC", "_GLFW_X11" }
     filter {}
 
 -- Options
@@ -30,6 +32,7 @@ local project_dirs = config.projects_dir or "src/render-projects"
 local selectedScene = _OPTIONS["scene"]
 if selectedScene == "tests" then error("Scene name 'tests' is reserved.") end
 if selectedScene == "core" then error("Scene name 'core' is reserved.") end
+if selectedScene == "benchmarks" then error("Scene name 'benchmarks' is reserved.") end
 
 
 local inc = {
@@ -67,6 +70,12 @@ project "engine"
         "external/glm-0.9.7.1/**.hpp",
     }
     removefiles { "src/core/**_dep.**" }
+    -- GLFW sources of other platforms compile to nothing under the _GLFW_ define of this one
+    filter "system:windows"
+        removefiles { "src/core/file-management/posixUtils.cpp" }
+    filter "system:not windows"
+        removefiles { "src/core/file-management/windowsUtils.cpp" }
+    filter {}
 
     includedirs(inc)
 
@@ -100,6 +109,9 @@ if selectedScene then
         kind "ConsoleApp"
 
         links { "engine" } -- Link the static library
+        filter "system:linux"
+            links { "GL", "dl", "pthread" }
+        filter {}
 
 
         targetdir ("build/" .. selectedScene .. "/bin/build-%{cfg.architecture}")
@@ -137,6 +149,9 @@ project "unitTests"
     kind "ConsoleApp"
 
     links { "engine" }
+    filter "system:linux"
+        links { "GL", "dl", "pthread" }
+    filter {}
 
     targetdir ("build/tests/bin/build-%{cfg.architecture}")
     objdir    ("build/tests/obj/build-%{cfg.architecture}")
@@ -162,3 +177,41 @@ project "unitTests"
         optimize "Speed"
         linktimeoptimization "On"
     filter {}
+
+
+project "benchmarks"
+    location ("build/benchmarks")
+    language "C++"
+    cppdialect(dialect)
+    staticruntime "off"
+    kind "ConsoleApp"
+
+    links { "engine" }
+    filter "system:linux"
+        links { "GL", "dl", "pthread" }
+    filter {}
+
+    targetdir ("build/benchmarks/bin/build-%{cfg.architecture}")
+    objdir    ("build/benchmarks/obj/build-%{cfg.architecture}")
+
+    files { "src/benchmarks/runBenchmarks.cpp", "src/benchmarks/**.hpp" }
+
+    includedirs(inc)
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        runtime "Debug"
+        symbols "On"
+    filter "configurations:Profile"
+        defines { "NDEBUG" }
+        runtime "Release"
+        symbols "On"
+        optimize "Speed"
+        linktimeoptimization "On"
+    filter "configurations:Dist"
+        defines { "NDEBUG" }
+        runtime "Release"
+        symbols "Off"
+        optimize "Speed"
+        linktimeoptimization "On"
+    filter {}
@@ -0,0 +1,287 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exceptions.hpp"
+#include "logging.hpp"
+
+
+/**
+ * @brief Minimal benchmark harness of the benchmarks target.
+ *
+ * A case is a setup function run once outside of the measurement, returning the body that is timed.
+ * The number of body calls per sample is calibrated during warmup so that one sample takes at least
+ * BenchmarkOptions::minSampleMs, statistics are computed over per-call times of all samples.
+ */
+using BenchmarkBody = std::function<void()>;
+
+
+struct BenchmarkCase {
+	std::string name;
+	std::function<BenchmarkBody()> setup;
+	long itemsPerCall = 0; // optional throughput unit (points, particles, triangles, ...)
+};
+
+
+struct BenchmarkOptions {
+	int warmup = 2;
+	int repetitions = 15;
+	double minSampleMs = 5;
+	std::string filter;
+};
+
+
+struct BenchmarkResult {
+	std::string name;
+	int samples = 0;
+	long callsPerSample = 0;
+	long itemsPerCall = 0;
+	double min = 0, mean = 0, median = 0, p90 = 0, p99 = 0, max = 0, stddev = 0; // nanoseconds per call
+};
+
+
+inline std::vector<BenchmarkCase> &benchmarkRegistry() {
+	static std::vector<BenchmarkCase> cases;
+	return cases;
+}
+
+inline void registerBenchmark(const std::string &name, const std::function<BenchmarkBody()> &setup, long itemsPerCall = 0) {
+	benchmarkRegistry().push_back({name, setup, itemsPerCall});
+}
+
+
+// keeps the computation of value alive without an observable side effect
+template<typename T>
+void doNotOptimize(const T &value) {
+	static const void *volatile sink;
+	sink = &value;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+
+// linear interpolation between closest ranks, samples sorted
+inline double percentile(const std::vector<double> &sorted, double p) {
+	if (sorted.empty())
+		return 0;
+	double rank = p * (sorted.size() - 1);
+	size_t lo = (size_t)std::floor(rank);
+	size_t hi = std::min(lo + 1, sorted.size() - 1);
+	return sorted[lo] + (sorted[hi] - sorted[lo]) * (rank - lo);
+}
+
+inline BenchmarkResult summarise(const std::string &name, std::vector<double> perCall, long callsPerSample, long itemsPerCall) {
+	BenchmarkResult r;
+	r.name = name;
+	r.samples = perCall.size();
+	r.callsPerSample = callsPerSample;
+	r.itemsPerCall = itemsPerCall;
+	std::sort(perCall.begin(), perCall.end());
+	double sum = 0;
+	for (double t : perCall)
+		sum += t;
+	r.mean = sum / perCall.size();
+	double var = 0;
+	for (double t : perCall)
+		var += (t - r.mean) * (t - r.mean);
+	r.stddev = perCall.size() > 1 ? std::sqrt(var / (perCall.size() - 1)) : 0;
+	r.min = perCall.front();
+	r.max = perCall.back();
+	r.median = percentile(perCall, .5);
+	r.p90 = percentile(perCall, .9);
+	r.p99 = percentile(perCall, .99);
+	return r;
+}
+
+
+inline BenchmarkResult runBenchmark(const BenchmarkCase &c, const BenchmarkOptions &options) {
+	using clock = std::chrono::steady_clock;
+	BenchmarkBody body = c.setup();
+	auto timeCalls = [&body](long calls) {
+		auto start = clock::now();
+		for (long i = 0; i < calls; ++i)
+			body();
+		return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+	};
+
+	long calls = 1;
+	double minSampleNs = options.minSampleMs * 1e6;
+	for (int w = 0; w < std::max(1, options.warmup); ++w) {
+		double t = timeCalls(calls);
+		while (t < minSampleNs && calls < (1L << 30)) {
+			calls *= t > 0 ? std::clamp<long>((long)std::ceil(minSampleNs / t), 2, 100) : 100;
+			t = timeCalls(calls);
+		}
+	}
+
+	std::vector<double> perCall;
+	for (int k = 0; k < std::max(1, options.repetitions); ++k)
+		perCall.push_back(timeCalls(calls) / calls);
+	return summarise(c.name, perCall, calls, c.itemsPerCall);
+}
+
+
+inline std::string formatDuration(double ns) {
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(2);
+	if (ns < 1e3) s << ns << "ns";
+	else if (ns < 1e6) s << ns / 1e3 << "us";
+	else if (ns < 1e9) s << ns / 1e6 << "ms";
+	else s << ns / 1e9 << "s";
+	return s.str();
+}
+
+inline std::string benchmarkLine(const BenchmarkResult &r) {
+	std::ostringstream s;
+	s << std::left << std::setw(44) << r.name << " median " << std::setw(10) << formatDuration(r.median)
+	  << " p90 " << std::setw(10) << formatDuration(r.p90) << " min " << std::setw(10) << formatDuration(r.min)
+	  << " (" << r.samples << "x" << r.callsPerSample << ")";
+	if (r.itemsPerCall > 0)
+		s << "  " << std::setprecision(3) << r.itemsPerCall / r.median * 1e3 << " Mitems/s";
+	return s.str();
+}
+
+
+inline std::string buildDescription() {
+#ifdef NDEBUG
+	std::string config = "release";
+#else
+	std::string config = "debug";
+#endif
+#if defined(__clang__)
+	std::string compiler = "clang " + std::to_string(__clang_major__) + "." + std::to_string(__clang_minor__);
+#elif defined(__GNUC__)
+	std::string compiler = "gcc " + std::to_string(__GNUC__) + "." + std::to_string(__GNUC_MINOR__);
+#elif defined(_MSC_VER)
+	std::string compiler = "msvc " + std::to_string(_MSC_VER);
+#else
+	std::string compiler = "unknown";
+#endif
+	return compiler + ", " + config + ", " + std::to_string(std::thread::hardware_concurrency()) + " hardware threads";
+}
+
+
+// one benchmark object per line, read back by readBenchmarkResults
+inline void writeBenchmarkJSON(const std::string &path, const std::vector<BenchmarkResult> &results) {
+	std::ofstream out(path);
+	out << std::setprecision(10);
+	out << "{\n  \"build\": \"" << buildDescription() << "\",\n  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const auto &r = results[i];
+		out << "    {\"name\": \"" << r.name << "\", \"samples\": " << r.samples << ", \"calls_per_sample\": " << r.callsPerSample
+		    << ", \"items_per_call\": " << r.itemsPerCall << ", \"min_ns\": " << r.min << ", \"mean_ns\": " << r.mean
+		    << ", \"median_ns\": " << r.median << ", \"p90_ns\": " << r.p90 << ", \"p99_ns\": " << r.p99
+		    << ", \"max_ns\": " << r.max << ", \"stddev_ns\": " << r.stddev << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+}
+
+inline void writeBenchmarkCSV(const std::string &path, const std::vector<BenchmarkResult> &results) {
+	std::ofstream out(path);
+	out << std::setprecision(10);
+	out << "name,samples,calls_per_sample,items_per_call,min_ns,mean_ns,median_ns,p90_ns,p99_ns,max_ns,stddev_ns\n";
+	for (const auto &r : results)
+		out << r.name << "," << r.samples << "," << r.callsPerSample << "," << r.itemsPerCall << "," << r.min << "," << r.mean << ","
+		    << r.median << "," << r.p90 << "," << r.p99 << "," << r.max << "," << r.stddev << "\n";
+}
+
+
+inline double jsonNumber(const std::string &line, const std::string &key) {
+	size_t pos = line.find("\"" + key + "\":");
+	return pos == std::string::npos ? 0 : std::stod(line.substr(pos + key.size() + 3));
+}
+
+inline std::string jsonString(const std::string &line, const std::string &key) {
+	size_t pos = line.find("\"" + key + "\": \"");
+	if (pos == std::string::npos)
+		return "";
+	pos += key.size() + 5;
+	return line.substr(pos, line.find('"', pos) - pos);
+}
+
+// reads files written by writeBenchmarkJSON or writeBenchmarkCSV (chosen by extension)
+inline std::vector<BenchmarkResult> readBenchmarkResults(const std::string &path) {
+	std::ifstream in(path);
+	THROW_IF(!in, FileNotFoundError, path);
+	std::vector<BenchmarkResult> results;
+	std::string line;
+	bool csv = path.size() >= 4 && path.substr(path.size() - 4) == ".csv";
+	if (csv)
+		std::getline(in, line);
+	while (std::getline(in, line)) {
+		BenchmarkResult r;
+		if (csv) {
+			std::vector<std::string> cells;
+			std::stringstream s(line);
+			for (std::string cell; std::getline(s, cell, ',');)
+				cells.push_back(cell);
+			if (cells.size() < 11)
+				continue;
+			r.name = cells[0];
+			r.samples = std::stoi(cells[1]);
+			r.callsPerSample = std::stol(cells[2]);
+			r.itemsPerCall = std::stol(cells[3]);
+			r.min = std::stod(cells[4]);
+			r.mean = std::stod(cells[5]);
+			r.median = std::stod(cells[6]);
+			r.p90 = std::stod(cells[7]);
+			r.p99 = std::stod(cells[8]);
+			r.max = std::stod(cells[9]);
+			r.stddev = std::stod(cells[10]);
+		} else {
+			r.name = jsonString(line, "name");
+			if (r.name.empty())
+				continue;
+			r.samples = jsonNumber(line, "samples");
+			r.callsPerSample = jsonNumber(line, "calls_per_sample");
+			r.itemsPerCall = jsonNumber(line, "items_per_call");
+			r.min = jsonNumber(line, "min_ns");
+			r.mean = jsonNumber(line, "mean_ns");
+			r.median = jsonNumber(line, "median_ns");
+			r.p90 = jsonNumber(line, "p90_ns");
+			r.p99 = jsonNumber(line, "p99_ns");
+			r.max = jsonNumber(line, "max_ns");
+			r.stddev = jsonNumber(line, "stddev_ns");
+		}
+		results.push_back(r);
+	}
+	return results;
+}
+
+
+/**
+ * @brief Prints median ratios of benchmarks present in both files and returns the number of regressions.
+ * @details A benchmark regressed when its median grew by more than threshold (relative) and even its fastest
+ * sample is slower than the old median, so that noise of single samples is not reported.
+ */
+inline int compareBenchmarkResults(const std::vector<BenchmarkResult> &base, const std::vector<BenchmarkResult> &current, double threshold) {
+	int regressions = 0;
+	for (const auto &now : current) {
+		auto old = std::find_if(base.begin(), base.end(), [&](const BenchmarkResult &r) { return r.name == now.name; });
+		if (old == base.end()) {
+			LOG_PURE(now.name + ": new");
+			continue;
+		}
+		double ratio = now.median / old->median;
+		bool regressed = ratio > 1 + threshold && now.min > old->median;
+		bool improved = ratio < 1 / (1 + threshold) && now.median < old->min;
+		regressions += regressed;
+		std::ostringstream s;
+		s << std::left << std::setw(44) << now.name << std::setw(10) << formatDuration(old->median) << " -> " << std::setw(10)
+		  << formatDuration(now.median) << std::fixed << std::setprecision(3) << " x" << ratio
+		  << (regressed ? "  REGRESSION" : improved ? "  improved" : "");
+		if (regressed)
+			LOG_WARN_PURE(s.str());
+		else
+			LOG_PURE(s.str());
+	}
+	return regressions;
+}
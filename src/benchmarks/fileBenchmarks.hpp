@@ -0,0 +1,88 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+
+#include "benchmarks.hpp"
+#include "../file-management/macroParsing.hpp"
+#include "../utils/signalIO.hpp"
+
+
+inline void registerFileBenchmarks()
+{
+	// shader sized template (about 200kB) with eight macros, each used every few lines
+	registerBenchmark("templateCodeFile/generateCodeText/8_macros", [] {
+		Path dir = std::filesystem::temp_directory_path();
+		Path source = dir / "benchmarkTemplate.glsl";
+		{
+			std::ofstream out(source, std::ios::binary);
+			out << "#version 330 core\n";
+			for (int i = 0; i < 2000; ++i)
+				out << "vec4 f" << i << "(vec3 p) { return vec4(p * __SCALE_" << i % 8 << "__, __OFFSET__); } // filler line of plain GLSL code\n";
+		}
+		vector<CodeMacro> macros = {CodeMacro("__OFFSET__", "1.0 + 0.5 * sin(time)")};
+		for (int k = 0; k < 8; ++k)
+			macros.emplace_back("__SCALE_" + std::to_string(k) + "__", "float(" + std::to_string(k + 1) + ") * scaleUniform");
+		auto file = make_shared<TemplateCodeFile>(CodeFileDescriptor(source, false), CodeFileDescriptor(dir / "benchmarkTemplate.out.glsl", false), macros);
+		return [file] {
+			string code = file->generateCodeText();
+			doNotOptimize(code);
+		};
+	});
+
+	// the same second-long recordings as one number per line and as 16 bit WAV
+	static constexpr int second = 1 << 20;
+	registerBenchmark("signal/loadSequence/text_1M", [] {
+		Path path = std::filesystem::temp_directory_path() / "benchmarkSignal.txt";
+		{
+			std::ofstream out(path, std::ios::binary);
+			for (int i = 0; i < second; ++i)
+				out << std::sin(.01f*i) << '\n';
+		}
+		return [path] {
+			auto f = loadSequence(CodeFileDescriptor(path, false), vec2(0, 1));
+			doNotOptimize(f);
+		};
+	}, second);
+
+	registerBenchmark("signal/loadSequence/wav16_1M", [] {
+		Path path = std::filesystem::temp_directory_path() / "benchmarkSignal.wav";
+		vector<float> samples(second);
+		for (int i = 0; i < second; ++i)
+			samples[i] = std::sin(.01f*i);
+		writeWav(path, samples, 44100);
+		return [path] {
+			auto f = loadSequence(CodeFileDescriptor(path, false), vec2(0, 1));
+			doNotOptimize(f);
+		};
+	}, second);
+
+	// 100MB of stereo 16 bit PCM, one channel read in chunks as a stream would
+	static constexpr int frames = 25 << 20;
+	registerBenchmark("signal/read/wav16_stereo_100MB", [] {
+		Path path = std::filesystem::temp_directory_path() / "benchmarkRecording.wav";
+		vector<float> samples(2*(size_t)frames);
+		for (size_t i = 0; i < samples.size(); ++i)
+			samples[i] = std::sin(.001f*i);
+		writeWav(path, samples, 44100, SampleFormat::PCM_S16, 2);
+		return [path] {
+			SignalReader reader(path, 1);
+			vector<float> chunk(1 << 16);
+			float sum = 0;
+			while (size_t n = reader.read(chunk))
+				sum += chunk[n - 1];
+			doNotOptimize(sum);
+		};
+	}, frames);
+
+	registerBenchmark("signal/readAll/f32_100MB", [] {
+		Path path = std::filesystem::temp_directory_path() / "benchmarkRecording.f32";
+		vector<float> samples(frames);
+		for (int i = 0; i < frames; ++i)
+			samples[i] = std::sin(.001f*i);
+		writeRaw(path, samples);
+		return [path] {
+			auto samples = SignalReader(path).readAll();
+			doNotOptimize(samples);
+		};
+	}, frames);
+}
@@ -0,0 +1,321 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "benchmarks.hpp"
+#include "../engine/indexedRendering.hpp"
+#include "../engine/specific.hpp"
+#include "../geometry/smoothImplicit.hpp"
+#include "../geometry/sph.hpp"
+#include "../geometry/uniformGrid.hpp"
+#include "../utils/randomUtils.hpp"
+
+using namespace glm;
+
+
+// n x n grid of v/vt/vn triangles
+inline string benchmarkOBJText(int n)
+{
+	string text;
+	text.reserve(n*n*120);
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < n; ++j)
+			text += std::format("v {} {} {}\nvt {} {}\nvn 0 0 1\n", .01f*i, .01f*j, .1f*sin(.1f*i)*cos(.07f*j), 1.f*i/n, 1.f*j/n);
+	for (int i = 0; i < n-1; ++i)
+		for (int j = 0; j < n-1; ++j)
+		{
+			int a = i*n + j + 1, b = (i+1)*n + j + 1, c = i*n + j + 2, d = (i+1)*n + j + 2;
+			text += std::format("f {0}/{0}/{0} {1}/{1}/{1} {2}/{2}/{2}\nf {1}/{1}/{1} {3}/{3}/{3} {2}/{2}/{2}\n", a, b, c, d);
+		}
+	return text;
+}
+
+
+inline void registerGeometryBenchmarks()
+{
+	registerBenchmark("sph/update/2000_particles", [] {
+		SPH_SETTINGS params = SPH_SETTINGS(4.5f, .3f, 1.3f, .2f);
+		ImplicitVolume vessel = implicitVolumeEllipsoid(1, 1, 2);
+		ImplicitVolume region = implicitVolumeEllipsoid(.5, .5, 1.1, vec3(.45, .2, -.1));
+		vector<FluidParticle> particles;
+		for (int i = 0; i < 2000; i++)
+			particles.emplace_back(region.uniform_random_sample(), 1.f, params.viscosity);
+		auto fluid = make_shared<FluidParticleSystem>(particles, [](vec3 p) { return vec3(0, 0, -4.f); }, vessel, Poly6Kernel(.3), params);
+		// the state keeps evolving between calls, small steps keep the particles inside the vessel
+		return [fluid] { fluid->update(.002f); };
+	}, 2000);
+
+	registerBenchmark("sph/update/20000_particles", [] {
+		SPH_SETTINGS params = SPH_SETTINGS(4.5f, .3f, 1.3f, .2f);
+		ImplicitVolume vessel = implicitVolumeEllipsoid(1, 1, 2);
+		ImplicitVolume region = implicitVolumeEllipsoid(.5, .5, 1.1, vec3(.45, .2, -.1));
+		vector<FluidParticle> particles;
+		for (int i = 0; i < 20000; i++)
+			particles.emplace_back(region.uniform_random_sample(), 1.f, params.viscosity);
+		auto fluid = make_shared<FluidParticleSystem>(particles, [](vec3 p) { return vec3(0, 0, -4.f); }, vessel, Poly6Kernel(.3), params);
+		return [fluid] { fluid->update(.002f); };
+	}, 20000);
+
+	// all neighbours within d of every particle, through the string-keyed std::map chunking FluidParticleSystem used before the grid index and through the grid
+	auto neighbourSearchParticles = [] {
+		auto pts = make_shared<vector<vec3>>();
+		for (int i = 0; i < 20000; ++i)
+			pts->push_back(random_vec3(vec3(-1, -1, -2), vec3(1, 1, 2)));
+		return pts;
+	};
+	registerBenchmark("sph/neighbourSearch/chunkMap_20000_particles", [neighbourSearchParticles] {
+		auto pts = neighbourSearchParticles();
+		return [pts] {
+			vec3 a = vec3(-1, -1, -2);
+			float d = .1f;
+			auto key = [](ivec3 v) { return std::to_string(v.x) + "," + std::to_string(v.y) + "," + std::to_string(v.z); };
+			std::map<string, std::set<int>> chunks;
+			for (int i = 0; i < (int)pts->size(); ++i)
+				chunks[key(ivec3(((*pts)[i] - a) / d))].insert(i);
+			long pairs = 0;
+			for (int i = 0; i < (int)pts->size(); ++i) {
+				ivec3 c = ivec3(((*pts)[i] - a) / d);
+				for (int x = -1; x <= 1; x++)
+					for (int y = -1; y <= 1; y++)
+						for (int z = -1; z <= 1; z++)
+							if (chunks.contains(key(c + ivec3(x, y, z))))
+								for (int j : chunks.at(key(c + ivec3(x, y, z))))
+									pairs += dot((*pts)[i] - (*pts)[j], (*pts)[i] - (*pts)[j]) <= d*d;
+			}
+			doNotOptimize(pairs);
+		};
+	}, 20000);
+
+	registerBenchmark("sph/neighbourSearch/uniformGrid_20000_particles", [neighbourSearchParticles] {
+		auto pts = neighbourSearchParticles();
+		return [pts] {
+			auto grid = UniformGridIndex(vec3(-1, -1, -2), vec3(1, 1, 2), .1f);
+			grid.rebuild(*pts);
+			long pairs = 0;
+			for (int i = 0; i < (int)pts->size(); ++i)
+				grid.forEachNeighbour(i, .1f, [&](int, vec3, float) { pairs++; });
+			doNotOptimize(pairs);
+		};
+	}, 20000);
+
+	// the same Poly6 kernel through std::function, as Poly6Kernel was built before the sph:: kernels, and as a static batch
+	registerBenchmark("sph/kernel/poly6_function_1M", [] {
+		auto kernel = make_shared<SmoothingKernel>(.3f, [](vec3 p, float d) {
+			if (dot(p, p) > d*d) return 0.0f;
+			return 315.0f / (64.0f * PI * (float)std::pow(d, 9)) * pow3(d*d - dot(p, p));
+		}, [](vec3 p, float d) { return vec3(0); });
+		auto offsets = make_shared<vector<vec3>>();
+		for (int i = 0; i < 1 << 20; i++)
+			offsets->push_back(random_vec3(vec3(-.17f), vec3(.17f)));
+		return [kernel, offsets] {
+			float sum = 0;
+			for (vec3 p : *offsets)
+				sum += (*kernel)(p);
+			doNotOptimize(sum);
+		};
+	}, 1 << 20);
+
+	registerBenchmark("sph/kernel/poly6_batch_1M", [] {
+		auto r2 = make_shared<vector<float>>();
+		for (int i = 0; i < 1 << 20; i++) {
+			vec3 p = random_vec3(vec3(-.17f), vec3(.17f));
+			r2->push_back(dot(p, p));
+		}
+		auto w = make_shared<vector<float>>(r2->size());
+		return [r2, w] {
+			sph::Poly6(.3f).W(r2->data(), w->data(), r2->size());
+			doNotOptimize(*w);
+		};
+	}, 1 << 20);
+
+	// the per-cube configuration walk MarchingCubeChunk::generate used before caching the samples
+	registerBenchmark("marchingCubes/generateCube/gyroid_48", [] {
+		auto gyroid = make_shared<SmoothImplicitSurface>([](vec3 p) { return sin(6*p.x)*cos(6*p.y) + sin(6*p.y)*cos(6*p.z) + sin(6*p.z)*cos(6*p.x); });
+		return [gyroid] {
+			auto chunk = MarchingCubeChunk(vec3(-1), vec3(1), ivec3(48), gyroid);
+			for (int i = 0; i < 48; i++)
+				for (int j = 0; j < 48; j++)
+					for (int k = 0; k < 48; k++)
+						chunk.generateCube(ivec3(i, j, k));
+			doNotOptimize(chunk);
+		};
+	}, 48*48*48);
+
+	registerBenchmark("marchingCubes/generate/gyroid_48", [] {
+		auto gyroid = make_shared<SmoothImplicitSurface>([](vec3 p) { return sin(6*p.x)*cos(6*p.y) + sin(6*p.y)*cos(6*p.z) + sin(6*p.z)*cos(6*p.x); });
+		return [gyroid] {
+			auto chunk = MarchingCubeChunk(vec3(-1), vec3(1), ivec3(48), gyroid);
+			chunk.generate();
+			doNotOptimize(chunk);
+		};
+	}, 48*48*48);
+
+	registerBenchmark("mesh/addUniformSurface/torus_200x200", [] {
+		auto surface = torus(.4f, 1);
+		return [surface] {
+			IndexedMesh mesh = IndexedMesh();
+			mesh.addUniformSurface(surface, 200, 200, 0);
+			doNotOptimize(mesh);
+		};
+	}, 200*200);
+
+	registerBenchmark("mesh/addUniformSurface/torus_1024x1024", [] {
+		auto surface = torus(.4f, 1);
+		return [surface] {
+			IndexedMesh mesh = IndexedMesh();
+			mesh.addUniformSurface(surface, 1024, 1024, 0);
+			doNotOptimize(mesh);
+		};
+	}, 1024*1024);
+
+	// a deforming surface rebuilt every frame
+	registerBenchmark("mesh/adjustToNewSurface/torus_1024x1024", [] {
+		auto mesh = make_shared<IndexedMesh>(torus(.4f, 1), 1024, 1024, 0);
+		auto frames = make_shared<vector<SmoothParametricSurface>>(vector{torus(.3f, 1.1f), torus(.4f, 1)});
+		auto frame = make_shared<int>(0);
+		return [mesh, frames, frame] {
+			mesh->adjustToNewSurface((*frames)[++*frame % 2], 0);
+			doNotOptimize(*mesh);
+		};
+	}, 1024*1024);
+
+	// the same frames evaluated vertex by vertex, without the grid layout
+	registerBenchmark("mesh/adjustPerVertex/torus_1024x1024", [] {
+		auto mesh = make_shared<IndexedMesh>(torus(.4f, 1), 1024, 1024, 0);
+		auto frames = make_shared<vector<SmoothParametricSurface>>(vector{torus(.3f, 1.1f), torus(.4f, 1)});
+		auto frame = make_shared<int>(0);
+		return [mesh, frames, frame] {
+			const SmoothParametricSurface &surface = (*frames)[++*frame % 2];
+			mesh->deformPerVertex(0, [&](BufferedVertex &v) { IndexedMesh::encodeSurfacePoint(v, surface, IndexedMesh::getSurfaceParameters(v)); });
+			doNotOptimize(*mesh);
+		};
+	}, 1024*1024);
+
+	registerBenchmark("mesh/optimiseVertexCache/torus_512x512", [] {
+		auto mesh = make_shared<IndexedMesh>(torus(.4f, 1), 512, 512, 0);
+		return [mesh] {
+			IndexedMesh copy = *mesh;
+			copy.optimiseVertexCache(0, {.overdraw = true});
+			doNotOptimize(copy);
+		};
+	}, 2*511*511);
+
+	registerBenchmark("mesh/recalculateNormals/torus_300x300", [] {
+		auto mesh = make_shared<IndexedMesh>(torus(.4f, 1), 300, 300, 0);
+		return [mesh] { mesh->recalculateNormals(); };
+	}, 2*299*299);
+
+	registerBenchmark("mesh/traverse/vertexView_1M", [] {
+		auto mesh = make_shared<IndexedMesh>(torus(.4f, 1), 1000, 1000, 0);
+		return [mesh] {
+			vec3 sum = vec3(0);
+			for (BufferedVertex v: mesh->vertexView(0))
+				sum += v.getPosition();
+			doNotOptimize(sum);
+		};
+	}, 1000*1000);
+
+	// one frame of an animated rigid motion, through the per vertex proxies and through the bulk kernels
+	mat3 rotation = mat3(vec3(cos(.01f), sin(.01f), 0), vec3(-sin(.01f), cos(.01f), 0), vec3(0, 0, 1));
+	registerBenchmark("mesh/deformPerVertex/affine_1M", [rotation] {
+		auto mesh = make_shared<IndexedMesh>(torus(.4f, 1), 1000, 1000, 0);
+		auto motion = make_shared<SpaceEndomorphism>(SpaceEndomorphism::affine(rotation, vec3(0, 0, .001f)));
+		return [mesh, motion] {
+			mesh->deformPerVertex(0, [&](BufferedVertex &v) { v.applyFunction(*motion); });
+			doNotOptimize(*mesh);
+		};
+	}, 1000*1000);
+
+	registerBenchmark("mesh/deformBulk/affine_1M", [rotation] {
+		auto mesh = make_shared<IndexedMesh>(torus(.4f, 1), 1000, 1000, 0);
+		return [mesh, rotation] {
+			mesh->affineTransform(rotation, vec3(0, 0, .001f), 0);
+			doNotOptimize(*mesh);
+		};
+	}, 1000*1000);
+
+	registerBenchmark("mesh/deformBulk/ambientMap_1M", [rotation] {
+		auto mesh = make_shared<IndexedMesh>(torus(.4f, 1), 1000, 1000, 0);
+		auto motion = make_shared<SpaceEndomorphism>(SpaceEndomorphism::affine(rotation, vec3(0, 0, .001f)));
+		return [mesh, motion] {
+			mesh->deformWithAmbientMap(0, *motion);
+			doNotOptimize(*mesh);
+		};
+	}, 1000*1000);
+
+	// the same torus with derivatives by central differences and by hyper-dual evaluation
+	auto torusParametrisation = [](auto t, auto u) {
+		return tvec3<decltype(t)>((1 + .4f*cos(u))*cos(t), (1 + .4f*cos(u))*sin(t), .4f*sin(u));
+	};
+	registerBenchmark("surface/meanCurvature/finiteDifferences_10k", [torusParametrisation] {
+		auto surface = make_shared<SmoothParametricSurface>([torusParametrisation](float t, float u) { return torusParametrisation(t, u); },
+															vec2(0, TAU), vec2(0, TAU), true, true);
+		return [surface] {
+			float sum = 0;
+			for (int i = 0; i < 10000; ++i)
+				sum += surface->meanCurvature(.01f*i, .003f*i);
+			doNotOptimize(sum);
+		};
+	}, 10000);
+
+	registerBenchmark("surface/meanCurvature/autodiff_10k", [torusParametrisation] {
+		auto surface = make_shared<SmoothParametricSurface>(SmoothParametricSurface::autodiff(torusParametrisation, vec2(0, TAU), vec2(0, TAU), true, true));
+		return [surface] {
+			float sum = 0;
+			for (int i = 0; i < 10000; ++i)
+				sum += surface->meanCurvature(.01f*i, .003f*i);
+			doNotOptimize(sum);
+		};
+	}, 10000);
+
+	for (int n : {100, 500})
+	{
+		Path path = std::filesystem::temp_directory_path() / ("benchmarkGrid" + std::to_string(n) + ".obj");
+		registerBenchmark("obj/addNewPolygroup/grid_" + std::to_string(n), [n, path] {
+			std::ofstream(path, std::ios::binary) << benchmarkOBJText(n);
+			return [path] {
+				IndexedMesh mesh = IndexedMesh();
+				mesh.addNewPolygroup(path.string().c_str(), 0);
+				doNotOptimize(mesh);
+			};
+		}, 2*(n-1)*(n-1));
+
+		// the getline/istringstream importer IndexedMesh used before, positions and faces only
+		registerBenchmark("obj/getlineParse/grid_" + std::to_string(n), [n] {
+			auto text = make_shared<string>(benchmarkOBJText(n));
+			return [text] {
+				std::istringstream in(*text);
+				string line;
+				vector<vec3> positions;
+				vector<ivec3> faces;
+				while (getline(in, line))
+					if (line.substr(0, 2) == "v ") {
+						std::istringstream s(line.substr(2));
+						vec3 v;
+						s >> v.x >> v.y >> v.z;
+						positions.push_back(v);
+					}
+					else if (line.substr(0, 2) == "f ") {
+						ivec3 v, t, nr;
+						sscanf(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d", &v[0], &t[0], &nr[0], &v[1], &t[1], &nr[1], &v[2], &t[2], &nr[2]);
+						faces.push_back(v - ivec3(1));
+					}
+				doNotOptimize(faces);
+			};
+		}, 2*(n-1)*(n-1));
+
+		Path cache = std::filesystem::temp_directory_path() / ("benchmarkGrid" + std::to_string(n) + ".meshcache");
+		registerBenchmark("obj/loadBinaryCache/grid_" + std::to_string(n), [n, cache] {
+			IndexedMesh mesh = IndexedMesh();
+			mesh.addNewPolygroup(parseOBJ(benchmarkOBJText(n)), 0);
+			mesh.saveBinaryCache(cache);
+			return [cache] {
+				IndexedMesh mesh = IndexedMesh::loadBinaryCache(cache);
+				doNotOptimize(mesh);
+			};
+		}, 2*(n-1)*(n-1));
+	}
+}
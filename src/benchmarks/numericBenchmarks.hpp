@@ -0,0 +1,280 @@
+#pragma once
+#include "benchmarks.hpp"
+#include "../geometry/pdeDiscrete.hpp"
+#include "../utils/fft.hpp"
+#include "../utils/func.hpp"
+#include "../utils/integralTransforms.hpp"
+#include "../utils/jobSystem.hpp"
+#include "../utils/randomUtils.hpp"
+#include "../utils/solvers.hpp"
+#include "../utils/sparse.hpp"
+#include "../utils/stft.hpp"
+
+using namespace glm;
+
+
+// cotangent Laplacian of an n x m torus mesh plus the lumped mass matrix, i.e. a screened Poisson system
+inline SparseMatrix benchmarkTorusPoissonMatrix(int n, int m)
+{
+	vector<vec3> positions(n*m);
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < m; ++j) {
+			float u = TAU*i/n, v = TAU*j/m;
+			positions[i*m + j] = vec3((2 + .7f*cos(v))*cos(u), (2 + .7f*cos(v))*sin(u), .7f*sin(v));
+		}
+	vector<SparseEntry> triplets;
+	triplets.reserve(n*m*24);
+	auto addTriangle = [&](int a, int b, int c) {
+		int corners[3] = {a, b, c};
+		float area = length(cross(positions[b] - positions[a], positions[c] - positions[a]))/2;
+		for (int k = 0; k < 3; ++k) {
+			int o = corners[k], p = corners[(k + 1)%3], q = corners[(k + 2)%3];
+			vec3 e1 = positions[p] - positions[o], e2 = positions[q] - positions[o];
+			float w = .5f*dot(e1, e2)/length(cross(e1, e2));
+			triplets.push_back({p, q, -w});
+			triplets.push_back({q, p, -w});
+			triplets.push_back({p, p, w});
+			triplets.push_back({q, q, w});
+			triplets.push_back({o, o, area/3});
+		}
+	};
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < m; ++j) {
+			int a = i*m + j, b = (i + 1)%n*m + j, c = i*m + (j + 1)%m, d = (i + 1)%n*m + (j + 1)%m;
+			addTriangle(a, b, c);
+			addTriangle(b, d, c);
+		}
+	return SparseMatrix(n*m, n*m, triplets);
+}
+
+// the composition of funcTests, built on graph-backed or closure-backed coordinates
+inline RealFunctionR3 benchmarkComposedFunction(const RealFunctionR3 &x, const RealFunctionR3 &y, const RealFunctionR3 &z)
+{
+	RealFunctionR3 f = x;
+	for (int k = 0; k < 7; ++k)
+		f = (f*(1 + .1f*k) + x*y - z) / (x*x + 1) + max(y, z)*.5f;
+	return f;
+}
+
+
+inline void registerNumericBenchmarks()
+{
+	// powers of two, mixed radix and Bluestein lengths
+	for (int n : {256, 1024, 4096, 65536, 3000, 1009, 65537})
+		registerBenchmark("fft/forward/" + std::to_string(n), [n] {
+			auto plan = FFTPlan::get(n, FFTDirection::FORWARD);
+			vector<Complex> input(n), work(n);
+			for (int i = 0; i < n; ++i)
+				input[i] = Complex(randomFloat(-1, 1), randomFloat(-1, 1));
+			return [plan, input, work]() mutable {
+				std::copy(input.begin(), input.end(), work.begin());
+				plan->execute(work);
+				doNotOptimize(work);
+			};
+		}, n);
+
+	registerBenchmark("gabor/transform/4096_window128_step16", [] {
+		auto signal = DiscreteRealFunction([](float x) { return sin(40*x*x) + .3f*cos(310*x); }, vec2(0, 1), 4096);
+		auto gabor = DiscreteGaborTransform(128, 16);
+		return [signal, gabor] {
+			auto spectrum = gabor.transform(signal);
+			doNotOptimize(spectrum);
+		};
+	}, 4096);
+
+	registerBenchmark("fft2D/forward/2048x2048", [] {
+		Grid2D<Complex> values(2048, 2048);
+		for (Complex &c: values.values())
+			c = Complex(randomFloat(-1, 1), randomFloat(-1, 1));
+		auto f = make_shared<DiscreteComplexFunctionR2>(std::move(values), vec2(0, 1), vec2(0, 1));
+		return [f] {
+			auto spectrum = f->fft();
+			doNotOptimize(spectrum);
+		};
+	}, 2048*2048);
+
+	registerBenchmark("grid2D/transpose/2048x2048", [] {
+		auto values = make_shared<Grid2D<Complex>>(2048, 2048);
+		auto out = make_shared<Grid2D<Complex>>();
+		return [values, out] {
+			values->transposeInto(*out);
+			doNotOptimize(*out);
+		};
+	}, 2048*2048);
+
+	// three minutes at 44.1kHz
+	static constexpr int recording = 180*44100;
+	auto recordingSignal = [] {
+		auto signal = make_shared<vector<float>>(recording);
+		for (int i = 0; i < recording; ++i)
+			(*signal)[i] = sin(.05f*i + 1e-7f*i*i) + .2f*randomFloat(-1, 1);
+		return signal;
+	};
+	registerBenchmark("stft/analyse/3min_44kHz_window2048_hop512", [recordingSignal] {
+		auto signal = recordingSignal();
+		auto engine = make_shared<STFTEngine>(STFTEngine::hannWindow(2048), 512);
+		return [signal, engine] {
+			auto spectra = engine->analyse(*signal);
+			doNotOptimize(spectra);
+		};
+	}, recording);
+
+	registerBenchmark("stft/stream/3min_44kHz_window2048_hop512_blocks4096", [recordingSignal] {
+		auto signal = recordingSignal();
+		auto engine = make_shared<STFTEngine>(STFTEngine::hannWindow(2048), 512);
+		return [signal, engine] {
+			float peak = 0;
+			STFTStream stream(*engine, [&peak](int, std::span<const Complex> spectrum) { peak = max(peak, spectrum[40].z.x); }, 0);
+			for (int i = 0; i < recording; i += 4096)
+				stream.push(std::span<const float>(*signal).subspan(i, min(4096, recording - i)));
+			stream.finish();
+			doNotOptimize(peak);
+		};
+	}, recording);
+
+	// quadrature backend is O(t_res N^2) and is left out at this size
+	for (auto [backend, name] : {std::pair(HeatSolverBackend::SPECTRAL, "spectral"), std::pair(HeatSolverBackend::CRANK_NICOLSON, "crankNicolson")})
+		registerBenchmark(string("heat/solution/") + name + "_1000x4096", [backend] {
+			auto u0 = DiscreteRealFunction([](float x) { return exp(-x*x) + .2f*sin(3*x); }, vec2(-20, 20), 4096);
+			auto solver = make_shared<HeatRealLineHomoDiscrete>(u0, .5f, 2, 1000, backend);
+			return [solver] {
+				auto u = solver->solution();
+				doNotOptimize(u);
+			};
+		}, 1000*4096);
+
+	// 400 x 250 torus, 100k unknowns
+	static constexpr int poissonSize = 400*250;
+	auto poissonSystem = [] {
+		auto A = make_shared<SparseMatrix>(benchmarkTorusPoissonMatrix(400, 250));
+		auto b = make_shared<vector<float>>(A->rows());
+		for (int i = 0; i < A->rows(); ++i)
+			(*b)[i] = sin(.001f*i) + .1f*randomFloat(-1, 1);
+		return std::pair(A, b);
+	};
+	registerBenchmark("sparse/multiply/torusPoisson_100k", [poissonSystem] {
+		auto [A, b] = poissonSystem();
+		auto y = make_shared<vector<float>>(A->rows());
+		return [A, b, y] {
+			A->multiply(*b, *y);
+			doNotOptimize(*y);
+		};
+	}, poissonSize);
+
+	for (auto [preconditioner, name] : {std::pair(SparsePreconditioner::JACOBI, "jacobi"), std::pair(SparsePreconditioner::ILU0, "ilu0")})
+		registerBenchmark(string("sparse/conjugateGradient/") + name + "_torusPoisson_100k", [poissonSystem, preconditioner] {
+			auto [A, b] = poissonSystem();
+			return [A, b, preconditioner] {
+				vector<float> x(A->rows(), 0.f);
+				auto report = conjugateGradient(*A, *b, x, {.tolerance = 1e-6f, .maxIterations = 5000, .preconditioner = preconditioner});
+				doNotOptimize(report);
+			};
+		}, poissonSize);
+
+	registerBenchmark("sparse/ldlt/analyseAndFactorize_torusPoisson_100k", [poissonSystem] {
+		auto [A, b] = poissonSystem();
+		return [A] {
+			SparseLDLT ldlt(*A);
+			doNotOptimize(ldlt.factorNonZeros());
+		};
+	}, poissonSize);
+
+	registerBenchmark("sparse/ldlt/factorize_torusPoisson_100k", [poissonSystem] {
+		auto [A, b] = poissonSystem();
+		auto ldlt = make_shared<SparseLDLT>(*A);
+		return [A, ldlt] {
+			ldlt->factorize(*A);
+			doNotOptimize(ldlt->factorNonZeros());
+		};
+	}, poissonSize);
+
+	registerBenchmark("sparse/ldlt/solve_torusPoisson_100k", [poissonSystem] {
+		auto [A, b] = poissonSystem();
+		auto ldlt = make_shared<SparseLDLT>(*A);
+		return [b, ldlt] {
+			auto x = ldlt->solve(*b);
+			doNotOptimize(x);
+		};
+	}, poissonSize);
+
+	// per item times of the first two are the scheduling overhead of one job
+	registerBenchmark("jobs/submitAndWait/empty_100k", [] {
+		return [] {
+			JobCounter counter;
+			JobSystem &jobs = JobSystem::global();
+			for (int i = 0; i < 100000; ++i)
+				jobs.submit(counter, [] {});
+			jobs.wait(counter);
+		};
+	}, 100000);
+
+	registerBenchmark("jobs/taskGraph/diamonds_10k", [] {
+		auto graph = make_shared<TaskGraph>();
+		for (int i = 0; i < 2500; ++i) {
+			int top = graph->add([] {}, i > 0 ? vector<int>{graph->size() - 1} : vector<int>{});
+			int left = graph->add([] {}, {top});
+			int right = graph->add([] {}, {top});
+			graph->add([] {}, {left, right});
+		}
+		return [graph] { graph->run(); };
+	}, 10000);
+
+	registerBenchmark("jobs/parallelFor/sqrt_16M", [] {
+		auto values = make_shared<vector<float>>(1 << 24);
+		return [values] {
+			JobSystem::global().parallelFor(values->size(), [&](int i) { (*values)[i] = std::sqrt((float)i); });
+			doNotOptimize(*values);
+		};
+	}, 1 << 24);
+
+	registerBenchmark("rk4/solveNSteps/lorenz_10000", [] {
+		return [] {
+			BIHOM(float, vec3, vec3) lorenz = [](float t, vec3 p) { return vec3(10*(p.y - p.x), p.x*(28 - p.z) - p.y, p.x*p.y - 8.f/3*p.z); };
+			RK4 solver = RK4(lorenz, 0, vec3(1, 1, 1), .001f);
+			solver.solveNSteps(10000);
+			doNotOptimize(solver.timeReached());
+		};
+	}, 10000);
+
+	// the same 7 step composition through a chain of closures, through the expression tape point by point and in a batch
+	auto tapePoints = [] {
+		auto pts = make_shared<vector<vec3>>();
+		for (int i = 0; i < 200000; ++i)
+			pts->push_back(random_vec3(vec3(-2), vec3(2)));
+		return pts;
+	};
+	registerBenchmark("func/evaluate/closureChain_200k", [tapePoints] {
+		RealFunctionR3 fx = RealFunctionR3([](vec3 v) { return v.x; }, [](vec3) { return vec3(1, 0, 0); });
+		RealFunctionR3 fy = RealFunctionR3([](vec3 v) { return v.y; }, [](vec3) { return vec3(0, 1, 0); });
+		RealFunctionR3 fz = RealFunctionR3([](vec3 v) { return v.z; }, [](vec3) { return vec3(0, 0, 1); });
+		auto f = make_shared<RealFunctionR3>(benchmarkComposedFunction(fx, fy, fz));
+		auto pts = tapePoints();
+		auto out = make_shared<vector<float>>(pts->size());
+		return [f, pts, out] {
+			for (int i = 0; i < (int)pts->size(); ++i)
+				(*out)[i] = (*f)((*pts)[i]);
+			doNotOptimize(*out);
+		};
+	}, 200000);
+
+	registerBenchmark("func/evaluate/tapePerPoint_200k", [tapePoints] {
+		auto f = make_shared<RealFunctionR3>(benchmarkComposedFunction(X_R3, Y_R3, Z_R3));
+		auto pts = tapePoints();
+		auto out = make_shared<vector<float>>(pts->size());
+		return [f, pts, out] {
+			for (int i = 0; i < (int)pts->size(); ++i)
+				(*out)[i] = (*f)((*pts)[i]);
+			doNotOptimize(*out);
+		};
+	}, 200000);
+
+	registerBenchmark("func/evaluate/tapeBatch_200k", [tapePoints] {
+		auto f = make_shared<RealFunctionR3>(benchmarkComposedFunction(X_R3, Y_R3, Z_R3));
+		auto pts = tapePoints();
+		auto out = make_shared<vector<float>>(pts->size());
+		return [f, pts, out] {
+			f->evaluate(*pts, *out);
+			doNotOptimize(*out);
+		};
+	}, 200000);
+}
@@ -0,0 +1,75 @@
+#include "numericBenchmarks.hpp"
+#include "geometryBenchmarks.hpp"
+#include "fileBenchmarks.hpp"
+
+#include "logging.hpp"
+
+
+/*
+ * benchmarks [--filter substring] [--repetitions n] [--warmup n] [--min-sample-ms t] [--json file] [--csv file] [--list]
+ * benchmarks --compare base.json current.json [--threshold 0.05]
+ *
+ * Compare mode exits with 1 when any benchmark regressed, so it can gate CI.
+ */
+int main(int argc, char **argv)
+{
+	logging::Logger::init();
+	BenchmarkOptions options;
+	string jsonPath, csvPath, basePath, currentPath;
+	double threshold = .05;
+	bool list = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		auto value = [&]() -> string {
+			THROW_IF(i + 1 >= argc, IllegalArgumentError, "Missing value of " + arg);
+			return argv[++i];
+		};
+		if (arg == "--filter") options.filter = value();
+		else if (arg == "--repetitions") options.repetitions = std::stoi(value());
+		else if (arg == "--warmup") options.warmup = std::stoi(value());
+		else if (arg == "--min-sample-ms") options.minSampleMs = std::stod(value());
+		else if (arg == "--json") jsonPath = value();
+		else if (arg == "--csv") csvPath = value();
+		else if (arg == "--threshold") threshold = std::stod(value());
+		else if (arg == "--list") list = true;
+		else if (arg == "--compare") {
+			basePath = value();
+			currentPath = value();
+		}
+		else THROW(IllegalArgumentError, "Unknown argument " + arg);
+	}
+
+	if (!basePath.empty())
+	{
+		int regressions = compareBenchmarkResults(readBenchmarkResults(basePath), readBenchmarkResults(currentPath), threshold);
+		LOG_PURE("--------------------------------");
+		LOG_PURE(std::to_string(regressions) + " regression(s) above " + std::to_string((int)std::round(threshold*100)) + "%");
+		return regressions > 0;
+	}
+
+	registerNumericBenchmarks();
+	registerGeometryBenchmarks();
+	registerFileBenchmarks();
+
+	LOG_PURE("Benchmarks (" + buildDescription() + ")");
+	vector<BenchmarkResult> results;
+	for (const BenchmarkCase &c : benchmarkRegistry())
+	{
+		if (!options.filter.empty() && c.name.find(options.filter) == string::npos)
+			continue;
+		if (list) {
+			LOG_PURE(c.name);
+			continue;
+		}
+		results.push_back(runBenchmark(c, options));
+		LOG_PURE(benchmarkLine(results.back()));
+	}
+
+	if (!jsonPath.empty())
+		writeBenchmarkJSON(jsonPath, results);
+	if (!csvPath.empty())
+		writeBenchmarkCSV(csvPath, results);
+	return 0;
+}
@@ -27,14 +27,11 @@ AreaUnderWave::AreaUnderWave(RealFunctionR2 f, vec2 dom, int sampling_res, float
 
 void AreaUnderWave::update(float t) {
 	this->t = t;
-	auto deformation = [&, T=t](BufferedVertex &v) {
-		if (v.getUV().x > .5) {
-			float x = v.getPosition().x;
-			float y = f(x, T);
-			v.setPosition(vec3(x, y, v.getPosition().z));
-		}
-	};
-	deformPerVertex(id, deformation);
+	deformBulk(id, [this, T=t](const VertexSpans &vs) {
+		for (int k = 0; k < vs.size(); k++)
+			if (vs.uvs[k].x > .5)
+				vs.positions[k].y = f(vs.positions[k].x, T);
+	}, {POSITION});
 }
 
 MovingCurve::MovingCurve(RealFunctionR2 f, vec2 dom, int sampling_res, float h, float r, int radial_res)
@@ -67,21 +64,26 @@ MovingCurve::MovingCurve(RealFunctionR2 f, vec2 dom, int sampling_res, float h,
 
 void MovingCurve::update(float T) {
 	this->t = time_reparam(T);
-	auto deformation = [&, t=t](BufferedVertex &v) {
-		vec4 color = v.getColor();
-		float R = color.x;
-		float H = color.y;
-		float x = v.getUV().x;
-		float theta = v.getUV().y;
-		float y = this->f(x, t);
-		vec3 n_c = vec3(this->f.dx(x, t), -1, 0)/norm(vec3(this->f.dx(x, t), -1, 0));
-		vec3 x_center = vec3(x, y, H);
-		vec3 n = normalise(n_c * std::sin(theta) + e3 * std::cos(theta));
+	deformBulk(id, tubeKernel(t, vec3(0)));
+}
 
-		v.setPosition(x_center + n * R);
-		v.setNormal(n);
+// the vertices of a ring share x, so the curve is evaluated once per ring of the chunk
+VertexKernel MovingCurve::tubeKernel(float t, vec3 shift) const {
+	return [this, t, shift](const VertexSpans &vs) {
+		float x = NAN, y = 0;
+		vec3 n_c = vec3(0);
+		for (int k = 0; k < vs.size(); k++) {
+			if (vs.uvs[k].x != x) {
+				x = vs.uvs[k].x;
+				y = f(x, t);
+				n_c = normalise(vec3(f.dx(x, t), -1, 0));
+			}
+			float theta = vs.uvs[k].y;
+			vec3 n = normalise(n_c * std::sin(theta) + e3 * std::cos(theta));
+			vs.positions[k] = vec3(x, y, vs.colors[k].y) + n * vs.colors[k].x + shift;
+			vs.normals[k] = n;
+		}
 	};
-	deformPerVertex(id, deformation);
 }
 
 
@@ -118,23 +120,12 @@ void String::set_tension(float T) {
 
 void String::update(float T) {
 	this->t = time_reparam(T);
-	vec3 sh = vec3(this->shift.x, this->shift.y, 0);
-	auto deformation = [&, t=t, sh](BufferedVertex &v) {
-		vec4 color = v.getColor();
-		float R = color.x;
-		float H = color.y;
-		float x = v.getUV().x;
-		float theta = v.getUV().y;
-		float y = this->f(x, t);
-		vec3 n_c = vec3(this->f.dx(x, t), -1, 0)/norm(vec3(this->f.dx(x, t), -1, 0));
-		vec3 x_center = vec3(x, y, H);
-		vec3 n = normalise(n_c * std::sin(theta) + e3 * std::cos(theta));
-
-		v.setPosition(x_center + n * R + sh);
-		v.setNormal(n);
-		v.setColor(get_params());
-	};
-	deformPerVertex(id, deformation);
+	VertexKernel tube = tubeKernel(t, vec3(shift.x, shift.y, 0));
+	// the tube reads radius and height from the colours, so they are replaced after it
+	deformBulk(id, [tube, params=get_params()](const VertexSpans &vs) {
+		tube(vs);
+		std::fill(vs.colors.begin(), vs.colors.end(), params);
+	}, {POSITION, NORMAL, COLOR});
 }
 
 DevelopingSurface::DevelopingSurface(RealFunctionR2 F, vec2 dom, int sampling_res, float h, float r, int radial_res, float T_max)
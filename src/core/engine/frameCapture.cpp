@@ -0,0 +1,361 @@
+#include "frameCapture.hpp"
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+
+#include "exceptions.hpp"
+#include "logging.hpp"
+
+
+namespace {
+	constexpr std::array<uint32_t, 256> crcTable() {
+		std::array<uint32_t, 256> table{};
+		for (uint32_t n = 0; n < 256; ++n) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k)
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+		return table;
+	}
+
+	constexpr std::array<uint32_t, 256> CRC_TABLE = crcTable();
+
+	uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc=0) {
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+			crc = CRC_TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	uint32_t adler32(const uint8_t *data, size_t size) {
+		uint32_t a = 1, b = 0;
+		while (size > 0) {
+			// largest run for which b cannot overflow before the modulo
+			size_t run = std::min<size_t>(size, 5552);
+			for (size_t i = 0; i < run; ++i) {
+				a += data[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			data += run;
+			size -= run;
+		}
+		return b << 16 | a;
+	}
+
+	void putBE32(vector<uint8_t> &out, uint32_t v) {
+		out.push_back(v >> 24);
+		out.push_back(v >> 16 & 0xFF);
+		out.push_back(v >> 8 & 0xFF);
+		out.push_back(v & 0xFF);
+	}
+
+	void putChunk(vector<uint8_t> &out, const char type[4], const uint8_t *data, size_t size) {
+		putBE32(out, size);
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data, data + size);
+		putBE32(out, crc32(out.data() + start, size + 4));
+	}
+
+	uint8_t clampByte(int v) {
+		return v < 0 ? 0 : v > 255 ? 255 : v;
+	}
+
+	Path framePath(const Path &dir, int index) {
+		string name = std::to_string(index);
+		return dir / ("frame_" + string(name.size() < 6 ? 6 - name.size() : 0, '0') + name + ".png");
+	}
+}
+
+
+void encodePNG(const uint8_t *rgba, int width, int height, vector<uint8_t> &out) {
+	static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	out.clear();
+	out.insert(out.end(), signature, signature + 8);
+
+	vector<uint8_t> header;
+	putBE32(header, width);
+	putBE32(header, height);
+	header.insert(header.end(), {8, 2, 0, 0, 0}); // 8 bit RGB, deflate, no filter, no interlace
+	putChunk(out, "IHDR", header.data(), header.size());
+
+	// filter byte (none) and RGB triples per row, flipped to top-down order
+	thread_local vector<uint8_t> raw;
+	size_t rowBytes = 1 + 3 * (size_t)width;
+	raw.resize(rowBytes * height);
+	for (int y = 0; y < height; ++y) {
+		uint8_t *dst = raw.data() + rowBytes * y;
+		const uint8_t *src = rgba + 4 * (size_t)width * (height - 1 - y);
+		*dst++ = 0;
+		for (int x = 0; x < width; ++x, src += 4) {
+			*dst++ = src[0];
+			*dst++ = src[1];
+			*dst++ = src[2];
+		}
+	}
+
+	thread_local vector<uint8_t> zlib;
+	zlib.clear();
+	zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+	size_t pos = 0;
+	do {
+		size_t len = std::min<size_t>(raw.size() - pos, 65535);
+		zlib.push_back(pos + len == raw.size());
+		zlib.push_back(len & 0xFF);
+		zlib.push_back(len >> 8);
+		zlib.push_back(~len & 0xFF);
+		zlib.push_back(~len >> 8 & 0xFF);
+		zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+		pos += len;
+	} while (pos < raw.size());
+	putBE32(zlib, adler32(raw.data(), raw.size()));
+
+	putChunk(out, "IDAT", zlib.data(), zlib.size());
+	putChunk(out, "IEND", nullptr, 0);
+}
+
+void encodeY4MFrame(const uint8_t *rgba, int width, int height, vector<uint8_t> &out) {
+	static const char tag[] = "FRAME\n";
+	size_t plane = (size_t)width * height;
+	size_t start = out.size();
+	out.insert(out.end(), tag, tag + 6);
+	out.resize(start + 6 + 3 * plane);
+	uint8_t *Y = out.data() + start + 6;
+	uint8_t *U = Y + plane;
+	uint8_t *V = U + plane;
+	for (int y = 0; y < height; ++y) {
+		const uint8_t *src = rgba + 4 * (size_t)width * (height - 1 - y);
+		for (int x = 0; x < width; ++x, src += 4) {
+			int r = src[0], g = src[1], b = src[2];
+			*Y++ = clampByte((77 * r + 150 * g + 29 * b + 128) >> 8);
+			*U++ = clampByte(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128);
+			*V++ = clampByte(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128);
+		}
+	}
+}
+
+string y4mHeader(int width, int height, int fps) {
+	return "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) + " F" + std::to_string(fps) + ":1 Ip A1:1 C444 XCOLORRANGE=FULL\n";
+}
+
+
+
+FrameWriter::FrameWriter(int width, int height, const Path &output, CaptureFormat format, int fps, int maxQueued)
+: width(width), height(height), output(output), format(format), maxQueued(std::max(1, maxQueued)) {
+	THROW_IF(width <= 0 || height <= 0, IllegalArgumentError, "Frame size must be positive.");
+	THROW_IF(fps <= 0, IllegalArgumentError, "Frame rate must be positive.");
+
+	std::error_code ec;
+	if (format == PNG_SEQUENCE)
+		std::filesystem::create_directories(output, ec);
+	else if (output.has_parent_path())
+		std::filesystem::create_directories(output.parent_path(), ec);
+	THROW_IF(ec, FileSystemError, "Cannot create capture directory for " + output.string() + ": " + ec.message());
+
+	if (format == Y4M_VIDEO) {
+		video.open(output, std::ios::binary | std::ios::trunc);
+		THROW_IF(!video, FileSystemError, "Cannot open " + output.string() + " for writing.");
+		string header = y4mHeader(width, height, fps);
+		video.write(header.data(), header.size());
+	}
+	worker = std::thread(&FrameWriter::run, this);
+}
+
+FrameWriter::~FrameWriter() {
+	try {
+		finish();
+	} catch (const std::exception &e) {
+		LOG_ERROR("Frame writer failed: " + string(e.what()));
+	}
+}
+
+void FrameWriter::run() {
+	vector<uint8_t> encoded;
+	while (true) {
+		std::pair<int, vector<uint8_t>> item;
+		{
+			std::unique_lock lock(mutex);
+			changed.wait(lock, [this] { return closing || !queue.empty(); });
+			if (queue.empty())
+				return;
+			item = std::move(queue.front());
+			queue.pop_front();
+		}
+		changed.notify_all();
+		try {
+			writeFrame(item.first, item.second, encoded);
+		} catch (...) {
+			std::lock_guard lock(mutex);
+			error = std::current_exception();
+			queue.clear();
+			changed.notify_all();
+			return;
+		}
+		std::lock_guard lock(mutex);
+		written++;
+		freeBuffers.push_back(std::move(item.second));
+	}
+}
+
+void FrameWriter::writeFrame(int index, const vector<uint8_t> &rgba, vector<uint8_t> &encoded) {
+	if (format == Y4M_VIDEO) {
+		encoded.clear();
+		encodeY4MFrame(rgba.data(), width, height, encoded);
+		video.write((const char *)encoded.data(), encoded.size());
+		THROW_IF(!video, FileSystemError, "Writing frame " + std::to_string(index) + " to " + output.string() + " failed.");
+		return;
+	}
+	encodePNG(rgba.data(), width, height, encoded);
+	Path path = framePath(output, index);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write((const char *)encoded.data(), encoded.size());
+	THROW_IF(!file, FileSystemError, "Writing frame to " + path.string() + " failed.");
+}
+
+void FrameWriter::rethrowError() {
+	if (error)
+		std::rethrow_exception(error);
+}
+
+vector<uint8_t> FrameWriter::acquireBuffer() {
+	vector<uint8_t> buffer;
+	{
+		std::lock_guard lock(mutex);
+		if (!freeBuffers.empty()) {
+			buffer = std::move(freeBuffers.back());
+			freeBuffers.pop_back();
+		}
+	}
+	buffer.resize(4 * (size_t)width * height);
+	return buffer;
+}
+
+void FrameWriter::push(int index, vector<uint8_t> &&rgba) {
+	THROW_IF(rgba.size() != 4 * (size_t)width * height, IllegalArgumentError, "Frame buffer has wrong size.");
+	std::unique_lock lock(mutex);
+	THROW_IF(closing, ValueError, "Frame pushed to a finished writer.");
+	changed.wait(lock, [this] { return queue.size() < maxQueued || error; });
+	rethrowError();
+	queue.emplace_back(index, std::move(rgba));
+	lock.unlock();
+	changed.notify_all();
+}
+
+void FrameWriter::finish() {
+	{
+		std::lock_guard lock(mutex);
+		closing = true;
+	}
+	changed.notify_all();
+	if (worker.joinable())
+		worker.join();
+	if (video.is_open())
+		video.close();
+	std::lock_guard lock(mutex);
+	rethrowError();
+}
+
+int FrameWriter::framesWritten() {
+	std::lock_guard lock(mutex);
+	return written;
+}
+
+
+
+OffscreenTarget::OffscreenTarget(int width, int height) : width(width), height(height) {
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	THROW_IF(status != GL_FRAMEBUFFER_COMPLETE, SystemError, "Offscreen framebuffer incomplete (status " + std::to_string(status) + ").");
+	bind();
+}
+
+OffscreenTarget::~OffscreenTarget() {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+}
+
+void OffscreenTarget::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+}
+
+
+
+FrameCapture::FrameCapture(int width, int height, const Path &output, CaptureFormat format, int fps, int ringSize)
+: width(width), height(height), pbos(std::max(2, ringSize)), fences(pbos.size(), nullptr), slotFrames(pbos.size(), -1),
+  writer(width, height, output, format, fps) {
+	glGenBuffers(pbos.size(), pbos.data());
+	for (GLuint pbo: pbos) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, 4 * (GLsizeiptr)width * height, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+FrameCapture::~FrameCapture() {
+	for (GLsync fence: fences)
+		if (fence)
+			glDeleteSync(fence);
+	glDeleteBuffers(pbos.size(), pbos.data());
+}
+
+void FrameCapture::collect(int slot) {
+	if (slotFrames[slot] < 0)
+		return;
+	while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+	glDeleteSync(fences[slot]);
+	fences[slot] = nullptr;
+
+	vector<uint8_t> pixels = writer.acquireBuffer();
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+	auto mapped = (const uint8_t *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixels.size(), GL_MAP_READ_BIT);
+	THROW_IF(mapped == nullptr, SystemError, "Mapping pixel buffer of frame " + std::to_string(slotFrames[slot]) + " failed.");
+	std::memcpy(pixels.data(), mapped, pixels.size());
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	writer.push(slotFrames[slot], std::move(pixels));
+	slotFrames[slot] = -1;
+}
+
+void FrameCapture::capture() {
+	int slot = frame % pbos.size();
+	collect(slot);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slotFrames[slot] = frame++;
+}
+
+void FrameCapture::finish() {
+	for (int k = 0; k < (int)pbos.size(); ++k)
+		collect((frame + k) % pbos.size());
+	writer.finish();
+}
+
+int FrameCapture::framesCaptured() const {
+	return frame;
+}
@@ -0,0 +1,201 @@
+#include "framePacer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <thread>
+
+#include "exceptions.hpp"
+
+
+namespace {
+	// the spin margin is this much above the last overshoot and decays by SPIN_MARGIN_DECAY per frame
+	constexpr double OVERSHOOT_HEADROOM = 1.25;
+	constexpr double SPIN_MARGIN_DECAY = .995;
+
+	string formatDuration(double seconds) {
+		return seconds < 1e-3 ? std::format("{:.0f}us", seconds*1e6) : std::format("{:.2f}ms", seconds*1e3);
+	}
+}
+
+
+double SteadyFrameClock::now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SteadyFrameClock::sleepFor(double seconds) {
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+}
+
+
+FrameTimeHistogram::FrameTimeHistogram(int capacity) : samples(capacity) {
+	THROW_IF(capacity < 1, IllegalArgumentError, "FrameTimeHistogram: capacity must be positive, got " + to_string(capacity));
+}
+
+void FrameTimeHistogram::record(double seconds) {
+	samples[next] = seconds;
+	if (++next == samples.size()) {
+		next = 0;
+		full = true;
+	}
+}
+
+void FrameTimeHistogram::clear() {
+	next = 0;
+	full = false;
+}
+
+std::vector<double> FrameTimeHistogram::window() const {
+	if (!full)
+		return std::vector<double>(samples.begin(), samples.begin() + next);
+	std::vector<double> res(samples.begin() + next, samples.end());
+	res.insert(res.end(), samples.begin(), samples.begin() + next);
+	return res;
+}
+
+double FrameTimeHistogram::last() const {
+	THROW_IF(empty(), ValueError, "FrameTimeHistogram: no samples recorded");
+	return samples[next == 0 ? samples.size() - 1 : next - 1];
+}
+
+double FrameTimeHistogram::mean() const {
+	THROW_IF(empty(), ValueError, "FrameTimeHistogram: no samples recorded");
+	double sum = 0;
+	for (int i = 0; i < count(); ++i)
+		sum += samples[i];
+	return sum/count();
+}
+
+double FrameTimeHistogram::min() const {
+	THROW_IF(empty(), ValueError, "FrameTimeHistogram: no samples recorded");
+	return *std::min_element(samples.begin(), samples.begin() + count());
+}
+
+double FrameTimeHistogram::max() const {
+	THROW_IF(empty(), ValueError, "FrameTimeHistogram: no samples recorded");
+	return *std::max_element(samples.begin(), samples.begin() + count());
+}
+
+double FrameTimeHistogram::stddev() const {
+	double mu = mean(), sum = 0;
+	for (int i = 0; i < count(); ++i)
+		sum += (samples[i] - mu)*(samples[i] - mu);
+	return std::sqrt(sum/count());
+}
+
+double FrameTimeHistogram::quantile(double q) const {
+	THROW_IF(empty(), ValueError, "FrameTimeHistogram: no samples recorded");
+	THROW_IF(q < 0 || q > 1, IllegalArgumentError, "FrameTimeHistogram: quantile " + to_string(q) + " outside of [0, 1]");
+	std::vector<double> sorted(samples.begin(), samples.begin() + count());
+	int rank = std::clamp((int)std::ceil(q*sorted.size()) - 1, 0, (int)sorted.size() - 1);
+	std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+	return sorted[rank];
+}
+
+int FrameTimeHistogram::bucketOf(double seconds) {
+	if (!(seconds > MIN_BUCKET_SECONDS))
+		return 0;
+	return std::min((int)(std::log2(seconds/MIN_BUCKET_SECONDS)*BUCKETS_PER_OCTAVE), BUCKETS - 1);
+}
+
+double FrameTimeHistogram::bucketLowerBound(int bucket) {
+	return bucket == 0 ? 0. : MIN_BUCKET_SECONDS*std::exp2((double)bucket/BUCKETS_PER_OCTAVE);
+}
+
+std::array<int, FrameTimeHistogram::BUCKETS> FrameTimeHistogram::histogram() const {
+	std::array<int, BUCKETS> res{};
+	for (int i = 0; i < count(); ++i)
+		++res[bucketOf(samples[i])];
+	return res;
+}
+
+
+FramePacer::FramePacer(FramePacing mode, float fps, std::shared_ptr<FrameClock> clock, int historyFrames, double minSpinMargin)
+: clock(std::move(clock)), minSpinMargin(minSpinMargin), spinMargin(minSpinMargin),
+  frames(historyFrames), simulation(historyFrames), render(historyFrames), waiting(historyFrames) {
+	THROW_IF(this->clock == nullptr, IllegalArgumentError, "FramePacer: no clock given");
+	setTarget(mode, fps);
+}
+
+void FramePacer::setTarget(FramePacing mode, float fps) {
+	THROW_IF(mode != FramePacing::UNCAPPED && !(fps > 0), IllegalArgumentError, "FramePacer: capped and fixed pacing need a positive frame rate, got " + to_string(fps));
+	_mode = mode;
+	period = mode == FramePacing::UNCAPPED ? 0. : 1./fps;
+	deadline = frameStart + period;
+}
+
+void FramePacer::reset() {
+	started = false;
+	simulationEnd = -1;
+}
+
+void FramePacer::waitUntil(double time) {
+	double remaining = time - clock->now();
+	if (remaining > spinMargin) {
+		double wake = time - spinMargin;
+		clock->sleepFor(remaining - spinMargin);
+		double overshoot = clock->now() - wake;
+		spinMargin = std::max({minSpinMargin, OVERSHOOT_HEADROOM*overshoot, SPIN_MARGIN_DECAY*spinMargin});
+	}
+	while (clock->now() < time)
+		clock->relax();
+}
+
+double FramePacer::beginFrame() {
+	double now = clock->now();
+	simulationEnd = -1;
+	if (!started) {
+		started = true;
+		frameStart = now;
+		deadline = now + period;
+		return _mode == FramePacing::FIXED ? period : 0.;
+	}
+	if (_mode != FramePacing::UNCAPPED) {
+		if (_mode == FramePacing::FIXED && now > deadline + period)
+			deadline = now;
+		waitUntil(deadline);
+	}
+	double start = clock->now();
+	waiting.record(start - now);
+	frames.record(start - frameStart);
+	double dt = _mode == FramePacing::FIXED ? period : start - frameStart;
+	frameStart = start;
+	deadline = (_mode == FramePacing::FIXED ? deadline : start) + period;
+	return dt;
+}
+
+void FramePacer::markSimulationDone() {
+	simulationEnd = clock->now();
+	simulation.record(simulationEnd - frameStart);
+}
+
+void FramePacer::endFrame() {
+	render.record(clock->now() - (simulationEnd >= 0 ? simulationEnd : frameStart));
+}
+
+std::string FramePacer::summary() const {
+	std::string res;
+	for (auto [name, times]: {std::pair("frame", &frames), std::pair("simulation", &simulation), std::pair("render", &render), std::pair("wait", &waiting)}) {
+		if (times->empty())
+			continue;
+		res += std::format("{:<10} mean {:>8}  p50 {:>8}  p90 {:>8}  p99 {:>8}  max {:>8}  ({} frames)\n", name,
+			formatDuration(times->mean()), formatDuration(times->quantile(.5)), formatDuration(times->quantile(.9)),
+			formatDuration(times->quantile(.99)), formatDuration(times->max()), times->count());
+	}
+	return res;
+}
+
+void FramePacer::dump(std::ostream &out) const {
+	out << summary();
+	for (auto [name, times]: {std::pair("frame", &frames), std::pair("simulation", &simulation), std::pair("render", &render), std::pair("wait", &waiting)}) {
+		if (times->empty())
+			continue;
+		out << name << " histogram\n";
+		auto buckets = times->histogram();
+		for (int b = 0; b < FrameTimeHistogram::BUCKETS; ++b)
+			if (buckets[b] > 0)
+				out << std::format("  [{:>8}, {:>8}) {}\n", formatDuration(FrameTimeHistogram::bucketLowerBound(b)),
+					b + 1 < FrameTimeHistogram::BUCKETS ? formatDuration(FrameTimeHistogram::bucketLowerBound(b + 1)) : string("inf"), buckets[b]);
+	}
+}
@@ -295,6 +295,46 @@ Window::Window(Resolution resolution, const char *title)
 	glfwMakeContextCurrent(window);
 }
 
+Window::Window(GLFWwindow *window, int width, int height)
+{
+	this->window = window;
+	this->width = width;
+	this->height = height;
+	this->aspectRatio = (float)width / (float)height;
+	glfwMakeContextCurrent(window);
+}
+
+Window::Window(unique_ptr<HeadlessContext> context, int width, int height)
+{
+	this->window = nullptr;
+	this->headlessContext = std::move(context);
+	this->width = width;
+	this->height = height;
+	this->aspectRatio = (float)width / (float)height;
+}
+
+unique_ptr<Window> Window::offscreen(int width, int height)
+{
+	if (auto context = HeadlessContext::create())
+		return std::make_unique<Window>(std::move(context), width, height);
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_SAMPLES, 0);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	for (int api : {GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API, GLFW_NATIVE_CONTEXT_API}) {
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+		GLFWwindow *handle = glfwCreateWindow(width, height, "offscreen", nullptr, nullptr);
+		if (handle) {
+			glfwDefaultWindowHints();
+			return std::make_unique<Window>(handle, width, height);
+		}
+	}
+	glfwDefaultWindowHints();
+	THROW(SystemError, "Offscreen context creation failed with EGL, OSMesa and native context APIs");
+}
+
 Window::~Window()
 {
 	destroy();
@@ -302,6 +342,7 @@ Window::~Window()
 
 int Window::destroy() {
     glfwDestroyWindow(this->window);
+	this->window = nullptr;
     // glfwTerminate(); // removed; handled by Renderer
     return 0;
 }
@@ -412,6 +453,7 @@ void ShaderProgram::linkShaders() {
 	glDeleteShader(FragmentShaderID);
 
 	shaderType = geometryShader ? GEOMETRY1 : CLASSIC;
+	uniformValues = UniformShadowBlock::ofProgram(programID);
 }
 
 
@@ -483,129 +525,118 @@ void ShaderProgram::setUniforms(const std::unordered_map<string, const GLfloat *
 	
 }
 
-void ShaderProgram::setUniform(const string &uniformName, const GLfloat *uniformValue)
+int ShaderProgram::uniformSlot(const string &uniformName, GLSLType uniformType, int count)
 {
-	GLSLType uniformType = this->uniformTypes[uniformName];
-	GLuint uniformLocation = this->uniformLocations[uniformName];
+	auto slot = uniformSlots.find(uniformName);
+	if (slot != uniformSlots.end()) {
+		THROW_IF(uniformValues->count(slot->second) != count, IllegalArgumentError, "Uniform " + uniformName + " was declared with another array size");
+		return slot->second;
+	}
+	auto location = uniformLocations.find(uniformName);
+	if (location == uniformLocations.end())
+		location = uniformLocations.emplace(uniformName, glGetUniformLocation(this->programID, uniformName.c_str())).first;
+	uniformTypes[uniformName] = uniformType;
+	int i = uniformValues->add(uniformName, (GLint)location->second, uniformType, count);
+	uniformSlots[uniformName] = i;
+	return i;
+}
 
-	switch (uniformType)
-	{
-	case FLOAT:
-		glUniform1fv(uniformLocation, 1, uniformValue);
-		break;
-	case INT:
-		glUniform1iv(uniformLocation, 1, (GLint *)uniformValue);
-		break;
-	case VEC2:
-		glUniform2fv(uniformLocation, 1, uniformValue);
-		break;
-	case VEC3:
-		glUniform3fv(uniformLocation, 1, uniformValue);
-		break;
-	case VEC4:
-		glUniform4fv(uniformLocation, 1, uniformValue);
-		break;
-	case MAT2:
-		glUniformMatrix2fv(uniformLocation, 1, GL_FALSE, uniformValue);
-		break;
-	case MAT3:
-		glUniformMatrix3fv(uniformLocation, 1, GL_FALSE, uniformValue);
-		break;
-	case MAT4:
-		glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, uniformValue);
-		break;
+void ShaderProgram::stageUniform(const string &uniformName, GLSLType uniformType, const void *value)
+{
+	uniformValues->write(uniformSlot(uniformName, uniformType), value);
+	uniformValues->flush();
+}
 
-	default:
-		throw std::invalid_argument("Uniform type not recognized");
-	}
+void ShaderProgram::flushUniforms()
+{
+	uniformValues->flush();
 }
 
+void ShaderProgram::setUniform(const string &uniformName, const GLfloat *uniformValue)
+{
+	GLSLType uniformType = this->uniformTypes[uniformName];
+	if (uniformType > MAT4)
+		throw std::invalid_argument("Uniform type not recognized");
+	stageUniform(uniformName, uniformType, uniformValue);
+}
 void ShaderProgram::setUniform(const string &uniformName, float uniformValue)
 {
 	if (this->uniformTypes[uniformName] != FLOAT)
 		throw std::invalid_argument("Uniform type must be FLOAT");
-	GLuint uniformLocation = this->uniformLocations[uniformName];
-	glUniform1f(uniformLocation, uniformValue);
+	stageUniform(uniformName, FLOAT, &uniformValue);
 }
 
 void ShaderProgram::setUniform(const string &uniformName, int uniformValue)
 {
 	if (this->uniformTypes[uniformName] != INT)
 		throw std::invalid_argument("Uniform type must be INT");
-	GLuint uniformLocation = this->uniformLocations[uniformName];
-	glUniform1i(uniformLocation, uniformValue);
+	stageUniform(uniformName, INT, &uniformValue);
 }
 
 void ShaderProgram::setUniform(const string &uniformName, vec2 uniformValue)
 {
 	if (this->uniformTypes[uniformName] != VEC2)
 		throw std::invalid_argument("Uniform type must be VEC2");
-	GLuint uniformLocation = this->uniformLocations[uniformName];
-	glUniform2f(uniformLocation, uniformValue.x, uniformValue.y);
+	stageUniform(uniformName, VEC2, &uniformValue);
 }
 
 void ShaderProgram::setUniform(const string &uniformName, vec3 uniformValue)
 {
 	if (this->uniformTypes[uniformName] != VEC3)
 		throw std::invalid_argument("Uniform type must be VEC3");
-	GLuint uniformLocation = this->uniformLocations[uniformName];
-	glUniform3f(uniformLocation, uniformValue.x, uniformValue.y, uniformValue.z);
+	stageUniform(uniformName, VEC3, &uniformValue);
 }
 
 void ShaderProgram::setUniform(const string &uniformName, vec4 uniformValue)
 {
 	if (this->uniformTypes[uniformName] != VEC4)
 		throw std::invalid_argument("Uniform type must be VEC4");
-	GLuint uniformLocation = this->uniformLocations[uniformName];
-	glUniform4f(uniformLocation, uniformValue.x, uniformValue.y, uniformValue.z, uniformValue.w);
+	stageUniform(uniformName, VEC4, &uniformValue);
 }
 
 void ShaderProgram::setUniform(const string &uniformName, mat2 uniformValue)
 {
 	if (this->uniformTypes[uniformName] != MAT2)
 		throw std::invalid_argument("Uniform type must be MAT2");
-	GLuint uniformLocation = this->uniformLocations[uniformName];
-	glUniformMatrix2fv(uniformLocation, 1, GL_FALSE, &uniformValue[0][0]);
+	stageUniform(uniformName, MAT2, &uniformValue);
 }
 
 void ShaderProgram::setUniform(const string &uniformName, mat3 uniformValue)
 {
 	if (this->uniformTypes[uniformName] != MAT3)
 		throw std::invalid_argument("Uniform type must be MAT3");
-	GLuint uniformLocation = this->uniformLocations[uniformName];
-	glUniformMatrix3fv(uniformLocation, 1, GL_FALSE, &uniformValue[0][0]);
+	stageUniform(uniformName, MAT3, &uniformValue);
 }
 
 void ShaderProgram::setUniform(const string& uniformName, mat4 uniformValue)
 {
 	if (this->uniformTypes[uniformName] != MAT4)
 		throw std::invalid_argument("Uniform type must be MAT4");
-	GLuint uniformLocation = this->uniformLocations[uniformName];
-	glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, &uniformValue[0][0]);
+	stageUniform(uniformName, MAT4, &uniformValue);
 }
 
 void ShaderProgram::setUniform(const string& uniformName, float x, float y)
 {
 	if (this->uniformTypes[uniformName] != VEC2)
 		throw std::invalid_argument("Uniform type must be VEC2");
-	GLuint uniformLocation = this->uniformLocations[uniformName];
-	glUniform2f(uniformLocation, x, y);
+	vec2 value = vec2(x, y);
+	stageUniform(uniformName, VEC2, &value);
 }
 
 void ShaderProgram::setUniform(const string &uniformName, float x, float y, float z)
 {
 	if (this->uniformTypes[uniformName] != VEC3)
 		throw std::invalid_argument("Uniform type must be VEC3");
-	GLuint uniformLocation = this->uniformLocations[uniformName];
-	glUniform3f(uniformLocation, x, y, z);
+	vec3 value = vec3(x, y, z);
+	stageUniform(uniformName, VEC3, &value);
 }
 
 void ShaderProgram::setUniform(const string &uniformName, float x, float y, float z, float w)
 {
 	if (this->uniformTypes[uniformName] != VEC4)
 		throw std::invalid_argument("Uniform type must be VEC4");
-	GLuint uniformLocation = this->uniformLocations[uniformName];
-	glUniform4f(uniformLocation, x, y, z, w);
+	vec4 value = vec4(x, y, z, w);
+	stageUniform(uniformName, VEC4, &value);
 }
 
 
@@ -714,6 +745,8 @@ Attribute::Attribute(const string &name, GLSLType type, int inputNumber, CommonB
 	this->size = sizeOfGLSLType(type);
 	this->enabled = false;
 	this->bufferInitialized = false;
+	this->allocatedBytes = 0;
+	this->uploadedGeneration = 0;
 	this->inputNumber = inputNumber;
 	this->bufferType = bufferType;
 }
@@ -753,20 +786,37 @@ void Attribute::load(const void *firstElementAdress, int bufferLength)
 	    initBuffer();
 	    glBindBuffer(GL_ARRAY_BUFFER, this->bufferAddress);
 	    glBufferData(GL_ARRAY_BUFFER, bufferLength * this->size, firstElementAdress, GL_STATIC_DRAW);
+	    allocatedBytes = bufferLength * this->size;
 	    return;
 	}
 	glBindBuffer(GL_ARRAY_BUFFER, this->bufferAddress);
      glBufferData(GL_ARRAY_BUFFER, bufferLength * this->size, firstElementAdress, GL_STATIC_DRAW);
-    // void *ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-    // memcpy(ptr, firstElementAdress, bufferLength * this->size);
-    // glUnmapBuffer(GL_ARRAY_BUFFER);
+	allocatedBytes = bufferLength * this->size;
+}
 
+void Attribute::upload(const void *firstElementAdress, const vector<BufferUpload> &uploads) {
+	if (uploads.empty())
+		return;
+	if (!bufferInitialized)
+		initBuffer();
+	glBindBuffer(GL_ARRAY_BUFFER, this->bufferAddress);
+	for (const auto &u: uploads) {
+		const void *src = u.size > 0 ? static_cast<const char *>(firstElementAdress) + u.offset : nullptr;
+		if (u.respecify) {
+			glBufferData(GL_ARRAY_BUFFER, u.size, src, GL_DYNAMIC_DRAW);
+			allocatedBytes = u.size;
+		}
+		else
+			glBufferSubData(GL_ARRAY_BUFFER, u.offset, u.size, src);
+	}
 }
 
 void Attribute::freeBuffer() {
     glDeleteBuffers(1, &this->bufferAddress);
     this->bufferAddress = -1;
     this->bufferInitialized = false;
+    this->allocatedBytes = 0;
+    this->uploadedGeneration = 0;
     this->enabled = false;
 }
 
@@ -790,6 +840,9 @@ RenderingStep::RenderingStep(const RenderingStep& other)
 	this->attributes = other.attributes;
 	this->uniforms = other.uniforms;
 	this->uniformSetters = other.uniformSetters;
+	this->setterSequence = other.setterSequence;
+	this->handleSetters = other.handleSetters;
+	this->uniformBuffers = other.uniformBuffers;
 	this->customStep = other.customStep;
 	this->material = other.material;
 }
@@ -826,21 +879,34 @@ void RenderingStep::bindTextures() {
 	shader->setTextureSampler(material->texture_specular.get());
 }
 
+// storage is allocated by the first loadElementBuffer
 void RenderingStep::initElementBuffer() {
     glGenBuffers(1, &elementBufferLoc);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferLoc);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, weak_super->bufferIndexSize(), weak_super->bufferIndexLocation(), GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferLoc);
-
+    elementBufferBytes = 0;
+    elementBufferGeneration = 0;
 }
 
 void RenderingStep::loadElementBuffer() {
     if (!weakSuperLoaded())
         throw std::invalid_argument("Element buffer can only be loaded for weak super mesh");
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferLoc);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, weak_super->bufferIndexSize(), weak_super->bufferIndexLocation(), GL_DYNAMIC_DRAW);
+    auto uploads = weak_super->getBufferBoss().collectUploads(INDEX, elementBufferBytes, elementBufferGeneration, &uploadLog);
+    for (const auto &u: uploads) {
+        const void *src = u.size > 0 ? static_cast<const char *>(weak_super->bufferIndexLocation()) + u.offset : nullptr;
+        if (u.respecify) {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, u.size, src, GL_DYNAMIC_DRAW);
+            elementBufferBytes = u.size;
+        }
+        else
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, u.offset, u.size, src);
+    }
 }
 
+const BufferUploadLog & RenderingStep::uploadStatistics() const { return uploadLog; }
+
+void RenderingStep::resetUploadStatistics() { uploadLog.reset(); }
+
 void RenderingStep::initStdAttributes()
 {
 	this->attributes.push_back(make_shared<Attribute>("position", VEC3, 0, POSITION));
@@ -878,9 +944,13 @@ void RenderingStep::initUnusualAttributes(const std::vector<shared_ptr<Attribute
 
 
 
+// only ranges written since the previous call of this step are transferred, an unchanged mesh uploads nothing
 void RenderingStep::loadMeshAttributes() {
-	for (const auto& attribute : attributes)
-		attribute->load(weak_super->getBufferLocation(attribute->bufferType), weak_super->getBufferLength(attribute->bufferType));
+	for (const auto& attribute : attributes) {
+		auto uploads = weak_super->getBufferBoss().collectUploads(attribute->bufferType, attribute->allocatedBytes, attribute->uploadedGeneration, &uploadLog);
+		if (!uploads.empty())
+			attribute->upload(weak_super->getBufferLocation(attribute->bufferType), uploads);
+	}
 }
 
 void RenderingStep::initWeakMeshAttributes() {
@@ -904,6 +974,15 @@ void RenderingStep::addUniform(string uniformName, GLSLType uniformType, shared_
 	this->uniforms[uniformName] = uniformType;
 	this->uniformSetters[uniformName] = std::move(setter);
 	this->shader->initUniforms({{uniformName, uniformType}});
+	setterSequence.clear();
+	for (const auto &s : uniformSetters | std::views::values)
+		setterSequence.push_back(s);
+}
+
+void RenderingStep::addUniformBuffer(const shared_ptr<UniformBufferBlock> &block, const string &blockName, GLuint bindingPoint)
+{
+	block->attach(shader->programID, blockName, bindingPoint);
+	uniformBuffers.push_back(block);
 }
 
 void RenderingStep::addConstFloats(const std::map<string, float>& uniforms)
@@ -954,39 +1033,25 @@ void RenderingStep::addMaterialUniforms() {
 
 void RenderingStep::setUniforms(float t)
 {
-	for (const auto &key: uniforms | std::views::keys)
-	{
-		auto name = key;
-		(*uniformSetters[name])(t, shader);
-	}
+	for (const auto &setter : setterSequence)
+		(*setter)(t, shader);
+	for (const auto &setter : handleSetters)
+		setter(t);
+	shader->flushUniforms();
+	for (const auto &block : uniformBuffers)
+		block->flush();
 }
 
 void RenderingStep::addCameraUniforms(const shared_ptr<Camera>& camera)
 {
-	std::function<void(float, shared_ptr<ShaderProgram>)> MVPsetter;
-
-	if (weakSuperLoaded())
-		MVPsetter = [camera, this](float t, const shared_ptr<ShaderProgram> &shader) {
-			mat4 mvp = camera->mvp(t, mat4(mat3(1)));
-			shader->setUniform("mvp", mvp);
-		};
-
-	auto positionSetter = [camera, this](float t, const shared_ptr<ShaderProgram> &shader) {
-		vec3 camPos = camera->position(t);
-		shader->setUniform("camPosition", camPos);
-	};
-	addUniform("mvp", MAT4,  std::make_shared<std::function<void(float, shared_ptr<ShaderProgram>)>>(MVPsetter));
-	addUniform("camPosition", VEC3,  std::make_shared<std::function<void(float, shared_ptr<ShaderProgram>)>>(positionSetter));
+	addUniform<mat4>("mvp", [camera](float t) { return camera->mvp(t, mat4(mat3(1))); });
+	addUniform<vec3>("camPosition", [camera](float t) { return camera->position(t); });
 }
 
 void RenderingStep::addLightUniform(const Light& pointLight, int lightIndex)
 {
-	string lightName = "light" + std::to_string(lightIndex);
-	auto lightSetter = [pointLight, lightName](float t, const shared_ptr<ShaderProgram> &shader) {
-		mat4 lightMat = pointLight.compressToMatrix();
-		shader->setUniform(lightName, lightMat);
-	};
-	addUniform(lightName, MAT4, std::make_shared<std::function<void(float, shared_ptr<ShaderProgram>)>>(lightSetter));
+	mat4 lightMat = pointLight.compressToMatrix();
+	addUniform<mat4>("light" + std::to_string(lightIndex), [lightMat](float t) { return lightMat; });
 }
 
 void RenderingStep::addLightsUniforms(const std::vector<Light> &lights)
@@ -1036,7 +1101,7 @@ void RenderingStep::weakMeshRenderStep(float t) {
 	// bindTextures();
 
     enableAttributes();
-    glDrawElements(GL_TRIANGLES, weak_super->bufferIndexSize(), GL_UNSIGNED_INT, 0);
+    glDrawElements(GL_TRIANGLES, weak_super->bufferIndexLength()*3, GL_UNSIGNED_INT, 0);
     disableAttributes();
 }
 
@@ -1050,6 +1115,29 @@ void RenderingStep::renderStep(float t)
         throw ValueError("Mesh not loaded correctly", __FILE__, __LINE__);
 }
 
+InstancedRenderingStep::InstancedRenderingStep(const shared_ptr<ShaderProgram> &shader, const shared_ptr<MaterialPhong> &material, const shared_ptr<InstancedMesh> &instanced, InstanceCalls calls)
+: RenderingStep(shader, material), instanced(instanced), instanceBuffers(std::move(calls)) {
+	setWeakSuperMesh(instanced->getShape());
+}
+
+void InstancedRenderingStep::init(const shared_ptr<Camera> &cam, const std::vector<Light> &lights) {
+	RenderingStep::init(cam, lights);
+	instanceBuffers.load(instanced->instances());
+}
+
+void InstancedRenderingStep::renderStep(float t) {
+	shader->use();
+	loadMeshAttributes();
+	customStep(t);
+	setUniforms(t);
+	loadElementBuffer();
+	instanceBuffers.load(instanced->instances());
+
+	enableAttributes();
+	instanceBuffers.draw(instanced->instances(), *weak_super);
+	disableAttributes();
+}
+
 RenderSettings::RenderSettings(vec4 bgColor, bool alphaBlending, bool depthTest, bool timeUniform, float speed, int maxFPS, bool takeScreenshots, Resolution resolution, float screenshotFrequency, const string &windowTitle):
 bgColor(bgColor),
 alphaBlending(alphaBlending),
@@ -1062,15 +1150,11 @@ resolution(resolution),
 screenshotFrequency(screenshotFrequency),
 windowTitle(windowTitle) {
 
-	if (takeScreenshots)
-		throw NotImplementedError("Screenshot functionality not implemented yet.", __FILE__, __LINE__);
-	this->screenshotFrequency = -1;
-
 	screenshotDirectory = ConfigFile().getScreenshotsDir();
 }
 
 Renderer::Renderer(float animSpeed, vec4 bgColor, const string &screenshotDirectory, float screenshotFrequency)
-: settings(bgColor,
+: Renderer(RenderSettings(bgColor,
 		   true,
 		   true,
 		   true,
@@ -1078,7 +1162,10 @@ Renderer::Renderer(float animSpeed, vec4 bgColor, const string &screenshotDirect
 		   120,
 		   false,
 		   UNKNOWN,
-		   screenshotFrequency) {
+		   screenshotFrequency)) {}
+
+Renderer::Renderer(const RenderSettings &settings)
+: settings(settings) {
 
 	this->window = nullptr;
 	this->vao = 0;
@@ -1090,26 +1177,22 @@ Renderer::Renderer(float animSpeed, vec4 bgColor, const string &screenshotDirect
 	glfwSetErrorCallback([](int error, const char* description) {
         std::cerr << "GLFW Error " << error << ": " << description << std::endl;
     });
+	if (settings.headless)
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
     if (!glfwInit()) {
         throw SystemError("Failed to initialize GLFW", __FILE__, __LINE__);
     }
 
-	this->animSpeed = [animSpeed](float t) { return animSpeed; };
+	this->animSpeed = [speed=settings.speed](float t) { return speed; };
 	this->perFrameFunction = [](float t, float delta) {};
-
-}
-
-Renderer::Renderer(const RenderSettings &settings)
-: Renderer(settings.speed, settings.bgColor, settings.screenshotDirectory.string(), settings.screenshotFrequency)
-{
-	this->settings = settings;
-	this->animSpeed = [settings](float t) { return settings.speed; };
+	setFramePacing(settings.maxFPS > 0 ? settings.pacing : FramePacing::UNCAPPED, settings.maxFPS);
 
 }
 
 
 Renderer::~Renderer()
 {
+	offscreen.reset();
 	if (window != nullptr)
 		window->destroy();
 	if (camera != nullptr)
@@ -1137,11 +1220,35 @@ void Renderer::initMainWindow() {
 	initMainWindow(predefinedWidth(settings.resolution), predefinedHeight(settings.resolution), title);
 }
 
+void Renderer::initOffscreen(int width, int height) {
+	this->window = Window::offscreen(width, height);
+	glewExperimental = true;
+	// GLEW_NO_GLX_DISPLAY is expected for EGL and OSMesa contexts, the entry points still resolve
+	GLenum err = glewInit();
+	if (err != GLEW_OK && glGenFramebuffers == nullptr) {
+		LOG_ERROR("Failed to initialize GLEW");
+		throw SystemError("Failed to initialize GLEW", __FILE__, __LINE__);
+	}
+	this->vao = bindVAO();
+	this->offscreen = std::make_unique<OffscreenTarget>(width, height);
+	LOG("Offscreen target initialized with size: " + std::to_string(width) + "x" + std::to_string(height));
+}
+
+void Renderer::initOffscreen(Resolution resolution) {
+	initOffscreen(predefinedWidth(resolution), predefinedHeight(resolution));
+}
+
 void Renderer::resetTimer() {
-	last_time_capture = glfwGetTime();
+	pacer.reset();
 	this->time = 0;
 }
 
+void Renderer::setFramePacing(FramePacing mode, float fps) {
+	pacer.setTarget(mode, fps);
+	settings.pacing = mode;
+	settings.maxFPS = mode == FramePacing::UNCAPPED ? 0 : std::round(fps);
+}
+
 void Renderer::addRenderingStep(shared_ptr<RenderingStep> renderingStep)
 {
 	this->renderingSteps.push_back(std::move(renderingStep));
@@ -1153,6 +1260,10 @@ void Renderer::addMeshStep(const ShaderProgram &shader, const shared_ptr<Indexed
 	addRenderingStep(renderingStep);
 }
 
+void Renderer::addInstancedMeshStep(const ShaderProgram &shader, const shared_ptr<InstancedMesh> &model, const shared_ptr<MaterialPhong> &material) {
+	addRenderingStep(make_shared<InstancedRenderingStep>(make_shared<ShaderProgram>(shader), material, model));
+}
+
 
 
 void Renderer::setCamera(const shared_ptr<Camera> &camera)
@@ -1183,23 +1294,31 @@ void Renderer::setLightsWithMesh(const std::vector<Light> &lights, float ambient
 		setLightWithMesh(light, ambient, diff, spec, shine, shader, radius);
 }
 
-float Renderer::initFrame()
+void Renderer::clearFrame()
 {
 //	glViewport(0, 0, window->width, window->height);
 	glClearColor(settings.bgColor.x, settings.bgColor.y, settings.bgColor.z, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+}
 
-	float real_dt = 0;
-	while (real_dt * settings.maxFPS < 1.0f) {
-		auto t = glfwGetTime();
-		real_dt += t - last_time_capture;
-		last_time_capture = t;
-	}
+float Renderer::initFrame()
+{
+	clearFrame();
+
+	float real_dt = pacer.beginFrame();
     dt = real_dt*animSpeed(time);
 	time += dt;
 	return time;
 }
 
+float Renderer::initFrame(float frameDuration)
+{
+	clearFrame();
+	dt = frameDuration*animSpeed(time);
+	time += dt;
+	return time;
+}
+
 
 
 float Renderer::lastDeltaTime() const {
@@ -1269,10 +1388,8 @@ void Renderer::addConstUniform(const string &uniformName, GLSLType uniformType,
 
 void Renderer::addTimeUniform()
 {
-	addPerFrameUniform("time", FLOAT, std::make_shared<std::function<void(float, shared_ptr<ShaderProgram>)>>(
-	[](float t, const shared_ptr<ShaderProgram> &shader) {
-		shader->setUniform("time", t);
-	}));
+	for (const auto& renderingStep : renderingSteps)
+		renderingStep->addUniform<float>("time", [](float t) { return t; });
 }
 
 void Renderer::addConstFloats(const std::map<string, float> &uniforms)
@@ -1316,11 +1433,46 @@ void Renderer::renderAllSteps()
 int Renderer::mainLoop() {
     initRendering();
 	resetTimer();
+	unique_ptr<FrameCapture> screenshots = nullptr;
+	float nextScreenshot = 0;
+	if (settings.takeScreenshots)
+		screenshots = std::make_unique<FrameCapture>(window->width, window->height, settings.screenshotDirectory, PNG_SEQUENCE, std::max(settings.maxFPS, 1));
     while (window->isOpen()) {
     	initFrame();
     	perFrameFunction(time, dt);
+    	pacer.markSimulationDone();
         renderAllSteps();
+    	if (screenshots != nullptr && time >= nextScreenshot) {
+    		screenshots->capture();
+    		nextScreenshot = time + settings.screenshotFrequency;
+    	}
     	window->renderFramebufferToScreen();
+    	pacer.endFrame();
     }
+	if (screenshots != nullptr)
+		screenshots->finish();
+	if (!pacer.frameTimes().empty())
+		LOG("Frame times of the last " + std::to_string(pacer.frameTimes().count()) + " frames:\n" + pacer.summary());
     return window->destroy();
 }
+
+int Renderer::renderOffline(int frames, int fps, const Path &output, CaptureFormat format) {
+	THROW_IF(offscreen == nullptr, ValueError, "Offline rendering needs a context created by initOffscreen.");
+	THROW_IF(frames < 0 || fps <= 0, IllegalArgumentError, "Frame count must be non-negative and frame rate positive.");
+	initRendering();
+	offscreen->bind();
+	time = 0;
+	dt = 0;
+
+	FrameCapture capture(offscreen->width, offscreen->height, output, format, fps);
+	for (int frame = 0; frame < frames; ++frame) {
+		// the first frame shows time 0, time steps between captures
+		initFrame(frame == 0 ? 0 : 1.f/fps);
+		perFrameFunction(time, dt);
+		renderAllSteps();
+		capture.capture();
+	}
+	capture.finish();
+	LOG("Rendered " + std::to_string(frames) + " frames offline to " + output.string());
+	return 0;
+}
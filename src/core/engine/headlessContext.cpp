@@ -0,0 +1,131 @@
+#include "headlessContext.hpp"
+
+#include "logging.hpp"
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+
+#ifndef _WIN32
+namespace {
+	// the few EGL 1.5 declarations needed here, to not depend on EGL headers being installed
+	typedef void *EGLDisplay;
+	typedef void *EGLConfig;
+	typedef void *EGLContext;
+	typedef void *EGLSurface;
+	typedef int EGLint;
+	typedef unsigned int EGLBoolean;
+	typedef unsigned int EGLenum;
+
+	constexpr EGLint EGL_NONE = 0x3038;
+	constexpr EGLint EGL_RED_SIZE = 0x3024;
+	constexpr EGLint EGL_GREEN_SIZE = 0x3023;
+	constexpr EGLint EGL_BLUE_SIZE = 0x3022;
+	constexpr EGLint EGL_ALPHA_SIZE = 0x3021;
+	constexpr EGLint EGL_SURFACE_TYPE = 0x3033;
+	constexpr EGLint EGL_PBUFFER_BIT = 0x0001;
+	constexpr EGLint EGL_RENDERABLE_TYPE = 0x3040;
+	constexpr EGLint EGL_OPENGL_BIT = 0x0008;
+	constexpr EGLenum EGL_OPENGL_API = 0x30A2;
+	constexpr EGLint EGL_CONTEXT_MAJOR_VERSION = 0x3098;
+	constexpr EGLint EGL_CONTEXT_MINOR_VERSION = 0x30FB;
+	constexpr EGLint EGL_CONTEXT_OPENGL_PROFILE_MASK = 0x30FD;
+	constexpr EGLint EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT = 0x0001;
+	constexpr EGLenum EGL_PLATFORM_SURFACELESS_MESA = 0x31DD;
+
+	typedef void *(*PFN_eglGetProcAddress)(const char *);
+	typedef EGLDisplay (*PFN_eglGetPlatformDisplay)(EGLenum, void *, const EGLint *);
+	typedef EGLDisplay (*PFN_eglGetDisplay)(void *);
+	typedef EGLBoolean (*PFN_eglInitialize)(EGLDisplay, EGLint *, EGLint *);
+	typedef EGLBoolean (*PFN_eglChooseConfig)(EGLDisplay, const EGLint *, EGLConfig *, EGLint, EGLint *);
+	typedef EGLBoolean (*PFN_eglBindAPI)(EGLenum);
+	typedef EGLContext (*PFN_eglCreateContext)(EGLDisplay, EGLConfig, EGLContext, const EGLint *);
+	typedef EGLBoolean (*PFN_eglMakeCurrent)(EGLDisplay, EGLSurface, EGLSurface, EGLContext);
+	typedef EGLBoolean (*PFN_eglDestroyContext)(EGLDisplay, EGLContext);
+	typedef EGLBoolean (*PFN_eglTerminate)(EGLDisplay);
+
+	template<typename F>
+	F eglSymbol(void *library, const char *name) {
+		return reinterpret_cast<F>(dlsym(library, name));
+	}
+}
+#endif
+
+
+HeadlessContext::~HeadlessContext() {
+#ifndef _WIN32
+	if (library == nullptr)
+		return;
+	if (display != nullptr) {
+		eglSymbol<PFN_eglMakeCurrent>(library, "eglMakeCurrent")(display, nullptr, nullptr, nullptr);
+		if (context != nullptr)
+			eglSymbol<PFN_eglDestroyContext>(library, "eglDestroyContext")(display, context);
+		eglSymbol<PFN_eglTerminate>(library, "eglTerminate")(display);
+	}
+	dlclose(library);
+#endif
+}
+
+std::unique_ptr<HeadlessContext> HeadlessContext::create() {
+#ifdef _WIN32
+	return nullptr;
+#else
+	std::unique_ptr<HeadlessContext> result(new HeadlessContext());
+	void *library = dlopen("libEGL.so.1", RTLD_LAZY | RTLD_LOCAL);
+	if (library == nullptr)
+		library = dlopen("libEGL.so", RTLD_LAZY | RTLD_LOCAL);
+	if (library == nullptr) {
+		LOG_WARN("Headless context: libEGL not found");
+		return nullptr;
+	}
+	result->library = library;
+
+	auto getProcAddress = eglSymbol<PFN_eglGetProcAddress>(library, "eglGetProcAddress");
+	auto initialize = eglSymbol<PFN_eglInitialize>(library, "eglInitialize");
+	auto getPlatformDisplay = (PFN_eglGetPlatformDisplay)getProcAddress("eglGetPlatformDisplayEXT");
+	EGLint major, minor;
+
+	if (getPlatformDisplay != nullptr) {
+		result->display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, nullptr, nullptr);
+		if (result->display != nullptr && !initialize(result->display, &major, &minor))
+			result->display = nullptr;
+	}
+	if (result->display == nullptr) {
+		result->display = eglSymbol<PFN_eglGetDisplay>(library, "eglGetDisplay")(nullptr);
+		if (result->display == nullptr || !initialize(result->display, &major, &minor)) {
+			result->display = nullptr;
+			LOG_WARN("Headless context: no EGL display could be initialised");
+			return nullptr;
+		}
+	}
+
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint configs = 0;
+	if (!eglSymbol<PFN_eglChooseConfig>(library, "eglChooseConfig")(result->display, configAttribs, &config, 1, &configs) || configs == 0) {
+		LOG_WARN("Headless context: no EGL config renders desktop OpenGL");
+		return nullptr;
+	}
+	eglSymbol<PFN_eglBindAPI>(library, "eglBindAPI")(EGL_OPENGL_API);
+
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	result->context = eglSymbol<PFN_eglCreateContext>(library, "eglCreateContext")(result->display, config, nullptr, contextAttribs);
+	if (result->context == nullptr || !eglSymbol<PFN_eglMakeCurrent>(library, "eglMakeCurrent")(result->display, nullptr, nullptr, result->context)) {
+		LOG_WARN("Headless context: creating surfaceless OpenGL 3.3 core context failed");
+		return nullptr;
+	}
+	LOG("Headless EGL context created (EGL " + std::to_string(major) + "." + std::to_string(minor) + ")");
+	return result;
+#endif
+}
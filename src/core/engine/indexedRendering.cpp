@@ -7,9 +7,97 @@
 #include<sstream>
 
 #include "utils/randomUtils.hpp"
+#include "utils/jobSystem.hpp"
 
 using namespace glm;
 
+namespace {
+	// smallest chunk of IndexedMesh::deformBulk, smaller ones cost more in scheduling than they save
+	constexpr int DEFORMATION_CHUNK = 2048;
+
+	// inactive extra buffers are null
+	unique_ptr<BUFF4> copyBuffer(const unique_ptr<BUFF4> &buffer) {
+		return buffer ? std::make_unique<BUFF4>(*buffer) : nullptr;
+	}
+}
+
+void DirtyRanges::insert(int begin, int end) {
+	auto it = std::lower_bound(ranges.begin(), ranges.end(), begin, [](ivec2 r, int b) { return r.y < b; });
+	if (it == ranges.end() || end < it->x)
+		ranges.insert(it, ivec2(begin, end));
+	else {
+		it->x = std::min(it->x, begin);
+		it->y = std::max(it->y, end);
+		auto next = it + 1;
+		while (next != ranges.end() && next->x <= it->y) {
+			it->y = std::max(it->y, next->y);
+			next = ranges.erase(next);
+		}
+	}
+	if (ranges.size() > MAX_RANGES) {
+		ivec2 hull = ivec2(ranges.front().x, ranges.back().y);
+		ranges.assign(1, hull);
+	}
+}
+
+int DirtyRanges::dirtyElements() const {
+	int res = 0;
+	for (ivec2 r: ranges)
+		res += r.y - r.x;
+	return res;
+}
+
+void DirtyHistory::markWhole() {
+	// older generations add nothing to a whole buffer
+	generations.resize(1);
+	generations.back().markWhole();
+}
+
+DirtyRanges DirtyHistory::since(unsigned long generation) const {
+	DirtyRanges res;
+	if (generation < oldestGeneration() || generation > newest)
+		return res;
+	res.clear();
+	for (auto it = generations.end() - (newest + 1 - generation); it != generations.end(); ++it) {
+		if (it->wholeBuffer()) {
+			res.markWhole();
+			return res;
+		}
+		for (ivec2 r: it->getRanges())
+			res.mark(r.x, r.y);
+	}
+	return res;
+}
+
+unsigned long DirtyHistory::advance() {
+	if (generations.back().empty())
+		return newest;
+	generations.emplace_back().clear();
+	if (generations.size() > MAX_GENERATIONS)
+		generations.erase(generations.begin());
+	return ++newest;
+}
+
+void BufferUploadLog::record(CommonBufferType type, const BufferUpload &upload) {
+	bytes_per_type[type] += upload.size;
+	record(upload);
+}
+
+void BufferUploadLog::record(const BufferUpload &upload) {
+	total_bytes += upload.size;
+	calls++;
+	if (upload.respecify)
+		respecifications++;
+}
+
+void BufferUploadLog::reset() {
+	bytes_per_type.fill(0);
+	total_bytes = 0;
+	calls = 0;
+	respecifications = 0;
+}
+
+
 BufferManager::BufferManager(const std::set<CommonBufferType> &activeBuffers, const vector<string> &extra_names ) : extraBufferNames(extra_names) {
     stds = make_unique<Stds>();
     extra0 = activeBuffers.contains(EXTRA0) ? make_unique<BUFF4>() : nullptr;
@@ -98,6 +186,8 @@ vector<string> BufferManager::getExtraBufferNames() const { return extraBufferNa
 
 int BufferManager::addTriangleVertexIndices(ivec3 ind, int shift) {
     indices->push_back(ind+ivec3(shift));
+    dirty[INDEX].markWhole();
+    topologyVersion++;
     return bufferLength(INDEX) - 1;
 }
 
@@ -132,32 +222,113 @@ int BufferManager::addFullVertexData(const Vertex &v) {
 			extra4->push_back(v.getExtraData(extraBufferNames[4]));
 		else
 			extra4->emplace_back(0, 0, 0, 0);
+	for (CommonBufferType type : {POSITION, NORMAL, UV, COLOR, EXTRA0, EXTRA1, EXTRA2, EXTRA3, EXTRA4})
+		dirty[type].markWhole();
 	return stds->positions.size() - 1;
 }
 
-
-BufferedVertex::BufferedVertex(BufferManager &bufferBoss, int index): bufferBoss(bufferBoss), index(index) {}
-
-BufferedVertex::BufferedVertex(BufferedVertex &&other) noexcept: bufferBoss(other.bufferBoss), index(other.index) {}
-
-BufferedVertex::BufferedVertex(BufferManager &bufferBoss, const Vertex &v) : bufferBoss(bufferBoss) {
-    index = this->bufferBoss.addFullVertexData(v);
-}
-
-BufferedVertex & BufferedVertex::operator=(const BufferedVertex &other) {
-	if (this == &other)
-		return *this;
-	bufferBoss = other.bufferBoss;
-	index = other.index;
-	return *this;
-}
-
-BufferedVertex & BufferedVertex::operator=(BufferedVertex &&other) noexcept {
-	if (this == &other)
-		return *this;
-	bufferBoss = other.bufferBoss;
-	index = other.index;
-	return *this;
+int BufferManager::addVertices(std::span<const vec3> positions, std::span<const vec3> normals, std::span<const vec2> uvs) {
+	THROW_IF(normals.size() != positions.size() || uvs.size() != positions.size(), IllegalArgumentError, "Vertex attribute arrays of different lengths");
+	int first = bufferLength(POSITION);
+	stds->positions.insert(stds->positions.end(), positions.begin(), positions.end());
+	stds->normals.insert(stds->normals.end(), normals.begin(), normals.end());
+	stds->uvs.insert(stds->uvs.end(), uvs.begin(), uvs.end());
+	stds->colors.resize(stds->positions.size(), BLACK);
+	for (auto *extra: {extra0.get(), extra1.get(), extra2.get(), extra3.get(), extra4.get()})
+		if (extra != nullptr)
+			extra->resize(stds->positions.size(), vec4(0));
+	for (CommonBufferType type : {POSITION, NORMAL, UV, COLOR, EXTRA0, EXTRA1, EXTRA2, EXTRA3, EXTRA4})
+		dirty[type].markWhole();
+	return first;
+}
+
+int BufferManager::addTriangles(std::span<const ivec3> faces, int shift) {
+	int first = indices->size();
+	indices->reserve(first + faces.size());
+	for (ivec3 f: faces)
+		indices->push_back(f + ivec3(shift));
+	dirty[INDEX].markWhole();
+	topologyVersion++;
+	return first;
+}
+
+void BufferManager::resizeBuffers(int vertexCount, int faceCount) {
+	stds->positions.resize(vertexCount);
+	stds->normals.resize(vertexCount);
+	stds->uvs.resize(vertexCount);
+	stds->colors.resize(vertexCount);
+	for (auto *extra: {extra0.get(), extra1.get(), extra2.get(), extra3.get(), extra4.get()})
+		if (extra != nullptr)
+			extra->resize(vertexCount);
+	indices->resize(faceCount);
+	markAllDirty();
+	topologyVersion++;
+}
+
+VertexSpans BufferManager::vertexSpans(int first, int count) {
+	THROW_IF(first < 0 || count < 0 || first + count > bufferLength(POSITION), IndexOutOfBounds, first + count, bufferLength(POSITION), "BufferManager vertex range");
+	VertexSpans res;
+	res.first = first;
+	res.positions = std::span(stds->positions).subspan(first, count);
+	res.normals = std::span(stds->normals).subspan(first, count);
+	res.uvs = std::span(stds->uvs).subspan(first, count);
+	res.colors = std::span(stds->colors).subspan(first, count);
+	int slot = 0;
+	for (auto *extra: {extra0.get(), extra1.get(), extra2.get(), extra3.get(), extra4.get()}) {
+		if (extra != nullptr)
+			res.extras[slot] = std::span(*extra).subspan(first, count);
+		slot++;
+	}
+	return res;
+}
+
+void BufferManager::reorderVertices(int first, std::span<const int> order) {
+	int count = order.size();
+	THROW_IF(first < 0 || first + count > bufferLength(POSITION), IndexOutOfBounds, first + count, bufferLength(POSITION), "BufferManager vertex range");
+	for (int k: order)
+		THROW_IF(k < 0 || k >= count, IndexOutOfBounds, k, count, "vertex order");
+	auto permute = [&](auto &buffer) {
+		std::remove_reference_t<decltype(buffer)> permuted(count);
+		for (int k = 0; k < count; k++)
+			permuted[k] = buffer[first + order[k]];
+		std::copy(permuted.begin(), permuted.end(), buffer.begin() + first);
+	};
+	permute(stds->positions);
+	permute(stds->normals);
+	permute(stds->uvs);
+	permute(stds->colors);
+	for (auto *extra: {extra0.get(), extra1.get(), extra2.get(), extra3.get(), extra4.get()})
+		if (extra != nullptr)
+			permute(*extra);
+	for (CommonBufferType type: activeBuffers)
+		if (type != INDEX)
+			dirty[type].mark(first, first + count);
+}
+
+void BufferManager::setTriangles(int first, std::span<const ivec3> faces, int shift) {
+	THROW_IF(first < 0 || first + (int)faces.size() > (int)indices->size(), IndexOutOfBounds, first + faces.size(), indices->size(), "BufferManager face range");
+	for (int k = 0; k < (int)faces.size(); k++)
+		(*indices)[first + k] = faces[k] + ivec3(shift);
+	dirty[INDEX].mark(first, first + faces.size());
+	topologyVersion++;
+}
+
+VertexSpans VertexSpans::subspan(int offset, int count) const {
+	VertexSpans res;
+	res.first = first + offset;
+	res.positions = positions.subspan(offset, count);
+	res.normals = normals.subspan(offset, count);
+	res.uvs = uvs.subspan(offset, count);
+	res.colors = colors.subspan(offset, count);
+	for (int slot = 0; slot < (int)extras.size(); slot++)
+		if (!extras[slot].empty())
+			res.extras[slot] = extras[slot].subspan(offset, count);
+	return res;
+}
+
+
+BufferedVertex::BufferedVertex(BufferManager &bufferBoss, const Vertex &v) : bufferBoss(&bufferBoss) {
+    index = bufferBoss.addFullVertexData(v);
 }
 
 int BufferedVertex::getIndex() const {
@@ -165,76 +336,76 @@ int BufferedVertex::getIndex() const {
 }
 
 vec3 BufferedVertex::getPosition() const {
-	return bufferBoss.getPosition(index);
+	return bufferBoss->getPosition(index);
 }
 
 vec3 BufferedVertex::getNormal() const {
-	return bufferBoss.getNormal(index);
+	return bufferBoss->getNormal(index);
 }
 
 vec2 BufferedVertex::getUV() const {
-	return bufferBoss.getUV(index);
+	return bufferBoss->getUV(index);
 }
 
 vec4 BufferedVertex::getColor() const {
-	return bufferBoss.getColor(index);
+	return bufferBoss->getColor(index);
 }
 
 vec4 BufferedVertex::getExtra(int slot) const {
-	return bufferBoss.getExtra(index, slot);
+	return bufferBoss->getExtra(index, slot);
 }
 
 vec4 BufferedVertex::getExtra0() const {
-	return bufferBoss.getExtra0(index);
+	return bufferBoss->getExtra0(index);
 }
 
 Vertex BufferedVertex::getVertex() const {
 	dict(string, vec4) extraData;
-	if (bufferBoss.isActive(EXTRA0)) extraData[bufferBoss.getExtraBufferName(0)] = getExtra0();
-	if (bufferBoss.isActive(EXTRA1)) extraData[bufferBoss.getExtraBufferName(1)] = getExtra(1);
-	if (bufferBoss.isActive(EXTRA2)) extraData[bufferBoss.getExtraBufferName(2)] = getExtra(2);
-	if (bufferBoss.isActive(EXTRA3)) extraData[bufferBoss.getExtraBufferName(3)] = getExtra(3);
-	if (bufferBoss.isActive(EXTRA4)) extraData[bufferBoss.getExtraBufferName(4)] = getExtra(4);
+	if (bufferBoss->isActive(EXTRA0)) extraData[bufferBoss->getExtraBufferName(0)] = getExtra0();
+	if (bufferBoss->isActive(EXTRA1)) extraData[bufferBoss->getExtraBufferName(1)] = getExtra(1);
+	if (bufferBoss->isActive(EXTRA2)) extraData[bufferBoss->getExtraBufferName(2)] = getExtra(2);
+	if (bufferBoss->isActive(EXTRA3)) extraData[bufferBoss->getExtraBufferName(3)] = getExtra(3);
+	if (bufferBoss->isActive(EXTRA4)) extraData[bufferBoss->getExtraBufferName(4)] = getExtra(4);
 
 	return Vertex(getPosition(), getUV(), getNormal(), getColor(), extraData);
 }
 
 void BufferedVertex::setPosition(vec3 value) {
-	bufferBoss.setPosition(index, value);
+	bufferBoss->setPosition(index, value);
 }
 
 void BufferedVertex::setNormal(vec3 value) {
-	bufferBoss.setNormal(index, value);
+	bufferBoss->setNormal(index, value);
 }
 
 void BufferedVertex::setUV(vec2 value) {
-	bufferBoss.setUV(index, value);
+	bufferBoss->setUV(index, value);
 }
 
 void BufferedVertex::setUV(float value, int i) {
-	bufferBoss.setUV(index, value, i);
+	bufferBoss->setUV(index, value, i);
 }
 
 void BufferedVertex::setColor(vec4 value) {
-	bufferBoss.setColor(index, value);
+	bufferBoss->setColor(index, value);
 }
 
 void BufferedVertex::setColor(float value, int i) {
-	bufferBoss.setColor(index, value, i);
+	bufferBoss->setColor(index, value, i);
 }
 
 void BufferedVertex::setExtra(vec4 value, int slot) {
-	bufferBoss.setExtra(index, value, slot);
+	bufferBoss->setExtra(index, value, slot);
 }
 
-void BufferedVertex::setExtra0(vec4 value) { bufferBoss.setExtra0(index, value); }
+void BufferedVertex::setExtra0(vec4 value) { bufferBoss->setExtra0(index, value); }
 
 void BufferedVertex::setExtra(vec3 value, int slot) {
-	bufferBoss.setExtra(index, value, slot);
+	bufferBoss->setExtra(index, value, slot);
 }
 
 void BufferedVertex::setExtra(float value, int slot, int component) {
-	bufferBoss.setExtra(index, value, slot, component);
+	bufferBoss->setExtra(index, value, slot, component);
 }
 
 void BufferedVertex::applyFunction(const SpaceEndomorphism &f) {
@@ -249,7 +420,7 @@ void BufferedVertex::setVertex(const Vertex &v) {
 	setUV(v.getUV());
 	setNormal(v.getNormal());
 	setColor(v.getColor());
-	auto extras = bufferBoss.getExtraBufferNames();
+	auto extras = bufferBoss->getExtraBufferNames();
 	for (int i=0; i < extras.size(); i++) {
 			string extraName = extras[i];
 			if (v.hasExtraData(extraName))
@@ -257,66 +428,50 @@ void BufferedVertex::setVertex(const Vertex &v) {
 	}
 }
 
-IndexedTriangle::IndexedTriangle(const IndexedTriangle &other): index(other.index), bufferBoss(other.bufferBoss) {}
-
-IndexedTriangle::IndexedTriangle(IndexedTriangle &&other) noexcept: index(other.index), bufferBoss(other.bufferBoss) {}
-
 IndexedTriangle::IndexedTriangle(BufferManager &bufferBoss, ivec3 index, int shift)
-: index(bufferBoss.addTriangleVertexIndices(index, shift)), bufferBoss(bufferBoss) {}
-
-IndexedTriangle & IndexedTriangle::operator=(const IndexedTriangle &other) {
-	if (this == &other)
-		return *this;
-	index = other.index;
-	bufferBoss = other.bufferBoss;
-	return *this;
-}
-
-IndexedTriangle & IndexedTriangle::operator=(IndexedTriangle &&other) noexcept {
-	if (this == &other)
-		return *this;
-	index = other.index;
-	bufferBoss = other.bufferBoss;
-	return *this;
-}
+: index(bufferBoss.addTriangleVertexIndices(index, shift)), bufferBoss(&bufferBoss) {}
 
 ivec3 IndexedTriangle::getVertexIndices() const {
-	return bufferBoss.getFaceIndices(index);
+	return bufferBoss->getFaceIndices(index);
 }
 
 Vertex IndexedTriangle::getVertex(int i) const {
-	return bufferBoss.getVertex(getVertexIndices()[i]);
+	return bufferBoss->getVertex(getVertexIndices()[i]);
+}
+
+vec3 IndexedTriangle::position(int i) const {
+	return bufferBoss->getPosition(getVertexIndices()[i]);
 }
 
 
 mat3 IndexedTriangle::orthonormalFrame() const {
-    vec3 p0 = getVertex(0).getPosition();
-    vec3 p1 = getVertex(1).getPosition();
-    vec3 p2 = getVertex(2).getPosition();
+    vec3 p0 = position(0);
+    vec3 p1 = position(1);
+    vec3 p2 = position(2);
     return  GramSchmidtProcess(mat3(p0-p2, p1-p2, cross(p1-p2, p0-p2)));
 }
 
 vec3 IndexedTriangle::fromPlanar(vec2 v) const {
     mat3 frame = orthonormalFrame();
-    return frame[0]*v.x + frame[1]*v.y + getVertex(2).getPosition();
+    return frame[0]*v.x + frame[1]*v.y + position(2);
 }
 
 vec2 IndexedTriangle::toPlanar(vec3 v) const {
     mat3 frame = orthonormalFrame();
-    return vec2(dot(frame[0], v-getVertex(2).getPosition()), dot(frame[1], v-getVertex(2).getPosition()));
+    return vec2(dot(frame[0], v-position(2)), dot(frame[1], v-position(2)));
 }
 
 
 vec3 IndexedTriangle::fromBars(vec2 v) const {
-    return getVertex(0).getPosition() * v.x + getVertex(1).getPosition() * v.y +
-           getVertex(2).getPosition() * (1 - v.x - v.y);
+    return position(0) * v.x + position(1) * v.y +
+           position(2) * (1 - v.x - v.y);
 }
 
 
 std::array<vec3, 3> IndexedTriangle::borderTriangle(float width) const {
-    vec3 p0 = getVertex(0).getPosition();
-    vec3 p1 = getVertex(1).getPosition();
-    vec3 p2 = getVertex(2).getPosition();
+    vec3 p0 = position(0);
+    vec3 p1 = position(1);
+    vec3 p2 = position(2);
     vec3 n = normalize(cross(p1 - p0, p2 - p0));
     vec3 v01 = p1-p0;
     vec3 v12 = p2-p1;
@@ -349,11 +504,11 @@ std::array<vec3, 3> IndexedTriangle::borderTriangle(float width) const {
     return {fromPlanar(b0), fromPlanar(b1), fromPlanar(b2)};
 }
 
-vec3 IndexedTriangle::faceNormal() const { return normalize(cross(getVertex(1).getPosition() - getVertex(0).getPosition(), getVertex(2).getPosition() - getVertex(0).getPosition())); }
+vec3 IndexedTriangle::faceNormal() const { return normalize(cross(position(1) - position(0), position(2) - position(0))); }
 
-vec3 IndexedTriangle::center() const { return (getVertex(0).getPosition() + getVertex(1).getPosition() + getVertex(2).getPosition()) / 3.f; }
+vec3 IndexedTriangle::center() const { return (position(0) + position(1) + position(2)) / 3.f; }
 
-float IndexedTriangle::area() const { return 0.5f * length(cross(getVertex(1).getPosition() - getVertex(0).getPosition(), getVertex(2).getPosition() - getVertex(0).getPosition())); }
+float IndexedTriangle::area() const { return 0.5f * length(cross(position(1) - position(0), position(2) - position(0))); }
 
 bool IndexedTriangle::containsEdge(int i, int j) const {
 	return contains(getVertexIndices(), i) && contains(getVertexIndices(), j);
@@ -361,15 +516,14 @@ bool IndexedTriangle::containsEdge(int i, int j) const {
 
 bool IndexedTriangle::containsEdge(ivec2 edge) const { return containsEdge(edge.x, edge.y); }
 
-void IndexedTriangle::setVertexIndices(const ivec3 &in) { bufferBoss.setFaceIndices(index, in); }
+void IndexedTriangle::setVertexIndices(const ivec3 &in) { bufferBoss->setFaceIndices(index, in); }
 
-void IndexedTriangle::changeOrientation() { bufferBoss.setFaceIndices(index, ivec3(getVertexIndices().z, getVertexIndices().y, getVertexIndices().x)); }
+void IndexedTriangle::changeOrientation() { bufferBoss->setFaceIndices(index, ivec3(getVertexIndices().z, getVertexIndices().y, getVertexIndices().x)); }
 
 
 IndexedMesh::IndexedMesh(IndexedMesh &&other) noexcept: boss(std::move(other.boss)),
-														vertices(std::move(other.vertices)),
-														triangles(std::move(other.triangles)),
-														polygroupIndexOrder(std::move(other.polygroupIndexOrder))
+														polygroupIndexOrder(std::move(other.polygroupIndexOrder)),
+														polygroups(std::move(other.polygroups))
 														{}
 
 IndexedMesh & IndexedMesh::operator=(IndexedMesh &&other) noexcept {
@@ -377,15 +531,13 @@ IndexedMesh & IndexedMesh::operator=(IndexedMesh &&other) noexcept {
         return *this;
     boss = std::move(other.boss);
 	polygroupIndexOrder = std::move(other.polygroupIndexOrder);
-    vertices = std::move(other.vertices);
-    triangles = std::move(other.triangles);
+	polygroups = std::move(other.polygroups);
+	invalidateAdjacency();
     return *this;
 }
 
 IndexedMesh::IndexedMesh() {
 	boss = make_unique<BufferManager>();
-	vertices = vector<vector<BufferedVertex>>();
-	triangles = vector<vector<IndexedTriangle>>();
 	polygroupIndexOrder = unordered_map<PolyGroupID, int>();
 }
 
@@ -398,98 +550,22 @@ IndexedMesh::IndexedMesh(const char *filename, const PolyGroupID &id) : IndexedM
 }
 
 void IndexedMesh::addNewPolygroup(const char *filename, const PolyGroupID &id) {
-	int shift = boss->bufferLength(POSITION);
-	int index = polygroupIndexOrder.size();
+	addNewPolygroup(readOBJ(filename), id);
+}
+
+void IndexedMesh::addNewPolygroup(const OBJData &data, const PolyGroupID &id) {
 	if (polygroupIndexOrder.contains(id))
 		throw IllegalVariantError("Polygroup ID already exists in mesh. ", __FILE__, __LINE__);
-	polygroupIndexOrder[id] = index;
-    vertices.emplace_back(vector<BufferedVertex>());
-    triangles.emplace_back(vector<IndexedTriangle>());
-    vector<vec3> norms = {};
-    vector<vec2> uvs = {};
-    vector<vec3> pos = {};
-
-	vec2 UV_DEFAULT = vec2(2137, 0);
-	vec3 NORM_DEFAULT = vec3(0, 0, 0);
-
-	std::set<int> vertexIndicesFilled = {};
-
-    // auto estimatedSizes = countEstimatedBufferSizesInOBJFile(filename);
-    // vertices[id].reserve(estimatedSizes["positions"]);
-    // triangles[id].reserve(estimatedSizes["faces"]);
-    // norms.reserve(estimatedSizes["normals"]);
-    // uvs.reserve(estimatedSizes["uvs"]);
-
-
-
-    std::ifstream in(filename, std::ios::in);
-    if (!in)
-        throw FileNotFoundError(string(filename), __FILE__, __LINE__);
-
-    string line;
-    while (getline(in, line))
-    {
-        if (line.substr(0,2) == "v ")
-        {
-            std::istringstream s(line.substr(2));
-            vec3 vert;
-            s >> vert.x;
-        	s >> vert.y;
-        	s >> vert.z;
-            pos.emplace_back(vert);
-        	vertices[index].emplace_back(*boss, Vertex(vert, UV_DEFAULT, NORM_DEFAULT));
-        }
-        if (line.substr(0,3) == "vt ")
-        {
-            std::istringstream s(line.substr(3));
-            vec2 uv;
-            s >> uv.x;
-        	s >> uv.y;
-            uvs.emplace_back(uv);
-        }
-
-        if (line.substr(0,3) == "vn ")
-        {
-            std::istringstream s(line.substr(3));
-            vec3 norm;
-            s >> norm.x;
-        	s >> norm.y;
-        	s >> norm.z;
-            norms.emplace_back(norm);
-        }
-
-        else if (line.substr(0,2) == "_f ")
-        {
-            ivec3 vertexIndex, uvIndex, normalIndex;
-            sscanf(line.c_str(),"_f %d/%d/%d %d/%d/%d %d/%d/%d", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
-
-            vertexIndex -= ivec3(1, 1, 1);
-            uvIndex -= ivec3(1, 1, 1);
-            normalIndex -= ivec3(1, 1, 1);
-
-            vector uvsVec = {uvs.at(uvIndex[0]), uvs.at(uvIndex[1]), uvs.at(uvIndex[2]) };
-            vector normsVec = {norms.at(normalIndex[0]), norms.at(normalIndex[1]), norms.at(normalIndex[2]) };
-
-            ivec3 face = ivec3(0);
-            for (int i = 0; i < 3; i++)
-				if (!vertexIndicesFilled.contains(vertexIndex[i])) {
-					face[i] = vertexIndex[i];
-					vertices[index][vertexIndex[i]].setNormal(normsVec[i]);
-					vertices[index][vertexIndex[i]].setUV(uvsVec[i]);
-					vertexIndicesFilled.insert(vertexIndex[i]);
-				}
-
-				else if (vertices[index][vertexIndex[i]].getNormal() == normsVec[i] && vertices[index][vertexIndex[i]].getUV() == uvsVec[i])
-					face[i] = vertexIndex[i];
-
-				else {
-					vertices[index].emplace_back(*boss, Vertex(pos[vertexIndex[i]], uvsVec[i], normsVec[i]));
-					face[i] = vertices[index].back().getIndex();
-				}
-
-			triangles[index].emplace_back(*boss, face, shift);
-        }
-    }
+
+	int shift = boss->bufferLength(POSITION);
+	int firstVertex = boss->addVertices(data.positions, data.normals, data.uvs);
+	int firstFace = boss->addTriangles(data.faces, shift);
+	addPolygroupRange(id, firstVertex, firstFace);
+}
+
+void IndexedMesh::addPolygroupRange(const PolyGroupID &id, int firstVertex, int firstFace) {
+	polygroupIndexOrder[id] = polygroups.size();
+	polygroups.push_back({firstVertex, boss->bufferLength(POSITION) - firstVertex, firstFace, boss->bufferLength(INDEX) - firstFace});
 }
 
 
@@ -497,9 +573,9 @@ IndexedMesh & IndexedMesh::operator=(const IndexedMesh &other) {
     if (this == &other)
         return *this;
     boss = std::make_unique<BufferManager>(*other.boss);
-    vertices = other.vertices;
-    triangles = other.triangles;
 	polygroupIndexOrder = other.polygroupIndexOrder;
+	polygroups = other.polygroups;
+	invalidateAdjacency();
     return *this;
 }
 
@@ -515,93 +591,100 @@ void IndexedMesh::addNewPolygroup(const vector<Vertex> &hardVertices, const vect
         throw IllegalVariantError("Polygroup ID already exists in mesh. ", __FILE__, __LINE__);
 
 	int shift = boss->bufferLength(POSITION);
-	int index = polygroupIndexOrder.size();
-	polygroupIndexOrder[id] = index;
-    vertices.emplace_back(vector<BufferedVertex>());
-    triangles.emplace_back(vector<IndexedTriangle>());
-    vertices[index].reserve(hardVertices.size());
-    triangles[index].reserve(faceIndices.size());
-
-    for (const Vertex &v: hardVertices)
-		vertices[index].emplace_back(*boss, v);
-
-	for (const ivec3 &ind: faceIndices)
-        triangles[index].emplace_back(*boss, ind, shift);
+	boss->reserveAdditionalSpace(hardVertices.size());
+	for (const Vertex &v: hardVertices)
+		boss->addFullVertexData(v);
+	int firstFace = boss->addTriangles(faceIndices, shift);
+	addPolygroupRange(id, shift, firstFace);
 }
 
-IndexedMesh::IndexedMesh(const IndexedMesh &other): boss(&*other.boss),
-													vertices(other.vertices),
+IndexedMesh::IndexedMesh(const IndexedMesh &other): boss(make_unique<BufferManager>(*other.boss)),
 													polygroupIndexOrder(other.polygroupIndexOrder),
-													triangles(other.triangles) {}
-
-
-void IndexedMesh::addUniformSurface(const SmoothParametricSurface &surf, int tRes, int uRes, const PolyGroupID &id) {
-    vector<Vertex> hardVertices = {};
-    vector<ivec3> faceIndices = {};
-    hardVertices.reserve(tRes * uRes + uRes + tRes + 1);
-    faceIndices.reserve(2 * (tRes) * (uRes));
-
-
-
-    for (int i = 0; i < tRes; i++)
-        for (int j = 0; j < uRes; j++) {
+													polygroups(other.polygroups) {}
+
+
+void sampleSurfaceGrid(const SmoothParametricSurface &surf, ivec2 size, bvec2 periodic, std::span<const vec2> params,
+					   std::span<vec3> positions, std::span<vec3> normals) {
+	size_t count = size.x*size.y;
+	THROW_IF(params.size() < count || positions.size() < count || normals.size() < count, IndexOutOfBounds,
+			 std::min({params.size(), positions.size(), normals.size()}), count, "sampleSurfaceGrid arrays");
+	JobSystem &jobs = JobSystem::global();
+	jobs.parallelFor(size.x, [&](int i) {
+		for (int j = 0; j < size.y; j++)
+			positions[i*size.y + j] = surf(params[i*size.y + j]);
+	});
 
-            float t_ = 1.f * i / (tRes - 1);
-        	if (surf.isPeriodicT()) t_ = 1.f * i / (1.f * tRes);
+	// neighbours of k in a direction of n samples, the same index when there is none
+	auto neighbours = [](int k, int n, bool wraps) {
+		if (wraps)
+			return ivec2((k + n - 1) % n, (k + 1) % n);
+		return ivec2(std::max(k - 1, 0), std::min(k + 1, n - 1));
+	};
+	jobs.parallelFor(size.x, [&](int i) {
+		ivec2 ti = neighbours(i, size.x, periodic.x);
+		for (int j = 0; j < size.y; j++) {
+			ivec2 uj = neighbours(j, size.y, periodic.y);
+			vec3 dt = positions[ti.y*size.y + j] - positions[ti.x*size.y + j];
+			vec3 du = positions[i*size.y + uj.y] - positions[i*size.y + uj.x];
+			vec3 n = cross(dt, du);
+			float area = length(n), scale = std::max(length(dt), length(du));
+			normals[i*size.y + j] = area > 1e-3f*scale*scale ? n/area : surf.normal(params[i*size.y + j]);
+		}
+	});
+}
 
-            float u_ = 1.f * j / (uRes - 1);
-        	if (surf.isPeriodicU()) u_ = 1.f * j / (1.f * uRes);
 
-            float t = lerp(surf.tMin(), surf.tMax(), t_);
-            float u = lerp(surf.uMin(), surf.uMax(), u_);
-            hardVertices.emplace_back(surf(t, u), vec2(t_, u_), surf.normal(t, u), vec4(t, u, 0, 1));
-        }
+void IndexedMesh::addUniformSurface(const SmoothParametricSurface &surf, int tRes, int uRes, const PolyGroupID &id) {
+	if (polygroupIndexOrder.contains(id))
+		throw IllegalVariantError("Polygroup ID already exists in mesh. ", __FILE__, __LINE__);
+	THROW_IF(tRes < 2 || uRes < 2, IllegalArgumentError, "Uniform surface needs at least 2 x 2 vertices, got " + to_string(tRes) + " x " + to_string(uRes));
 
 	ivec2 size = ivec2(tRes, uRes);
-
-    for (int i = 1; i < tRes ; i++)
-        for (int j = 1; j < uRes; j++) {
-
-        	int i0 = flattened2DVectorIndex(i, j, size);
-            int i1 = flattened2DVectorIndex(i-1, j, size);
-            int i2 = flattened2DVectorIndex(i-1, j-1, size);
-        	int i3 = flattened2DVectorIndex(i, j-1, size);
-
-			faceIndices.emplace_back(i0, i1, i2);
-			faceIndices.emplace_back(i0, i3, i2);
-        }
-
-
-	if (surf.isPeriodicT())
-		for (int j = 1; j < uRes; j++) {
-			int i0 = flattened2DVectorIndex(0, j, size);
-			int i1 = flattened2DVectorIndex(-1, j, size);
-			int i2 = flattened2DVectorIndex(-1, j-1, size);
-			int i3 = flattened2DVectorIndex(0, j-1, size);
-			faceIndices.emplace_back(i0, i1, i2);
-			faceIndices.emplace_back(i0, i3, i2);
+	bvec2 periodic = bvec2(surf.isPeriodicT(), surf.isPeriodicU());
+	// periodic directions have one more row of cells closing the seam
+	ivec2 cells = size - 1 + ivec2(periodic);
+	int shift = boss->bufferLength(POSITION);
+	int firstFace = boss->bufferLength(INDEX);
+	boss->resizeBuffers(shift + tRes*uRes, firstFace + 2*cells.x*cells.y);
+
+	auto *positions = static_cast<vec3 *>(boss->firstElementAddress(POSITION)) + shift;
+	auto *normals = static_cast<vec3 *>(boss->firstElementAddress(NORMAL)) + shift;
+	auto *uvs = static_cast<vec2 *>(boss->firstElementAddress(UV)) + shift;
+	auto *colors = static_cast<vec4 *>(boss->firstElementAddress(COLOR)) + shift;
+	auto *faces = static_cast<ivec3 *>(boss->firstElementAddress(INDEX)) + firstFace;
+
+	// uv are the parameters normalised to [0, 1], the colour stores the parameters themselves
+	vector<vec2> params(tRes*uRes);
+	JobSystem &jobs = JobSystem::global();
+	jobs.parallelFor(tRes, [&](int i) {
+		float t_ = periodic.x ? 1.f*i/tRes : 1.f*i/(tRes - 1);
+		for (int j = 0; j < uRes; j++) {
+			float u_ = periodic.y ? 1.f*j/uRes : 1.f*j/(uRes - 1);
+			vec2 tu = vec2(lerp(surf.tMin(), surf.tMax(), t_), lerp(surf.uMin(), surf.uMax(), u_));
+			params[i*uRes + j] = tu;
+			uvs[i*uRes + j] = vec2(t_, u_);
+			colors[i*uRes + j] = vec4(tu, 0, 1);
 		}
-//
-	if (surf.isPeriodicU())
-		for (int i = 1; i < tRes; i++) {
-			int i0 = flattened2DVectorIndex(i, 0, size);
-			int i1 = flattened2DVectorIndex(i-1, 0, size);
-			int i2 = flattened2DVectorIndex(i-1, -1, size);
-			int i3 = flattened2DVectorIndex(i, -1, size);
-			faceIndices.emplace_back(i0, i1, i2);
-			faceIndices.emplace_back(i0, i3, i2);
+	});
+	sampleSurfaceGrid(surf, size, periodic, params, std::span(positions, tRes*uRes), std::span(normals, tRes*uRes));
+
+	// cell (ci, cj) spans vertices ci-1, ci and cj-1, cj, the last cell of a periodic direction wraps to vertex 0
+	jobs.parallelFor(cells.x, [&](int ci) {
+		int i = (ci + 1) % tRes;
+		for (int cj = 0; cj < cells.y; cj++) {
+			int j = (cj + 1) % uRes;
+			int i0 = shift + i*uRes + j;
+			int i1 = shift + ci*uRes + j;
+			int i2 = shift + ci*uRes + cj;
+			int i3 = shift + i*uRes + cj;
+			faces[2*(ci*cells.y + cj)] = ivec3(i0, i1, i2);
+			faces[2*(ci*cells.y + cj) + 1] = ivec3(i0, i3, i2);
 		}
+	});
 
-	if (surf.isPeriodicT() && surf.isPeriodicU()) {
-		int i0 = flattened2DVectorIndex(0, 0, size);
-		int i1 = flattened2DVectorIndex(-1, 0, size);
-		int i2 = flattened2DVectorIndex(-1, -1, size);
-		int i3 = flattened2DVectorIndex(0, -1, size);
-		faceIndices.emplace_back(i0, i1, i2);
-		faceIndices.emplace_back(i0, i3, i2);
-	}
-
-    addNewPolygroup(hardVertices, faceIndices, id);
+	addPolygroupRange(id, shift, firstFace);
+	polygroups.back().grid = size;
+	polygroups.back().gridPeriodic = periodic;
 }
 
 
@@ -701,32 +784,55 @@ bool IndexedMesh::isActive(CommonBufferType type) const {
 // 	return !isActive(MATERIAL1) && material->textured();
 // }
 
-BufferedVertex & IndexedMesh::getAnyVertexFromPolyGroup(const PolyGroupID &id) {
-	return vertices.at(polygroupIndexOrder[id]).front();
+BufferedVertex IndexedMesh::getAnyVertexFromPolyGroup(const PolyGroupID &id) {
+	return vertexView(id).front();
 }
 
 void IndexedMesh::deformPerVertex(const PolyGroupID &id, const HOM(BufferedVertex&, void) &deformation) {
-	for (auto &v : vertices.at(polygroupIndexOrder[id]))
+	for (BufferedVertex v : vertexView(id))
 		deformation(v);
 }
 
 void IndexedMesh::deformPerVertex(const HOM(BufferedVertex&, void) &deformation) {
 	for (auto id: getPolyGroupIDs())
-		for (auto &v : vertices.at(polygroupIndexOrder[id]))
+		for (BufferedVertex v : vertexView(id))
 			deformation(v);
 }
 
 void IndexedMesh::deformPerVertex(const PolyGroupID &id, const BIHOM(int, BufferedVertex&, void) &deformation) {
-	for (int i=0; i<vertices.at(polygroupIndexOrder[id]).size(); i++)
-		deformation(i, vertices.at(polygroupIndexOrder[id])[i]);
+	PolygroupVertices vertices = vertexView(id);
+	for (int i=0; i<vertices.size(); i++) {
+		BufferedVertex v = vertices[i];
+		deformation(i, v);
+	}
 }
 
 void IndexedMesh::deformPerId(const BIHOM(BufferedVertex&, PolyGroupID, void) &deformation) {
 	for (auto id: getPolyGroupIDs())
-		for (auto &v : vertices.at(polygroupIndexOrder[id]))
+		for (BufferedVertex v : vertexView(id))
 			deformation(v, id);
 }
 
+VertexSpans IndexedMesh::vertexSpans(const PolyGroupID &id) {
+	const PolygroupRange &range = polygroupRange(id);
+	return boss->vertexSpans(range.firstVertex, range.vertexCount);
+}
+
+void IndexedMesh::deformBulk(const PolyGroupID &id, const VertexKernel &kernel, const std::set<CommonBufferType> &writes) {
+	VertexSpans vertices = vertexSpans(id);
+	JobSystem &jobs = JobSystem::global();
+	jobs.parallelForRange(vertices.size(), [&](int begin, int end) {
+		kernel(vertices.subspan(begin, end - begin));
+	}, std::max(DEFORMATION_CHUNK, jobs.autoGrain(vertices.size())));
+	for (CommonBufferType type: writes)
+		boss->markDirty(type, vertices.first, vertices.first + vertices.size());
+}
+
+void IndexedMesh::deformBulk(const VertexKernel &kernel, const std::set<CommonBufferType> &writes) {
+	for (auto id: getPolyGroupIDs())
+		deformBulk(id, kernel, writes);
+}
+
 vec2 IndexedMesh::getSurfaceParameters(const BufferedVertex &v) {
 	return vec2(v.getColor().x, v.getColor().y);
 }
@@ -741,9 +847,30 @@ void IndexedMesh::encodeSurfacePoint(BufferedVertex &v, const SmoothParametricSu
 }
 
 void IndexedMesh::adjustToNewSurface(const SmoothParametricSurface &surf, const PolyGroupID &id) {
-	deformPerVertex(id, [&](BufferedVertex &v) {
-		encodeSurfacePoint(v, surf, getSurfaceParameters(v));
+	const PolygroupRange &range = polygroupRange(id);
+	if (range.grid.x*range.grid.y != range.vertexCount || range.vertexCount == 0) {
+		deformPerVertex(id, [&](BufferedVertex &v) {
+			encodeSurfacePoint(v, surf, getSurfaceParameters(v));
+		});
+		return;
+	}
+	int first = range.firstVertex, count = range.vertexCount;
+	auto *positions = static_cast<vec3 *>(boss->firstElementAddress(POSITION)) + first;
+	auto *normals = static_cast<vec3 *>(boss->firstElementAddress(NORMAL)) + first;
+	auto *uvs = static_cast<vec2 *>(boss->firstElementAddress(UV)) + first;
+	const auto *colors = static_cast<const vec4 *>(boss->firstElementAddress(COLOR)) + first;
+
+	vector<vec2> params(count);
+	vec2 origin = vec2(surf.tMin(), surf.uMin()), extent = vec2(surf.tMax(), surf.uMax()) - origin;
+	JobSystem::global().parallelForRange(count, [&](int begin, int end) {
+		for (int k = begin; k < end; k++) {
+			params[k] = vec2(colors[k]);
+			uvs[k] = (params[k] - origin)/extent;
+		}
 	});
+	sampleSurfaceGrid(surf, range.grid, range.gridPeriodic, params, std::span(positions, count), std::span(normals, count));
+	for (CommonBufferType type: {POSITION, NORMAL, UV})
+		boss->markDirty(type, first, first + count);
 }
 
 void IndexedMesh::adjustToNewSurface(const SmoothParametricSurface &surf) {
@@ -752,13 +879,11 @@ void IndexedMesh::adjustToNewSurface(const SmoothParametricSurface &surf) {
 }
 
 void IndexedMesh::moveAlongVectorField(const PolyGroupID &id, const VectorField &X, float delta) {
-    for (BufferedVertex &v: vertices.at(polygroupIndexOrder[id]))
-        v.setPosition(X.moveAlong(v.getPosition(), delta));
+	deformBulk(id, vertexKernels::positionMap([&X, delta](vec3 p) { return X.moveAlong(p, delta); }), {POSITION});
 }
 
 void IndexedMesh::deformWithAmbientMap(const PolyGroupID &id, const SpaceEndomorphism &f) {
-    for (BufferedVertex &v: vertices.at(polygroupIndexOrder[id]))
-        v.applyFunction(f);
+	deformBulk(id, vertexKernels::ambientMap(f));
 }
 
 void IndexedMesh::deformWithAmbientMap(const SpaceEndomorphism &f) {
@@ -768,7 +893,7 @@ void IndexedMesh::deformWithAmbientMap(const SpaceEndomorphism &f) {
 
 
 void IndexedMesh::affineTransform(const mat3 &M, vec3 v, const PolyGroupID &id) {
-	deformWithAmbientMap(id, SpaceEndomorphism::affine(M, v));
+	deformBulk(id, vertexKernels::affine(M, v));
 }
 
 void IndexedMesh::affineTransform(const mat3 &M, vec3 v) {
@@ -777,11 +902,11 @@ void IndexedMesh::affineTransform(const mat3 &M, vec3 v) {
 }
 
 void IndexedMesh::shift(vec3 v, const PolyGroupID &id) {
-	affineTransform(mat3(1), v, id);
+	deformBulk(id, vertexKernels::translation(v), {POSITION});
 }
 
 void IndexedMesh::shift(vec3 v) {
-	affineTransform(mat3(1), v);
+	deformBulk(vertexKernels::translation(v), {POSITION});
 }
 
 void IndexedMesh::scale(float s, const PolyGroupID &id) {
@@ -792,31 +917,34 @@ void IndexedMesh::scale(float s) {
 	affineTransform(mat3(s), vec3(0));
 }
 
+PolygroupVertices IndexedMesh::vertexView(const PolyGroupID &id) const {
+	const PolygroupRange &range = polygroupRange(id);
+	return PolygroupVertices(*boss, range.firstVertex, range.vertexCount);
+}
+
+PolygroupTriangles IndexedMesh::triangleView(const PolyGroupID &id) const {
+	const PolygroupRange &range = polygroupRange(id);
+	return PolygroupTriangles(*boss, range.firstFace, range.faceCount);
+}
+
 vector<Vertex> IndexedMesh::getVertices(const PolyGroupID &id) const {
+    PolygroupVertices vertices = vertexView(id);
     vector<Vertex> verts = {};
-    verts.reserve(vertices.at(polygroupIndexOrder.at(id)).size());
-    for (const BufferedVertex &v: vertices.at(polygroupIndexOrder.at(id)))
+    verts.reserve(vertices.size());
+    for (const BufferedVertex &v: vertices)
         verts.push_back(v.getVertex());
     return verts;
 }
 
-vector<BufferedVertex> IndexedMesh::getBufferedVertices(const PolyGroupID &id) const {
-	return vertices.at(polygroupIndexOrder.at(id));
-}
-
-
 vector<ivec3> IndexedMesh::getIndices(const PolyGroupID &id) const {
+    PolygroupTriangles triangles = triangleView(id);
     vector<ivec3> inds = {};
-    inds.reserve(triangles.at(polygroupIndexOrder.at(id)).size());
-    for (const IndexedTriangle &t: triangles.at(polygroupIndexOrder.at(id)))
+    inds.reserve(triangles.size());
+    for (const IndexedTriangle &t: triangles)
         inds.push_back(t.getVertexIndices());
     return inds;
 }
 
-vector<IndexedTriangle> IndexedMesh::getTriangles(const PolyGroupID &id) const {
-	return triangles.at(polygroupIndexOrder.at(id));
-}
-
 // vec4 IndexedMesh::getIntencities() const {
 // 	return material->compressIntencities();
 // }
@@ -831,18 +959,14 @@ vector<IndexedTriangle> IndexedMesh::getTriangles(const PolyGroupID &id) const {
 // }
 
 void IndexedMesh::flipNormals(const PolyGroupID &id) {
-	deformPerVertex(id, [](BufferedVertex &v) {
-		v.setNormal(-v.getNormal());
-	});
+	deformBulk(id, vertexKernels::flipNormals(), {NORMAL});
 }
 
 void IndexedMesh::flipNormals() { for (auto &name: getPolyGroupIDs()) flipNormals(name); }
 
 void IndexedMesh::pointNormalsInDirection(vec3 dir, const PolyGroupID &id) {
-	deformPerVertex(id, [dir](BufferedVertex &v) {
-	vec3 n = v.getNormal();
-	v.setNormal(n*1.f*sgn(dot(n, dir)));
-}); }
+	deformBulk(id, vertexKernels::pointNormalsTowards(dir), {NORMAL});
+}
 
 void IndexedMesh::pointNormalsInDirection(vec3 dir) {
 	for (auto &name: getPolyGroupIDs())
@@ -889,8 +1013,8 @@ IndexedMesh IndexedMesh::subdivideEdgecentric(const PolyGroupID &id) const {
 }
 
 IndexedMesh IndexedMesh::wireframe(PolyGroupID id, PolyGroupID targetId, float width, float heightCenter, float heightSide) const {
-    vector<IndexedTriangle> trs = triangles.at(polygroupIndexOrder.at(id));
-    vector<BufferedVertex> verts = vertices.at(polygroupIndexOrder.at(id));
+    PolygroupTriangles trs = triangleView(id);
+    PolygroupVertices verts = vertexView(id);
     vector<Vertex> new_verts = getVertices(id);
     vector<ivec3> new_inds = {};
     for (const auto &v: verts) {
@@ -933,9 +1057,11 @@ IndexedMesh IndexedMesh::wireframe(PolyGroupID id, PolyGroupID targetId, float w
 
 
 void BufferManager::insertValueToSingleBuffer(CommonBufferType type, void *valueAddress) {
+    dirty[type].markWhole();
     if (type == INDEX) {
         ivec3* value = static_cast<ivec3*>(valueAddress);
         indices->push_back(*value);
+        topologyVersion++;
     }
    if (bufferElementLength(type) == 2) {
         vec2* v = static_cast<vec2*>(valueAddress);
@@ -959,8 +1085,10 @@ void BufferManager::insertValueToSingleBuffer(CommonBufferType type, void *value
 }
 
 void BufferManager::insertDefaultValueToSingleBuffer(CommonBufferType type) {
+    dirty[type].markWhole();
     if (type == INDEX) {
         indices->emplace_back(0, 0, 0);
+        topologyVersion++;
         return;
     }
     if (bufferElementLength(type) == 2) {
@@ -983,11 +1111,11 @@ void BufferManager::insertDefaultValueToSingleBuffer(CommonBufferType type) {
 
 BufferManager::BufferManager(const BufferManager &other) :
     stds(std::make_unique<Stds>(*other.stds)),
-    extra0(std::make_unique<vector<vec4>>(*other.extra0)),
-	extra1(std::make_unique<BUFF4>(*other.extra1)),
-	extra2(std::make_unique<BUFF4>(*other.extra2)),
-	extra3(std::make_unique<BUFF4>(*other.extra3)),
-	extra4(std::make_unique<BUFF4>(*other.extra4)),
+    extra0(copyBuffer(other.extra0)),
+	extra1(copyBuffer(other.extra1)),
+	extra2(copyBuffer(other.extra2)),
+	extra3(copyBuffer(other.extra3)),
+	extra4(copyBuffer(other.extra4)),
     indices(std::make_unique<IBUFF3>(*other.indices)),
 	extraBufferNames(other.extraBufferNames),
     activeBuffers(other.activeBuffers) {}
@@ -1004,6 +1132,8 @@ BufferManager & BufferManager::operator=(BufferManager &&other) noexcept {
     indices = std::move(other.indices);
     activeBuffers = std::move(other.activeBuffers);
 	extraBufferNames = std::move(other.extraBufferNames);
+	markAllDirty();
+	topologyVersion++;
     return *this;
 }
 
@@ -1022,20 +1152,24 @@ BufferManager & BufferManager::operator=(const BufferManager &other) {
     if (this == &other)
         return *this;
     stds = std::make_unique<Stds>(*other.stds);
-    extra0 = std::make_unique<BUFF4>(*other.extra0);
-	extra1 = std::make_unique<BUFF4>(*other.extra1);
-	extra2 = std::make_unique<BUFF4>(*other.extra2);
-	extra3 = std::make_unique<BUFF4>(*other.extra3);
-	extra4 = std::make_unique<BUFF4>(*other.extra4);
+    extra0 = copyBuffer(other.extra0);
+	extra1 = copyBuffer(other.extra1);
+	extra2 = copyBuffer(other.extra2);
+	extra3 = copyBuffer(other.extra3);
+	extra4 = copyBuffer(other.extra4);
     indices = std::make_unique<IBUFF3>(*other.indices);
     activeBuffers = other.activeBuffers;
 	extraBufferNames = other.extraBufferNames;
+	markAllDirty();
+	topologyVersion++;
     return *this;
 }
 
 void BufferManager::reserveAdditionalSpaceForIndex(int extraStorage) { reserveSpaceForIndex(bufferLength(INDEX) + extraStorage); }
 
 void BufferManager::initialiseExtraBufferSlot(int slot) {
+    if (slot >= 0 && slot <= 4)
+        dirty[EXTRA0 + slot].markWhole();
     switch (slot) {
         case 0:
             if (extra0 == nullptr)
@@ -1106,41 +1240,74 @@ Vertex BufferManager::getVertex(int index) const {
 	return Vertex(getPosition(index), getUV(index), getNormal(index), getColor(index), extraData);
 }
 
-void BufferManager::setPosition(int index, vec3 value) { stds->positions[index] = value; }
+void BufferManager::setPosition(int index, vec3 value) {
+	stds->positions[index] = value;
+	dirty[POSITION].mark(index);
+}
 
-void BufferManager::setNormal(int index, vec3 value) { stds->normals[index] = value; }
+void BufferManager::setNormal(int index, vec3 value) {
+	stds->normals[index] = value;
+	dirty[NORMAL].mark(index);
+}
 
-void BufferManager::setUV(int index, vec2 value) { stds->uvs[index] = value; }
+void BufferManager::setUV(int index, vec2 value) {
+	stds->uvs[index] = value;
+	dirty[UV].mark(index);
+}
 
-void BufferManager::setUV(int index, float value, int coord) { stds->uvs[index][coord] = value; }
+void BufferManager::setUV(int index, float value, int coord) {
+	stds->uvs[index][coord] = value;
+	dirty[UV].mark(index);
+}
 
-void BufferManager::setColor(int index, vec4 value) { stds->colors[index] = value; }
+void BufferManager::setColor(int index, vec4 value) {
+	stds->colors[index] = value;
+	dirty[COLOR].mark(index);
+}
 
-void BufferManager::setColor(int index, float value, int component) { stds->colors[index][component] = value; }
+void BufferManager::setColor(int index, float value, int component) {
+	stds->colors[index][component] = value;
+	dirty[COLOR].mark(index);
+}
 
-void BufferManager::setFaceIndices(int index, const ivec3 &in) { indices->at(index) = in; }
+void BufferManager::setFaceIndices(int index, const ivec3 &in) {
+	indices->at(index) = in;
+	dirty[INDEX].mark(index);
+	topologyVersion++;
+}
 
-void BufferManager::setExtra0(int index, vec4 v) { (*extra0)[index] = v; }
+void BufferManager::setExtra0(int index, vec4 v) {
+	(*extra0)[index] = v;
+	dirty[EXTRA0].mark(index);
+}
 
-void BufferManager::setExtra0(int index, float value, int component) { (*extra0)[index][component] = value; }
+void BufferManager::setExtra0(int index, float value, int component) {
+	(*extra0)[index][component] = value;
+	dirty[EXTRA0].mark(index);
+}
 
 
 void BufferManager::setExtra(int index, vec4 value, int slot) {
     switch (slot) {
         case 0:
             (*extra0)[index] = value;
+            dirty[EXTRA0].mark(index);
             return;
         case 1:
             (*extra1)[index] = value;
+            dirty[EXTRA1].mark(index);
             return;
         case 2:
             (*extra2)[index] = value;
+            dirty[EXTRA2].mark(index);
             return;
         case 3:
             (*extra3)[index] = value;
+            dirty[EXTRA3].mark(index);
             return;
         case 4:
             (*extra4)[index] = value;
+            dirty[EXTRA4].mark(index);
             return;
     }
     throw UnknownVariantError("Extra slot not recognised. ", __FILE__, __LINE__);
@@ -1154,18 +1321,23 @@ void BufferManager::setExtra(int index, float value, int slot, int component) {
     switch (slot) {
         case 0:
             (*extra0)[index][component] = value;
+            dirty[EXTRA0].mark(index);
             return;
         case 1:
             (*extra1)[index][component] = value;
+            dirty[EXTRA1].mark(index);
             return;
         case 2:
             (*extra2)[index][component] = value;
+            dirty[EXTRA2].mark(index);
             return;
         case 3:
             (*extra3)[index][component] = value;
+            dirty[EXTRA3].mark(index);
             return;
         case 4:
             (*extra4)[index][component] = value;
+            dirty[EXTRA4].mark(index);
             return;
         default:
             throw UnknownVariantError("Extra slot not recognised. ", __FILE__, __LINE__);
@@ -1183,6 +1355,56 @@ bool BufferManager::hasExtra3() const { return activeBuffers.contains(EXTRA3); }
 
 bool BufferManager::hasExtra4() const { return activeBuffers.contains(EXTRA4); }
 
+DirtyRanges BufferManager::dirtyRanges(CommonBufferType type, unsigned long uploadedGeneration) const { return dirty[type].since(uploadedGeneration); }
+
+bool BufferManager::isDirty(CommonBufferType type, unsigned long uploadedGeneration) const { return !dirty[type].since(uploadedGeneration).empty(); }
+
+void BufferManager::markDirty(CommonBufferType type, int begin, int end) { dirty[type].mark(begin, end); }
+
+void BufferManager::markAllDirty() {
+	for (auto &d: dirty)
+		d.markWhole();
+}
+
+vector<BufferUpload> collectUploads(DirtyRanges &d, int length, size_t elementSize, size_t allocatedBytes) {
+	vector<BufferUpload> uploads;
+	size_t size = length * elementSize;
+
+	if (size == 0)
+		d.clear();
+	if (d.empty() && size == allocatedBytes)
+		return uploads;
+
+	if (size != allocatedBytes)
+		uploads.push_back({0, size, true});
+	else if (d.wholeBuffer() || 2*d.dirtyElements() > length)
+		uploads.push_back({0, size, true});
+	else
+		for (ivec2 r: d.getRanges()) {
+			int end = std::min(r.y, length);
+			if (r.x < end)
+				uploads.push_back({r.x * elementSize, (end - r.x) * elementSize, false});
+		}
+	d.clear();
+	return uploads;
+}
+
+vector<BufferUpload> collectUploads(DirtyHistory &history, unsigned long &uploadedGeneration, int length, size_t elementSize, size_t allocatedBytes) {
+	DirtyRanges d = history.since(uploadedGeneration);
+	uploadedGeneration = history.advance();
+	return collectUploads(d, length, elementSize, allocatedBytes);
+}
+
+vector<BufferUpload> BufferManager::collectUploads(CommonBufferType type, size_t allocatedBytes, unsigned long &uploadedGeneration, BufferUploadLog *log) {
+	auto uploads = ::collectUploads(dirty[type], uploadedGeneration, bufferLength(type), bufferElementSize(type), allocatedBytes);
+	if (log != nullptr)
+		for (const auto &u: uploads)
+			log->record(type, u);
+	return uploads;
+}
+
+unsigned long BufferManager::getTopologyVersion() const { return topologyVersion; }
+
 void BufferManager::reserveSpace(int targetSize) {
     stds->positions.reserve(targetSize);
     stds->normals.reserve(targetSize);
@@ -1211,7 +1433,7 @@ void BufferManager::reserveAdditionalSpace(int extraStorage) { reserveSpace(buff
 vec3 IndexedMesh::centerOfMass(PolyGroupID id) const {
 	vec3 sum        = vec3(0);
 	float totalArea = 0;
-	for (const IndexedTriangle &t: triangles.at(polygroupIndexOrder.at(id))) {
+	for (const IndexedTriangle &t: triangleView(id)) {
 		sum += t.center()*t.area();
 		totalArea += t.area();
 	}
@@ -1222,7 +1444,7 @@ vec3 IndexedMesh::centerOfMass() const {
 	vec3 sum        = vec3(0);
 	float totalArea = 0;
 	for (const auto &id: getPolyGroupIDs())
-		for (const IndexedTriangle &t: triangles.at(polygroupIndexOrder.at(id))) {
+		for (const IndexedTriangle &t: triangleView(id)) {
 			sum += t.center()*t.area();
 			totalArea += t.area();
 		}
@@ -1258,7 +1480,7 @@ Wireframe::Wireframe(const SmoothParametricSurface &surf, float width, int n, in
 
 void Wireframe::changeBaseSurface(const SmoothParametricSurface &newsurf) {
 	for (auto id: getPolyGroupIDs())
-		for (BufferedVertex &v: vertices.at(polygroupIndexOrder.at(id))) {
+		for (BufferedVertex v: vertexView(id)) {
 			vec2 tu     = getSurfaceParameters(v);
 			vec3 old_p0 = surf(tu);
 			vec3 new_p0 = newsurf(tu);
@@ -1759,7 +1981,7 @@ void PipeCurveVertexShader::setExtra(BufferedVertex &v, float value, int extra_i
 
 
 std::function<void(float, float)> deformationOperator(const std::function<void(BufferedVertex &, float, float)> &deformation, IndexedMesh &mesh, const PolyGroupID &id) {
-    return [&deformation, &mesh, id](float t, float delta) {
+    return [deformation, &mesh, id](float t, float delta) {
         mesh.deformPerVertex(id, [deformation, t, delta](BufferedVertex &v) {
 	        deformation(v, t, delta);
         });
@@ -1767,17 +1989,64 @@ std::function<void(float, float)> deformationOperator(const std::function<void(B
 }
 
 std::function<void(float)> deformationOperator(const std::function<void(BufferedVertex &, float)> &deformation, IndexedMesh &mesh, const PolyGroupID &id) {
-    return [&deformation, &mesh, id](float t) {
+    return [deformation, &mesh, id](float t) {
         mesh.deformPerVertex(id, [deformation, t](BufferedVertex &v) {
 	        deformation(v, t);
         });
     };
 }
 
+// the displacement is the same for every vertex, so it is evaluated once per step
 std::function<void(float, float)> moveAlongCurve(const SmoothParametricCurve &curve, IndexedMesh &mesh, const PolyGroupID &id) {
-    return deformationOperator([curve](BufferedVertex &v, float t, float delta) {
-        v.setPosition(v.getPosition() + curve(t) - curve(t - delta));
-    }, mesh, id);
+    return [curve, &mesh, id](float t, float delta) {
+        mesh.deformBulk(id, vertexKernels::translation(curve(t) - curve(t - delta)), {POSITION});
+    };
+}
+
+VertexKernel vertexKernels::affine(const mat3 &M, vec3 v) {
+	return [M, v](const VertexSpans &vs) {
+		for (int k = 0; k < vs.size(); k++) {
+			vs.positions[k] = M*vs.positions[k] + v;
+			vs.normals[k] = normalise(M*vs.normals[k]);
+		}
+	};
+}
+
+VertexKernel vertexKernels::translation(vec3 v) {
+	return [v](const VertexSpans &vs) {
+		for (vec3 &p: vs.positions)
+			p += v;
+	};
+}
+
+VertexKernel vertexKernels::ambientMap(const SpaceEndomorphism &f) {
+	return [f](const VertexSpans &vs) {
+		vector<vec3> old(vs.positions.begin(), vs.positions.end());
+		f.evaluate(old, vs.positions);
+		for (int k = 0; k < vs.size(); k++)
+			vs.normals[k] = normalise(f.df(old[k])*vs.normals[k]);
+	};
+}
+
+VertexKernel vertexKernels::renormaliseNormals() {
+	return [](const VertexSpans &vs) {
+		for (vec3 &n: vs.normals)
+			n = normalise(n);
+	};
+}
+
+VertexKernel vertexKernels::flipNormals() {
+	return [](const VertexSpans &vs) {
+		for (vec3 &n: vs.normals)
+			n = -n;
+	};
+}
+
+VertexKernel vertexKernels::pointNormalsTowards(vec3 dir) {
+	return [dir](const VertexSpans &vs) {
+		for (vec3 &n: vs.normals)
+			n *= 1.f*sgn(dot(n, dir));
+	};
 }
 
 // ReSharper disable once CppPassValueParameterByConstReference
@@ -1785,30 +2054,43 @@ mat3 IndexedMesh::inertiaTensorCMAppBd(PolyGroupID id) const {
 	return inertiaTensorAppBd(id, centerOfMass(id));
 }
 
+const MeshAdjacency & IndexedMesh::adjacency(const PolyGroupID &id) const {
+	int g = polygroupIndexOrder.at(id);
+	if (adjacencyCache.size() <= g)
+		adjacencyCache.resize(polygroupIndexOrder.size());
+	auto &[version, adj] = adjacencyCache[g];
+	if (adj != nullptr && version == boss->getTopologyVersion())
+		return *adj;
+
+	const PolygroupRange &range = polygroups[g];
+	auto faces = std::span<const ivec3>(static_cast<const ivec3 *>(boss->firstElementAddress(INDEX)) + range.firstFace, range.faceCount);
+	adj = make_shared<const MeshAdjacency>(vector<ivec3>(faces.begin(), faces.end()), range.vertexCount, range.firstVertex);
+	version = boss->getTopologyVersion();
+	return *adj;
+}
+
+void IndexedMesh::invalidateAdjacency() {
+	adjacencyCache.clear();
+}
+
 vector<int> IndexedMesh::findVertexNeighbours(int i, const PolyGroupID &id) const {
-	std::set<int> neighbours = {};
-	for (const IndexedTriangle &t: triangles.at(polygroupIndexOrder.at(id)))
-		if (contains(i, t.getVertexIndices())) {
-			neighbours.insert(setMinus(t.getVertexIndices(), i)[0]);
-			neighbours.insert(setMinus(t.getVertexIndices(), i)[1]);
-		}
+	auto neighbours = adjacency(id).vertexNeighbours(i);
 	return vector(neighbours.begin(), neighbours.end());
 }
 
 vector<int> IndexedMesh::findVertexParentTriangles(int i, const PolyGroupID &id) const {
-	std::set<int> parentTriangles = {};
-	for (int j = 0; j < triangles.at(polygroupIndexOrder.at(id)).size(); j++)
-		if (contains(i, triangles.at(polygroupIndexOrder.at(id))[j].getVertexIndices()))
-			parentTriangles.insert(j);
-	return vector(parentTriangles.begin(), parentTriangles.end());
+	auto parents = adjacency(id).vertexFaces(i);
+	vector<int> res(parents.begin(), parents.end());
+	res.erase(std::unique(res.begin(), res.end()), res.end());
+	return res;
 }
 
 void IndexedMesh::recalculateNormal(int i, const PolyGroupID &id) {
-	auto trs = findVertexParentTriangles(i, id);
+	PolygroupTriangles trs = triangleView(id);
 	vec3 n   = vec3(0);
-	for (int j: trs)
-		n += triangles.at(polygroupIndexOrder.at(id))[j].faceNormal()*triangles.at(polygroupIndexOrder.at(id))[j].area();
-	vertices.at(polygroupIndexOrder.at(id))[i].setNormal(normalize(n));
+	for (int j: adjacency(id).vertexFaces(i))
+		n += trs[j].faceNormal()*trs[j].area();
+	vertexView(id)[i].setNormal(normalize(n));
 }
 
 void IndexedMesh::recalculateNormalsNearby(int i, const PolyGroupID &id) {
@@ -1816,9 +2098,24 @@ void IndexedMesh::recalculateNormalsNearby(int i, const PolyGroupID &id) {
 		recalculateNormal(j, id);
 }
 
+// area weighted face normals are computed once per face and gathered per vertex
 void IndexedMesh::recalculateNormals(const PolyGroupID &id) {
-	for (int i = 0; i < vertices.at(polygroupIndexOrder.at(id)).size(); i++)
-		recalculateNormal(i, id);
+	const MeshAdjacency &adj = adjacency(id);
+	PolygroupVertices vertices = vertexView(id);
+	PolygroupTriangles triangles = triangleView(id);
+	vector<vec3> weighted;
+	weighted.reserve(triangles.size());
+	for (const IndexedTriangle &t: triangles) {
+		ivec3 ind = t.getVertexIndices();
+		vec3 p0 = boss->getPosition(ind.x);
+		weighted.push_back(.5f*cross(boss->getPosition(ind.y) - p0, boss->getPosition(ind.z) - p0));
+	}
+	for (int i = 0; i < vertices.size(); i++) {
+		vec3 n = vec3(0);
+		for (int j: adj.vertexFaces(i))
+			n += weighted[j];
+		vertices[i].setNormal(normalize(n));
+	}
 }
 
 void IndexedMesh::recalculateNormals() {
@@ -1827,8 +2124,8 @@ void IndexedMesh::recalculateNormals() {
 }
 
 void IndexedMesh::orientFaces(const PolyGroupID &id) {
-	for (auto &t: triangles.at(polygroupIndexOrder.at(id)))
-		if (dot(t.faceNormal(), t.getVertex(0).getNormal()) < 0)
+	for (IndexedTriangle t: triangleView(id))
+		if (dot(t.faceNormal(), boss->getNormal(t.getVertexIndices().x)) < 0)
 			t.changeOrientation();
 }
 
@@ -1837,28 +2134,62 @@ void IndexedMesh::orientFaces() {
 		orientFaces(id);
 }
 
+void IndexedMesh::optimiseVertexCache(const PolyGroupID &id, const MeshOptimisationSettings &settings) {
+	PolygroupRange &range = polygroups.at(polygroupIndexOrder.at(id));
+	auto stored = std::span(static_cast<const ivec3 *>(boss->firstElementAddress(INDEX)) + range.firstFace, range.faceCount);
+	vector<ivec3> faces;
+	faces.reserve(range.faceCount);
+	for (ivec3 f: stored)
+		faces.push_back(f - ivec3(range.firstVertex));
+
+	vector<int> order = vertexCacheTriangleOrder(faces, range.vertexCount, settings.cacheSize);
+	if (settings.overdraw) {
+		auto positions = std::span(static_cast<const vec3 *>(boss->firstElementAddress(POSITION)) + range.firstVertex, range.vertexCount);
+		order = overdrawTriangleOrder(faces, positions, order, settings.overdrawThreshold, settings.cacheSize);
+	}
+	vector<ivec3> reordered(range.faceCount);
+	for (int k = 0; k < range.faceCount; k++)
+		reordered[k] = faces[order[k]];
+
+	if (settings.vertexFetch) {
+		vector<int> fetch = vertexFetchOrder(reordered, range.vertexCount);
+		vector<int> remap(range.vertexCount);
+		for (int k = 0; k < range.vertexCount; k++)
+			remap[fetch[k]] = k;
+		for (ivec3 &f: reordered)
+			f = ivec3(remap[f.x], remap[f.y], remap[f.z]);
+		boss->reorderVertices(range.firstVertex, fetch);
+		range.grid = ivec2(0);
+	}
+	boss->setTriangles(range.firstFace, reordered, range.firstVertex);
+}
+
+void IndexedMesh::optimiseVertexCache(const MeshOptimisationSettings &settings) {
+	for (auto id: getPolyGroupIDs())
+		optimiseVertexCache(id, settings);
+}
+
+VertexCacheStats IndexedMesh::vertexCacheStats(const PolyGroupID &id, int cacheSize, VertexCacheModel model) const {
+	vector<ivec3> faces = getIndices(id);
+	const PolygroupRange &range = polygroupRange(id);
+	for (ivec3 &f: faces)
+		f -= ivec3(range.firstVertex);
+	return simulateVertexCache(faces, range.vertexCount, cacheSize, model);
+}
+
 vector<int> IndexedMesh::findNeighboursSorted(int i, const PolyGroupID &id) const {
+	PolygroupVertices vertices = vertexView(id);
 	vector<int> neighbours = findVertexNeighbours(i, id);
 	std::map<int, float> angles = {};
-	auto t = orthogonalComplementBasis(vertices.at(polygroupIndexOrder.at(id))[i].getNormal());
+	auto t = orthogonalComplementBasis(vertices[i].getNormal());
 	for (int j = 0; j < neighbours.size(); j++)
-		angles[i] = polarAngle(vertices.at(polygroupIndexOrder.at(id))[neighbours[j]].getPosition() - vertices.at(polygroupIndexOrder.at(id))[i].getPosition(), vertices.at(polygroupIndexOrder.at(id))[i].getNormal());
+		angles[neighbours[j]] = polarAngle(vertices[neighbours[j]].getPosition() - vertices[i].getPosition(), vertices[i].getNormal());
 	std::ranges::sort(neighbours, [&angles](int a, int b) { return angles[a] < angles[b]; });
 	return neighbours;
 }
 
 bool IndexedMesh::checkIfHasCompleteNeighbourhood(int i, const PolyGroupID &id) const {
-	vector<int> trs = findVertexParentTriangles(i, id);
-	vector<int> neighbours = findVertexNeighbours(i, id);
-	for (int p: neighbours) {
-		int found = 0;
-		for (int t: trs)
-			if (triangles.at(polygroupIndexOrder.at(id))[t].containsEdge(i, p))
-				found++;
-		if (found < 2)
-			return false;
-	}
-	return true;
+	return adjacency(id).hasCompleteNeighbourhood(i);
 }
 
 float IndexedMesh::meanCurvature(int i, const PolyGroupID &id) const {
@@ -1866,11 +2197,12 @@ float IndexedMesh::meanCurvature(int i, const PolyGroupID &id) const {
 		return 0;
 	float sum = 0;
 	auto nbhd = findNeighboursSorted(i, id);
-	vec3 p = vertices.at(polygroupIndexOrder.at(id))[i].getPosition();
+	PolygroupVertices vertices = vertexView(id);
+	vec3 p = vertices[i].getPosition();
 	for (int j=0; j<nbhd.size(); j++) {
-		vec3 prev = vertices.at(polygroupIndexOrder.at(id))[nbhd[(j-1+nbhd.size())%nbhd.size()]].getPosition();
-		vec3 next = vertices.at(polygroupIndexOrder.at(id))[nbhd[(j+1)%nbhd.size()]].getPosition();
-		vec3 current = vertices.at(polygroupIndexOrder.at(id))[nbhd[j]].getPosition();
+		vec3 prev = vertices[nbhd[(j-1+nbhd.size())%nbhd.size()]].getPosition();
+		vec3 next = vertices[nbhd[(j+1)%nbhd.size()]].getPosition();
+		vec3 current = vertices[nbhd[j]].getPosition();
 		float angle1 = abs(angle(prev-p, prev-current));
 		float angle2 = abs(angle(next-p, next-current));
 		sum += 0.5f*(cot(angle1) + cot(angle2))*length(current-p);
@@ -1879,17 +2211,18 @@ float IndexedMesh::meanCurvature(int i, const PolyGroupID &id) const {
 }
 
 vec3 IndexedMesh::meanCurvatureVector(int i, const PolyGroupID &id) const {
-	return meanCurvature(i, id)*vertices.at(polygroupIndexOrder.at(id))[i].getNormal();
+	return meanCurvature(i, id)*vertexView(id)[i].getNormal();
 }
 
 float IndexedMesh::GaussCurvature(int i, const PolyGroupID &id) const {
+	PolygroupVertices vertices = vertexView(id);
 	auto nbhd = findNeighboursSorted(i, id);
 	float sum = 0;
-	vec3 p = vertices.at(polygroupIndexOrder.at(id))[i].getPosition();
+	vec3 p = vertices[i].getPosition();
 	for (int j=0; j<nbhd.size(); j++) {
-		vec3 prev = vertices.at(polygroupIndexOrder.at(id))[nbhd[(j-1+nbhd.size())%nbhd.size()]].getPosition();
-		vec3 next = vertices.at(polygroupIndexOrder.at(id))[nbhd[(j+1)%nbhd.size()]].getPosition();
-		vec3 current = vertices.at(polygroupIndexOrder.at(id))[nbhd[j]].getPosition();
+		vec3 prev = vertices[nbhd[(j-1+nbhd.size())%nbhd.size()]].getPosition();
+		vec3 next = vertices[nbhd[(j+1)%nbhd.size()]].getPosition();
+		vec3 current = vertices[nbhd[j]].getPosition();
 		sum += angle(prev-current, next-current)/length(prev-next)*length(p-current)/2;
 	}
 	return sum;
@@ -1931,7 +2264,7 @@ SurfacePlotDiscretisedMesh::SurfacePlotDiscretisedMesh(const DiscreteRealFunctio
 		float t = ts[i];
 		for (int j = 0; j < plot.samples_x(); j++) {
 			float x = xs[j];
-			vec3 p = vec3(x, t, plot[i][j]);
+			vec3 p = vec3(x, t, plot.at(i, j));
 			vec3 n = e3;
 			if (i > 0 && j > 0) {
 				auto p1 = points.back().getPosition();
@@ -1974,7 +2307,7 @@ SurfacePolarPlotDiscretisedMesh::SurfacePolarPlotDiscretisedMesh(const DiscreteR
 		for (int j = 0; j < nx; j++) {
 			float phi = xs[j] + t*rot_speed;
 			// float R = r-_f[i][j];
-			float R = r-log(1+f[i][j]);
+			float R = r-log(1+f.at(i, j));
 
 			vec3 p = vec3(R*sin(phi), t, R*cos(phi));
 			vec3 n = -vec3(sin(phi), 0, cos(phi));
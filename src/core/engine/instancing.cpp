@@ -0,0 +1,122 @@
+#include "instancing.hpp"
+
+
+InstanceCalls InstanceCalls::gl() {
+	InstanceCalls calls;
+	calls.createBuffer = [] {
+		GLuint buffer;
+		glGenBuffers(1, &buffer);
+		return buffer;
+	};
+	calls.bufferData = [](GLuint buffer, GLsizeiptr bytes, const void *data) {
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_DYNAMIC_DRAW);
+	};
+	calls.bufferSubData = [](GLuint buffer, GLintptr offset, GLsizeiptr bytes, const void *data) {
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, data);
+	};
+	calls.instanceAttribute = [](GLuint buffer, GLuint location, GLsizei stride, GLintptr offset) {
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void *>(offset));
+		glVertexAttribDivisor(location, 1);
+	};
+	calls.disableAttribute = [](GLuint location) {
+		glVertexAttribDivisor(location, 0);
+		glDisableVertexAttribArray(location);
+	};
+	calls.drawInstanced = [](GLsizei indexCount, GLsizei instanceCount) {
+		glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, instanceCount);
+	};
+	calls.deleteBuffer = [](GLuint buffer) { glDeleteBuffers(1, &buffer); };
+	return calls;
+}
+
+
+InstanceTable::InstanceTable(const vector<InstanceAttribute> &attributes, int size) {
+	for (auto a: attributes)
+		active[a] = true;
+	THROW_IF(active[INSTANCE_TRANSFORM] && active[INSTANCE_OFFSET], IllegalArgumentError, "Instance transform and offset share attribute locations");
+	resize(size);
+}
+
+void InstanceTable::resize(int size) {
+	if (active[INSTANCE_TRANSFORM])
+		transforms.resize(size, mat4(1));
+	for (int a = INSTANCE_OFFSET; a < INSTANCE_ATTRIBUTES; ++a)
+		if (active[a])
+			columns[a].resize(size, a == INSTANCE_OFFSET ? vec4(0, 0, 0, 1) : vec4(1));
+	for (auto &d: dirty)
+		d.mark(n, size);
+	n = size;
+}
+
+const void *InstanceTable::data(InstanceAttribute attribute) const {
+	if (attribute == INSTANCE_TRANSFORM)
+		return transforms.data();
+	return columns[attribute].data();
+}
+
+vector<BufferUpload> InstanceTable::collectUploads(InstanceAttribute attribute, size_t allocatedBytes, unsigned long &uploadedGeneration) {
+	return ::collectUploads(dirty[attribute], uploadedGeneration, n, elementBytes(attribute), allocatedBytes);
+}
+
+
+InstanceBuffers::InstanceBuffers(InstanceCalls calls) : calls(std::move(calls)) {}
+
+InstanceBuffers::~InstanceBuffers() {
+	for (GLuint buffer: buffers)
+		if (buffer != 0)
+			calls.deleteBuffer(buffer);
+}
+
+void InstanceBuffers::load(InstanceTable &table) {
+	for (int a = 0; a < INSTANCE_ATTRIBUTES; ++a) {
+		auto attribute = static_cast<InstanceAttribute>(a);
+		if (!table.has(attribute))
+			continue;
+		auto uploads = table.collectUploads(attribute, allocatedBytes[a], uploadedGenerations[a]);
+		if (uploads.empty())
+			continue;
+		if (buffers[a] == 0)
+			buffers[a] = calls.createBuffer();
+		auto src = static_cast<const char *>(table.data(attribute));
+		for (const auto &u: uploads) {
+			if (u.respecify) {
+				calls.bufferData(buffers[a], u.size, u.size > 0 ? src : nullptr);
+				allocatedBytes[a] = u.size;
+			}
+			else
+				calls.bufferSubData(buffers[a], u.offset, u.size, src + u.offset);
+			uploadLog.record(u);
+		}
+	}
+}
+
+void InstanceBuffers::draw(const InstanceTable &table, int indexCount) {
+	if (table.size() == 0)
+		return;
+	std::array<GLuint, INSTANCE_ATTRIBUTES + 3> enabled;
+	int enabledCount = 0;
+	for (int a = 0; a < INSTANCE_ATTRIBUTES; ++a) {
+		auto attribute = static_cast<InstanceAttribute>(a);
+		if (!table.has(attribute))
+			continue;
+		THROW_IF(buffers[a] == 0, ValueError, "Instance table has to be loaded before drawing");
+		GLuint location = instanceAttributeLocation(attribute);
+		// a matrix takes one location per column
+		int locations = attribute == INSTANCE_TRANSFORM ? 4 : 1;
+		for (int c = 0; c < locations; ++c) {
+			calls.instanceAttribute(buffers[a], location + c, InstanceTable::elementBytes(attribute), c*sizeof(vec4));
+			enabled[enabledCount++] = location + c;
+		}
+	}
+	calls.drawInstanced(indexCount, table.size());
+	for (int i = 0; i < enabledCount; ++i)
+		calls.disableAttribute(enabled[i]);
+}
+
+void InstanceBuffers::draw(const InstanceTable &table, const IndexedMesh &shape) {
+	draw(table, shape.bufferIndexLength()*3);
+}
@@ -0,0 +1,492 @@
+#include "meshIO.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+
+#include "indexedRendering.hpp"
+#include "logging.hpp"
+#include "parallel.hpp"
+
+
+namespace {
+	bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+	const char *skipBlank(const char *p, const char *end) {
+		while (p < end && isBlank(*p))
+			++p;
+		return p;
+	}
+
+	const char *lineEnd(const char *p, const char *end) {
+		auto eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+		return eol ? eol : end;
+	}
+
+	string excerpt(const char *p, const char *end) {
+		return string(p, std::min<ptrdiff_t>(end - p, 24));
+	}
+
+	enum class OBJLine { POSITION, UV, NORMAL, FACE, OTHER };
+
+	// recognises the keyword of a line and moves p past it
+	OBJLine lineType(const char *&p, const char *end) {
+		p = skipBlank(p, end);
+		auto keyword = [&](std::string_view k) {
+			if (end - p <= (ptrdiff_t)k.size() || std::string_view(p, k.size()) != k || !isBlank(p[k.size()]))
+				return false;
+			p += k.size();
+			return true;
+		};
+		if (keyword("v")) return OBJLine::POSITION;
+		if (keyword("vt")) return OBJLine::UV;
+		if (keyword("vn")) return OBJLine::NORMAL;
+		if (keyword("f")) return OBJLine::FACE;
+		return OBJLine::OTHER;
+	}
+
+	template<typename T>
+	const char *parseNumber(const char *p, const char *end, T &x) {
+		if (p < end && *p == '+')
+			++p;
+		auto [next, error] = std::from_chars(p, end, x);
+		THROW_IF(error != std::errc(), ValueError, "OBJ: expected a number at '" + excerpt(p, end) + "'");
+		return next;
+	}
+
+	// reads up to n blank separated floats, at least `required` of them, the remaining ones are left untouched
+	void parseFloats(const char *p, const char *end, float *x, int required, int n) {
+		for (int i = 0; i < n; ++i) {
+			p = skipBlank(p, end);
+			if (i >= required && (p == end || *p == '#'))
+				return;
+			p = parseNumber(p, end, x[i]);
+		}
+	}
+
+	// 1-based or negative (relative to count, the number of elements defined so far) OBJ index to a 0-based one
+	int objIndex(int i, int count, int total, const char *what) {
+		int res = i > 0 ? i - 1 : count + i;
+		THROW_IF(i == 0 || res < 0 || res >= total, ValueError, std::format("OBJ: {} index {} out of range", what, i));
+		return res;
+	}
+
+	// appends the fan triangulation of a face as (position, uv, normal) corners, -1 marks a missing attribute
+	void parseFace(const char *p, const char *end, ivec3 count, ivec3 total, vector<ivec3> &corners) {
+		ivec3 first, previous;
+		int n = 0;
+		while (true) {
+			p = skipBlank(p, end);
+			if (p == end || *p == '#')
+				break;
+			ivec3 c = ivec3(-1);
+			int i;
+			p = parseNumber(p, end, i);
+			c.x = objIndex(i, count.x, total.x, "position");
+			if (p < end && *p == '/') {
+				if (++p < end && *p != '/') {
+					p = parseNumber(p, end, i);
+					c.y = objIndex(i, count.y, total.y, "texture coordinate");
+				}
+				if (p < end && *p == '/') {
+					p = parseNumber(p + 1, end, i);
+					c.z = objIndex(i, count.z, total.z, "normal");
+				}
+			}
+			THROW_IF(p < end && !isBlank(*p) && *p != '#', ValueError, "OBJ: unexpected characters in a face at '" + excerpt(p, end) + "'");
+			if (n == 0)
+				first = c;
+			else if (n >= 2)
+				corners.insert(corners.end(), {first, previous, c});
+			previous = c;
+			n++;
+		}
+		THROW_IF(n < 3, ValueError, "OBJ: face with less than three corners");
+	}
+
+	struct OBJChunk {
+		const char *begin, *end;
+		ivec3 counts = ivec3(0); // positions, uvs and normals defined in the chunk
+		vector<ivec3> corners;
+	};
+
+	void countElements(OBJChunk &chunk) {
+		for (const char *p = chunk.begin; p < chunk.end;) {
+			const char *eol = lineEnd(p, chunk.end);
+			switch (lineType(p, eol)) {
+				case OBJLine::POSITION: chunk.counts.x++; break;
+				case OBJLine::UV: chunk.counts.y++; break;
+				case OBJLine::NORMAL: chunk.counts.z++; break;
+				default: break;
+			}
+			p = eol + 1;
+		}
+	}
+
+	// offset is the number of elements defined in preceding chunks, attributes are written at these positions
+	void parseChunk(OBJChunk &chunk, ivec3 offset, ivec3 total, vec3 *positions, vec2 *uvs, vec3 *normals) {
+		ivec3 count = offset;
+		for (const char *p = chunk.begin; p < chunk.end;) {
+			const char *eol = lineEnd(p, chunk.end);
+			switch (lineType(p, eol)) {
+				case OBJLine::POSITION: parseFloats(p, eol, &positions[count.x++].x, 3, 3); break;
+				case OBJLine::UV: parseFloats(p, eol, &uvs[count.y++].x, 1, 2); break;
+				case OBJLine::NORMAL: parseFloats(p, eol, &normals[count.z++].x, 3, 3); break;
+				case OBJLine::FACE: parseFace(p, eol, count, total, chunk.corners); break;
+				default: break;
+			}
+			p = eol + 1;
+		}
+	}
+
+	/**
+	 * Open addressing map from (position, uv, normal) corners to vertex indices, for corners that differ
+	 * from the first corner of their position. Linear probing, grows at half load.
+	 */
+	class CornerTable {
+		vector<ivec3> keys;
+		vector<int> values;
+		int n = 0;
+
+		static size_t hash(ivec3 c) {
+			return (uint64_t(c.x) * 0x9e3779b97f4a7c15ull) ^ (uint64_t(c.y) * 0xc2b2ae3d27d4eb4full) ^ (uint64_t(c.z) * 0x165667b19e3779f9ull);
+		}
+
+		void grow() {
+			vector<ivec3> oldKeys = std::move(keys);
+			vector<int> oldValues = std::move(values);
+			keys.assign(std::max<size_t>(64, 2*oldKeys.size()), ivec3(-1));
+			values.assign(keys.size(), -1);
+			for (size_t i = 0; i < oldKeys.size(); ++i)
+				if (oldValues[i] >= 0)
+					slot(oldKeys[i]) = {oldKeys[i], oldValues[i]};
+		}
+
+		pair<ivec3&, int&> slot(ivec3 c) {
+			size_t mask = keys.size() - 1;
+			size_t i = hash(c) & mask;
+			while (values[i] >= 0 && keys[i] != c)
+				i = (i + 1) & mask;
+			return {keys[i], values[i]};
+		}
+
+	public:
+		// index of the corner, or newIndex if it was not present (and is now)
+		int find(ivec3 c, int newIndex) {
+			if (2*(n + 1) > (int)keys.size())
+				grow();
+			auto [key, value] = slot(c);
+			if (value < 0) {
+				key = c;
+				value = newIndex;
+				n++;
+			}
+			return value;
+		}
+	};
+
+	void computeNormals(OBJData &data, const vector<int> &positionOf) {
+		vector<vec3> sums(data.positions.size(), vec3(0));
+		for (ivec3 f: data.faces) {
+			vec3 n = cross(data.positions[f.y] - data.positions[f.x], data.positions[f.z] - data.positions[f.x]);
+			for (int i = 0; i < 3; ++i)
+				sums[positionOf[f[i]]] += n;
+		}
+		for (int v = 0; v < (int)data.normals.size(); ++v) {
+			vec3 n = sums[positionOf[v]];
+			float len = length(n);
+			data.normals[v] = len > 0 ? n / len : vec3(0);
+		}
+	}
+}
+
+
+OBJData parseOBJ(std::string_view text, int threads) {
+	threads = resolveThreadCount(threads);
+	constexpr size_t MIN_CHUNK_SIZE = 1 << 16;
+	int n = std::clamp<size_t>(text.size() / MIN_CHUNK_SIZE, 1, 4*threads);
+	const char *begin = text.data();
+	const char *end = begin + text.size();
+	vector<OBJChunk> chunks(n);
+	for (int k = 0; k < n; ++k) {
+		chunks[k].begin = k == 0 ? begin : chunks[k-1].end;
+		const char *cut = std::max(begin + text.size()*(k + 1)/n, chunks[k].begin);
+		chunks[k].end = k == n - 1 ? end : std::min(end, lineEnd(cut, end) + 1);
+	}
+
+	parallelFor(n, threads, [&](int k) { countElements(chunks[k]); });
+	vector<ivec3> offsets(n + 1, ivec3(0));
+	for (int k = 0; k < n; ++k)
+		offsets[k+1] = offsets[k] + chunks[k].counts;
+	ivec3 total = offsets[n];
+
+	OBJData data;
+	vector<vec2> uvs(total.y, vec2(0));
+	vector<vec3> normals(total.z, vec3(0));
+	data.positions.resize(total.x, vec3(0));
+	parallelFor(n, threads, [&](int k) {
+		parseChunk(chunks[k], offsets[k], total, data.positions.data(), uvs.data(), normals.data());
+	});
+
+	// vertex i < total.x is position i with the attributes of its first corner, other corners get new vertices
+	size_t cornerCount = 0;
+	for (const OBJChunk &chunk: chunks)
+		cornerCount += chunk.corners.size();
+	data.faces.resize(cornerCount / 3);
+	vector<ivec2> attributes(total.x, ivec2(-2));
+	vector<ivec3> extraCorners;
+	CornerTable table;
+	int *out = data.faces.empty() ? nullptr : &data.faces[0].x;
+	for (const OBJChunk &chunk: chunks)
+		for (ivec3 c: chunk.corners) {
+			ivec2 &a = attributes[c.x];
+			data.hasUVs |= c.y >= 0;
+			data.hasNormals |= c.z >= 0;
+			if (a.x == -2)
+				a = ivec2(c.y, c.z);
+			if (a == ivec2(c.y, c.z)) {
+				*out++ = c.x;
+				continue;
+			}
+			int next = total.x + extraCorners.size();
+			int v = table.find(c, next);
+			if (v == next)
+				extraCorners.push_back(c);
+			*out++ = v;
+		}
+
+	int vertexCount = total.x + extraCorners.size();
+	vector<int> positionOf(vertexCount);
+	data.positions.resize(vertexCount);
+	data.uvs.resize(vertexCount, vec2(0));
+	data.normals.resize(vertexCount, vec3(0));
+	for (int v = 0; v < vertexCount; ++v) {
+		ivec3 c = v < total.x ? ivec3(v, attributes[v]) : extraCorners[v - total.x];
+		positionOf[v] = c.x;
+		data.positions[v] = data.positions[c.x];
+		if (c.y >= 0) data.uvs[v] = uvs[c.y];
+		if (c.z >= 0) data.normals[v] = normals[c.z];
+	}
+	if (!data.hasNormals)
+		computeNormals(data, positionOf);
+	return data;
+}
+
+OBJData readOBJ(const Path &path, int threads) {
+	ReadOnlyFileMapping file = ReadOnlyFileMapping(path);
+	return parseOBJ(file.view(), threads);
+}
+
+
+
+namespace {
+	// buffers a cache can hold, in the order they are stored
+	constexpr CommonBufferType CACHED_BUFFERS[] = {POSITION, NORMAL, UV, COLOR, INDEX, EXTRA0, EXTRA1, EXTRA2, EXTRA3, EXTRA4};
+
+	size_t alignCacheOffset(size_t offset) {
+		return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+	}
+
+	template<typename T>
+	void put(vector<char> &out, T x) {
+		const char *bytes = reinterpret_cast<const char *>(&x);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	void putString(vector<char> &out, const string &s) {
+		put<uint32_t>(out, s.size());
+		out.insert(out.end(), s.begin(), s.end());
+	}
+
+	// sorted or not, consecutive indices are stored as (begin, length) runs
+	// a polygroup is stored as a list of runs, written by the current meshes as at most one run
+	void putRun(vector<char> &out, int begin, int length) {
+		put<uint32_t>(out, length > 0);
+		if (length > 0) {
+			put<uint32_t>(out, begin);
+			put<uint32_t>(out, length);
+		}
+	}
+
+	class CacheTableReader {
+		const char *p, *end;
+		string filename;
+
+	public:
+		CacheTableReader(const char *p, size_t size, string filename) : p(p), end(p + size), filename(std::move(filename)) {}
+
+		void require(size_t bytes) const {
+			if ((size_t)(end - p) < bytes)
+				throw InvalidFileError(filename, "mesh cache polygroup table is truncated", __FILE__, __LINE__);
+		}
+
+		template<typename T>
+		T get() {
+			require(sizeof(T));
+			T x;
+			std::memcpy(&x, p, sizeof(T));
+			p += sizeof(T);
+			return x;
+		}
+
+		string getString(size_t length) {
+			require(length);
+			string s(p, length);
+			p += length;
+			return s;
+		}
+
+		// (begin, length) of the runs read from the table, which have to be consecutive and below bound
+		ivec2 getRun(uint64_t bound) {
+			ivec2 res = ivec2(0);
+			uint32_t n = get<uint32_t>();
+			for (uint32_t k = 0; k < n; ++k) {
+				uint32_t begin = get<uint32_t>(), length = get<uint32_t>();
+				if (uint64_t(begin) + length > bound)
+					throw InvalidFileError(filename, "mesh cache polygroup refers to data outside of the buffers", __FILE__, __LINE__);
+				if (k > 0 && begin != uint32_t(res.x + res.y))
+					throw InvalidFileError(filename, "mesh cache polygroup is not contiguous", __FILE__, __LINE__);
+				if (k == 0)
+					res.x = begin;
+				res.y += length;
+			}
+			return res;
+		}
+	};
+}
+
+
+void IndexedMesh::saveBinaryCache(const Path &path) const {
+	vector<PolyGroupID> ids(polygroupIndexOrder.size());
+	for (const auto &[id, index]: polygroupIndexOrder)
+		ids[index] = id;
+
+	vector<char> table;
+	for (int k = 0; k < (int)ids.size(); ++k) {
+		if (std::holds_alternative<int>(ids[k])) {
+			put<int32_t>(table, 0);
+			put<int32_t>(table, std::get<int>(ids[k]));
+		} else {
+			put<int32_t>(table, 1);
+			putString(table, std::get<string>(ids[k]));
+		}
+		putRun(table, polygroups[k].firstVertex, polygroups[k].vertexCount);
+		putRun(table, polygroups[k].firstFace, polygroups[k].faceCount);
+	}
+	vector<string> names = boss->getExtraBufferNames();
+	put<uint32_t>(table, names.size());
+	for (const string &name: names)
+		putString(table, name);
+
+	MeshCacheHeader header = {};
+	std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof header.magic);
+	header.version = MESH_CACHE_VERSION;
+	for (CommonBufferType type: CACHED_BUFFERS)
+		if (boss->isActive(type))
+			header.buffers |= 1u << type;
+	header.polygroups = ids.size();
+	header.vertices = boss->bufferLength(POSITION);
+	header.faces = boss->bufferLength(INDEX);
+	header.tableBytes = table.size();
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+		THROW(FileSystemError, "Cannot open " + path.string() + " for writing");
+	out.write(reinterpret_cast<const char *>(&header), sizeof header);
+	out.write(table.data(), table.size());
+	size_t offset = sizeof header + table.size();
+	const char padding[MESH_CACHE_ALIGNMENT] = {};
+	for (CommonBufferType type: CACHED_BUFFERS)
+		if (header.buffers & 1u << type) {
+			size_t start = alignCacheOffset(offset);
+			out.write(padding, start - offset);
+			if (boss->bufferSize(type) > 0)
+				out.write(static_cast<const char *>(boss->firstElementAddress(type)), boss->bufferSize(type));
+			offset = start + boss->bufferSize(type);
+		}
+	if (!out)
+		THROW(FileSystemError, "Writing mesh cache " + path.string() + " failed");
+}
+
+IndexedMesh IndexedMesh::loadBinaryCache(const Path &path) {
+	string filename = path.string();
+	ReadOnlyFileMapping file = ReadOnlyFileMapping(path);
+	size_t size = file.size();
+	if (size < sizeof(MeshCacheHeader))
+		throw InvalidFileError(filename, "too short for a mesh cache", __FILE__, __LINE__);
+	const char *base = file.data();
+
+	MeshCacheHeader header;
+	std::memcpy(&header, base, sizeof header);
+	if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof header.magic) != 0)
+		throw InvalidFileError(filename, "not a mesh cache", __FILE__, __LINE__);
+	if (header.version != MESH_CACHE_VERSION)
+		throw InvalidFileError(filename, std::format("mesh cache version {}, expected {}", header.version, MESH_CACHE_VERSION), __FILE__, __LINE__);
+	if (header.tableBytes > size - sizeof header || header.vertices > INT_MAX || header.faces > INT_MAX || !(header.buffers & 1u << POSITION) || !(header.buffers & 1u << INDEX))
+		throw InvalidFileError(filename, "corrupted mesh cache header", __FILE__, __LINE__);
+
+	std::set<CommonBufferType> active;
+	size_t offset = sizeof header + header.tableBytes;
+	vector<pair<CommonBufferType, size_t>> bufferOffsets;
+	for (CommonBufferType type: CACHED_BUFFERS)
+		if (header.buffers & 1u << type) {
+			active.insert(type);
+			offset = alignCacheOffset(offset);
+			bufferOffsets.emplace_back(type, offset);
+			offset += (type == INDEX ? header.faces : header.vertices) * bufferElementSize(type);
+		}
+	if (offset > size)
+		throw InvalidFileError(filename, "mesh cache is truncated", __FILE__, __LINE__);
+
+	CacheTableReader table = CacheTableReader(base + sizeof header, header.tableBytes, filename);
+	vector<PolyGroupID> ids;
+	vector<ivec2> vertexRuns, faceRuns;
+	for (uint32_t k = 0; k < header.polygroups; ++k) {
+		if (table.get<int32_t>() == 0)
+			ids.emplace_back(table.get<int32_t>());
+		else
+			ids.emplace_back(table.getString(table.get<uint32_t>()));
+		vertexRuns.push_back(table.getRun(header.vertices));
+		faceRuns.push_back(table.getRun(header.faces));
+	}
+	vector<string> names(table.get<uint32_t>());
+	for (string &name: names)
+		name = table.getString(table.get<uint32_t>());
+
+	IndexedMesh mesh = IndexedMesh();
+	mesh.boss = make_unique<BufferManager>(active, names);
+	mesh.boss->resizeBuffers(header.vertices, header.faces);
+	for (auto [type, start]: bufferOffsets)
+		if (mesh.boss->bufferSize(type) > 0)
+			std::memcpy(mesh.boss->firstElementAddress(type), base + start, mesh.boss->bufferSize(type));
+	// both counts were checked against INT_MAX above
+	for (int i = 0; i < (int)header.faces; ++i) {
+		ivec3 f = mesh.boss->getFaceIndices(i);
+		if (std::min({f.x, f.y, f.z}) < 0 || std::max({f.x, f.y, f.z}) >= (int)header.vertices)
+			throw InvalidFileError(filename, "mesh cache face refers to a missing vertex", __FILE__, __LINE__);
+	}
+
+	for (int k = 0; k < (int)ids.size(); ++k) {
+		if (mesh.polygroupIndexOrder.contains(ids[k]))
+			throw InvalidFileError(filename, "mesh cache contains a polygroup twice", __FILE__, __LINE__);
+		mesh.polygroupIndexOrder[ids[k]] = k;
+		mesh.polygroups.push_back({vertexRuns[k].x, vertexRuns[k].y, faceRuns[k].x, faceRuns[k].y});
+	}
+	return mesh;
+}
+
+IndexedMesh IndexedMesh::fromOBJCached(const Path &objPath, const PolyGroupID &id, const Path &cachePath) {
+	Path cache = cachePath.empty() ? Path(objPath.string() + ".meshcache") : cachePath;
+	std::error_code error;
+	if (filesystem::exists(cache, error) && filesystem::last_write_time(cache, error) >= filesystem::last_write_time(objPath))
+		try {
+			IndexedMesh mesh = loadBinaryCache(cache);
+			if (mesh.polygroupIndexOrder.size() == 1 && mesh.polygroupIndexOrder.contains(id))
+				return mesh;
+		} catch (const InvalidFileError &e) {
+			LOG_WARN("Rebuilding mesh cache " + cache.string() + ": " + e.what());
+		}
+	IndexedMesh mesh = IndexedMesh(objPath.string().c_str(), id);
+	mesh.saveBinaryCache(cache);
+	return mesh;
+}
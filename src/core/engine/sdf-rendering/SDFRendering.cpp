@@ -264,15 +264,18 @@ SDFRenderingStep::SDFRenderingStep(const std::shared_ptr<ShaderProgram> &shader,
 }
 
 void SDFRenderingStep::addSDFUniforms() {
-	paramsUniformLoc = glGetUniformLocation(shader->programID, "params");
+	if (paramsSize > 0)
+		paramsUniform = shader->uniformHandle<vec3>("params", paramsSize);
 	if (materialSize > 0)
-		materialUniformLoc = glGetUniformLocation(shader->programID, "materials");
+		materialUniform = shader->uniformHandle<vec4>("materials", materialSize);
 }
 
 void SDFRenderingStep::loadSDFUniforms() {
-	glUniform3fv(paramsUniformLoc, paramsSize, (float *) paramsData);
-	if (materialSize > 0)
-		glUniform4fv(materialUniformLoc, materialSize, (float *) materialData);
+	if (paramsUniform.valid())
+		paramsUniform.set((const vec3 *) paramsData, paramsSize);
+	if (materialUniform.valid())
+		materialUniform.set((const vec4 *) materialData, materialSize);
+	shader->flushUniforms();
 }
 
 
@@ -300,16 +303,8 @@ void SDFRenderingStep::renderStep(float t) {
 }
 
 void SDFRenderingStep::addCameraUniforms(const std::shared_ptr<Camera> &camera) {
-	auto MVPsetter = [camera, this](float t, const std::shared_ptr<ShaderProgram> &shader) {
-		mat4 mvp = camera->vp(t);
-		shader->setUniform("mvp", mvp);
-	};
-	auto positionSetter = [camera, this](float t, const std::shared_ptr<ShaderProgram> &shader) {
-		vec3 camPos = camera->position(t);
-		shader->setUniform("camPosition", camPos);
-	};
-	addUniform("mvp", MAT4, std::make_shared<std::function<void(float, shared_ptr<ShaderProgram>)> >(MVPsetter));
-	addUniform("camPosition", VEC3, std::make_shared<std::function<void(float, shared_ptr<ShaderProgram>)> >(positionSetter));
+	addUniform<mat4>("mvp", [camera](float t) { return camera->vp(t); });
+	addUniform<vec3>("camPosition", [camera](float t) { return camera->position(t); });
 }
 
 
@@ -335,9 +330,11 @@ int SDFRenderer::mainLoop() {
 	while (window->isOpen()) {
 		initFrame();
 		perFrameFunction(time, dt);
+		pacer.markSimulationDone();
 		for (auto &step: sdfSteps)
 			step->renderStep(time);
 		window->renderFramebufferToScreen();
+		pacer.endFrame();
 	}
 	return window->destroy();
 }
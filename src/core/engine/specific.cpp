@@ -530,7 +530,7 @@ void Disk3D::move(vec3 center, vec3 forward, vec3 down, bool scaleWidth) {
     vec3 delta = center - this->center;
 
     vec3 n = normalise(cross(forward, down));
-    for (BufferedVertex &v: getBufferedVertices(id)) {
+    for (BufferedVertex v: vertexView(id)) {
         vec3 normalComponent = scaleWidth ? normal*widthNormalised(v)*radius : normal*width(v);
         v.setPosition(center + forward*cos(angle(v))*rParam(v)*radius + down*sin(angle(v))*rParam(v)*radius +  normalComponent);
         v.setNormal(normalise(dot(v.getNormal(), this->normal)*n + dot(v.getNormal(), this->forward)*forward + dot(v.getNormal(), this->down)*down));
@@ -544,7 +544,7 @@ void Disk3D::move(vec3 center, vec3 forward, vec3 down, bool scaleWidth) {
 float Disk3D::moveRotate(vec3 center, vec3 forward, vec3 down) {
     float distance = norm(center + down- this->center-this->down);
     float angle = distance / radius - asin(dot(normal, cross(this->down, down)));
-    for (BufferedVertex &v: getBufferedVertices(id))
+    for (BufferedVertex v: vertexView(id))
         v.setColor(v.getColor() + vec4(angle, 0, 0, 0));
 
     move(center, forward, down, false);
@@ -552,7 +552,7 @@ float Disk3D::moveRotate(vec3 center, vec3 forward, vec3 down) {
 }
 
 void Disk3D::rotate(float angle) {
-    for (BufferedVertex &v: getBufferedVertices(id))
+    for (BufferedVertex v: vertexView(id))
         v.setColor(v.getColor() + vec4(angle, 0, 0, 0));
 
     move(center, forward, down, false);
@@ -566,7 +566,7 @@ void Disk3D::scaleR(float r, bool scaleWidth) {
     vec3 scaleFactors = scaleWidth ? vec3(r/this->radius) : vec3(r/this->radius, r/this->radius, 1);
     radius = r;
     SpaceAutomorphism scaling = SpaceAutomorphism::scaling(scaleFactors).applyWithBasis(forward, down, normal).applyWithShift(center);
-    for (BufferedVertex &v: getBufferedVertices(id)) {
+    for (BufferedVertex v: vertexView(id)) {
         v.applyFunction(scaling);
         if (scaleWidth) setAbsoluteWidth(v, dot(v.getPosition() - center, normal));
         else setRelativeWidth(v, dot(v.getPosition() - center, normal)/radius);
@@ -578,12 +578,12 @@ void Disk3D::setR(float r) {
 }
 
 void Disk3D::setEmpiricalRadius() {
-    for ( auto &v: getBufferedVertices(id))
+    for (BufferedVertex v: vertexView(id))
         radius = std::max(radius, norm(projectVectorToPlane(v.getPosition() - this->center, this->normal)));
 }
 
 void Disk3D::setColorInfo() {
-    for ( auto &v: getBufferedVertices(id))
+    for (BufferedVertex v: vertexView(id))
         v.setColor(vec4(   atan2(dot(v.getPosition() - center, forward), dot(v.getPosition() - center, down)),
                                 rReal(v)/radius,
                                 dot(v.getPosition() - center, normal),
@@ -780,6 +780,32 @@ IndexedMesh drawVectorFieldArrows(const VectorField &field, const vector<vec3> &
 	return mesh;
 }
 
+mat4 arrowTransform(vec3 start, vec3 direction, float length, float radius) {
+	if (length == 0 || norm(direction) == 0)
+		return mat4(vec4(0), vec4(0), vec4(0), vec4(start, 1));
+	vec3 d = normalise(direction);
+	auto [w1, w2] = orthogonalComplementBasis(d);
+	return mat4(vec4(w1*radius, 0), vec4(w2*radius, 0), vec4(d*length, 0), vec4(start, 1));
+}
+
+InstancedMesh instancedVectorFieldArrows(const VectorField &field, const vector<vec3> &points, const std::function<float(float)>& len, const std::function<float(float)> &radius,
+		float head_len, float head_radius, int radial, int straight, float eps) {
+	auto shape = arrow(vec3(0), vec3(0, 0, 1), 1, head_len, head_radius, radial, straight, eps, randomID());
+	InstancedMesh arrows = InstancedMesh(std::move(shape), InstanceTable({INSTANCE_TRANSFORM, INSTANCE_COLOR}, points.size()));
+	updateVectorFieldArrows(arrows.instances(), field, points, len, radius);
+	return arrows;
+}
+
+void updateVectorFieldArrows(InstanceTable &arrows, const VectorField &field, const vector<vec3> &points, const std::function<float(float)>& len, const std::function<float(float)> &radius) {
+	if (arrows.size() != points.size())
+		arrows.resize(points.size());
+	for (int i = 0; i < points.size(); i++) {
+		vec3 f = field(points[i]);
+		float s = norm(f);
+		arrows.setTransform(i, arrowTransform(points[i], f, len(s), radius(s)));
+	}
+}
+
 vec3 getArrayStart(const BufferedVertex &v) {
 	return vec3(v.getColor().x, v.getColor().y, v.getColor().z);
 }
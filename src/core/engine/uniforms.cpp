@@ -0,0 +1,210 @@
+#include "uniforms.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace {
+	int columnsOf(GLSLType type) {
+		switch (type) {
+			case MAT2: return 2;
+			case MAT3: return 3;
+			case MAT4: return 4;
+			default: return 1;
+		}
+	}
+
+	int columnBytesOf(GLSLType type) {
+		switch (type) {
+			case FLOAT: case INT: return 4;
+			case VEC2: case MAT2: return 8;
+			case VEC3: case MAT3: return 12;
+			case VEC4: case MAT4: return 16;
+			default: THROW(IllegalArgumentError, "Samplers are not stored in uniform storages");
+		}
+	}
+
+	// std140 base alignment of a single (non-array) value
+	int std140Alignment(GLSLType type) {
+		if (columnsOf(type) > 1)
+			return 16;
+		int bytes = columnBytesOf(type);
+		return bytes == 12 ? 16 : bytes;
+	}
+
+	int roundUp(int x, int alignment) {
+		return (x + alignment - 1)/alignment*alignment;
+	}
+}
+
+
+UniformCalls UniformCalls::gl() {
+	UniformCalls calls;
+	calls.uniform = [](GLint location, GLSLType type, int count, const void *data) {
+		auto f = static_cast<const GLfloat *>(data);
+		switch (type) {
+			case FLOAT: glUniform1fv(location, count, f); break;
+			case INT: glUniform1iv(location, count, static_cast<const GLint *>(data)); break;
+			case VEC2: glUniform2fv(location, count, f); break;
+			case VEC3: glUniform3fv(location, count, f); break;
+			case VEC4: glUniform4fv(location, count, f); break;
+			case MAT2: glUniformMatrix2fv(location, count, GL_FALSE, f); break;
+			case MAT3: glUniformMatrix3fv(location, count, GL_FALSE, f); break;
+			case MAT4: glUniformMatrix4fv(location, count, GL_FALSE, f); break;
+			default: THROW(IllegalArgumentError, "Uniform type not recognized");
+		}
+	};
+	calls.createBuffer = [](GLsizeiptr bytes, GLuint binding, const void *data) {
+		GLuint buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, bytes, data, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+		return buffer;
+	};
+	calls.bufferSubData = [](GLuint buffer, GLintptr offset, GLsizeiptr bytes, const void *data) {
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, bytes, data);
+	};
+	calls.deleteBuffer = [](GLuint buffer) { glDeleteBuffers(1, &buffer); };
+	return calls;
+}
+
+
+UniformStorage::UniformStorage(UniformCalls calls) : calls(std::move(calls)) {}
+
+int UniformStorage::addSlot(const std::string &name, GLint location, GLSLType type, int count, bool std140) {
+	Slot s;
+	s.name = name;
+	s.location = location;
+	s.type = type;
+	s.count = count;
+	s.columns = columnsOf(type);
+	s.columnBytes = columnBytesOf(type);
+	s.written = false;
+	s.dirty = false;
+	if (std140) {
+		// matrix columns and array elements are padded to vec4
+		s.columnStride = s.columns > 1 ? 16 : s.columnBytes;
+		int size = s.columns*s.columnStride;
+		s.elementStride = count > 1 ? roundUp(size, 16) : size;
+		s.offset = roundUp(data.size(), count > 1 ? 16 : std140Alignment(type));
+	} else {
+		s.columnStride = s.columnBytes;
+		s.elementStride = s.columns*s.columnBytes;
+		s.offset = data.size();
+	}
+	s.bytes = count*s.elementStride;
+	data.resize(s.offset + s.bytes);
+	slots.push_back(s);
+	return slots.size() - 1;
+}
+
+bool UniformStorage::write(int slot, const void *values, int elements) {
+	Slot &s = slots[slot];
+	auto src = static_cast<const std::byte *>(values);
+	std::byte *dst = data.data() + s.offset;
+	int n = std::min(elements, s.count);
+	bool changed = false;
+	if (s.columnStride == s.columnBytes && s.elementStride == s.columns*s.columnBytes) {
+		size_t bytes = n*s.elementStride;
+		if (std::memcmp(dst, src, bytes) != 0) {
+			std::memcpy(dst, src, bytes);
+			changed = true;
+		}
+	}
+	else
+		for (int e = 0; e < n; ++e)
+			for (int c = 0; c < s.columns; ++c) {
+				std::byte *to = dst + e*s.elementStride + c*s.columnStride;
+				const std::byte *from = src + (e*s.columns + c)*s.columnBytes;
+				if (std::memcmp(to, from, s.columnBytes) != 0) {
+					std::memcpy(to, from, s.columnBytes);
+					changed = true;
+				}
+			}
+
+	// the first write is uploaded even when it equals the zero initialised copy
+	if ((changed || !s.written) && !s.dirty) {
+		s.dirty = true;
+		dirtySlots.push_back(slot);
+	}
+	s.written = true;
+	return changed;
+}
+
+int UniformStorage::find(const std::string &name) const {
+	for (int i = 0; i < slots.size(); ++i)
+		if (slots[i].name == name)
+			return i;
+	return -1;
+}
+
+
+std::unordered_map<GLuint, std::weak_ptr<UniformShadowBlock>> UniformShadowBlock::programBlocks = {};
+
+int UniformShadowBlock::add(const std::string &name, GLint location, GLSLType type, int count) {
+	int slot = find(name);
+	if (slot < 0)
+		return addSlot(name, location, type, count, false);
+	THROW_IF(slots[slot].type != type, IllegalArgumentError, "Uniform " + name + " was declared with another type");
+	THROW_IF(slots[slot].count != count, IllegalArgumentError, "Uniform " + name + " was declared with another array size");
+	return slot;
+}
+
+std::shared_ptr<UniformShadowBlock> UniformShadowBlock::ofProgram(GLuint programID, UniformCalls calls) {
+	std::shared_ptr<UniformShadowBlock> block = programBlocks[programID].lock();
+	if (!block) {
+		block = std::make_shared<UniformShadowBlock>(std::move(calls));
+		programBlocks[programID] = block;
+	}
+	return block;
+}
+
+void UniformShadowBlock::flush() {
+	for (int i : dirtySlots) {
+		Slot &s = slots[i];
+		s.dirty = false;
+		// location -1 belongs to uniforms removed by the compiler
+		if (s.location >= 0 && s.count > 0)
+			calls.uniform(s.location, s.type, s.count, data.data() + s.offset);
+	}
+	dirtySlots.clear();
+}
+
+
+UniformBufferBlock::~UniformBufferBlock() {
+	if (buffer != 0)
+		calls.deleteBuffer(buffer);
+}
+
+int UniformBufferBlock::add(const std::string &member, GLSLType type, int count) {
+	THROW_IF(buffer != 0, ValueError, "Uniform buffer block members must be declared before its first flush");
+	return addSlot(member, -1, type, count, true);
+}
+
+void UniformBufferBlock::attach(GLuint programID, const std::string &blockName, GLuint bindingPoint) {
+	GLuint index = glGetUniformBlockIndex(programID, blockName.c_str());
+	THROW_IF(index == GL_INVALID_INDEX, IllegalArgumentError, "No uniform block " + blockName + " in the program");
+	THROW_IF(buffer != 0 && bindingPoint != binding, ValueError, "Uniform buffer block is already bound to another binding point");
+	glUniformBlockBinding(programID, index, bindingPoint);
+	binding = bindingPoint;
+}
+
+void UniformBufferBlock::flush() {
+	if (buffer == 0) {
+		data.resize(bytes());
+		buffer = calls.createBuffer(bytes(), binding, data.data());
+	}
+	else if (!dirtySlots.empty()) {
+		int begin = data.size(), end = 0;
+		for (int i : dirtySlots) {
+			begin = std::min(begin, slots[i].offset);
+			end = std::max(end, slots[i].offset + slots[i].bytes);
+		}
+		calls.bufferSubData(buffer, begin, end - begin, data.data() + begin);
+	}
+	for (int i : dirtySlots)
+		slots[i].dirty = false;
+	dirtySlots.clear();
+}
@@ -0,0 +1,111 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <utility>
+#include "filesUtils.hpp"
+
+
+
+
+#ifdef _WIN32
+
+ReadOnlyFileMapping::ReadOnlyFileMapping(const Path &path) {
+	string fullPath = path.string();
+	HANDLE file = CreateFileA(fullPath.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		THROW(FileNotFoundError, fullPath);
+	fileHandle = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		release();
+		throw InvalidFileError(fullPath, "File size unavailable", __FILE__, __LINE__);
+	}
+	bytesize = size.QuadPart;
+	// mapping an empty file fails, there is nothing to map anyway
+	if (bytesize == 0)
+		return;
+	mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingHandle) {
+		release();
+		throw InvalidFileError(fullPath, "File mapping creation failed", __FILE__, __LINE__);
+	}
+	address = static_cast<const char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (!address) {
+		release();
+		throw InvalidFileError(fullPath, "Mapping view creation failed", __FILE__, __LINE__);
+	}
+}
+
+void ReadOnlyFileMapping::release() {
+	if (address)
+		UnmapViewOfFile(address);
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	if (fileHandle)
+		CloseHandle(fileHandle);
+	address = nullptr;
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+	bytesize = 0;
+}
+
+#else
+
+// the descriptor is closed right after mmap, the mapping keeps the file alive by itself
+ReadOnlyFileMapping::ReadOnlyFileMapping(const Path &path) {
+	string fullPath = path.string();
+	int fd = open(fullPath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		THROW(FileNotFoundError, fullPath);
+	struct stat status;
+	if (fstat(fd, &status) != 0) {
+		close(fd);
+		throw InvalidFileError(fullPath, "File size unavailable", __FILE__, __LINE__);
+	}
+	bytesize = status.st_size;
+	if (bytesize == 0) {
+		close(fd);
+		return;
+	}
+	void *mapped = mmap(nullptr, bytesize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		bytesize = 0;
+		throw InvalidFileError(fullPath, "File mapping creation failed", __FILE__, __LINE__);
+	}
+	address = static_cast<const char *>(mapped);
+}
+
+void ReadOnlyFileMapping::release() {
+	if (address)
+		munmap(const_cast<char *>(address), bytesize);
+	address = nullptr;
+	bytesize = 0;
+}
+
+#endif
+
+
+ReadOnlyFileMapping::~ReadOnlyFileMapping() {
+	release();
+}
+
+ReadOnlyFileMapping::ReadOnlyFileMapping(ReadOnlyFileMapping &&other) noexcept
+: address(std::exchange(other.address, nullptr)), bytesize(std::exchange(other.bytesize, 0)),
+  fileHandle(std::exchange(other.fileHandle, nullptr)), mappingHandle(std::exchange(other.mappingHandle, nullptr)) {}
+
+ReadOnlyFileMapping &ReadOnlyFileMapping::operator=(ReadOnlyFileMapping &&other) noexcept {
+	if (this != &other) {
+		release();
+		address = std::exchange(other.address, nullptr);
+		bytesize = std::exchange(other.bytesize, 0);
+		fileHandle = std::exchange(other.fileHandle, nullptr);
+		mappingHandle = std::exchange(other.mappingHandle, nullptr);
+	}
+	return *this;
+}
@@ -1,7 +1,9 @@
 #include "filesUtils.hpp"
 
 #include <fstream>
+#ifdef _WIN32
 #include <io.h>
+#endif
 #include <iostream>
 #include <sstream>
 
@@ -800,4 +802,3 @@ Path CodeFileDescriptor::getDirectory() const {
 	return file.getPath().parent_path();
 }
 
-DiscreteRealFunction loadSequence(const CodeFileDescriptor &file, vec2 domain);
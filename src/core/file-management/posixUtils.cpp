@@ -0,0 +1,69 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "filesUtils.hpp"
+
+
+// counterpart of windowsUtils.cpp, the build takes one of the two depending on the system
+
+
+void FileDescriptor::mapFile() {
+    if (isMapped())
+        return;
+    string fullPath = path.string();
+    if (!exists())
+        THROW(FileNotFoundError, fullPath);
+    int fd = open(fullPath.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        throw InvalidFileError(fullPath, "Invalid file descriptor", __FILE__, __LINE__);
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        throw InvalidFileError(fullPath, "File size unavailable", __FILE__, __LINE__);
+    }
+    bytesize = status.st_size;
+    void *mapped = mmap(nullptr, bytesize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        throw InvalidFileError(fullPath, "File mapping creation failed", __FILE__, __LINE__);
+    address = mapped;
+}
+
+void FileDescriptor::flush() const {
+    if (address == nullptr)
+        THROW(FileSystemError, "File not mapped, cannot be flushed");
+    msync(address, bytesize, MS_SYNC);
+}
+
+
+
+void FileDescriptor::moveTo(const Path &destination) {
+    bool wasMapped = isMapped();
+    if (wasMapped)
+        closeFile();
+    DirectoryEntry::moveTo(destination);
+    if (wasMapped)
+        mapFile();
+}
+
+void FileDescriptor::remove() {
+    closeFile();
+    filesystem::remove(path);
+    bytesize = 0;
+    type = FILE_NOT_FOUND;
+}
+
+size_t FileDescriptor::getSize() const {
+    return bytesize;
+}
+
+
+
+// the descriptor was closed right after mmap, unmapping releases the file
+void FileDescriptor::closeFile() {
+    if (address == nullptr)
+        return;
+    munmap(address, bytesize);
+    address = nullptr;
+}
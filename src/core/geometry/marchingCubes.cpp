@@ -0,0 +1,183 @@
+#include "marchingCubes.hpp"
+
+#include <stdexcept>
+
+#include "parallel.hpp"
+
+
+namespace {
+	// corner c sits at offset (c & 1, c >> 1 & 1, c >> 2 & 1), edges are listed from the lower corner, grouped by axis
+	constexpr int EDGE_CORNERS[12][2] = {
+		{0, 1}, {2, 3}, {4, 5}, {6, 7},
+		{0, 2}, {1, 3}, {4, 6}, {5, 7},
+		{0, 4}, {1, 5}, {2, 6}, {3, 7}
+	};
+
+	// corners of every face, counterclockwise when seen from outside the cube
+	constexpr int FACE_CORNERS[6][4] = {
+		{0, 4, 6, 2}, {1, 3, 7, 5},
+		{0, 1, 5, 4}, {2, 6, 7, 3},
+		{0, 2, 3, 1}, {4, 5, 7, 6}
+	};
+
+	constexpr int MAX_CASE_TRIANGLES = 5;
+
+	struct CaseTable {
+		std::array<std::array<signed char, 3*MAX_CASE_TRIANGLES + 1>, 256> triangles{};
+	};
+
+	constexpr int edgeBetween(int a, int b) {
+		for (int e = 0; e < 12; ++e)
+			if ((EDGE_CORNERS[e][0] == a && EDGE_CORNERS[e][1] == b) || (EDGE_CORNERS[e][0] == b && EDGE_CORNERS[e][1] == a))
+				return e;
+		return -1;
+	}
+
+	/*
+	 * Walking every face counterclockwise, a sign change from negative to positive corner is an entry crossing.
+	 * Each entry is joined to the next exit crossing on the same face, which cuts off positive corners one by one
+	 * and does not depend on which of the two cubes sharing the face is processed. Every crossing edge is an entry
+	 * on one of its faces and an exit on the other, so the segments close into polygons, fanned into triangles.
+	 */
+	constexpr CaseTable buildCaseTable() {
+		CaseTable table{};
+		for (int cubeCase = 0; cubeCase < 256; ++cubeCase) {
+			auto positive = [cubeCase](int corner) { return (cubeCase >> corner & 1) != 0; };
+			int next[12]{};
+			for (int &e: next)
+				e = -1;
+
+			for (const auto &face: FACE_CORNERS) {
+				int edges[4]{};
+				bool entry[4]{};
+				int n = 0;
+				for (int i = 0; i < 4; ++i) {
+					int a = face[i], b = face[(i+1)%4];
+					if (positive(a) != positive(b)) {
+						edges[n] = edgeBetween(a, b);
+						entry[n] = positive(b);
+						n++;
+					}
+				}
+				for (int i = 0; i < n; ++i)
+					if (entry[i])
+						for (int s = 1; s < n; ++s)
+							if (!entry[(i+s)%n]) {
+								next[edges[i]] = edges[(i+s)%n];
+								break;
+							}
+			}
+
+			int len = 0;
+			bool used[12]{};
+			for (int e = 0; e < 12; ++e) {
+				if (next[e] < 0 || used[e])
+					continue;
+				int polygon[12]{};
+				int m = 0;
+				for (int x = e; !used[x]; x = next[x]) {
+					used[x] = true;
+					polygon[m++] = x;
+				}
+				for (int t = 1; t + 1 < m; ++t) {
+					if (len + 3 > 3*MAX_CASE_TRIANGLES)
+						throw std::logic_error("marching cubes case exceeds MAX_CASE_TRIANGLES");
+					table.triangles[cubeCase][len++] = polygon[0];
+					table.triangles[cubeCase][len++] = polygon[t+1];
+					table.triangles[cubeCase][len++] = polygon[t];
+				}
+			}
+			table.triangles[cubeCase][len] = -1;
+		}
+		return table;
+	}
+
+	constexpr CaseTable CASE_TABLE = buildCaseTable();
+}
+
+
+int marchingCubesCaseTriangles(int cubeCase) {
+	int n = 0;
+	while (CASE_TABLE.triangles[cubeCase][3*n] >= 0)
+		n++;
+	return n;
+}
+
+MarchingCubesMesh marchingCubes(const HOM(vec3, float) &field, vec3 cornerLow, vec3 cornerHigh, ivec3 res, float level, int threads) {
+	THROW_IF(res.x < 1 || res.y < 1 || res.z < 1, IllegalArgumentError, "marchingCubes: resolution has to be positive in every direction");
+	threads = resolveThreadCount(threads);
+
+	ivec3 nodes = res + ivec3(1);
+	vec3 step = (cornerHigh - cornerLow) / vec3(res);
+	auto node = [nodes](int i, int j, int k) { return (k*nodes.y + j)*nodes.x + i; };
+	auto nodePosition = [cornerLow, step](int i, int j, int k) { return cornerLow + vec3(i, j, k)*step; };
+
+	vector<float> samples(nodes.x * nodes.y * nodes.z);
+	parallelFor(nodes.z, threads, [&](int k) {
+		for (int j = 0; j < nodes.y; ++j)
+			for (int i = 0; i < nodes.x; ++i)
+				samples[node(i, j, k)] = field(nodePosition(i, j, k));
+	});
+
+	// vertex of the edge leaving a node along given axis, indexed 3*node + axis, numbered within the node plane
+	vector<int> edgeVertex(3 * samples.size(), -1);
+	vector<vector<vec3>> planeVertices(nodes.z);
+	parallelFor(nodes.z, threads, [&](int k) {
+		auto &out = planeVertices[k];
+		for (int j = 0; j < nodes.y; ++j)
+			for (int i = 0; i < nodes.x; ++i) {
+				int n0 = node(i, j, k);
+				float f0 = samples[n0];
+				for (int axis = 0; axis < 3; ++axis) {
+					ivec3 d = ivec3(axis == 0, axis == 1, axis == 2);
+					if (i + d.x >= nodes.x || j + d.y >= nodes.y || k + d.z >= nodes.z)
+						continue;
+					float f1 = samples[node(i + d.x, j + d.y, k + d.z)];
+					if ((f0 > level) == (f1 > level))
+						continue;
+					float t = (level - f0) / (f1 - f0);
+					edgeVertex[3*n0 + axis] = out.size();
+					out.push_back(mix(nodePosition(i, j, k), nodePosition(i + d.x, j + d.y, k + d.z), t));
+				}
+			}
+	});
+
+	MarchingCubesMesh mesh;
+	vector<int> planeOffset(nodes.z + 1, 0);
+	for (int k = 0; k < nodes.z; ++k)
+		planeOffset[k+1] = planeOffset[k] + planeVertices[k].size();
+	mesh.positions.reserve(planeOffset[nodes.z]);
+	for (auto &plane: planeVertices)
+		mesh.positions.insert(mesh.positions.end(), plane.begin(), plane.end());
+
+	vector<vector<ivec3>> slabTriangles(res.z);
+	parallelFor(res.z, threads, [&](int k) {
+		auto &out = slabTriangles[k];
+		for (int j = 0; j < res.y; ++j)
+			for (int i = 0; i < res.x; ++i) {
+				int cubeCase = 0;
+				for (int c = 0; c < 8; ++c)
+					if (samples[node(i + (c & 1), j + (c >> 1 & 1), k + (c >> 2 & 1))] > level)
+						cubeCase |= 1 << c;
+				if (cubeCase == 0 || cubeCase == 255)
+					continue;
+
+				auto vertexOf = [&](int e) {
+					int a = EDGE_CORNERS[e][0];
+					int kk = k + (a >> 2 & 1);
+					return planeOffset[kk] + edgeVertex[3*node(i + (a & 1), j + (a >> 1 & 1), kk) + e/4];
+				};
+				const auto &row = CASE_TABLE.triangles[cubeCase];
+				for (int t = 0; row[t] >= 0; t += 3)
+					out.emplace_back(vertexOf(row[t]), vertexOf(row[t+1]), vertexOf(row[t+2]));
+			}
+	});
+
+	size_t total = 0;
+	for (const auto &slab: slabTriangles)
+		total += slab.size();
+	mesh.triangles.reserve(total);
+	for (const auto &slab: slabTriangles)
+		mesh.triangles.insert(mesh.triangles.end(), slab.begin(), slab.end());
+	return mesh;
+}
@@ -0,0 +1,91 @@
+#include "meshAdjacency.hpp"
+
+#include <algorithm>
+
+
+MeshAdjacency::MeshAdjacency(const vector<ivec3> &faces, int vertexCount, int shift) : n_vertices(vertexCount) {
+	int n_faces = faces.size();
+	vector<ivec3> local;
+	local.reserve(n_faces);
+	for (const ivec3 &f: faces) {
+		ivec3 g = f - ivec3(shift);
+		for (int k = 0; k < 3; ++k)
+			THROW_IF(g[k] < 0 || g[k] >= vertexCount, IndexOutOfBounds, g[k], vertexCount, "MeshAdjacency vertex range");
+		local.push_back(g);
+	}
+
+	// vertex -> faces, counting sort by vertex
+	face_offsets.assign(vertexCount + 1, 0);
+	for (const ivec3 &f: local)
+		for (int k = 0; k < 3; ++k)
+			face_offsets[f[k] + 1]++;
+	for (int i = 0; i < vertexCount; ++i)
+		face_offsets[i+1] += face_offsets[i];
+	face_ids.resize(3 * n_faces);
+	vector<int> cursor(face_offsets.begin(), face_offsets.end() - 1);
+	for (int t = 0; t < n_faces; ++t)
+		for (int k = 0; k < 3; ++k)
+			face_ids[cursor[local[t][k]]++] = t;
+
+	// vertex -> vertices, gathered from incident faces and deduplicated per vertex
+	neighbour_offsets.assign(vertexCount + 1, 0);
+	neighbour_ids.reserve(2 * face_ids.size());
+	vector<int> ring;
+	for (int i = 0; i < vertexCount; ++i) {
+		ring.clear();
+		for (int s = face_offsets[i]; s < face_offsets[i+1]; ++s) {
+			const ivec3 &f = local[face_ids[s]];
+			for (int k = 0; k < 3; ++k)
+				if (f[k] != i)
+					ring.push_back(f[k]);
+		}
+		std::ranges::sort(ring);
+		ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+		neighbour_ids.insert(neighbour_ids.end(), ring.begin(), ring.end());
+		neighbour_offsets[i+1] = neighbour_ids.size();
+	}
+
+	// edge slot -> opposite vertices, same counting sort over directed edges of every face (degenerate edges skipped)
+	int n_slots = neighbour_ids.size();
+	opposite_offsets.assign(n_slots + 1, 0);
+	for (const ivec3 &f: local)
+		for (int k = 0; k < 3; ++k) {
+			if (f[k] == f[(k+1)%3]) continue;
+			opposite_offsets[neighbourSlot(f[k], f[(k+1)%3]) + 1]++;
+			opposite_offsets[neighbourSlot(f[(k+1)%3], f[k]) + 1]++;
+		}
+	for (int s = 0; s < n_slots; ++s)
+		opposite_offsets[s+1] += opposite_offsets[s];
+	opposite_ids.resize(opposite_offsets[n_slots]);
+	cursor.assign(opposite_offsets.begin(), opposite_offsets.end() - 1);
+	for (const ivec3 &f: local)
+		for (int k = 0; k < 3; ++k) {
+			int a = f[k], b = f[(k+1)%3], c = f[(k+2)%3];
+			if (a == b) continue;
+			opposite_ids[cursor[neighbourSlot(a, b)]++] = c;
+			opposite_ids[cursor[neighbourSlot(b, a)]++] = c;
+		}
+}
+
+int MeshAdjacency::neighbourSlot(int i, int j) const {
+	auto begin = neighbour_ids.begin() + neighbour_offsets[i];
+	auto end = neighbour_ids.begin() + neighbour_offsets[i+1];
+	auto it = std::lower_bound(begin, end, j);
+	if (it == end || *it != j)
+		return -1;
+	return it - neighbour_ids.begin();
+}
+
+std::span<const int> MeshAdjacency::edgeOpposites(int i, int j) const {
+	int s = neighbourSlot(i, j);
+	if (s < 0)
+		return {};
+	return {opposite_ids.data() + opposite_offsets[s], opposite_ids.data() + opposite_offsets[s+1]};
+}
+
+bool MeshAdjacency::hasCompleteNeighbourhood(int i) const {
+	for (int s = neighbour_offsets[i]; s < neighbour_offsets[i+1]; ++s)
+		if (opposite_offsets[s+1] - opposite_offsets[s] < 2)
+			return false;
+	return true;
+}
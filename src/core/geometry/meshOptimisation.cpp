@@ -0,0 +1,276 @@
+#include "meshOptimisation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+	// Forsyth's scoring, retuned from his 1.5, .75 and 2 on lattice surfaces and marching cubes output replayed through a 16 vertex FIFO
+	constexpr float CACHE_DECAY_POWER = 1.f;
+	constexpr float LAST_TRIANGLE_SCORE = .5f;
+	constexpr float VALENCE_BOOST_SCALE = 3.f;
+	constexpr float VALENCE_BOOST_POWER = .5f;
+
+	float forsythVertexScore(int cachePosition, int liveTriangles, int cacheSize) {
+		if (liveTriangles == 0)
+			return -1;
+		float score = 0;
+		if (cachePosition >= 0 && cachePosition < 3)
+			score = LAST_TRIANGLE_SCORE;
+		else if (cachePosition >= 3)
+			score = std::pow(1 - (cachePosition - 3.f)/(cacheSize - 3), CACHE_DECAY_POWER);
+		return score + VALENCE_BOOST_SCALE*std::pow((float)liveTriangles, -VALENCE_BOOST_POWER);
+	}
+
+	// corners of a possibly degenerate triangle without repetitions, returns their number
+	int distinctCorners(const ivec3 &f, int corners[3]) {
+		int n = 0;
+		for (int k = 0; k < 3; ++k)
+			if (std::find(corners, corners + n, f[k]) == corners + n)
+				corners[n++] = f[k];
+		return n;
+	}
+
+	void checkFaces(std::span<const ivec3> faces, int vertexCount, const string &name) {
+		for (const ivec3 &f: faces)
+			for (int k = 0; k < 3; ++k)
+				THROW_IF(f[k] < 0 || f[k] >= vertexCount, IndexOutOfBounds, f[k], vertexCount, name);
+	}
+
+	// a vertex stays cached until size other vertices entered after it, hits do not refresh it
+	class FIFOVertexCache {
+		vector<long> entered;
+		long insertions = 0;
+		int size;
+
+	public:
+		FIFOVertexCache(int vertexCount, int size) : entered(vertexCount, -1), size(size) {}
+
+		bool access(int v) {
+			if (entered[v] >= 0 && insertions - entered[v] <= size)
+				return true;
+			entered[v] = insertions++;
+			return false;
+		}
+		int misses(const ivec3 &f) { return !access(f.x) + !access(f.y) + !access(f.z); }
+		void clear() { insertions += size; }
+	};
+}
+
+
+VertexCacheStats simulateVertexCache(std::span<const ivec3> faces, int vertexCount, int cacheSize, VertexCacheModel model) {
+	THROW_IF(cacheSize < 3, IllegalArgumentError, "vertex cache has to hold at least a triangle");
+	checkFaces(faces, vertexCount, "simulateVertexCache vertex");
+	VertexCacheStats stats;
+	stats.triangles = faces.size();
+	vector<char> used(vertexCount, 0);
+	FIFOVertexCache fifo(model == VertexCacheModel::FIFO ? vertexCount : 0, cacheSize);
+	// most recent first
+	vector<int> lru;
+	lru.reserve(cacheSize + 1);
+	for (const ivec3 &f: faces)
+		for (int k = 0; k < 3; ++k) {
+			int v = f[k];
+			used[v] = 1;
+			bool hit;
+			if (model == VertexCacheModel::FIFO)
+				hit = fifo.access(v);
+			else {
+				auto it = std::find(lru.begin(), lru.end(), v);
+				hit = it != lru.end();
+				if (hit)
+					lru.erase(it);
+				lru.insert(lru.begin(), v);
+				if ((int)lru.size() > cacheSize)
+					lru.pop_back();
+			}
+			stats.transforms += !hit;
+		}
+	stats.vertices = std::count(used.begin(), used.end(), 1);
+	stats.acmr = stats.triangles > 0 ? 1.f*stats.transforms/stats.triangles : 0;
+	stats.atvr = stats.vertices > 0 ? 1.f*stats.transforms/stats.vertices : 0;
+	return stats;
+}
+
+
+vector<int> vertexCacheTriangleOrder(std::span<const ivec3> faces, int vertexCount, int cacheSize) {
+	THROW_IF(cacheSize < 4, IllegalArgumentError, "vertex cache order needs a cache of at least 4 vertices");
+	checkFaces(faces, vertexCount, "vertexCacheTriangleOrder vertex");
+	int n = faces.size();
+	int corners[3];
+
+	// vertex -> triangles still to be emitted, in CSR with the live ones kept at the front of every list
+	vector<int> offsets(vertexCount + 1, 0), live(vertexCount, 0);
+	for (const ivec3 &f: faces)
+		for (int j = 0, m = distinctCorners(f, corners); j < m; ++j)
+			live[corners[j]]++;
+	for (int i = 0; i < vertexCount; ++i)
+		offsets[i+1] = offsets[i] + live[i];
+	vector<int> adjacent(offsets[vertexCount]);
+	vector<int> cursor(offsets.begin(), offsets.end() - 1);
+	for (int t = 0; t < n; ++t)
+		for (int j = 0, m = distinctCorners(faces[t], corners); j < m; ++j)
+			adjacent[cursor[corners[j]]++] = t;
+
+	vector<int> cachePosition(vertexCount, -1);
+	vector<float> vertexScore(vertexCount), triangleScore(n, 0);
+	for (int i = 0; i < vertexCount; ++i)
+		vertexScore[i] = forsythVertexScore(-1, live[i], cacheSize);
+	for (int t = 0; t < n; ++t)
+		for (int j = 0, m = distinctCorners(faces[t], corners); j < m; ++j)
+			triangleScore[t] += vertexScore[corners[j]];
+
+	vector<char> emitted(n, 0);
+	vector<int> order;
+	order.reserve(n);
+	vector<int> cache, next;
+	cache.reserve(cacheSize + 3);
+	next.reserve(cacheSize + 3);
+	int best = n > 0 ? std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin() : -1;
+	int scan = 0;
+	while ((int)order.size() < n) {
+		// dead end, no cached vertex waits for more triangles, so the order continues with the next one of the input
+		if (best < 0) {
+			while (emitted[scan])
+				scan++;
+			best = scan;
+		}
+		emitted[best] = 1;
+		order.push_back(best);
+
+		int m = distinctCorners(faces[best], corners);
+		next.assign(corners, corners + m);
+		for (int v: cache)
+			if (std::find(corners, corners + m, v) == corners + m)
+				next.push_back(v);
+		for (int j = 0; j < m; ++j) {
+			auto first = adjacent.begin() + offsets[corners[j]];
+			int &count = live[corners[j]];
+			std::iter_swap(std::find(first, first + count, best), first + count - 1);
+			count--;
+		}
+
+		// only cached and just evicted vertices change their score, their waiting triangles change by the difference
+		for (int p = 0; p < (int)next.size(); ++p) {
+			int v = next[p];
+			cachePosition[v] = p < cacheSize ? p : -1;
+			float score = forsythVertexScore(cachePosition[v], live[v], cacheSize);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+			for (int a = offsets[v]; a < offsets[v] + live[v]; ++a)
+				triangleScore[adjacent[a]] += delta;
+		}
+		next.resize(std::min((int)next.size(), cacheSize));
+		std::swap(cache, next);
+
+		best = -1;
+		float bestScore = -1;
+		for (int v: cache)
+			for (int a = offsets[v]; a < offsets[v] + live[v]; ++a)
+				if (triangleScore[adjacent[a]] > bestScore) {
+					bestScore = triangleScore[adjacent[a]];
+					best = adjacent[a];
+				}
+	}
+	return order;
+}
+
+
+vector<int> overdrawTriangleOrder(std::span<const ivec3> faces, std::span<const vec3> positions, std::span<const int> order, float threshold, int cacheSize) {
+	int n = order.size();
+	THROW_IF(n != (int)faces.size(), IllegalArgumentError, "overdraw order has to start from an order of all the faces");
+	THROW_IF(cacheSize < 3, IllegalArgumentError, "vertex cache has to hold at least a triangle");
+	checkFaces(faces, positions.size(), "overdrawTriangleOrder vertex");
+	FIFOVertexCache cache(positions.size(), cacheSize);
+
+	// regions start where the order jumps to a part of the mesh that misses with all three vertices
+	vector<int> regions = {0}, orderMisses(n + 1, 0);
+	for (int k = 0; k < n; ++k) {
+		int misses = cache.misses(faces[order[k]]);
+		if (misses == 3 && k > 0)
+			regions.push_back(k);
+		orderMisses[k+1] = orderMisses[k] + misses;
+	}
+	regions.push_back(n);
+
+	// a cluster starts on an empty cache, so it is closed once its ACMR is back within threshold of what the order achieves there
+	vector<int> clusters;
+	for (int r = 0; r + 1 < (int)regions.size(); ++r) {
+		int begin = regions[r], end = regions[r+1];
+		if (begin == end)
+			continue;
+		float limit = threshold*(orderMisses[end] - orderMisses[begin])/(end - begin);
+
+		cache.clear();
+		clusters.push_back(begin);
+		int start = begin, misses = 0;
+		for (int k = begin; k < end - 1; ++k) {
+			misses += cache.misses(faces[order[k]]);
+			if (misses <= limit*(k + 1 - start)) {
+				clusters.push_back(k + 1);
+				start = k + 1;
+				misses = 0;
+				cache.clear();
+			}
+		}
+		// a tail that never got within the limit stays with the cluster before it, where the cache is warm
+		misses += cache.misses(faces[order[end - 1]]);
+		if (start > begin && misses > limit*(end - start))
+			clusters.pop_back();
+	}
+	clusters.push_back(n);
+
+	// area weighted centroids and normals
+	auto triangleCentroid = [&](int t) { return (positions[faces[t].x] + positions[faces[t].y] + positions[faces[t].z])/3.f; };
+	auto triangleNormal = [&](int t) { return cross(positions[faces[t].y] - positions[faces[t].x], positions[faces[t].z] - positions[faces[t].x]); };
+	vec3 meshCentroid = vec3(0);
+	float meshArea = 0;
+	for (int t = 0; t < n; ++t) {
+		float area = length(triangleNormal(t));
+		meshCentroid += area*triangleCentroid(t);
+		meshArea += area;
+	}
+	meshCentroid = meshArea > 0 ? meshCentroid/meshArea : meshCentroid;
+
+	int clusterCount = clusters.size() - 1;
+	vector<float> occlusion(clusterCount);
+	for (int c = 0; c < clusterCount; ++c) {
+		vec3 centroid = vec3(0), normal = vec3(0);
+		float area = 0;
+		for (int k = clusters[c]; k < clusters[c+1]; ++k) {
+			vec3 N = triangleNormal(order[k]);
+			centroid += length(N)*triangleCentroid(order[k]);
+			normal += N;
+			area += length(N);
+		}
+		occlusion[c] = area > 0 ? dot(centroid/area - meshCentroid, normalise(normal)) : 0;
+	}
+	vector<int> sorted(clusterCount);
+	for (int c = 0; c < clusterCount; ++c)
+		sorted[c] = c;
+	std::stable_sort(sorted.begin(), sorted.end(), [&](int a, int b) { return occlusion[a] > occlusion[b]; });
+
+	vector<int> result;
+	result.reserve(n);
+	for (int c: sorted)
+		result.insert(result.end(), order.begin() + clusters[c], order.begin() + clusters[c+1]);
+	return result;
+}
+
+
+vector<int> vertexFetchOrder(std::span<const ivec3> faces, int vertexCount) {
+	checkFaces(faces, vertexCount, "vertexFetchOrder vertex");
+	vector<char> placed(vertexCount, 0);
+	vector<int> order;
+	order.reserve(vertexCount);
+	for (const ivec3 &f: faces)
+		for (int k = 0; k < 3; ++k)
+			if (!placed[f[k]]) {
+				placed[f[k]] = 1;
+				order.push_back(f[k]);
+			}
+	for (int i = 0; i < vertexCount; ++i)
+		if (!placed[i])
+			order.push_back(i);
+	return order;
+}
@@ -4,13 +4,174 @@
 
 #include "pdeDiscrete.hpp"
 
+#include "fft.hpp"
+
+
+namespace {
+	// smallest mixed radix length holding the data twice, so the periodic images of the data do not overlap
+	int paddedFFTSize(int n) {
+		int m = 2*n;
+		while (!FFTPlan::mixedRadixSize(m))
+			++m;
+		return m;
+	}
+
+	// exact step of u' = -l u + f over [0, h] with f linear: u(h) = decay u(0) + h (now f(h) + before f(0))
+	struct ExponentialStep {
+		float decay, now, before;
+	};
+
+	ExponentialStep exponentialStep(double l, double h) {
+		double x = l*h;
+		double e = std::exp(-x);
+		double phi1 = x < 1e-4 ? 1 - x/2 + x*x/6 : (1 - e)/x;
+		double psi = x < 1e-4 ? .5 - x/3 + x*x/8 : (1 - e*(1 + x))/(x*x);
+		return {(float)e, (float)(phi1 - psi), (float)psi};
+	}
+}
+
 DiscreteRealFunction HeatRealLineHomoDiscrete::green(float t, float x) const {
 	return DiscreteRealFunction([k=k, t, x](float y) {
 		return 1.f*std::exp(-pow2(x-y)/(4.f*k*t))/(2.f*std::sqrt(PI*t*k));
 	}, u0.getDomain(), u0.samples());
 }
 
+DiscreteRealFunctionR2 HeatRealLineHomoDiscrete::spectralSolution(const DiscreteRealFunctionR2 *source) const {
+	int n = u0.samples();
+	int m = paddedFFTSize(n);
+	THROW_IF(t_res < 2, IllegalArgumentError, "Heat solver needs at least two time slices.");
+	THROW_IF(source && (source->samples_t() != t_res || source->samples_x() != n), IllegalArgumentError, "Source sampling differs from the solution sampling.");
+	auto forward = FFTPlan::get(m, FFTDirection::FORWARD);
+	auto backward = FFTPlan::get(m, FFTDirection::BACKWARD);
+	float h = t_max/(t_res - 1);
+	float dx = u0.sampling_step();
+
+	vector<float> rate(m);
+	vector<ExponentialStep> steps(m);
+	for (int j = 0; j < m; ++j) {
+		int q = j <= m/2 ? j : j - m;
+		double w = TAU*q/(m*dx);
+		rate[j] = k*w*w;
+		steps[j] = exponentialStep(k*w*w, h);
+	}
+
+	auto spectrum = [&](const DiscreteRealFunction &f) {
+		vector<Complex> z(m);
+		for (int i = 0; i < n; ++i)
+			z[i].z = vec2(f[i], 0);
+		forward->execute(z);
+		return z;
+	};
+
+	vector<vector<float>> slices(t_res, vector<float>(n));
+	vector<Complex> packed(m);
+	// spectra of two real slices are inverted by one transform, as the real and imaginary part of its result
+	auto invert = [&](const vector<Complex> &a, const vector<Complex> *b, int i_a) {
+		for (int j = 0; j < m; ++j)
+			packed[j].z = b ? a[j].z + vec2(-(*b)[j].z.y, (*b)[j].z.x) : a[j].z;
+		backward->execute(packed);
+		for (int i = 0; i < n; ++i) {
+			slices[i_a][i] = packed[i].z.x/m;
+			if (b)
+				slices[i_a + 1][i] = packed[i].z.y/m;
+		}
+	};
+
+	vector<Complex> u_hat0 = spectrum(u0);
+	vector<Complex> current = u_hat0, previous(m), f_prev, f_next;
+	if (source)
+		f_prev = spectrum((*source)[0]);
+	for (int i_t = 0; i_t < t_res; ++i_t) {
+		if (i_t > 0 && source) {
+			f_next = spectrum((*source)[i_t]);
+			for (int j = 0; j < m; ++j)
+				current[j].z = steps[j].decay*current[j].z + h*(steps[j].now*f_next[j].z + steps[j].before*f_prev[j].z);
+			std::swap(f_prev, f_next);
+		}
+		else if (i_t > 0) {
+			float t = h*i_t;
+			for (int j = 0; j < m; ++j)
+				current[j].z = u_hat0[j].z*std::exp(-rate[j]*t);
+		}
+		if (i_t % 2 == 1)
+			invert(previous, &current, i_t - 1);
+		else
+			previous = current;
+	}
+	if (t_res % 2 == 1)
+		invert(previous, nullptr, t_res - 1);
+
+	vector<DiscreteRealFunction> f_nt;
+	for (const auto &slice : slices)
+		f_nt.emplace_back(slice, u0.getDomain());
+	return DiscreteRealFunctionR2(f_nt, vec2(0, t_max));
+}
+
+DiscreteRealFunctionR2 HeatRealLineHomoDiscrete::crankNicolsonSolution(const DiscreteRealFunctionR2 *source) const {
+	int n = u0.samples();
+	THROW_IF(t_res < 2, IllegalArgumentError, "Heat solver needs at least two time slices.");
+	THROW_IF(n < 3, IllegalArgumentError, "Crank-Nicolson needs at least three samples.");
+	THROW_IF(source && (source->samples_t() != t_res || source->samples_x() != n), IllegalArgumentError, "Source sampling differs from the solution sampling.");
+	float dt = t_max/(t_res - 1)/cn_substeps;
+	float dx = u0.sampling_step();
+	float r = k*dt/(dx*dx);
+
+	// Thomas algorithm on the constant matrix tridiag(-r/2, 1 + r, -r/2) of the interior, forward sweep factors precomputed
+	int interior = n - 2;
+	vector<float> c_prime(interior), inv_denominator(interior);
+	float lower = -r/2, diagonal = 1 + r;
+	for (int i = 0; i < interior; ++i) {
+		float denominator = diagonal - (i > 0 ? lower*c_prime[i - 1] : 0);
+		inv_denominator[i] = 1/denominator;
+		c_prime[i] = lower*inv_denominator[i];
+	}
+
+	vector<float> u(n), rhs(interior), f0(n, 0), f1(n, 0), f_a(n, 0), f_b(n, 0);
+	for (int i = 0; i < n; ++i)
+		u[i] = u0[i];
+	vector<vector<float>> slices = {u};
+	if (source)
+		for (int i = 0; i < n; ++i)
+			f_a[i] = (*source)[0][i];
+
+	for (int i_t = 1; i_t < t_res; ++i_t) {
+		if (source) {
+			DiscreteRealFunction next = (*source)[i_t];
+			for (int i = 0; i < n; ++i)
+				f_b[i] = next[i];
+		}
+		for (int s = 0; s < cn_substeps; ++s) {
+			// source linear between the slices, trapezoidal in time like the diffusion term
+			float w0 = 1.f*s/cn_substeps, w1 = 1.f*(s + 1)/cn_substeps;
+			for (int i = 1; i < n - 1; ++i) {
+				float f = ((1 - w0)*f_a[i] + w0*f_b[i] + (1 - w1)*f_a[i] + w1*f_b[i])/2;
+				rhs[i - 1] = r/2*u[i - 1] + (1 - r)*u[i] + r/2*u[i + 1] + dt*f;
+			}
+			rhs[0] -= lower*u[0];
+			rhs[interior - 1] -= lower*u[n - 1];
+
+			rhs[0] *= inv_denominator[0];
+			for (int i = 1; i < interior; ++i)
+				rhs[i] = (rhs[i] - lower*rhs[i - 1])*inv_denominator[i];
+			for (int i = interior - 2; i >= 0; --i)
+				rhs[i] -= c_prime[i]*rhs[i + 1];
+			std::copy(rhs.begin(), rhs.end(), u.begin() + 1);
+		}
+		slices.push_back(u);
+		std::swap(f_a, f_b);
+	}
+
+	vector<DiscreteRealFunction> f_nt;
+	for (const auto &slice : slices)
+		f_nt.emplace_back(slice, u0.getDomain());
+	return DiscreteRealFunctionR2(f_nt, vec2(0, t_max));
+}
+
 DiscreteRealFunctionR2 HeatRealLineHomoDiscrete::solution() const {
+	if (backend == HeatSolverBackend::SPECTRAL)
+		return spectralSolution(nullptr);
+	if (backend == HeatSolverBackend::CRANK_NICOLSON)
+		return crankNicolsonSolution(nullptr);
 	vector<DiscreteRealFunction> f_nt = {this->u0};
 	for (float t: linspace(0.f, t_max, t_res)) {
 		if (t < 0.001f) continue;
@@ -23,6 +184,10 @@ DiscreteRealFunctionR2 HeatRealLineHomoDiscrete::solution() const {
 }
 
 DiscreteRealFunctionR2 HeatRealLineDiscreteNotHomo::solution() const {
+	if (backend == HeatSolverBackend::SPECTRAL)
+		return spectralSolution(&f_free);
+	if (backend == HeatSolverBackend::CRANK_NICOLSON)
+		return crankNicolsonSolution(&f_free);
 	vector<DiscreteRealFunction> f_nt = {this->u0};
 	for (int i_t=1; i_t<t_res; ++i_t) {
 		float t = this->t_max/t_res*i_t;
@@ -1,6 +1,7 @@
 #include "smoothImplicit.hpp"
 #include "../utils/func.hpp"
 #include "../engine/indexedRendering.hpp"
+#include "marchingCubes.hpp"
 
 using std::vector, std::string, std::shared_ptr, std::unique_ptr, std::pair, std::make_unique, std::make_shared, std::function;
 
@@ -10,7 +11,8 @@ using namespace glm;
 vec3 SmoothImplicitSurface::newtonStepProject(vec3 p, float tolerance, int maxIter) const {
 	vec3 last_q = p;
 	for (int i = 0; i < maxIter; i++) {
-		vec3 q = last_q - _F.df(last_q)*_F(last_q)/norm2(_F.df(last_q));
+		auto [F, dF] = _F.valueAndGradient(last_q);
+		vec3 q = last_q - dF*F/norm2(dF);
 		if (norm2(q - last_q) < tolerance*tolerance)
 			return q;
 		last_q = q;
@@ -18,6 +20,21 @@ vec3 SmoothImplicitSurface::newtonStepProject(vec3 p, float tolerance, int maxIt
 	return last_q;
 }
 
+float SmoothImplicitSurface::meanCurvature(vec3 p) const {
+	vec3 g = _F.df(p);
+	mat3 H = _F.hessian(p);
+	float g2 = norm2(g);
+	return (dot(g, H*g) - g2*(H[0][0] + H[1][1] + H[2][2])) / (2*g2*std::sqrt(g2));
+}
+
+float SmoothImplicitSurface::gaussianCurvature(vec3 p) const {
+	vec3 g = _F.df(p);
+	mat3 H = _F.hessian(p);
+	// rows of the adjugate of H are cross products of its columns
+	mat3 adjugate = mat3(cross(H[1], H[2]), cross(H[2], H[0]), cross(H[0], H[1]));
+	return dot(g, adjugate*g) / pow2(norm2(g));
+}
+
 void SmoothImplicitSurface::projectPoints(IndexedMesh &mesh, float tolerance, int maxIter) {
 	mesh.deformPerVertex([this, tolerance, maxIter](BufferedVertex &v) {
 		v.setPosition(newtonStepProject(v.getPosition(), tolerance, maxIter));
@@ -496,21 +513,20 @@ ivec3 MarchingCubeChunk::edgeCenterVertex(ivec3 cube, CubeCorner corner1, CubeCo
 void MarchingCubeChunk::generate() {
 	if (!triangles.empty())
 		return;
-	for (int i = 0; i < res.x; i++)
-		for (int j = 0; j < res.y; j++)
-			for (int k = 0; k < res.z; k++)
-				generateCube(ivec3(i, j, k));
+	auto mesh = marchingCubes([surf=surface](vec3 p) { return (*surf)(p); }, cornerLow, cornerHigh, res);
+	interpolatedVertices = std::move(mesh.positions);
+	triangles = std::move(mesh.triangles);
 }
 
 
 bool MarchingCubeChunk::vertexAlreadyAdded(ivec3 vertex) const {
-	return addedVertices.contains(hash_ivec3(vertex));
+	return addedVertices.contains(vertexKey(vertex));
 }
 
 int MarchingCubeChunk::addVertex(ivec3 vertex) {
-	if (vertexAlreadyAdded(vertex))
-		return addedVertices[hash_ivec3(vertex)];
-	addedVertices[hash_ivec3(vertex)] = vertices.size();
+	auto [it, inserted] = addedVertices.try_emplace(vertexKey(vertex), vertices.size());
+	if (!inserted)
+		return it->second;
 	vertices.push_back(vertex);
 	return vertices.size() - 1;
 }
@@ -907,6 +923,7 @@ vector<CubeCorner> MarchingCubeChunk::complementaryCorners(const vector<CubeCorn
 
 IndexedMesh MarchingCubeChunk::generateMesh(bool tetra) {
 	vertices = {};
+	interpolatedVertices = {};
 	triangles = {};
 	addedVertices = {};
 
@@ -922,6 +939,7 @@ IndexedMesh MarchingCubeChunk::generateMesh(bool tetra) {
 
 IndexedMesh MarchingCubeChunk::generateMesh(bool tetra, float tolerance, int maxIter) {
 	vertices = {};
+	interpolatedVertices = {};
 	triangles = {};
 	addedVertices = {};
 
@@ -938,6 +956,9 @@ IndexedMesh MarchingCubeChunk::generateMesh(bool tetra, float tolerance, int max
 
 void MarchingCubeChunk::addToMesh(IndexedMesh &mesh) {
 	vector<Vertex> vertices_hard = {};
+	vec3 extent = cornerHigh - cornerLow;
+	for (vec3 p: interpolatedVertices)
+		vertices_hard.emplace_back(p, vec2((p.x - cornerLow.x)/extent.x, (p.y - cornerLow.y)/extent.y), surface->normal(p));
 	for (ivec3 v: this->vertices)
 		vertices_hard.emplace_back(vertexPosition(v), vec2(1.f*v.x/res.x, 1.f*v.y/res.y), surface->normal(vertexPosition(v)));
 	mesh.addNewPolygroup(vertices_hard, triangles, id);
@@ -945,6 +966,11 @@ void MarchingCubeChunk::addToMesh(IndexedMesh &mesh) {
 
 void MarchingCubeChunk::addToMesh(IndexedMesh &mesh,  float tolerance, int maxIter){
 	vector<Vertex> vertices_hard = {};
+	vec3 extent = cornerHigh - cornerLow;
+	for (vec3 v: interpolatedVertices) {
+		vec3 p = surface->newtonStepProject(v, tolerance, maxIter);
+		vertices_hard.emplace_back(p, vec2((v.x - cornerLow.x)/extent.x, (v.y - cornerLow.y)/extent.y), surface->normal(p));
+	}
 	for (ivec3 v: this->vertices) {
 		vec3 p = surface->newtonStepProject(vertexPosition(v), tolerance, maxIter);
 		vertices_hard.emplace_back(p, vec2(1.f*v.x/res.x, 1.f*v.y/res.y), surface->normal(p));
@@ -109,12 +109,30 @@ mat2 SmoothParametricSurface::metricTensor(float t, float s) const {
 }
 
 
+SurfaceJet SmoothParametricSurface::jet(float t, float s) const {
+	if (_jet)
+		return _jet(t, s);
+	vec3 dt_plus = _df_t(t + epsilon, s), dt_minus = _df_t(t - epsilon, s);
+	vec3 du_plus = _df_u(t, s + epsilon), du_minus = _df_u(t, s - epsilon);
+	return {_f(t, s), _df_t(t, s), _df_u(t, s),
+			(dt_plus - dt_minus)/(2*epsilon), (_df_t(t, s + epsilon) - _df_t(t, s - epsilon))/(2*epsilon), (du_plus - du_minus)/(2*epsilon)};
+}
+
+std::pair<mat2, mat2> SmoothParametricSurface::fundamentalForms(float t, float s) const {
+	SurfaceJet j = jet(t, s);
+	vec3 n = cross(j.df_t, j.df_u);
+	n = norm(n) < .0002 ? normal(t, s) : normalise(n);
+	float E = dot(j.df_t, j.df_t), F = dot(j.df_t, j.df_u), G = dot(j.df_u, j.df_u);
+	float L = dot(j.d2f_tt, n), M = dot(j.d2f_tu, n), N = dot(j.d2f_uu, n);
+	return {mat2(E, F, F, G), mat2(L, M, M, N)};
+}
+
 mat2 SmoothParametricSurface::firstFundamentalForm(float t, float s) const {
-	return mat2(_E(t, s), _F(t, s), _F(t, s), _G(t, s));
+	return metricTensor(t, s);
 }
 
 mat2 SmoothParametricSurface::secondFundamentalForm(float t, float s) const {
-	return mat2(_L(t, s), _M(t, s), _M(t, s), _N(t, s));
+	return fundamentalForms(t, s).second;
 }
 
 float SmoothParametricSurface::_E(float t, float s) const {
@@ -129,13 +147,19 @@ float SmoothParametricSurface::_G(float t, float s) const {
 	return norm2(_df_u(t, s));
 }
 vec3 SmoothParametricSurface::d2f_tt(float t, float s) const {
+	if (_jet)
+		return _jet(t, s).d2f_tt;
 	return (_df_t(t + epsilon, s) - _df_t(t - epsilon, s)) / (2 * epsilon);
 }
 vec3 SmoothParametricSurface::d2f_uu(float t, float u) const {
+	if (_jet)
+		return _jet(t, u).d2f_uu;
 	return (_df_u(t, u + epsilon) - _df_u(t, u - epsilon)) / (2 * epsilon);
 }
 
 vec3 SmoothParametricSurface::d2f_tu (float t, float u) const {
+	if (_jet)
+		return _jet(t, u).d2f_tu;
 	return (_df_t(t, u + epsilon) - _df_t(t, u - epsilon)) / (2 * epsilon);
 }
 
@@ -154,23 +178,36 @@ float SmoothParametricSurface::_N(float t, float s) const {
 
 vec3 SmoothParametricSurface::normalCurvature(float t, float s, vec2 v) const { throw std::logic_error("Not implemented"); }
 
-mat2 SmoothParametricSurface::shapeOperator(float t, float s) const { throw std::logic_error("Not implemented"); }
+// Weingarten map in the coordinate basis of the tangent plane, I^-1 II
+mat2 SmoothParametricSurface::shapeOperator(float t, float s) const {
+	auto [I, II] = fundamentalForms(t, s);
+	return inverse(I)*II;
+}
 
 float SmoothParametricSurface::meanCurvature(float t, float s) const {
-	return (_E(t, s) * _N(t, s) + _G(t, s) * _L(t, s) - 2 * _F(t, s) * _M(t, s)) / (2 * (_E(t, s) * _G(t, s) - _F(t, s) * _F(t, s)));
+	auto [I, II] = fundamentalForms(t, s);
+	return (I[0][0]*II[1][1] + I[1][1]*II[0][0] - 2*I[0][1]*II[0][1]) / (2*determinant(I));
 }
 
 float SmoothParametricSurface::gaussianCurvature(float t, float s) const {
-	return (_L(t, s) * _N(t, s) - _M(t, s) * _M(t, s)) / (_E(t, s) * _G(t, s) - _F(t, s) * _F(t, s)); }
+	auto [I, II] = fundamentalForms(t, s);
+	return determinant(II) / determinant(I);
+}
 
 mat2x3 SmoothParametricSurface::principalDirections(float t, float s) const { throw std::logic_error("Not implemented"); }
 
 std::pair<float, float> SmoothParametricSurface::principalCurvatures(float t, float s) const {
-	return {meanCurvature(t, s) - sqrt(meanCurvature(t, s)*meanCurvature(t, s) - gaussianCurvature(t, s)),
-			meanCurvature(t, s) + sqrt(meanCurvature(t, s)*meanCurvature(t, s) - gaussianCurvature(t, s))};
+	auto [I, II] = fundamentalForms(t, s);
+	float H = (I[0][0]*II[1][1] + I[1][1]*II[0][0] - 2*I[0][1]*II[0][1]) / (2*determinant(I));
+	float K = determinant(II) / determinant(I);
+	float d = sqrt(max(H*H - K, 0.f));
+	return {H - d, H + d};
 }
 
-vec3 SmoothParametricSurface::Laplacian(float t, float s) const { throw std::logic_error("Not implemented"); }
+// Laplace-Beltrami operator of the embedding, equal to the mean curvature vector 2Hn
+vec3 SmoothParametricSurface::Laplacian(float t, float s) const {
+	return 2*meanCurvature(t, s)*normal(t, s);
+}
 
 SmoothParametricSurface SmoothParametricSurface::meanCurvatureFlow(float dt) const {
 	return SmoothParametricSurface([S=*this, dt](float t, float s) {return S(t, s) + S.normal(t, s)*S.meanCurvature(t, s)*dt; },
@@ -256,6 +293,12 @@ void SmoothParametricSurface::normaliseDomainToI2() {
     _f = [f=_f, t0=t0, t1=t1, u0=u0, u1=u1](float t, float u) {return f(lerp(t0, t1, t), lerp(u0, u1, u)); };
     _df_t = [df=_df_t, t0=t0, t1=t1, u0=u0, u1=u1](float t, float u) {return (t1-t0)*df(lerp(t0, t1, t), lerp(u0, u1, u)); };
     _df_u = [df=_df_u, t0=t0, t1=t1, u0=u0, u1=u1](float t, float u) {return (u1-u0)*df(lerp(t0, t1, t), lerp(u0, u1, u)); };
+    if (_jet)
+        _jet = [jet=_jet, t0=t0, t1=t1, u0=u0, u1=u1](float t, float u) {
+            SurfaceJet j = jet(lerp(t0, t1, t), lerp(u0, u1, u));
+            float a = t1 - t0, b = u1 - u0;
+            return SurfaceJet{j.f, a*j.df_t, b*j.df_u, a*a*j.d2f_tt, a*b*j.d2f_tu, b*b*j.d2f_uu};
+        };
     t0 = 0;
     t1 = 1;
     u0 = 0;
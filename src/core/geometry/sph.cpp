@@ -4,17 +4,9 @@
 
 #include "sph.hpp"
 
-SmoothingKernel::SmoothingKernel(float radius_of_influence, std::function<float(vec3, float)> F, std::function<vec3(vec3, float)> DF): d(radius_of_influence), F(F), DF(DF) {}
+#include <ranges>
 
-Poly6Kernel::Poly6Kernel(float radius_of_influence): SmoothingKernel(radius_of_influence, [](vec3 p, float d) {
-																		 if (dot(p, p) > d*d) return 0.0f;
-																		 float a = 315.0f / (64.0f * PI * std::pow(d, 9));
-																		 return a * pow3(d*d - dot(p, p));
-																	 }, [](vec3 p, float d) {
-																		 if (dot(p, p) > d*d) return vec3(0.0f);
-																		 float a = 315.0f / (64.0f * PI * std::pow(d, 9));
-																		 return p * -6.f * a * pow2(d*d - dot(p, p));
-																	 }) {}
+SmoothingKernel::SmoothingKernel(float radius_of_influence, std::function<float(vec3, float)> F, std::function<vec3(vec3, float)> DF): d(radius_of_influence), F(F), DF(DF) {}
 
 FluidParticle::FluidParticle(vec3 position, float mass, float viscosity, vector<float> attributes)
 : FluidParticle(position, vec3(0.0f), mass, viscosity, attributes) {}
@@ -39,106 +31,222 @@ void FluidParticle::update(float dt) {
 	position += velocity * dt;
 }
 
+FluidParticleStorage::FluidParticleStorage(const vector<FluidParticle> &particles) {
+	for (const auto &particle : particles)
+		append(particle);
+}
+
+FluidParticleStorage::FluidParticleStorage(const FluidParticleStorage &other)
+: ids(other.ids), slots(other.slots), position(other.position), velocity(other.velocity), acceleration(other.acceleration), force(other.force),
+  mass(other.mass), viscosity(other.viscosity), density(other.density), pressure(other.pressure), attributes(other.attributes) {
+	for (const auto &[name, c] : other.channels)
+		channels[name] = c->clone();
+}
+
+FluidParticleStorage &FluidParticleStorage::operator=(const FluidParticleStorage &other) {
+	if (this != &other)
+		*this = FluidParticleStorage(other);
+	return *this;
+}
+
+void FluidParticleStorage::append(const FluidParticle &particle) {
+	int n = size();
+	ids.push_back(n);
+	slots.push_back(n);
+	position.push_back(particle.pos());
+	velocity.push_back(particle.v());
+	acceleration.push_back(particle.a());
+	force.push_back(particle.f());
+	mass.push_back(particle.m());
+	viscosity.push_back(particle.mu());
+	density.push_back(particle.rho());
+	pressure.push_back(particle.p());
+	if (attributes.size() < particle.attribute_count())
+		attributes.resize(particle.attribute_count(), vector<float>(n, 0.f));
+	for (int a = 0; a < attributes.size(); ++a)
+		attributes[a].push_back(a < particle.attribute_count() ? particle.get_attribute(a) : 0.f);
+	for (auto &c : channels | std::views::values)
+		c->resize(n + 1);
+}
+
+FluidParticle FluidParticleStorage::particle(int slot) const {
+	vector<float> attr;
+	for (const auto &a : attributes)
+		attr.push_back(a[slot]);
+	auto particle = FluidParticle(position[slot], velocity[slot], acceleration[slot], mass[slot], viscosity[slot], attr);
+	particle.set_forces(force[slot]);
+	particle.set_density(density[slot]);
+	particle.set_pressure(pressure[slot]);
+	return particle;
+}
+
+namespace {
+	// kernel given by functions, seen through the interface of the sph:: kernels; it is assumed radial
+	struct GenericEvaluator {
+		const SmoothingKernel &kernel;
+		float W(float r2) const { return kernel(vec3(std::sqrt(r2), 0, 0)); }
+		vec3 grad(vec3 p, float r2) const { return kernel.grad(p); }
+		void W(const float *r2, float *out, int n) const {
+			for (int i = 0; i < n; ++i)
+				out[i] = W(r2[i]);
+		}
+	};
+
+	template<typename T>
+	void permuteArray(vector<T> &values, const vector<int> &order) {
+		vector<T> permuted(order.size());
+		for (int k = 0; k < order.size(); ++k)
+			permuted[k] = values[order[k]];
+		values = std::move(permuted);
+	}
+}
+
+void FluidParticleStorage::permute(const vector<int> &order) {
+	for (auto *v : {&position, &velocity, &acceleration, &force})
+		permuteArray(*v, order);
+	for (auto *v : {&mass, &viscosity, &density, &pressure})
+		permuteArray(*v, order);
+	for (auto &a : attributes)
+		permuteArray(a, order);
+	for (auto &c : channels | std::views::values)
+		c->permute(order);
+	permuteArray(ids, order);
+	for (int k = 0; k < ids.size(); ++k)
+		slots[ids[k]] = k;
+}
+
+void FluidParticleRef::update(float dt) const {
+	storage->acceleration[slot] = storage->force[slot] / storage->density[slot];
+	storage->velocity[slot] += storage->acceleration[slot] * dt;
+	storage->position[slot] += storage->velocity[slot] * dt;
+}
+
+
 FluidParticleSystem::FluidParticleSystem(const vector<FluidParticle> &particles, const std::function<vec3(vec3)> &gravity_field, const ImplicitVolume &boundary, SmoothingKernel smoothing_kernel, SPH_SETTINGS params)
 : particles(particles), gravity_field(gravity_field), bounding_volume(boundary), bound_min(bounding_volume.bounding_box().first), bound_max(bounding_volume.bounding_box().second),
-	d(smoothing_kernel.radius_of_influence()), smoothing_kernel(smoothing_kernel), no_particles(particles.size()), params(params)
+	d(smoothing_kernel.radius_of_influence()), smoothing_kernel(smoothing_kernel), no_particles(particles.size()), params(params),
+	neighbour_grid(bound_min, bound_max, d/2), pool(make_shared<WorkerPool>())
 {
-	grid_size = ivec3(ceil((bound_max - bound_min).x) / d,
-					  ceil((bound_max - bound_min).y) / d,
-					  ceil((bound_max - bound_min).z) / d);
-
-	for (int i = 0; i < no_particles; i++) {
-		vec3 p = particles[i].pos();
-		ivec3 chunk = ivec3((p - bound_min) / d);
+	grid_size = neighbour_grid.gridSize();
+	rebuild_neighbour_grid();
+}
 
-		if (particle_chunks.contains(ivec3key(chunk)))
-			particle_chunks[ivec3key(chunk)].insert(i);
+template<typename F>
+void FluidParticleSystem::with_kernel(F &&f) const {
+	std::visit([&](const auto &kernel) {
+		if constexpr (std::is_same_v<std::decay_t<decltype(kernel)>, std::monostate>)
+			f(GenericEvaluator{smoothing_kernel});
 		else
-			particle_chunks[ivec3key(chunk)] = {i};
-	}
+			f(kernel);
+	}, smoothing_kernel.static_kernel());
+}
+
+void FluidParticleSystem::set_threads(int threads) {
+	pool = make_shared<WorkerPool>(threads);
 }
 
-vector<ivec3> FluidParticleSystem::relevant_chunks(vec3 p) const {
-	ivec3 current_chunk = chunk(p);
-	vector<ivec3> res;
-	for (int x = -1; x <= 1; x++)
-		for (int y = -1; y <= 1; y++)
-			for (int z = -1; z <= 1; z++)
-				if (particle_chunks.contains(ivec3key(current_chunk + ivec3(x, y, z))))
-					res.push_back(current_chunk + ivec3(x, y, z));
-	return res;
+void FluidParticleSystem::rebuild_neighbour_grid() {
+	neighbour_grid.rebuild(particles.position);
+	particles.permute(neighbour_grid.sortedIds());
+	neighbour_grid.relabelInSortedOrder();
 }
 
 float FluidParticleSystem::density(vec3 x) const{
 	float rho = 0.0f;
-	for (ivec3 c : relevant_chunks(x))
-		for (int i : particle_chunks.at(ivec3key(c)))
-			rho += particles[i].m() * smoothing_kernel(x - particles[i].pos());
-
+	with_kernel([&](const auto &kernel) {
+		neighbour_grid.forEachNeighbour(x, d, [&](int j, vec3 delta, float dist2) {
+			rho += particles.mass[j] * kernel.W(dist2);
+		});
+	});
 	return rho;
 }
 
 void FluidParticleSystem::calculate_densities() {
-	for (int i = 0; i < no_particles; i++) {
-		vec3 p = particles[i].pos();
-		particles[i].set_density(density(p));
-	}
+	with_kernel([this](const auto &kernel) {
+		pool->forRange(no_particles, grain, [&](int begin, int end) {
+			// neighbour distances are gathered first and the kernel is evaluated on them as one batch
+			vector<float> r2, m, w;
+			for (int i = begin; i < end; i++) {
+				r2.clear();
+				m.clear();
+				neighbour_grid.forEachNeighbour(particles.position[i], d, [&](int j, vec3, float dist2) {
+					r2.push_back(dist2);
+					m.push_back(particles.mass[j]);
+				});
+				w.resize(r2.size());
+				kernel.W(r2.data(), w.data(), r2.size());
+				float rho = 0.0f;
+				for (int k = 0; k < w.size(); k++)
+					rho += m[k] * w[k];
+				particles.density[i] = rho;
+			}
+		});
+	});
 }
 
 void FluidParticleSystem::calculate_pressures() {
-	for (int i = 0; i < no_particles; i++)
-		particles[i].set_pressure(params.stiffness * (std::pow(particles[i].rho()/params.rest_density, params.compressibility) - 1.f));
+	pool->forRange(no_particles, grain, [this](int begin, int end) {
+		for (int i = begin; i < end; i++)
+			particles.pressure[i] = params.stiffness * (std::pow(particles.density[i]/params.rest_density, params.compressibility) - 1.f);
+	});
 }
 
 void FluidParticleSystem::calculate_forces() {
-	for (int i = 0; i < no_particles; i++) {
-		vec3 x = particles[i].pos();
-		vec3 f = gravity_field(x) * particles[i].m();
-		float m = particles[i].m();
-		vec3 pressure_f = vec3(0.0f);
-		vec3 viscosity_f = vec3(0.0f);
-		float p_over_rho2 = particles[i].p()/pow2(particles[i].rho());
-		for (ivec3 c : relevant_chunks(x)) {
-			for (int j : particle_chunks[ivec3key(c)]) {
-				if (i == j) continue;
-				auto y = particles[j].pos();
-				auto m2 = particles[j].m();
-				auto rho2 = particles[j].rho();
-				pressure_f -= smoothing_kernel.grad(x - y) * m2 * m * (p_over_rho2 + particles[j].p()/pow2(particles[j].rho()));
-				viscosity_f += smoothing_kernel.grad(x - y) * params.viscosity * 10.f * m2/rho2 * dot(x-y, particles[i].v() - particles[j].v()) / (dot(x-y, x-y) + .01f*d*d) * m;
-			}
+	// per particle factors of the pair terms, so that the neighbour loop does no division by neighbour data
+	p_over_rho2.resize(no_particles);
+	m_over_rho.resize(no_particles);
+	pool->forRange(no_particles, grain, [this](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			p_over_rho2[i] = particles.pressure[i]/pow2(particles.density[i]);
+			m_over_rho[i] = particles.mass[i]/particles.density[i];
 		}
-		f += pressure_f + viscosity_f;
-		particles[i].set_forces(f);
-	}
+	});
+
+	const vec3 *x_ = particles.position.data();
+	const vec3 *v_ = particles.velocity.data();
+	const float *m_ = particles.mass.data();
+	const float *q_ = p_over_rho2.data();
+	const float *w_ = m_over_rho.data();
+	float viscosity = params.viscosity * 10.f;
+	float eps = .01f*d*d;
+	with_kernel([&](const auto &kernel) {
+		pool->forRange(no_particles, grain, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				vec3 x = x_[i];
+				vec3 v = v_[i];
+				float m = m_[i];
+				float q = q_[i];
+				vec3 pressure_f = vec3(0.0f);
+				vec3 viscosity_f = vec3(0.0f);
+				neighbour_grid.forEachNeighbour(x, d, [&](int j, vec3 x_y, float dist2) {
+					if (i == j) return;
+					vec3 grad = kernel.grad(x_y, dist2);
+					pressure_f -= grad * (m_[j] * (q + q_[j]));
+					viscosity_f += grad * (w_[j] * dot(x_y, v - v_[j]) / (dist2 + eps));
+				});
+				particles.force[i] = gravity_field(x) * m + m * pressure_f + m * viscosity * viscosity_f;
+			}
+		});
+	});
 }
 
 void FluidParticleSystem::update(float dt) {
 	calculate_densities();
 	calculate_pressures();
 	calculate_forces();
-	for (int i = 0; i < no_particles; i++) {
-		auto old_x = particles[i].pos();
-		ivec3 c = chunk(old_x);
-		particles[i].update(dt);
-		auto new_x = particles[i].pos();
-		if (!bounding_volume.contains(new_x)) {
-			auto n = bounding_volume.inside_normal(old_x);
-			particles[i].set_velocity(glm::reflect(particles[i].v(), n));
-			particles[i].set_position(old_x + particles[i].v() * dt);
-			new_x = particles[i].pos();
-		}
-
-		ivec3 new_chunk = chunk(new_x);
-		if (c != new_chunk) {
-			particle_chunks[ivec3key(c)].erase(i);
-			if (particle_chunks[ivec3key(c)].empty())
-				particle_chunks.erase(ivec3key(c));
-			if (!particle_chunks.contains(ivec3key(new_chunk)))
-				particle_chunks[ivec3key(new_chunk)] = {};
-			particle_chunks[ivec3key(new_chunk)].insert(i);
+	pool->forRange(no_particles, grain, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			auto particle = FluidParticleRef(&particles, i);
+			auto old_x = particle.pos();
+			particle.update(dt);
+			if (!bounding_volume.contains(particle.pos())) {
+				auto n = bounding_volume.inside_normal(old_x);
+				particle.set_velocity(glm::reflect(particle.v(), n));
+				particle.set_position(old_x + particle.v() * dt);
+			}
 		}
-	}
+	});
+	rebuild_neighbour_grid();
 }
 
 SmoothImplicitSurface FluidParticleSystem::density_surface(float level) const {
@@ -148,16 +256,34 @@ SmoothImplicitSurface FluidParticleSystem::density_surface(float level) const {
 IndexedMesh FluidParticleSystem::particle_mesh(float r, int icosphere_res) const {
 	IndexedMesh mesh = IndexedMesh();
 	for (int i = 0; i < no_particles; i++) {
-		vec3 x = particles[i].pos();
+		int slot = particles.slotOf(i);
+		vec3 x = particles.position[slot];
 
 		// color = (pressure, density, total forces, speed)
-		vec4 color = vec4(particles[i].p(), x.x, x.y, x.z);
+		vec4 color = vec4(particles.pressure[slot], x.x, x.y, x.z);
 
 		mesh.mergeAndKeepID(icosphere(r, icosphere_res, x, i, color));
 	}
 	return mesh;
 }
 
+InstancedMesh FluidParticleSystem::particle_instances(float r, int icosphere_res) const {
+	InstancedMesh instances = InstancedMesh(icosphere(r, icosphere_res, ORIGIN, 0), InstanceTable({INSTANCE_OFFSET, INSTANCE_COLOR}, no_particles));
+	update_particle_instances(instances.instances());
+	return instances;
+}
+
+void FluidParticleSystem::update_particle_instances(InstanceTable &instances) const {
+	if (instances.size() != no_particles)
+		instances.resize(no_particles);
+	for (int i = 0; i < no_particles; i++) {
+		int slot = particles.slotOf(i);
+		vec3 x = particles.position[slot];
+		instances.setOffset(i, x);
+		instances.setColor(i, vec4(particles.pressure[slot], x.x, x.y, x.z));
+	}
+}
+
 MarchingCubeChunk FluidParticleSystem::boundary_surface_march(const ivec3 &res) const {
 	return MarchingCubeChunk(bound_min, bound_max, res, make_shared<SmoothImplicitSurface>(bounding_volume.boundary_surface()));
 }
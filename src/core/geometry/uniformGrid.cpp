@@ -0,0 +1,51 @@
+#include "uniformGrid.hpp"
+
+
+UniformGridIndex::UniformGridIndex(vec3 bound_min, vec3 bound_max, float cell_size)
+: origin(bound_min), cell(cell_size) {
+	THROW_IF(cell_size <= 0, IllegalArgumentError, "UniformGridIndex: cell size must be positive");
+	vec3 extent = glm::max(bound_max - bound_min, vec3(0));
+	dims = ivec3(glm::floor(extent / cell_size)) + ivec3(1);
+	cell_start = vector<int>(dims.x * dims.y * dims.z + 1, 0);
+}
+
+void UniformGridIndex::rebuild(const vector<vec3> &positions) {
+	int n = positions.size();
+	point_cell.resize(n);
+	sorted_slot.resize(n);
+	sorted_ids.resize(n);
+	sorted_pos.resize(n);
+	std::fill(cell_start.begin(), cell_start.end(), 0);
+
+	// counting sort by cell: histogram, exclusive prefix sum, scatter
+	for (int i = 0; i < n; ++i) {
+		int c = cellIndex(cellCoords(positions[i]));
+		point_cell[i] = c;
+		cell_start[c + 1]++;
+	}
+	for (int c = 1; c < cell_start.size(); ++c)
+		cell_start[c] += cell_start[c - 1];
+
+	for (int i = 0; i < n; ++i) {
+		int slot = cell_start[point_cell[i]]++;
+		sorted_slot[i] = slot;
+		sorted_ids[slot] = i;
+		sorted_pos[slot] = positions[i];
+	}
+	// the scatter advanced every start to the end of its cell, shift back by one cell
+	for (int c = cell_start.size() - 1; c > 0; --c)
+		cell_start[c] = cell_start[c - 1];
+	cell_start[0] = 0;
+}
+
+void UniformGridIndex::relabelInSortedOrder() {
+	int n = sorted_ids.size();
+	vector<int> cells(n);
+	for (int k = 0; k < n; ++k)
+		cells[k] = point_cell[sorted_ids[k]];
+	point_cell = std::move(cells);
+	for (int k = 0; k < n; ++k) {
+		sorted_ids[k] = k;
+		sorted_slot[k] = k;
+	}
+}
@@ -36,6 +36,8 @@ protected:
 	float r, h;
 	int radial_res;
 	int sampling_res;
+	// places the tube around the graph of f(-, t), reading radius and height from the colour and x, angle from the uv
+	VertexKernel tubeKernel(float t, vec3 shift) const;
 public:
 	MovingCurve(RealFunctionR2 f, vec2 dom, int sampling_res, float h, float r, int radial_res);
 	void update(float t) override;
@@ -71,10 +73,7 @@ public:
 			last_plot_t -= period;
 			PolyGroupID newid = randomID();
 			copyPolygroup(id, newid);
-			deformPerVertex(newid, [this, t](BufferedVertex &v) {
-				auto col = v.getColor();
-				v.setColor(vec4(col.x, col.y, col.z, t));
-			});
+			deformBulk(newid, vertexKernels::colorMap([t](vec3, vec3, vec4 col) { return vec4(col.x, col.y, col.z, t); }), {COLOR});
 
 		}
 	}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "filesUtils.hpp"
+
+
+enum CaptureFormat {
+	PNG_SEQUENCE,
+	Y4M_VIDEO
+};
+
+
+/**
+ * @brief Encodes a tightly packed RGBA8 image as an RGB PNG.
+ *
+ * Rows are taken bottom to top (as read by glReadPixels). Deflate is written as stored blocks,
+ * so the output is a deterministic function of the pixels and encoding costs a copy and two checksums.
+ */
+void encodePNG(const uint8_t *rgba, int width, int height, vector<uint8_t> &out);
+
+// appends one Y4M frame (planar full range BT.601 YCbCr 4:4:4) of a bottom-up RGBA8 image
+void encodeY4MFrame(const uint8_t *rgba, int width, int height, vector<uint8_t> &out);
+
+// stream header matching frames written by encodeY4MFrame
+string y4mHeader(int width, int height, int fps);
+
+
+
+/**
+ * @class FrameWriter
+ * @brief Encodes and writes captured frames on a separate thread.
+ *
+ * PNG_SEQUENCE writes frame_000000.png, frame_000001.png, ... into the output directory,
+ * Y4M_VIDEO appends frames to a single output file. Frames must be pushed in order.
+ * The queue holds at most maxQueued frames, push blocks only when the encoder falls that far behind.
+ * Errors of the writer thread are rethrown by the next push or by finish.
+ */
+class FrameWriter {
+	int width, height;
+	Path output;
+	CaptureFormat format;
+	size_t maxQueued;
+
+	std::ofstream video;
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<std::pair<int, vector<uint8_t>>> queue;
+	vector<vector<uint8_t>> freeBuffers;
+	std::exception_ptr error = nullptr;
+	bool closing = false;
+	int written = 0;
+
+	void run();
+	void writeFrame(int index, const vector<uint8_t> &rgba, vector<uint8_t> &encoded);
+	void rethrowError();
+
+public:
+	FrameWriter(int width, int height, const Path &output, CaptureFormat format, int fps, int maxQueued=8);
+	~FrameWriter();
+	FrameWriter(const FrameWriter &) = delete;
+	FrameWriter &operator=(const FrameWriter &) = delete;
+
+	// buffer of width*height*4 bytes to fill and push, reused from already written frames when possible
+	vector<uint8_t> acquireBuffer();
+	void push(int index, vector<uint8_t> &&rgba);
+	// waits until every pushed frame is written and joins the writer thread
+	void finish();
+	int framesWritten();
+};
+
+
+
+/**
+ * @class OffscreenTarget
+ * @brief Framebuffer with RGBA8 colour and depth renderbuffers, replacing the default framebuffer in headless rendering.
+ * @note Not multisampled, so the frames depend only on the rasteriser and not on the resolve done by the driver.
+ */
+class OffscreenTarget {
+	GLuint framebuffer = 0;
+	GLuint colorBuffer = 0;
+	GLuint depthBuffer = 0;
+
+public:
+	int width, height;
+
+	OffscreenTarget(int width, int height);
+	~OffscreenTarget();
+	OffscreenTarget(const OffscreenTarget &) = delete;
+	OffscreenTarget &operator=(const OffscreenTarget &) = delete;
+
+	// binds for drawing and reading and sets the viewport
+	void bind() const;
+};
+
+
+
+/**
+ * @class FrameCapture
+ * @brief Reads frames back through a ring of pixel buffer objects and hands them to a FrameWriter.
+ *
+ * capture() only queues an asynchronous glReadPixels into the next PBO of the ring, the pixels of a frame
+ * are mapped when its PBO is reused ringSize frames later, by which time the GPU has long finished it.
+ * With ringSize 2 the mapped frame is the previous one, so capture never waits on more than one frame of GPU work.
+ */
+class FrameCapture {
+	int width, height;
+	vector<GLuint> pbos;
+	vector<GLsync> fences;
+	vector<int> slotFrames;
+	int frame = 0;
+	FrameWriter writer;
+
+	void collect(int slot);
+
+public:
+	FrameCapture(int width, int height, const Path &output, CaptureFormat format, int fps, int ringSize=3);
+	~FrameCapture();
+	FrameCapture(const FrameCapture &) = delete;
+	FrameCapture &operator=(const FrameCapture &) = delete;
+
+	// reads the currently bound read framebuffer
+	void capture();
+	// collects all frames still in flight and waits for the writer
+	void finish();
+	int framesCaptured() const;
+};
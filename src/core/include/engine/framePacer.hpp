@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+/**
+ * @class FrameClock
+ * @brief Monotonic time source in seconds, the pacer only reaches the OS through it.
+ */
+class FrameClock {
+public:
+	virtual ~FrameClock() = default;
+	virtual double now() = 0;
+	// may return late, the pacer measures and compensates the overshoot
+	virtual void sleepFor(double seconds) = 0;
+	// called on every iteration of the final busy wait
+	virtual void relax() {}
+};
+
+// std::chrono::steady_clock with std::this_thread::sleep_for
+class SteadyFrameClock : public FrameClock {
+public:
+	double now() override;
+	void sleepFor(double seconds) override;
+};
+
+
+/**
+ * @class FrameTimeHistogram
+ * @brief Durations of the last capacity() frames with their statistics.
+ *
+ * Samples are kept in a ring buffer, quantiles are exact over the window. The histogram has logarithmic
+ * buckets, BUCKETS_PER_OCTAVE per doubling from MIN_BUCKET_SECONDS, so it resolves both sub-millisecond
+ * phases and long stalls.
+ */
+class FrameTimeHistogram {
+	std::vector<double> samples;
+	size_t next = 0;
+	bool full = false;
+
+public:
+	static constexpr double MIN_BUCKET_SECONDS = 1e-5;
+	static constexpr int BUCKETS_PER_OCTAVE = 4;
+	static constexpr int BUCKETS = 15*BUCKETS_PER_OCTAVE;
+
+	explicit FrameTimeHistogram(int capacity=600);
+
+	void record(double seconds);
+	void clear();
+
+	int capacity() const { return samples.size(); }
+	int count() const { return full ? samples.size() : next; }
+	bool empty() const { return count() == 0; }
+	// samples in recording order, oldest first
+	std::vector<double> window() const;
+	double last() const;
+	double mean() const;
+	double min() const;
+	double max() const;
+	double stddev() const;
+	// q in [0, 1], nearest rank
+	double quantile(double q) const;
+
+	static int bucketOf(double seconds);
+	static double bucketLowerBound(int bucket);
+	std::array<int, BUCKETS> histogram() const;
+};
+
+
+enum class FramePacing {
+	UNCAPPED, // frames start as soon as the previous one ended
+	CAPPED,   // frames start at least 1/fps after the previous one, dt is the measured interval
+	FIXED     // frames start on a grid of 1/fps, dt is always exactly 1/fps
+};
+
+
+/**
+ * @class FramePacer
+ * @brief Limits the frame rate by sleeping and records frame, simulation and render times.
+ *
+ * beginFrame sleeps until shortly before the deadline of the next frame and spins only for the rest, so the
+ * calling thread is idle for most of the budget. The spin margin follows the worst sleep overshoot seen
+ * recently (never less than minSpinMargin), coarse timers thus cost a bit more spinning instead of late frames.
+ * A frame is beginFrame, simulation until markSimulationDone, rendering until endFrame. Without markSimulationDone
+ * the whole work of the frame counts as rendering. Deadlines of FIXED pacing follow a grid, a frame late by more than one period
+ * moves the grid instead of rendering a burst of frames to catch up.
+ */
+class FramePacer {
+	std::shared_ptr<FrameClock> clock;
+	FramePacing _mode;
+	double period;
+	double minSpinMargin;
+	double spinMargin;
+
+	bool started = false;
+	double frameStart = 0, deadline = 0, simulationEnd = -1;
+	FrameTimeHistogram frames, simulation, render, waiting;
+
+	void waitUntil(double time);
+
+public:
+	explicit FramePacer(FramePacing mode=FramePacing::CAPPED, float fps=60, std::shared_ptr<FrameClock> clock=std::make_shared<SteadyFrameClock>(),
+		int historyFrames=600, double minSpinMargin=2e-4);
+
+	FramePacing mode() const { return _mode; }
+	float targetFPS() const { return period > 0 ? 1./period : 0.f; }
+	void setTarget(FramePacing mode, float fps);
+
+	// forgets the previous frame, the next beginFrame does not wait and returns 0 (1/fps when FIXED)
+	void reset();
+	// waits as the mode requires and returns the simulation time step of the new frame in seconds
+	double beginFrame();
+	void markSimulationDone();
+	void endFrame();
+
+	// intervals between consecutive frame starts
+	const FrameTimeHistogram &frameTimes() const { return frames; }
+	const FrameTimeHistogram &simulationTimes() const { return simulation; }
+	const FrameTimeHistogram &renderTimes() const { return render; }
+	// time beginFrame spent sleeping and spinning
+	const FrameTimeHistogram &waitTimes() const { return waiting; }
+	double currentSpinMargin() const { return spinMargin; }
+
+	// one line of mean and quantiles per phase
+	std::string summary() const;
+	// summary followed by the nonempty histogram buckets of every phase
+	void dump(std::ostream &out) const;
+};
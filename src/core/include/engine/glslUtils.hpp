@@ -2,6 +2,11 @@
 
 #include "indexedRendering.hpp"
 #include "renderingUtils.hpp"
+#include "frameCapture.hpp"
+#include "framePacer.hpp"
+#include "headlessContext.hpp"
+#include "uniforms.hpp"
+#include "instancing.hpp"
 #include "file-management/filesUtils.hpp"
 #include "utils/logging.hpp"
 
@@ -44,9 +49,15 @@ public:
 	int width;
 	int height;
 	float aspectRatio;
+	unique_ptr<HeadlessContext> headlessContext = nullptr;
 	Window(int width, int height, const char* title);
 	Window(Resolution resolution, const char* title);
+	Window(GLFWwindow* window, int width, int height);
+	Window(unique_ptr<HeadlessContext> context, int width, int height);
 	~Window();
+
+	// surfaceless HeadlessContext when EGL allows it, otherwise an invisible GLFW window (EGL, OSMesa, native context)
+	static unique_ptr<Window> offscreen(int width, int height);
 	int destroy();
 
 	void initViewport();
@@ -111,6 +122,12 @@ protected:
 
 	ShaderType shaderType;
 
+	// values of the uniforms set through this program and its copies, string keyed setters and handles share it
+	shared_ptr<UniformShadowBlock> uniformValues;
+	std::unordered_map<string, int> uniformSlots;
+	int uniformSlot(const string &uniformName, GLSLType uniformType, int count=1);
+	void stageUniform(const string &uniformName, GLSLType uniformType, const void *value);
+
 public:
 	std::unordered_map<string, GLuint> uniformLocations;
 	std::unordered_map<string, GLSLType> uniformTypes;
@@ -145,6 +162,13 @@ public:
 	void setUniform(const string& uniformName, float x, float y);
 	void setUniform(const string &uniformName, float x, float y, float z);
 	void setUniform(const string &uniformName, float x, float y, float z, float w);
+
+	// resolves the location once, writes through the handle are uploaded by flushUniforms when they changed
+	template<typename T>
+	UniformHandle<T> uniformHandle(const string &uniformName, int count=1) {
+		return UniformHandle<T>(uniformValues.get(), uniformSlot(uniformName, glslTypeOf<T>(), count));
+	}
+	void flushUniforms();
 };
 
 class Camera {
@@ -193,6 +217,8 @@ public:
 	int inputNumber;
 	bool enabled;
 	bool bufferInitialized;
+	size_t allocatedBytes;
+	unsigned long uploadedGeneration;	// of the mesh buffer, see BufferManager::collectUploads
 	CommonBufferType bufferType;
 
 	Attribute(const string &name, GLSLType type, int inputNumber, CommonBufferType bufferType);
@@ -203,6 +229,7 @@ public:
 	virtual void enable();
 	virtual void disable();
 	virtual void load(const void* firstElementAdress, int bufferLength);
+	virtual void upload(const void* firstElementAdress, const vector<BufferUpload> &uploads);
 	virtual void freeBuffer();
 };
 
@@ -217,7 +244,13 @@ protected:
 	vector<shared_ptr<Attribute>> attributes;
 	shared_ptr<IndexedMesh> weak_super = nullptr;
 	GLuint elementBufferLoc = 0;
+	size_t elementBufferBytes = 0;
+	unsigned long elementBufferGeneration = 0;
 	shared_ptr<MaterialPhong> material = nullptr;
+	BufferUploadLog uploadLog;
+	vector<shared_ptr<std::function<void(float, shared_ptr<ShaderProgram>)>>> setterSequence;
+	vector<std::function<void(float)>> handleSetters;
+	vector<shared_ptr<UniformBufferBlock>> uniformBuffers;
 
 	void weakMeshRenderStep(float t);
 
@@ -243,6 +276,8 @@ public:
 
 	void loadMeshAttributes();
     void loadElementBuffer();
+	const BufferUploadLog &uploadStatistics() const;
+	void resetUploadStatistics();
 	void enableAttributes();
 	void disableAttributes();
 
@@ -255,6 +290,14 @@ public:
 
 	void addUniforms(const std::map<string, GLSLType> &uniforms, std::map<string, shared_ptr<std::function<void(float, shared_ptr<ShaderProgram>)>>> setters);
 	void addUniform(string uniformName, GLSLType uniformType, shared_ptr<std::function<void(float, shared_ptr<ShaderProgram>)>> setter);
+	// per frame value written through a pre-resolved handle, uploaded only when it changes
+	template<typename T>
+	void addUniform(const string &uniformName, const std::function<T(float)> &value) {
+		auto handle = shader->uniformHandle<T>(uniformName);
+		handleSetters.push_back([handle, value](float t) { handle.set(value(t)); });
+	}
+	// grouped parameters kept in a uniform buffer, flushed together with the other uniforms of the step
+	void addUniformBuffer(const shared_ptr<UniformBufferBlock> &block, const string &blockName, GLuint bindingPoint);
 	void addConstFloats(const std::map<string, float>& uniforms);
 	void addConstVec4(const string& name, vec4 value);
 	void addConstColor(const string &name, vec4 value);
@@ -270,6 +313,27 @@ public:
 };
 
 
+/**
+ * @class InstancedRenderingStep
+ * @brief Draws every instance of an InstancedMesh with one instanced call.
+ *
+ * The template mesh is uploaded like the mesh of a RenderingStep, the instance table goes to
+ * separate buffers read by the vertex shader at instanceAttributeLocation, so per frame updates
+ * only transfer the instances that changed.
+ */
+class InstancedRenderingStep : public RenderingStep {
+	shared_ptr<InstancedMesh> instanced;
+	InstanceBuffers instanceBuffers;
+
+public:
+	InstancedRenderingStep(const shared_ptr<ShaderProgram> &shader, const shared_ptr<MaterialPhong> &material, const shared_ptr<InstancedMesh> &instanced, InstanceCalls calls=InstanceCalls::gl());
+
+	void init(const shared_ptr<Camera> &cam, const vector<Light> &lights) override;
+	void renderStep(float t) override;
+	const BufferUploadLog &instanceUploadStatistics() const { return instanceBuffers.uploadStatistics(); }
+};
+
+
 class RenderSettings {
 public:
 	vec4 bgColor;
@@ -277,13 +341,17 @@ public:
 	bool depthTest;
 	bool timeUniform;
 	float speed;
-	int maxFPS;
+	int maxFPS; // frames are not limited when maxFPS <= 0
+	// how maxFPS is enforced by the main loop, FIXED steps simulation time by exactly 1/maxFPS
+	FramePacing pacing = FramePacing::CAPPED;
 	Resolution resolution;
 	string windowTitle;
 
 	bool takeScreenshots;
 	float screenshotFrequency;
 	Path screenshotDirectory;
+	// initialise GLFW on its null platform, windows can then only be created with initOffscreen
+	bool headless = false;
 
 	RenderSettings(vec4 bgColor, bool alphaBlending, bool depthTest, bool timeUniform, float speed, int maxFPS,
 		bool takeScreenshots, Resolution resolution, float screenshotFrequency=0.f, const string &windowTitle="window");
@@ -296,10 +364,11 @@ public:
 
 class Renderer {
 protected:
-	float last_time_capture = 0;
+	FramePacer pacer;
 	GLuint vao;
 
 	unique_ptr<Window> window;
+	unique_ptr<OffscreenTarget> offscreen;
 	vector<shared_ptr<RenderingStep>> renderingSteps;
 
 	shared_ptr<Camera> camera;
@@ -320,7 +389,12 @@ public:
 	void initMainWindow(int width, int height, const char* title);
 	void initMainWindow(Resolution resolution, const char* title);
 	void initMainWindow();
+	void initOffscreen(int width, int height);
+	void initOffscreen(Resolution resolution);
 	void resetTimer();
+	void setFramePacing(FramePacing mode, float fps);
+	// frame, simulation and render times of the recent frames of mainLoop
+	const FramePacer &framePacer() const { return pacer; }
 
 	void setCamera(const shared_ptr<Camera> &camera);
 	void setLights(const vector<Light> &lights);
@@ -332,8 +406,12 @@ public:
 
 	void addRenderingStep(shared_ptr<RenderingStep> renderingStep);
 	void addMeshStep(const ShaderProgram& shader, const shared_ptr<IndexedMesh> &model, const shared_ptr<MaterialPhong>& material);
+	void addInstancedMeshStep(const ShaderProgram& shader, const shared_ptr<InstancedMesh> &model, const shared_ptr<MaterialPhong>& material);
 
+	void clearFrame();
 	float initFrame();
+	// advances time by animSpeed(time)*frameDuration independently of the wall clock
+	float initFrame(float frameDuration);
 	float lastDeltaTime() const;
 
 	void addPerFrameUniforms(const std::map<string, GLSLType> &uniforms, const std::map<string, shared_ptr<std::function<void(float, shared_ptr<ShaderProgram>)>>> &setters);
@@ -352,4 +430,14 @@ public:
 	virtual void initRendering();
 	virtual void renderAllSteps();
 	virtual int mainLoop();
+
+	/**
+	 * @brief Renders given number of frames into the offscreen target and captures every one of them.
+	 *
+	 * The first frame is rendered at time 0 and simulation time advances by animSpeed(time)/fps between frames,
+	 * so frame k shows time k/fps at unit speed and the same scene gives the same frames on every run. Frames are read back asynchronously and encoded on a writer thread (see FrameCapture).
+	 * @param output directory of the PNG sequence or path of the Y4M file
+	 * @throws ValueError when the renderer was not set up with initOffscreen
+	 */
+	virtual int renderOffline(int frames, int fps, const Path &output, CaptureFormat format=PNG_SEQUENCE);
 };
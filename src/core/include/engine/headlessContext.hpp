@@ -0,0 +1,28 @@
+#pragma once
+
+#include <memory>
+
+
+/**
+ * @class HeadlessContext
+ * @brief OpenGL 3.3 core context without any surface, created through EGL on the surfaceless Mesa platform
+ * (falling back to the default EGL display), so it runs on machines without display server or GPU.
+ *
+ * libEGL is loaded at runtime, nothing has to be linked. Rendering has to target a framebuffer object,
+ * the context has no default framebuffer.
+ */
+class HeadlessContext {
+	void *library = nullptr;
+	void *display = nullptr;
+	void *context = nullptr;
+
+	HeadlessContext() = default;
+
+public:
+	~HeadlessContext();
+	HeadlessContext(const HeadlessContext &) = delete;
+	HeadlessContext &operator=(const HeadlessContext &) = delete;
+
+	// current context or nullptr when EGL is not available or refuses the context (always on Windows)
+	static std::unique_ptr<HeadlessContext> create();
+};
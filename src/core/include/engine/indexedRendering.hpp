@@ -3,9 +3,13 @@
 #include "renderingUtils.hpp"
 // #include "../geometry/pde.hpp"
 
+#include <iterator>
 #include <set>
 
 #include "../utils/randomUtils.hpp"
+#include "../geometry/meshAdjacency.hpp"
+#include "../geometry/meshOptimisation.hpp"
+#include "meshIO.hpp"
 
 
 
@@ -66,6 +70,135 @@ inline size_t bufferElementSize(CommonBufferType type) { return type != INDEX ?
 
 const vector<string> DEFAULT_EXTRA_BUFS = {"extra0", "extra1", "extra2", "extra3", "extra4"};
 const std::set DEFAULT_ACTIVE_BUFFERS = {POSITION, NORMAL, UV, COLOR, INDEX};
+constexpr int COMMON_BUFFER_TYPES = EXTRA4 + 1;
+
+
+
+
+/**
+ * @class DirtyRanges
+ * @brief Element ranges of a single buffer modified since its last upload.
+ *
+ * Ranges are half-open [begin, end), kept sorted and merged when they touch, so the usual
+ * write pattern (consecutive vertices of a polygroup) only ever extends the last range.
+ * When more than MAX_RANGES separate ranges accumulate they collapse into their hull.
+ */
+class DirtyRanges {
+	vector<ivec2> ranges;
+	bool whole = true;
+
+	void insert(int begin, int end);
+
+public:
+	static constexpr int MAX_RANGES = 8;
+
+	void mark(int i) {
+		if (whole) return;
+		if (!ranges.empty() && ranges.back().x <= i && i <= ranges.back().y) {
+			ranges.back().y = std::max(ranges.back().y, i + 1);
+			return;
+		}
+		insert(i, i + 1);
+	}
+	void mark(int begin, int end) { if (!whole && begin < end) insert(begin, end); }
+	void markWhole() { whole = true; ranges.clear(); }
+	void clear() { whole = false; ranges.clear(); }
+
+	bool empty() const { return !whole && ranges.empty(); }
+	bool wholeBuffer() const { return whole; }
+	const vector<ivec2> &getRanges() const { return ranges; }
+	int dirtyElements() const;
+};
+
+
+/**
+ * @class DirtyHistory
+ * @brief Dirty ranges of a buffer split into generations, so that several GPU copies of it are kept up to date independently.
+ *
+ * Marks go to the newest generation. A copy remembers the generation it was last brought up to date with and is given
+ * the ranges marked since, nothing is cleared by collecting them, so the other copies still see every write.
+ * Only the last MAX_GENERATIONS are kept, a copy lagging further behind or never uploaded gets the whole buffer.
+ */
+class DirtyHistory {
+	vector<DirtyRanges> generations = {DirtyRanges()};	// oldest first, the back one is being marked
+	unsigned long newest = 1;
+
+public:
+	static constexpr int MAX_GENERATIONS = 8;
+
+	void mark(int i) { generations.back().mark(i); }
+	void mark(int begin, int end) { generations.back().mark(begin, end); }
+	void markWhole();
+
+	unsigned long newestGeneration() const { return newest; }
+	unsigned long oldestGeneration() const { return newest + 1 - generations.size(); }
+	// union of the ranges marked in the given generation and after, the whole buffer if it is no longer kept
+	DirtyRanges since(unsigned long generation) const;
+	// starts a new generation unless nothing was marked in the current one, returns the generation a fresh copy is up to date with
+	unsigned long advance();
+};
+
+
+
+
+/**
+ * @brief Single transfer to a GPU buffer, offsets and sizes in bytes.
+ * @note respecify means the whole storage is (re)allocated with glBufferData, which also orphans
+ * the old storage, otherwise the range is written into existing storage with glBufferSubData.
+ */
+struct BufferUpload {
+	size_t offset;
+	size_t size;
+	bool respecify;
+};
+
+// uploads bringing a GPU copy of allocatedBytes up to date with a buffer of length elements, clears the ranges
+vector<BufferUpload> collectUploads(DirtyRanges &dirty, int length, size_t elementSize, size_t allocatedBytes);
+// same for one of possibly several copies, last brought up to date with uploadedGeneration of the history, which is advanced
+vector<BufferUpload> collectUploads(DirtyHistory &history, unsigned long &uploadedGeneration, int length, size_t elementSize, size_t allocatedBytes);
+
+
+/**
+ * @brief Attribute arrays of a contiguous range of vertices, the form in which bulk deformation kernels see a polygroup.
+ * @note first is the buffer index of the first vertex, extras of inactive slots are empty.
+ */
+struct VertexSpans {
+	int first = 0;
+	std::span<vec3> positions;
+	std::span<vec3> normals;
+	std::span<vec2> uvs;
+	std::span<vec4> colors;
+	std::array<std::span<vec4>, 5> extras;
+
+	int size() const { return positions.size(); }
+	VertexSpans subspan(int offset, int count) const;
+};
+
+// runs on a chunk of vertices, chunks of one deformation may run concurrently
+using VertexKernel = std::function<void(const VertexSpans &)>;
+
+
+/**
+ * @class BufferUploadLog
+ * @brief Counts bytes and calls of planned buffer uploads, so upload traffic can be checked without a GPU.
+ */
+class BufferUploadLog {
+	std::array<size_t, COMMON_BUFFER_TYPES> bytes_per_type = {};
+	size_t total_bytes = 0;
+	int calls = 0;
+	int respecifications = 0;
+
+public:
+	void record(CommonBufferType type, const BufferUpload &upload);
+	// uploads of buffers outside the BufferManager, counted only in the totals
+	void record(const BufferUpload &upload);
+	void reset();
+
+	size_t totalBytes() const { return total_bytes; }
+	size_t bytes(CommonBufferType type) const { return bytes_per_type[type]; }
+	int uploadCalls() const { return calls; }
+	int respecifiedBuffers() const { return respecifications; }
+};
 
 class BufferManager {
 	unique_ptr<Stds> stds;
@@ -77,6 +210,8 @@ class BufferManager {
 	unique_ptr<vector<ivec3>> indices;
 	std::set<CommonBufferType> activeBuffers;
 	vector<string> extraBufferNames;
+	std::array<DirtyHistory, COMMON_BUFFER_TYPES> dirty;
+	unsigned long topologyVersion = 0;
 	void insertValueToSingleBuffer(CommonBufferType type, void *valueAddress);
 	void insertDefaultValueToSingleBuffer(CommonBufferType type);
 
@@ -101,6 +236,18 @@ public:
 	int addTriangleVertexIndices(ivec3 ind, int shift = 0);
 
 	int addFullVertexData(const Vertex &v);
+	// appends vertices with default color and extras in one go, returns the index of the first one
+	int addVertices(std::span<const vec3> positions, std::span<const vec3> normals, std::span<const vec2> uvs);
+	// appends faces shifted by shift, returns the index of the first one
+	int addTriangles(std::span<const ivec3> faces, int shift = 0);
+	// sets the length of every active vertex buffer and of the index buffer, meant for filling them through firstElementAddress
+	void resizeBuffers(int vertexCount, int faceCount);
+	// writes through the spans are not tracked, see markDirty
+	VertexSpans vertexSpans(int first, int count);
+	// permutes the vertices in [first, first + order.size()), the k-th of them becomes the one at first + order[k]
+	void reorderVertices(int first, std::span<const int> order);
+	// overwrites the faces from index first on with faces shifted by shift
+	void setTriangles(int first, std::span<const ivec3> faces, int shift = 0);
 
 	void reserveSpace(int targetSize);
 	void reserveSpaceForIndex(int targetSize);
@@ -139,27 +286,43 @@ public:
 	bool hasExtra2() const;
 	bool hasExtra3() const;
 	bool hasExtra4() const;
+
+	/**
+	 * Every setter marks the written element dirty, appending data or activating a buffer marks
+	 * the whole buffer. A freshly constructed or assigned manager is entirely dirty.
+	 * Dirty state is relative to a GPU copy, identified by the generation it was last brought up to date with (0 if never).
+	 */
+	DirtyRanges dirtyRanges(CommonBufferType type, unsigned long uploadedGeneration) const;
+	bool isDirty(CommonBufferType type, unsigned long uploadedGeneration) const;
+	void markDirty(CommonBufferType type, int begin, int end);
+	void markAllDirty();
+
+	/**
+	 * Plans the transfers bringing a GPU copy of given buffer up to date.
+	 * @param allocatedBytes size of the storage currently allocated on the GPU side, if it differs from
+	 * the buffer size the storage is respecified. Same happens when most of the buffer is dirty anyway.
+	 * @param uploadedGeneration the copy's own, advanced to the current generation; any number of rendering steps
+	 * can share the mesh, each keeps its own and receives every write made since its previous call
+	 * @param log optional counter the planned transfers are recorded to
+	 */
+	vector<BufferUpload> collectUploads(CommonBufferType type, size_t allocatedBytes, unsigned long &uploadedGeneration, BufferUploadLog *log = nullptr);
+
+	// increases whenever the index buffer is written, so topology derived caches can detect they are stale
+	unsigned long getTopologyVersion() const;
 };
 
 
 
 
+// proxy of a vertex stored in a BufferManager, cheap to copy
 class BufferedVertex {
-	BufferManager &bufferBoss;
+	BufferManager *bufferBoss;
 	int index;
 
 public:
-	BufferedVertex();
-	BufferedVertex(BufferManager &bufferBoss, int index);
-	BufferedVertex(const BufferedVertex &other) : bufferBoss(other.bufferBoss), index(other.index) {}
-	BufferedVertex(BufferedVertex &&other) noexcept;
+	BufferedVertex(BufferManager &bufferBoss, int index) : bufferBoss(&bufferBoss), index(index) {}
 	BufferedVertex(BufferManager &bufferBoss, const Vertex &v);
 
-
-	BufferedVertex & operator=(const BufferedVertex &other);
-
-	BufferedVertex & operator=(BufferedVertex &&other) noexcept;
-
 	int getIndex() const;
 	vec3 getPosition() const;
 	vec3 getNormal() const;
@@ -192,18 +355,18 @@ public:
 
 
 
+// proxy of a face stored in the index buffer of a BufferManager, cheap to copy
 class IndexedTriangle {
 	int index;
-	BufferManager &bufferBoss;
+	BufferManager *bufferBoss;
+	vec3 position(int i) const;
 
 public:
-	//    IndexedTriangle(BufferManager &bufferBoss, int index) : index(index), bufferBoss(bufferBoss) {}
-	IndexedTriangle(const IndexedTriangle &other);
-	IndexedTriangle(IndexedTriangle &&other) noexcept;
+	// triangle already stored in the index buffer at given position
+	IndexedTriangle(BufferManager &bufferBoss, int index) : index(index), bufferBoss(&bufferBoss) {}
 	IndexedTriangle(BufferManager &bufferBoss, ivec3 index, int shift);
-	IndexedTriangle & operator=(const IndexedTriangle &other);
-	IndexedTriangle & operator=(IndexedTriangle &&other) noexcept;
 
+	int getIndex() const { return index; }
 	ivec3 getVertexIndices() const;
 	Vertex getVertex(int i) const;
 	mat2 barMatrix() const;
@@ -223,15 +386,104 @@ public:
 	void changeOrientation();
 };
 
+/**
+ * @class PolygroupView
+ * @brief Contiguous range of vertices or faces of a polygroup, seen through proxies into its BufferManager.
+ *
+ * Dereferencing constructs a BufferedVertex or an IndexedTriangle on the fly, so traversing a view
+ * allocates nothing. A view stays valid while the mesh owning the buffers exists, adding polygroups
+ * does not invalidate it.
+ */
+template<typename Proxy>
+class PolygroupView {
+	BufferManager *bufferBoss;
+	int first;
+	int count;
+
+public:
+	class iterator {
+		BufferManager *bufferBoss = nullptr;
+		int index = 0;
+
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = Proxy;
+		using difference_type = std::ptrdiff_t;
+		using reference = Proxy;
+		using pointer = void;
+
+		iterator() = default;
+		iterator(BufferManager *bufferBoss, int index) : bufferBoss(bufferBoss), index(index) {}
+
+		Proxy operator*() const { return Proxy(*bufferBoss, index); }
+		Proxy operator[](difference_type n) const { return Proxy(*bufferBoss, index + n); }
+		iterator &operator++() { ++index; return *this; }
+		iterator operator++(int) { iterator it = *this; ++index; return it; }
+		iterator &operator--() { --index; return *this; }
+		iterator operator--(int) { iterator it = *this; --index; return it; }
+		iterator &operator+=(difference_type n) { index += n; return *this; }
+		iterator &operator-=(difference_type n) { index -= n; return *this; }
+		iterator operator+(difference_type n) const { return iterator(bufferBoss, index + n); }
+		iterator operator-(difference_type n) const { return iterator(bufferBoss, index - n); }
+		friend iterator operator+(difference_type n, const iterator &it) { return it + n; }
+		difference_type operator-(const iterator &other) const { return index - other.index; }
+		bool operator==(const iterator &other) const { return index == other.index; }
+		auto operator<=>(const iterator &other) const { return index <=> other.index; }
+	};
+
+	PolygroupView(BufferManager &bufferBoss, int first, int count) : bufferBoss(&bufferBoss), first(first), count(count) {}
+
+	iterator begin() const { return iterator(bufferBoss, first); }
+	iterator end() const { return iterator(bufferBoss, first + count); }
+	int size() const { return count; }
+	bool empty() const { return count == 0; }
+	// index of the first element in the buffer, local index i is the buffer index firstIndex() + i
+	int firstIndex() const { return first; }
+
+	Proxy operator[](int i) const { return Proxy(*bufferBoss, first + i); }
+	Proxy front() const { return (*this)[0]; }
+	Proxy back() const { return (*this)[count - 1]; }
+	vector<Proxy> toVector() const { return vector<Proxy>(begin(), end()); }
+};
+
+using PolygroupVertices = PolygroupView<BufferedVertex>;
+using PolygroupTriangles = PolygroupView<IndexedTriangle>;
+
+
 class SmoothParametricSurface;
 
+/**
+ * @brief Evaluates a surface on a grid of size.x x size.y parameters, params[i*size.y + j] being those of vertex (i, j).
+ *
+ * Rows are evaluated in parallel as jobs of the global JobSystem. Tangents are central differences of the neighbouring
+ * samples, wrapping around the periodic directions and one-sided on open borders, and the normals their cross product
+ * oriented as SmoothParametricSurface::normal, so the surface is called once per vertex. Where the sampled tangents
+ * degenerate, e.g. at the poles of a sphere, the normal is evaluated from the surface instead.
+ */
+void sampleSurfaceGrid(const SmoothParametricSurface &surf, ivec2 size, bvec2 periodic, std::span<const vec2> params,
+					   std::span<vec3> positions, std::span<vec3> normals);
+
 
 class IndexedMesh{
 protected:
+	// vertices and faces of a polygroup are consecutive in the buffers
+	struct PolygroupRange {
+		int firstVertex, vertexCount;
+		int firstFace, faceCount;
+		// vertex grid of polygroups made by addUniformSurface, zero otherwise
+		ivec2 grid = ivec2(0);
+		bvec2 gridPeriodic = bvec2(false);
+	};
+
 	unique_ptr<BufferManager> boss;
 	unordered_map<PolyGroupID, int> polygroupIndexOrder = {};
-	vector<vector<BufferedVertex>> vertices = {};
-	vector<vector<IndexedTriangle>> triangles = {};
+	vector<PolygroupRange> polygroups = {};
+	mutable vector<pair<unsigned long, shared_ptr<const MeshAdjacency>>> adjacencyCache = {};
+
+	const PolygroupRange &polygroupRange(const PolyGroupID &id) const { return polygroups.at(polygroupIndexOrder.at(id)); }
+	void addPolygroupRange(const PolyGroupID &id, int firstVertex, int firstFace);
+	// writable arrays of the polygroup, untracked, so they are only handed out by deformBulk, which marks what it writes dirty
+	VertexSpans vertexSpans(const PolyGroupID &id);
 
 public:
 	virtual ~IndexedMesh() = default;
@@ -243,12 +495,28 @@ public:
 
 	void addNewPolygroup(const vector<Vertex> &hardVertices, const vector<ivec3> &faceIndices, const PolyGroupID &id);
 	void addNewPolygroup(const char *filename, const PolyGroupID &id);
+	void addNewPolygroup(const OBJData &data, const PolyGroupID &id);
+
+	/**
+	 * Binary cache of all buffers and polygroups, see MeshCacheHeader. Loading maps the file and copies
+	 * the buffers in place, so it costs little more than reading the file.
+	 * @throws InvalidFileError when the file is not a cache of the current version
+	 */
+	void saveBinaryCache(const Path &path) const;
+	static IndexedMesh loadBinaryCache(const Path &path);
+	// imports the OBJ through a cache (default: objPath + ".meshcache") that is rebuilt when missing, outdated or older than the OBJ
+	static IndexedMesh fromOBJCached(const Path &objPath, const PolyGroupID &id, const Path &cachePath = Path());
 
 	IndexedMesh &operator=(const IndexedMesh &other);
 	IndexedMesh(IndexedMesh &&other) noexcept;
 	IndexedMesh &operator=(IndexedMesh &&other) noexcept;
 	IndexedMesh(const IndexedMesh &other);
 
+	/**
+	 * Tessellates the surface on a uniform tRes x uRes grid, see sampleSurfaceGrid. Vertices are written straight into the
+	 * buffers and the faces generated from the grid, periodic directions are closed by a seam of faces.
+	 * @throws IllegalArgumentError when a resolution is below 2
+	 */
 	void addUniformSurface(const SmoothParametricSurface &surf, int tRes, int uRes, const PolyGroupID &id = randomID());
 
 	void merge(const IndexedMesh &other);
@@ -274,15 +542,23 @@ public:
 	BufferManager &getBufferBoss() const;
 	bool isActive(CommonBufferType type) const;
 
-	BufferedVertex &getAnyVertexFromPolyGroup(const PolyGroupID &id);
+	BufferedVertex getAnyVertexFromPolyGroup(const PolyGroupID &id);
 
 	void deformPerVertex(const PolyGroupID &id, const HOM(BufferedVertex&, void) &deformation);
 	void deformPerVertex(const HOM(BufferedVertex&, void) &deformation);
 	void deformPerVertex(const PolyGroupID &id, const std::function<void(int, BufferedVertex &)> &deformation);
 	void deformPerId(const std::function<void(BufferedVertex &, PolyGroupID)> &deformation);
 
+	/**
+	 * Runs the kernel over the vertices of the polygroup split into chunks, which are jobs of the global JobSystem,
+	 * and marks the buffers listed in writes dirty over the polygroup. A kernel may only touch the vertices it is given.
+	 */
+	void deformBulk(const PolyGroupID &id, const VertexKernel &kernel, const std::set<CommonBufferType> &writes = {POSITION, NORMAL});
+	void deformBulk(const VertexKernel &kernel, const std::set<CommonBufferType> &writes = {POSITION, NORMAL});
+
 	static vec2 getSurfaceParameters(const BufferedVertex &v);
 	static void encodeSurfacePoint(BufferedVertex &v, const SmoothParametricSurface &surf, vec2 tu);
+	// moves the vertices to the new surface at their stored parameters, polygroups made by addUniformSurface are resampled as a grid
 	void adjustToNewSurface(const SmoothParametricSurface &surf, const PolyGroupID &id);
 	void adjustToNewSurface(const SmoothParametricSurface &surf);
 
@@ -307,12 +583,23 @@ public:
 	IndexedMesh subdivideEdgecentric(const PolyGroupID &id) const;
 	IndexedMesh wireframe(PolyGroupID id, PolyGroupID targetId, float width, float heightCenter, float heightSide) const;
 
+	PolygroupVertices vertexView(const PolyGroupID &id) const;
+	PolygroupTriangles triangleView(const PolyGroupID &id) const;
+
 	vector<Vertex> getVertices(const PolyGroupID &id) const;
-	vector<BufferedVertex> getBufferedVertices(const PolyGroupID &id) const;
 	vector<ivec3> getIndices(const PolyGroupID &id) const;
-	vector<IndexedTriangle> getTriangles(const PolyGroupID &id) const;
+	// copies of vertexView(id) and triangleView(id), for code that keeps the proxies in a vector
+	vector<BufferedVertex> getBufferedVertices(const PolyGroupID &id) const { return vertexView(id).toVector(); }
+	vector<IndexedTriangle> getTriangles(const PolyGroupID &id) const { return triangleView(id).toVector(); }
 
 
+	/**
+	 * Incidence structure of a polygroup in its local vertex indices, i.e. positions in getBufferedVertices(id).
+	 * Built on first use and rebuilt after the index buffer changes. Not safe to call concurrently with a rebuild.
+	 */
+	const MeshAdjacency &adjacency(const PolyGroupID &id) const;
+	void invalidateAdjacency();
+
 	vector<int> findVertexNeighbours(int i, const PolyGroupID &id) const;
 	vector<int> findVertexParentTriangles(int i, const PolyGroupID &id) const;
 	void recalculateNormal(int i, const PolyGroupID &id);
@@ -322,6 +609,16 @@ public:
 	void orientFaces(const PolyGroupID &id);
 	void orientFaces();
 
+	/**
+	 * Reorders the faces of the polygroup for the post-transform vertex cache, see vertexCacheTriangleOrder, optionally
+	 * clusters them against overdraw and then, with settings.vertexFetch, orders its vertices by first use. The polygroup
+	 * keeps its buffer ranges; they become dirty in INDEX, and in every vertex buffer too when the vertices are reordered.
+	 * @note reordering vertices drops the grid of polygroups made by addUniformSurface, so adjustToNewSurface resamples them per vertex
+	 */
+	void optimiseVertexCache(const PolyGroupID &id, const MeshOptimisationSettings &settings = {});
+	void optimiseVertexCache(const MeshOptimisationSettings &settings = {});
+	VertexCacheStats vertexCacheStats(const PolyGroupID &id, int cacheSize = 16, VertexCacheModel model = VertexCacheModel::FIFO) const;
+
 	vector<int> findNeighboursSorted(int i, const PolyGroupID &id) const;
 	bool checkIfHasCompleteNeighbourhood(int i, const PolyGroupID &id) const;
 	float meanCurvature(int i, const PolyGroupID &id) const;
@@ -343,10 +640,43 @@ std::function<void(float, float)> deformationOperator(const std::function<void(B
 std::function<void(float)> deformationOperator(const std::function<void(BufferedVertex &, float)> &deformation, IndexedMesh &mesh, const PolyGroupID &id);
 std::function<void(float, float)> moveAlongCurve(const SmoothParametricCurve &curve, IndexedMesh &mesh, const PolyGroupID &id);
 
+
+// built-in kernels of IndexedMesh::deformBulk, the comments name the buffers they write
+namespace vertexKernels {
+	// positions and normals, normals are transformed by M and renormalised like under deformWithAmbientMap
+	VertexKernel affine(const mat3 &M, vec3 v);
+	// positions
+	VertexKernel translation(vec3 v);
+	// positions and normals, the map is evaluated on the whole chunk at once, normals are pushed forward by its differential
+	VertexKernel ambientMap(const SpaceEndomorphism &f);
+	// normals
+	VertexKernel renormaliseNormals();
+	VertexKernel flipNormals();
+	VertexKernel pointNormalsTowards(vec3 dir);
+
+	// colours, f(position, normal, colour) -> new colour
+	template<typename F>
+	VertexKernel colorMap(F f) {
+		return [f](const VertexSpans &vs) {
+			for (int k = 0; k < vs.size(); k++)
+				vs.colors[k] = f(vs.positions[k], vs.normals[k], vs.colors[k]);
+		};
+	}
+
+	// positions, f(position) -> new position
+	template<typename F>
+	VertexKernel positionMap(F f) {
+		return [f](const VertexSpans &vs) {
+			for (vec3 &p: vs.positions)
+				p = f(p);
+		};
+	}
+}
+
 template<typename T>
 T IndexedMesh::integrateOverTriangles(const std::function<T(const IndexedTriangle &)> &f, PolyGroupID id) const {
 	T sum = T(0);
-	for (const IndexedTriangle &t: triangles.at(polygroupIndexOrder.at(id)))
+	for (const IndexedTriangle &t: triangleView(id))
 		sum += f(t) * t.area();
 	return sum;
 }
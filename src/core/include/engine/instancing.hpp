@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "indexedRendering.hpp"
+#include "exceptions.hpp"
+
+
+/**
+ * @brief GL entry points used by instance buffers.
+ *
+ * Kept replaceable so that tests can record uploads and draw parameters without a GL context.
+ */
+struct InstanceCalls {
+	std::function<GLuint()> createBuffer;
+	std::function<void(GLuint buffer, GLsizeiptr bytes, const void *data)> bufferData;
+	std::function<void(GLuint buffer, GLintptr offset, GLsizeiptr bytes, const void *data)> bufferSubData;
+	// enables a vec4 attribute advancing once per instance
+	std::function<void(GLuint buffer, GLuint location, GLsizei stride, GLintptr offset)> instanceAttribute;
+	std::function<void(GLuint location)> disableAttribute;
+	std::function<void(GLsizei indexCount, GLsizei instanceCount)> drawInstanced;
+	std::function<void(GLuint buffer)> deleteBuffer;
+
+	static InstanceCalls gl();
+};
+
+
+/**
+ * Per instance attributes. TRANSFORM is a full model matrix, OFFSET a translation in xyz with a
+ * uniform scale in w; they share the first locations, so a table holds at most one of them.
+ */
+enum InstanceAttribute {
+	INSTANCE_TRANSFORM,
+	INSTANCE_OFFSET,
+	INSTANCE_COLOR,
+	INSTANCE_EXTRA0,
+	INSTANCE_EXTRA1
+};
+constexpr int INSTANCE_ATTRIBUTES = INSTANCE_EXTRA1 + 1;
+
+// shader input locations, following the standard and extra vertex attributes 0-8
+constexpr GLuint instanceAttributeLocation(InstanceAttribute attribute) {
+	switch (attribute) {
+		case INSTANCE_TRANSFORM: case INSTANCE_OFFSET: return 9;
+		case INSTANCE_COLOR: return 13;
+		case INSTANCE_EXTRA0: return 14;
+		default: return 15;
+	}
+}
+
+
+/**
+ * @class InstanceTable
+ * @brief Structure of arrays with the attributes of every instance of a shared mesh.
+ *
+ * Each attribute is a separate contiguous array uploaded to its own buffer. Writes mark the
+ * instance dirty, so a frame changing k instances transfers O(k) bytes and the template mesh
+ * is never touched. Dirty state is kept per generation, see DirtyHistory, so any number of
+ * InstanceBuffers can load the same table.
+ */
+class InstanceTable {
+	vector<mat4> transforms;
+	std::array<vector<vec4>, INSTANCE_ATTRIBUTES> columns;
+	std::array<bool, INSTANCE_ATTRIBUTES> active = {};
+	std::array<DirtyHistory, INSTANCE_ATTRIBUTES> dirty;
+	int n = 0;
+
+	void checkActive(InstanceAttribute attribute) const {
+		THROW_IF(!active[attribute], ValueError, "Instance attribute is not stored in this table");
+	}
+
+public:
+	explicit InstanceTable(const vector<InstanceAttribute> &attributes={INSTANCE_OFFSET, INSTANCE_COLOR}, int size=0);
+
+	int size() const { return n; }
+	bool has(InstanceAttribute attribute) const { return active[attribute]; }
+	// new instances get the identity transform, zero offset with unit scale and white colour
+	void resize(int size);
+
+	void setTransform(int i, const mat4 &transform) {
+		checkActive(INSTANCE_TRANSFORM);
+		transforms[i] = transform;
+		dirty[INSTANCE_TRANSFORM].mark(i);
+	}
+	void setOffset(int i, vec3 position, float scale=1) { set(INSTANCE_OFFSET, i, vec4(position, scale)); }
+	void setColor(int i, vec4 color) { set(INSTANCE_COLOR, i, color); }
+	void set(InstanceAttribute attribute, int i, vec4 value) {
+		checkActive(attribute);
+		columns[attribute][i] = value;
+		dirty[attribute].mark(i);
+	}
+
+	const mat4 &transform(int i) const { return transforms[i]; }
+	vec4 get(InstanceAttribute attribute, int i) const { return columns[attribute][i]; }
+
+	static size_t elementBytes(InstanceAttribute attribute) { return attribute == INSTANCE_TRANSFORM ? sizeof(mat4) : sizeof(vec4); }
+	const void *data(InstanceAttribute attribute) const;
+	// uploadedGeneration belongs to the GPU copy being updated and is advanced, see BufferManager::collectUploads
+	vector<BufferUpload> collectUploads(InstanceAttribute attribute, size_t allocatedBytes, unsigned long &uploadedGeneration);
+};
+
+
+/**
+ * @class InstanceBuffers
+ * @brief GPU copies of an instance table, drawn with a single instanced call.
+ */
+class InstanceBuffers {
+	InstanceCalls calls;
+	std::array<GLuint, INSTANCE_ATTRIBUTES> buffers = {};
+	std::array<size_t, INSTANCE_ATTRIBUTES> allocatedBytes = {};
+	std::array<unsigned long, INSTANCE_ATTRIBUTES> uploadedGenerations = {};
+	BufferUploadLog uploadLog;
+
+public:
+	explicit InstanceBuffers(InstanceCalls calls=InstanceCalls::gl());
+	InstanceBuffers(const InstanceBuffers &other) = delete;
+	InstanceBuffers & operator=(const InstanceBuffers &other) = delete;
+	~InstanceBuffers();
+
+	// transfers what changed in the table since the previous load of these buffers
+	void load(InstanceTable &table);
+	// draws indexCount indices of the bound mesh once per instance of the table
+	void draw(const InstanceTable &table, int indexCount);
+	// draws every face of shape, which has to be the bound mesh
+	void draw(const InstanceTable &table, const IndexedMesh &shape);
+
+	const BufferUploadLog &uploadStatistics() const { return uploadLog; }
+	void resetUploadStatistics() { uploadLog.reset(); }
+};
+
+
+/**
+ * @class InstancedMesh
+ * @brief One template mesh drawn at every row of an instance table.
+ */
+class InstancedMesh {
+	shared_ptr<IndexedMesh> shape;
+	InstanceTable table;
+
+public:
+	InstancedMesh(const shared_ptr<IndexedMesh> &shape, InstanceTable table) : shape(shape), table(std::move(table)) {}
+	InstancedMesh(IndexedMesh &&shape, InstanceTable table) : InstancedMesh(make_shared<IndexedMesh>(std::move(shape)), std::move(table)) {}
+
+	shared_ptr<IndexedMesh> getShape() const { return shape; }
+	InstanceTable &instances() { return table; }
+	const InstanceTable &instances() const { return table; }
+	int instanceCount() const { return table.size(); }
+};
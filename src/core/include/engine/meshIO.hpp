@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "mat.hpp"
+#include "filesUtils.hpp"
+
+
+/**
+ * @struct OBJData
+ * @brief Triangulated contents of an OBJ file, with every distinct v/vt/vn corner turned into one vertex.
+ *
+ * Vertex i is OBJ position i (0-based) with the attributes of the first corner referencing it, corners
+ * combining the same position with other attributes are appended after all positions. Attributes missing
+ * in the file are zero, normals are computed as area weighted face normals when the file has none.
+ */
+struct OBJData {
+	vector<vec3> positions;
+	vector<vec3> normals;
+	vector<vec2> uvs;
+	vector<ivec3> faces;
+	bool hasNormals = false;
+	bool hasUVs = false;
+};
+
+
+/**
+ * @brief Parses OBJ text in parallel chunks split at line boundaries.
+ *
+ * Reads v, vt, vn and f lines (v, v/vt, v//vn and v/vt/vn corners, negative indices relative to
+ * the preceding elements), everything else is skipped. Polygons with more than three corners
+ * are triangulated as fans around their first corner. The result does not depend on the thread count.
+ * @param threads chunks parsed at once, as in resolveThreadCount
+ * @throws ValueError on malformed numbers, faces with less than three corners and indices out of range
+ */
+OBJData parseOBJ(std::string_view text, int threads = 0);
+
+// maps the file into memory and parses it with parseOBJ
+OBJData readOBJ(const Path &path, int threads = 0);
+
+
+
+/**
+ * @brief Header of binary mesh cache files written by IndexedMesh::saveBinaryCache.
+ *
+ * Layout: header, polygroup table (tableBytes), then raw contents of every buffer whose bit
+ * (1 << CommonBufferType) is set in buffers, in the order of CommonBufferType, each starting at
+ * a multiple of MESH_CACHE_ALIGNMENT. Buffers hold native (little endian) floats and indices, so
+ * a mapped file is copied straight into the buffers. Polygroup table entries are
+ * (int32 id kind: 0 int / 1 string, int32 id or string length, string bytes,
+ * uint32 vertex runs, uint32 face runs, (uint32 begin, uint32 length) per run),
+ * followed by the number of extra buffer names and the names as (uint32 length, bytes).
+ */
+struct MeshCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t buffers;
+	uint32_t polygroups;
+	uint64_t vertices;
+	uint64_t faces;
+	uint64_t tableBytes;
+};
+
+constexpr char MESH_CACHE_MAGIC[4] = {'S', 'E', 'M', 'C'};
+constexpr uint32_t MESH_CACHE_VERSION = 1;
+constexpr size_t MESH_CACHE_ALIGNMENT = 16;
@@ -115,8 +115,8 @@ public:
 
 
 class SDFRenderingStep : public RenderingStep {
-	GLuint paramsUniformLoc = 0;
-	GLuint materialUniformLoc = 0;
+	UniformHandle<vec3> paramsUniform;
+	UniformHandle<vec4> materialUniform;
 
 	int paramsSize;
 	int materialSize = 0;
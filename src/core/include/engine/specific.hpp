@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "indexedRendering.hpp"
+#include "instancing.hpp"
 #include "renderingUtils.hpp"
 
 
@@ -151,6 +152,12 @@ IndexedMesh arrow(vec3 start, vec3 head, float radius, float head_len, float hea
 IndexedMesh drawArrows(const vector<vec3> &points, const vector<vec3> &directions, float radius, float head_len, float head_radius, int radial, int straight, float eps, const std::variant<int, std::string> &id);
 IndexedMesh drawVectorFieldArrows(const VectorField &field, const vector<vec3> &points, const HOM(float, float)& len, const HOM(float, float) &radius, const HOM(float, float) &head_len, const HOM(float, float)& head_radius, int radial, int straight, float eps, const std::variant<int, std::string> &id);
 
+// maps the unit arrow along the z axis to an arrow from start in the given direction
+mat4 arrowTransform(vec3 start, vec3 direction, float length, float radius);
+// one arrow of unit length and shaft radius shared by all points, head_len and head_radius are relative to them
+InstancedMesh instancedVectorFieldArrows(const VectorField &field, const vector<vec3> &points, const HOM(float, float)& len, const HOM(float, float) &radius, float head_len, float head_radius, int radial, int straight, float eps);
+void updateVectorFieldArrows(InstanceTable &arrows, const VectorField &field, const vector<vec3> &points, const HOM(float, float)& len, const HOM(float, float) &radius);
+
 
 /**
  * \brief  Steady flows
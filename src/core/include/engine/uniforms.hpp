@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "renderingUtils.hpp"
+#include "exceptions.hpp"
+
+
+/**
+ * @brief GL entry points used by uniform storages.
+ *
+ * Kept replaceable so that tests can count or record the uploads without a GL context.
+ */
+struct UniformCalls {
+	std::function<void(GLint location, GLSLType type, int count, const void *data)> uniform;
+	std::function<GLuint(GLsizeiptr bytes, GLuint binding, const void *data)> createBuffer;
+	std::function<void(GLuint buffer, GLintptr offset, GLsizeiptr bytes, const void *data)> bufferSubData;
+	std::function<void(GLuint buffer)> deleteBuffer;
+
+	static UniformCalls gl();
+};
+
+
+template<typename T> constexpr GLSLType glslTypeOf();
+template<> constexpr GLSLType glslTypeOf<float>() { return FLOAT; }
+template<> constexpr GLSLType glslTypeOf<int>() { return INT; }
+template<> constexpr GLSLType glslTypeOf<vec2>() { return VEC2; }
+template<> constexpr GLSLType glslTypeOf<vec3>() { return VEC3; }
+template<> constexpr GLSLType glslTypeOf<vec4>() { return VEC4; }
+template<> constexpr GLSLType glslTypeOf<mat2>() { return MAT2; }
+template<> constexpr GLSLType glslTypeOf<mat3>() { return MAT3; }
+template<> constexpr GLSLType glslTypeOf<mat4>() { return MAT4; }
+
+
+/**
+ * @class UniformStorage
+ * @brief CPU side copy of uniform values with change detection.
+ *
+ * Values are written into slots, a write equal to the staged value is dropped and flush uploads only
+ * the slots that changed since the previous flush. Slots are laid out by the concrete storage
+ * (tightly packed for plain uniforms, std140 for uniform buffers).
+ */
+class UniformStorage {
+protected:
+	struct Slot {
+		std::string name;
+		GLint location;
+		GLSLType type;
+		int count;
+		int offset;
+		int elementStride;
+		int bytes;
+		int columns, columnBytes, columnStride;
+		bool written, dirty;
+	};
+	std::vector<Slot> slots;
+	std::vector<std::byte> data;
+	std::vector<int> dirtySlots;
+	UniformCalls calls;
+
+	int addSlot(const std::string &name, GLint location, GLSLType type, int count, bool std140);
+
+public:
+	explicit UniformStorage(UniformCalls calls);
+	virtual ~UniformStorage() = default;
+
+	// values of up to count elements of the slot type, laid out as glm stores them; returns whether anything changed
+	bool write(int slot, const void *values, int elements=1);
+	virtual void flush() = 0;
+
+	int find(const std::string &name) const;
+	GLSLType type(int slot) const { return slots[slot].type; }
+	int count(int slot) const { return slots[slot].count; }
+	bool pending() const { return !dirtySlots.empty(); }
+};
+
+
+/**
+ * @class UniformHandle
+ * @brief Pre-resolved typed reference to a uniform, written without any lookup.
+ *
+ * The type is checked once when the handle is created. Writes are staged in the storage and reach GL
+ * on its next flush (ShaderProgram::flushUniforms, done by RenderingStep::setUniforms each frame).
+ */
+template<typename T>
+class UniformHandle {
+	UniformStorage *storage = nullptr;
+	int slot = -1;
+public:
+	UniformHandle() = default;
+	UniformHandle(UniformStorage *storage, int slot) : storage(storage), slot(slot) {
+		THROW_IF(storage->type(slot) != glslTypeOf<T>(), IllegalArgumentError, "Uniform handle type differs from the declared uniform type");
+	}
+
+	void set(const T &value) const { storage->write(slot, &value); }
+	void set(const T *values, int n) const { storage->write(slot, values, n); }
+	bool valid() const { return storage != nullptr; }
+};
+
+
+/**
+ * @class UniformShadowBlock
+ * @brief Uniforms of one program, flushed with glUniform*v calls.
+ *
+ * The staged values have to mirror the state of the GL program, so copies of a ShaderProgram share
+ * the block of their programID (see ofProgram) and every write is compared with what the last step
+ * drawing with the program uploaded.
+ */
+class UniformShadowBlock : public UniformStorage {
+	static std::unordered_map<GLuint, std::weak_ptr<UniformShadowBlock>> programBlocks;
+public:
+	explicit UniformShadowBlock(UniformCalls calls=UniformCalls::gl()) : UniformStorage(std::move(calls)) {}
+	// a name added again returns its slot, so every user of the program can declare the uniforms it writes
+	int add(const std::string &name, GLint location, GLSLType type, int count=1);
+	void flush() override;
+
+	// block of a linked program, created with the given calls when no live block belongs to it
+	static std::shared_ptr<UniformShadowBlock> ofProgram(GLuint programID, UniformCalls calls=UniformCalls::gl());
+};
+
+
+/**
+ * @class UniformBufferBlock
+ * @brief Group of parameters stored in a uniform buffer object with std140 layout.
+ *
+ * Members are declared in the order of the GLSL block. The buffer is created on the first flush,
+ * later flushes upload one contiguous range covering the changed members.
+ */
+class UniformBufferBlock : public UniformStorage {
+	GLuint buffer = 0;
+	GLuint binding = 0;
+public:
+	explicit UniformBufferBlock(UniformCalls calls=UniformCalls::gl()) : UniformStorage(std::move(calls)) {}
+	UniformBufferBlock(const UniformBufferBlock &other) = delete;
+	UniformBufferBlock & operator=(const UniformBufferBlock &other) = delete;
+	~UniformBufferBlock() override;
+
+	int add(const std::string &member, GLSLType type, int count=1);
+	template<typename T>
+	UniformHandle<T> handle(const std::string &member) {
+		int slot = find(member);
+		THROW_IF(slot < 0, IllegalArgumentError, "No member " + member + " in the uniform buffer block");
+		return UniformHandle<T>(this, slot);
+	}
+	int bytes() const { return (data.size() + 15)/16*16; }
+	int offset(const std::string &member) const { return slots[find(member)].offset; }
+
+	// binds the block of the given name in a linked program to the binding point of this buffer, before the first flush
+	void attach(GLuint programID, const std::string &blockName, GLuint bindingPoint);
+	void flush() override;
+};
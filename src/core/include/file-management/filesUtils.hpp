@@ -112,6 +112,35 @@ public:
 };
 
 
+/**
+ * @class ReadOnlyFileMapping
+ * @brief Whole file mapped for reading only, released with the object.
+ *
+ * Meant for parsers working on the bytes in place. Unlike FileDescriptor::mapFile it asks for no write access,
+ * so read-only files can be mapped too. An empty file has no mapping and a null address.
+ */
+class ReadOnlyFileMapping {
+	const char *address = nullptr;
+	size_t bytesize = 0;
+	void *fileHandle = nullptr;
+	void *mappingHandle = nullptr;
+
+	void release();
+
+public:
+	explicit ReadOnlyFileMapping(const Path &path);
+	~ReadOnlyFileMapping();
+	ReadOnlyFileMapping(const ReadOnlyFileMapping &other) = delete;
+	ReadOnlyFileMapping &operator=(const ReadOnlyFileMapping &other) = delete;
+	ReadOnlyFileMapping(ReadOnlyFileMapping &&other) noexcept;
+	ReadOnlyFileMapping &operator=(ReadOnlyFileMapping &&other) noexcept;
+
+	const char *data() const { return address; }
+	size_t size() const { return bytesize; }
+	std::string_view view() const { return {address, bytesize}; }
+};
+
+
 bool isValidFilename(const string &filename);
 bool isValidFilenameCharacter(char c);
 
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include "mat.hpp"
+
+
+struct MarchingCubesMesh {
+	vector<vec3> positions;
+	vector<ivec3> triangles;
+};
+
+
+/**
+ * @brief Extracts the level set {f = level} of a scalar field sampled on a regular grid over a box.
+ *
+ * The field is evaluated exactly once per grid node (res + 1 nodes along every axis), vertices are
+ * placed on cube edges by linear interpolation of the sampled values and shared between cubes through
+ * integer edge ids, so the output is an indexed, watertight mesh inside the box. Triangles are wound
+ * counterclockwise when seen from the side where f > level.
+ * Sampling and extraction run over z-slabs as parallel jobs, the output is identical for any thread count.
+ * @param threads z-slabs processed at once, as in resolveThreadCount
+ * @note Case table is built at compile time, face ambiguities are resolved by separating the corners
+ * with f > level, which is consistent between neighbouring cubes.
+ */
+MarchingCubesMesh marchingCubes(const HOM(vec3, float) &field, vec3 cornerLow, vec3 cornerHigh, ivec3 res, float level = 0, int threads = 0);
+
+// number of triangles the case table emits for a cube with given corner bit mask (corner c = x + 2y + 4z)
+int marchingCubesCaseTriangles(int cubeCase);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "mat.hpp"
+
+
+/**
+ * @class MeshAdjacency
+ * @brief Vertex-face, vertex-vertex and edge-opposite vertex incidence of a triangle list in CSR form.
+ *
+ * Every relation is stored as an offset array and one flat array of ids, so a query returns a view
+ * into contiguous memory in O(1) and iterating it costs O(degree). Neighbour lists are sorted,
+ * opposite vertices of an edge are stored per directed neighbour slot, i.e. for edge (i, j)
+ * they are the third vertices of faces containing both i and j (two for interior edges of a manifold).
+ * The structure is immutable, it has to be rebuilt when the faces change.
+ */
+class MeshAdjacency {
+	int n_vertices = 0;
+	vector<int> face_offsets, face_ids;
+	vector<int> neighbour_offsets, neighbour_ids;
+	vector<int> opposite_offsets, opposite_ids;
+
+	int neighbourSlot(int i, int j) const;
+
+public:
+	MeshAdjacency() = default;
+	// face indices are shifted by -shift, all of them have to land in [0, vertexCount)
+	MeshAdjacency(const vector<ivec3> &faces, int vertexCount, int shift = 0);
+
+	int vertexCount() const { return n_vertices; }
+	int faceCount() const { return face_ids.size() / 3; }
+
+	std::span<const int> vertexFaces(int i) const { return {face_ids.data() + face_offsets[i], face_ids.data() + face_offsets[i+1]}; }
+	std::span<const int> vertexNeighbours(int i) const { return {neighbour_ids.data() + neighbour_offsets[i], neighbour_ids.data() + neighbour_offsets[i+1]}; }
+	std::span<const int> edgeOpposites(int i, int j) const;
+
+	int valence(int i) const { return neighbour_offsets[i+1] - neighbour_offsets[i]; }
+	bool isEdge(int i, int j) const { return neighbourSlot(i, j) >= 0; }
+	// every edge at i is shared by at least two faces, i.e. i does not lie on a boundary
+	bool hasCompleteNeighbourhood(int i) const;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "mat.hpp"
+
+
+enum class VertexCacheModel { FIFO, LRU };
+
+struct VertexCacheStats {
+	int triangles = 0;
+	int vertices = 0;	// referenced by at least one triangle
+	int transforms = 0;	// cache misses, i.e. vertex shader invocations
+	float acmr = 0;		// transforms per triangle, 3 without any reuse and around .5 at best on regular meshes
+	float atvr = 0;		// transforms per referenced vertex, 1 at best
+};
+
+/**
+ * @brief Replays a triangle list through a post-transform vertex cache holding cacheSize vertices.
+ * @note FIFO is the model of most hardware, whose caches do not reorder on hits, LRU is the model the optimisers below assume.
+ */
+VertexCacheStats simulateVertexCache(std::span<const ivec3> faces, int vertexCount, int cacheSize = 16, VertexCacheModel model = VertexCacheModel::FIFO);
+
+/**
+ * @brief Greedy triangle order for vertex cache locality after Forsyth's linear-speed optimisation.
+ *
+ * Vertices are scored by their position in a simulated LRU cache of cacheSize entries and by the number of triangles
+ * still waiting for them, triangles by the sum of their vertex scores. Each step emits the best triangle touching the cache,
+ * so only the scores of cached vertices and their triangles change, and the whole order costs O(faces * cacheSize).
+ * @return order[k] is the index of the k-th triangle to draw
+ */
+vector<int> vertexCacheTriangleOrder(std::span<const ivec3> faces, int vertexCount, int cacheSize = 32);
+
+/**
+ * @brief Clusters a cache optimised triangle order and sorts the clusters against overdraw, after Sander, Nehab and Barczak.
+ *
+ * Regions end where the order restarts the cache and are split into clusters where the ACMR of the cluster so far, replayed
+ * from an empty cache, falls to threshold times the ACMR the order has over the region, so the cache efficiency lost on the
+ * new boundaries stays around threshold.
+ * Clusters are then drawn by decreasing dot(centroid - mesh centroid, normal), outward facing clusters first,
+ * which makes them occlude the rest of a convex-ish mesh from most directions.
+ */
+vector<int> overdrawTriangleOrder(std::span<const ivec3> faces, std::span<const vec3> positions, std::span<const int> order, float threshold = 1.05f, int cacheSize = 16);
+
+// vertices in order of their first use by the faces, order[new] = old, unreferenced ones follow in their original order
+vector<int> vertexFetchOrder(std::span<const ivec3> faces, int vertexCount);
+
+
+struct MeshOptimisationSettings {
+	int cacheSize = 32;				// of the LRU model the triangle order is optimised for
+	bool overdraw = false;
+	float overdrawThreshold = 1.05f;	// see overdrawTriangleOrder
+	bool vertexFetch = true;
+};
@@ -2,18 +2,45 @@
 #include "pde.hpp"
 
 
+/**
+ * @brief Numerical method of the heat equation solvers on a sampled line.
+ *
+ * GREEN_QUADRATURE integrates against the heat kernel separately for every output sample, O(t_res N^2).
+ * SPECTRAL multiplies the FFT of the data, zero padded to at least twice its length so that the periodic images
+ * stay apart, by the exact propagator exp(-k w^2 t) per mode, O(t_res N log N). Sources are integrated exactly
+ * in time assuming they are linear between time slices.
+ * CRANK_NICOLSON is the unconditionally stable implicit scheme on the bounded domain, with boundary values
+ * fixed to those of u0, solved by the Thomas algorithm in O(N) per step.
+ */
+enum class HeatSolverBackend {
+	GREEN_QUADRATURE,
+	SPECTRAL,
+	CRANK_NICOLSON
+};
+
+
 class HeatRealLineHomoDiscrete{
 protected:
 	DiscreteRealFunction u0;
 	float k, t_max;
 	int t_res;
+	HeatSolverBackend backend;
+	int cn_substeps = 1;
 	DiscreteRealFunction green(float t, float x) const;
+
+	// source given as slices at the output times, nullptr for the homogeneous equation
+	DiscreteRealFunctionR2 spectralSolution(const DiscreteRealFunctionR2 *source) const;
+	DiscreteRealFunctionR2 crankNicolsonSolution(const DiscreteRealFunctionR2 *source) const;
 public:
-	HeatRealLineHomoDiscrete (DiscreteRealFunction u0, float k, float t_max, int t_res) : u0(std::move(u0)), k(k), t_max(t_max), t_res(t_res) {}
+	HeatRealLineHomoDiscrete (DiscreteRealFunction u0, float k, float t_max, int t_res, HeatSolverBackend backend=HeatSolverBackend::GREEN_QUADRATURE)
+	: u0(std::move(u0)), k(k), t_max(t_max), t_res(t_res), backend(backend) {}
 	virtual DiscreteRealFunctionR2 solution() const;
 	virtual ~HeatRealLineHomoDiscrete() = default;
 
 	float t_step() const {return t_max/t_res;}
+	void setBackend(HeatSolverBackend backend) { this->backend = backend; }
+	// Crank-Nicolson steps between consecutive time slices, more steps damp the oscillation of rough initial data
+	void setCrankNicolsonSubsteps(int substeps) { cn_substeps = std::max(1, substeps); }
 };
 
 
@@ -22,7 +49,9 @@ class HeatRealLineDiscreteNotHomo : public HeatRealLineHomoDiscrete {
 	DiscreteRealFunctionR2 green2(float t, float x) const;
 
 public:
-	HeatRealLineDiscreteNotHomo (DiscreteRealFunctionR2 f_free, DiscreteRealFunction u0, float k, float t_max, int t_res) : HeatRealLineHomoDiscrete(std::move(u0), k, t_max, t_res), f_free(std::move(f_free)) {}
+	// f_free holds the source at the t_res output times, on the sampling of u0
+	HeatRealLineDiscreteNotHomo (DiscreteRealFunctionR2 f_free, DiscreteRealFunction u0, float k, float t_max, int t_res, HeatSolverBackend backend=HeatSolverBackend::GREEN_QUADRATURE)
+	: HeatRealLineHomoDiscrete(std::move(u0), k, t_max, t_res, backend), f_free(std::move(f_free)) {}
 	DiscreteRealFunctionR2 solution() const override;
 
 };
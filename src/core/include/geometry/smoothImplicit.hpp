@@ -21,10 +21,16 @@ public:
 	explicit SmoothImplicitSurface(Foo1111 F, float epsilon=0.01) : _F(RealFunctionR3(std::move(F), epsilon)) {}
 	SmoothImplicitSurface(Foo31 F, Foo33 dF, float epsilon=0.01) : _F(RealFunctionR3(std::move(F), std::move(dF), epsilon)) {}
 	SmoothImplicitSurface(Foo1111 F, Foo1113 dF, float epsilon=0.01) : _F(RealFunctionR3(std::move(F), std::move(dF), epsilon)) {}
+	// level set of a callable generic in the scalar type, with exact gradient and Hessian (see RealFunctionR3::autodiff)
+	template<typename F>
+	static SmoothImplicitSurface autodiff(const F &f) { return SmoothImplicitSurface(RealFunctionR3::autodiff(f)); }
 
     float operator()(vec3 p) const { return _F(p); }
 	vec3 normal(vec3 p) const { return normalise(_F.df(p)); }
 	vec3 newtonStepProject(vec3 p, float tolerance, int maxIter) const;
+	// curvatures of the level set through p, with respect to the normal along the gradient of F
+	float meanCurvature(vec3 p) const;
+	float gaussianCurvature(vec3 p) const;
 	void projectPoints(IndexedMesh &mesh, float tolerance, int maxIter);
 	RealFunctionR3 getF() const {return _F;}
 
@@ -218,11 +224,14 @@ class MarchingCubeChunk {
 	vec3 cornerLow, cornerHigh;
 	ivec3 res;
 	vector<ivec3> vertices = {};
-	std::map<std::string, int> addedVertices = {};
+	vector<vec3> interpolatedVertices = {};
+	std::unordered_map<long long, int> addedVertices = {};
 	vector<ivec3> triangles = {};
 	std::shared_ptr<SmoothImplicitSurface> surface;
 	vec3 vertexStep;
 
+	long long vertexKey(ivec3 v) const { return (1LL*v.z*(4*res.y + 1) + v.y)*(4*res.x + 1) + v.x; }
+
 	vector<PrimitiveCubeConfiguration> configurations(ivec3 cube) const;
 	vector<CubeCorner> differingCorners(ivec3 cube) const;
 	bool cornerSign(ivec3 cube, CubeCorner corner) const;
@@ -243,6 +252,7 @@ public:
 	static ivec3 edgeCenterVertex(ivec3 cube, CubeCorner corner1, CubeCorner corner2);
 	PolyGroupID getID() const { return id; }
 
+	// interpolating marching cubes over the whole chunk, see marchingCubes
 	void generate();
 	void generateCube(ivec3 ind);
 	bool vertexAlreadyAdded(ivec3 vertex) const;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "complexGeo.hpp"
+#include "dual.hpp"
 
 
 class AffinePlane;
@@ -36,6 +37,18 @@ public:
     SmoothParametricCurve &operator=(const SmoothParametricCurve &other);
     SmoothParametricCurve &operator=(SmoothParametricCurve &&other) noexcept;
 
+	/**
+	 * @brief Curve with exact first and second derivatives from a callable generic in the scalar type,
+	 * e.g. [](auto t) { return tvec3<decltype(t)>(cos(t), sin(t), t); }.
+	 */
+	template<typename F>
+	static SmoothParametricCurve autodiff(const F &f, PolyGroupID id=DFLT_CURV, float t0=0, float t1=TAU, bool periodic=true) {
+		return SmoothParametricCurve([f](float t) { return vec3(f(t)); },
+									 [f](float t) { return partialOf(f(Dual<float>::variable(t, 0)), 0); },
+									 [f](float t) { return secondPartialOf(f(HyperDual<float>::variable(t, 0)), 0, 0); },
+									 id, t0, t1, periodic);
+	}
+
 
 
     PolyGroupID getID() const { return id; }
@@ -109,11 +122,18 @@ public:
 
 
 
+// value and partial derivatives up to second order of a parametric surface at a point
+struct SurfaceJet {
+	vec3 f, df_t, df_u, d2f_tt, d2f_tu, d2f_uu;
+};
+
+
 // R2 -> R3
 class SmoothParametricSurface {
   Foo113 _f;
   Foo113 _df_t;
   Foo113 _df_u;
+  std::function<SurfaceJet(float, float)> _jet; // exact derivatives of surfaces built by autodiff, empty otherwise
   float t0, t1, u0, u1;
   bool t_periodic, u_periodic;
   float epsilon;
@@ -128,6 +148,27 @@ public:
   SmoothParametricSurface(const std::function<SmoothParametricCurve(float)>& pencil, vec2 t_range, vec2 u_range, bool t_periodic=false, bool u_periodic=false, float eps=.01);
   SmoothParametricSurface(RealFunctionR2 plot, vec2 t_range, vec2 u_range);
 
+	/**
+	 * @brief Surface with exact derivatives up to second order from a callable generic in the scalar type,
+	 * e.g. [](auto t, auto u) { return tvec3<decltype(t)>(cos(t)*cos(u), sin(t)*cos(u), sin(u)); }.
+	 * Curvatures then need a single evaluation of f on hyper-dual numbers. Sums, compositions and other
+	 * derived surfaces fall back to finite differences.
+	 */
+	template<typename F>
+	static SmoothParametricSurface autodiff(const F &f, vec2 t_range, vec2 u_range, bool t_periodic=false, bool u_periodic=false) {
+		using D = Dual<float>;
+		SmoothParametricSurface S([f](float t, float u) { return vec3(f(t, u)); },
+								  [f](float t, float u) { return partialOf(f(D::variable(t, 0), D(u)), 0); },
+								  [f](float t, float u) { return partialOf(f(D(t), D::variable(u, 0)), 0); },
+								  t_range, u_range, t_periodic, u_periodic);
+		S._jet = [f](float t, float u) {
+			using HD = HyperDual<float, 2>;
+			auto x = f(HD::variable(t, 0), HD::variable(u, 1));
+			return SurfaceJet{valueOf(x), partialOf(x, 0), partialOf(x, 1), secondPartialOf(x, 0, 0), secondPartialOf(x, 0, 1), secondPartialOf(x, 1, 1)};
+		};
+		return S;
+	}
+
   vec3 operator()(float t, float s) const;
   vec3 operator()(vec2 tu) const;
   vec3 parametersNormalised(vec2 tu) const { return operator()(t0 + tu.x*(t1-t0), u0 + tu.y*(u1-u0)); }
@@ -184,8 +225,12 @@ public:
 	mat2x3 tangentSpacePrincipalBasis(float t, float s) const;
 
 
+	// value and derivatives at one point, exact for autodiff surfaces and by central differences otherwise
+	SurfaceJet jet(float t, float s) const;
 	mat2 firstFundamentalForm(float t, float s) const;
 	mat2 secondFundamentalForm(float t, float s) const;
+	// both fundamental forms from a single jet
+	std::pair<mat2, mat2> fundamentalForms(float t, float s) const;
 	float _E(float t, float u) const;
 	float _F(float t, float u) const;
 	float _G(float t, float u) const;
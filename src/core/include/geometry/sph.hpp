@@ -1,15 +1,41 @@
 #pragma once
 #include "smoothImplicit.hpp"
+#include "uniformGrid.hpp"
+#include "sphKernels.hpp"
 #include "../engine/specific.hpp"
+#include "../utils/parallel.hpp"
 
+#include <map>
+#include <variant>
+
+using StaticSmoothingKernel = std::variant<std::monostate, sph::Poly6, sph::Spiky, sph::Viscosity, sph::CubicSpline, sph::WendlandC2, sph::WendlandC4>;
+
+
+/**
+ * @class SmoothingKernel
+ * @brief Type-erased radial smoothing kernel, W(p) and grad W(p) for offsets of length at most d.
+ *
+ * Built from one of the sph:: kernels it keeps that kernel, and FluidParticleSystem runs its loops on
+ * the static type; built from functions it goes through std::function on every evaluation.
+ */
 class SmoothingKernel {
 	float d;
 	BIHOM(vec3, float, float) F;
 	BIHOM(vec3, float, vec3) DF;
+	StaticSmoothingKernel kernel;
+
 public:
 	SmoothingKernel(float radius_of_influence, BIHOM(vec3, float, float) F, BIHOM(vec3, float, vec3) DF);
+	template<typename K> requires std::is_constructible_v<StaticSmoothingKernel, K>
+	explicit SmoothingKernel(K k)
+	: d(k.h),
+	  F([k](vec3 p, float) { float r2 = dot(p, p); return r2 < k.h2 ? k.W(r2) : 0.f; }),
+	  DF([k](vec3 p, float) { float r2 = dot(p, p); return r2 < k.h2 ? k.grad(p, r2) : vec3(0); }),
+	  kernel(k) {}
 	virtual ~SmoothingKernel() = default;
 	float radius_of_influence() const { return d; }
+	// std::monostate for kernels given by functions
+	const StaticSmoothingKernel &static_kernel() const { return kernel; }
 
 	virtual float operator()(vec3 p) const { return F(p, d); }
 	virtual vec3 grad(vec3 p) const { return DF(p, d); }
@@ -18,7 +44,32 @@ public:
 
 class Poly6Kernel : public SmoothingKernel {
 public:
-	explicit Poly6Kernel(float radius_of_influence);
+	explicit Poly6Kernel(float radius_of_influence) : SmoothingKernel(sph::Poly6(radius_of_influence)) {}
+};
+
+class SpikyKernel : public SmoothingKernel {
+public:
+	explicit SpikyKernel(float radius_of_influence) : SmoothingKernel(sph::Spiky(radius_of_influence)) {}
+};
+
+class ViscosityKernel : public SmoothingKernel {
+public:
+	explicit ViscosityKernel(float radius_of_influence) : SmoothingKernel(sph::Viscosity(radius_of_influence)) {}
+};
+
+class CubicSplineKernel : public SmoothingKernel {
+public:
+	explicit CubicSplineKernel(float radius_of_influence) : SmoothingKernel(sph::CubicSpline(radius_of_influence)) {}
+};
+
+class WendlandC2Kernel : public SmoothingKernel {
+public:
+	explicit WendlandC2Kernel(float radius_of_influence) : SmoothingKernel(sph::WendlandC2(radius_of_influence)) {}
+};
+
+class WendlandC4Kernel : public SmoothingKernel {
+public:
+	explicit WendlandC4Kernel(float radius_of_influence) : SmoothingKernel(sph::WendlandC4(radius_of_influence)) {}
 };
 
 
@@ -45,6 +96,7 @@ public:
 	vec3 f() const { return forces; }
 
 	float get_attribute(int i) const { return attributes[i]; }
+	int attribute_count() const { return attributes.size(); }
 	float m() const { return mass; }
 	float rho() const { return density.value_or(0.0f); }
 	float p() const { return pressure.value_or(0.0f); }
@@ -63,6 +115,108 @@ public:
 };
 
 
+/**
+ * @class FluidParticleStorage
+ * @brief Particles of a FluidParticleSystem as a structure of arrays.
+ *
+ * Every quantity is a contiguous array indexed by slot. The system permutes the slots into the cell order
+ * of its neighbour grid after each step, so neighbours are close in memory; the index a particle had
+ * at construction (its id) stays valid through slotOf and idOf. Attributes of FluidParticle are kept
+ * as float arrays, channel<T>(name) adds typed per-particle arrays permuted together with the rest.
+ */
+class FluidParticleStorage {
+	struct ChannelBase {
+		virtual ~ChannelBase() = default;
+		virtual void resize(int n) = 0;
+		virtual void permute(const vector<int> &order) = 0;
+		virtual unique_ptr<ChannelBase> clone() const = 0;
+	};
+
+	template<typename T>
+	struct Channel : ChannelBase {
+		vector<T> values;
+		void resize(int n) override { values.resize(n); }
+		void permute(const vector<int> &order) override {
+			vector<T> permuted(order.size());
+			for (int k = 0; k < order.size(); ++k)
+				permuted[k] = values[order[k]];
+			values = std::move(permuted);
+		}
+		unique_ptr<ChannelBase> clone() const override { return std::make_unique<Channel>(*this); }
+	};
+
+	std::map<string, unique_ptr<ChannelBase>> channels;
+	vector<int> ids, slots;
+
+public:
+	vector<vec3> position, velocity, acceleration, force;
+	vector<float> mass, viscosity, density, pressure;
+	vector<vector<float>> attributes; // attributes[a][slot]
+
+	FluidParticleStorage() = default;
+	explicit FluidParticleStorage(const vector<FluidParticle> &particles);
+	FluidParticleStorage(const FluidParticleStorage &other);
+	FluidParticleStorage(FluidParticleStorage &&other) noexcept = default;
+	FluidParticleStorage &operator=(const FluidParticleStorage &other);
+	FluidParticleStorage &operator=(FluidParticleStorage &&other) noexcept = default;
+
+	int size() const { return position.size(); }
+	void append(const FluidParticle &particle);
+	FluidParticle particle(int slot) const;
+
+	int slotOf(int id) const { return slots[id]; }
+	int idOf(int slot) const { return ids[slot]; }
+
+	template<typename T>
+	vector<T> &channel(const string &name) {
+		auto &c = channels[name];
+		if (!c) {
+			c = std::make_unique<Channel<T>>();
+			c->resize(size());
+		}
+		auto typed = dynamic_cast<Channel<T> *>(c.get());
+		THROW_IF(typed == nullptr, IllegalArgumentError, "Particle channel " + name + " has another type");
+		return typed->values;
+	}
+
+	// slot k receives the particle from slot order[k]
+	void permute(const vector<int> &order);
+};
+
+
+// view of one particle in a FluidParticleStorage with the accessors of FluidParticle
+class FluidParticleRef {
+	FluidParticleStorage *storage;
+	int slot;
+
+public:
+	FluidParticleRef(FluidParticleStorage *storage, int slot) : storage(storage), slot(slot) {}
+	operator FluidParticle() const { return storage->particle(slot); }
+
+	vec3 pos() const { return storage->position[slot]; }
+	vec3 v() const { return storage->velocity[slot]; }
+	vec3 a() const { return storage->acceleration[slot]; }
+	vec3 f() const { return storage->force[slot]; }
+
+	float get_attribute(int i) const { return storage->attributes[i][slot]; }
+	float m() const { return storage->mass[slot]; }
+	float rho() const { return storage->density[slot]; }
+	float p() const { return storage->pressure[slot]; }
+	float mu() const { return storage->viscosity[slot]; }
+
+	void set_forces(vec3 f) const { storage->force[slot] = f; }
+	void add_force(vec3 f) const { storage->force[slot] += f; }
+	void set_density(float rho) const { storage->density[slot] = rho; }
+	void set_pressure(float p) const { storage->pressure[slot] = p; }
+	void set_attribute(int i, float value) const { storage->attributes[i][slot] = value; }
+	void set_velocity(vec3 v) const { storage->velocity[slot] = v; }
+	void set_position(vec3 p) const { storage->position[slot] = p; }
+	void set_acceleration(vec3 a) const { storage->acceleration[slot] = a; }
+
+	void update(float dt) const;
+};
+
+
 struct SPH_SETTINGS {;
 	float rest_density;
 	float stiffness;
@@ -71,8 +225,16 @@ struct SPH_SETTINGS {;
 };
 
 
+/**
+ * @class FluidParticleSystem
+ * @brief SPH fluid stepped in parallel over a structure of arrays kept in neighbour grid order.
+ *
+ * Every phase computes each particle from its neighbours (gather), so workers write disjoint slots and
+ * the result does not depend on the number of threads. Particles are addressed by the index they had
+ * in the vector passed to the constructor.
+ */
 class FluidParticleSystem {
-	vector<FluidParticle> particles;
+	FluidParticleStorage particles;
 	HOM(vec3, vec3) gravity_field;
 	ImplicitVolume bounding_volume;
 	vec3 bound_min, bound_max;
@@ -82,17 +244,23 @@ class FluidParticleSystem {
 	int no_particles;
 	SPH_SETTINGS params;
 
-	vector<FluidParticle> fluid_particles;
-	std::map<string, std::set<int>> particle_chunks;
+	UniformGridIndex neighbour_grid;
+	shared_ptr<WorkerPool> pool;
+	static constexpr int grain = 64;
+	vector<float> p_over_rho2, m_over_rho;
 
-	static string ivec3key(const ivec3 &v) {
-		return std::to_string(v.x) + "," + std::to_string(v.y) + "," + std::to_string(v.z);
-	}
+	// calls f with an evaluator of the kernel and its gradient at an offset with known squared length
+	template<typename F>
+	void with_kernel(F &&f) const;
 
 public:
 	FluidParticleSystem(const vector<FluidParticle> &particles, const HOM(vec3, vec3) &gravity_field, const ImplicitVolume &boundary, SmoothingKernel smoothing_kernel, SPH_SETTINGS params);
-	ivec3 chunk(vec3 p) const { return ivec3((p - bound_min) / d); }
-	vector<ivec3> relevant_chunks(vec3 p) const;
+	ivec3 chunk(vec3 p) const { return neighbour_grid.cellCoords(p); }
+	void rebuild_neighbour_grid();
+	const UniformGridIndex &neighbour_index() const { return neighbour_grid; }
+	// 0 uses all hardware threads
+	void set_threads(int threads);
+	int threads() const { return pool->threads(); }
 
 	float density(vec3 x) const;
 	void calculate_densities();
@@ -103,8 +271,15 @@ public:
 
 	SmoothImplicitSurface density_surface(float level) const;
 	IndexedMesh particle_mesh(float r, int icosphere_res) const;
+	// one icosphere drawn at every particle, instance colours as in particle_mesh
+	InstancedMesh particle_instances(float r, int icosphere_res) const;
+	void update_particle_instances(InstanceTable &instances) const;
 	MarchingCubeChunk boundary_surface_march(const ivec3 &res) const;
 	MarchingCubeChunk free_surface_march(const ivec3 &res, float level) const;
 
-	FluidParticle &operator[](int i) { return particles[i]; }
+	int size() const { return no_particles; }
+	FluidParticleRef operator[](int i) { return FluidParticleRef(&particles, particles.slotOf(i)); }
+	FluidParticle particle(int i) const { return particles.particle(particles.slotOf(i)); }
+	FluidParticleStorage &storage() { return particles; }
+	const FluidParticleStorage &storage() const { return particles; }
 };
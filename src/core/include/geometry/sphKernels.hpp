@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "mat.hpp"
+
+
+/**
+ * Statically dispatched SPH smoothing kernels.
+ *
+ * Every kernel is radial with compact support h and integrates to one over R^3. Constants depending
+ * on h are computed once by the constructor. Values are taken from the squared distance r2 <= h^2,
+ * which the neighbour search already has, so only Spiky and Viscosity need sqrt(r2). Gradients take
+ * the offset p with |p|^2 = r2. W(r2, out, n) evaluates a batch of squared distances in a loop
+ * without branches on the kernel support, which the compiler can vectorise.
+ */
+namespace sph {
+	// entries outside the support give 0, every kernel vanishes at r = h
+	template<typename K>
+	void evaluateBatch(const K &kernel, const float *r2, float *out, int n) {
+		for (int i = 0; i < n; ++i)
+			out[i] = kernel.W(std::min(r2[i], kernel.h2));
+	}
+
+
+	// Mueller et al. 2003, 315/(64 pi h^9) (h^2 - r^2)^3, default density kernel
+	struct Poly6 {
+		float h, h2, w, g, l;
+		explicit Poly6(float h) : h(h), h2(h*h) {
+			w = 315.f/(64.f*PI*pow3(h2)*pow3(h));
+			g = -6.f*w;
+			l = -6.f*w;
+		}
+		float W(float r2) const { return w*pow3(h2 - r2); }
+		vec3 grad(vec3 p, float r2) const { return p*(g*pow2(h2 - r2)); }
+		float laplacian(float r2) const { return l*(h2 - r2)*(3.f*h2 - 7.f*r2); }
+		void W(const float *r2, float *out, int n) const { evaluateBatch(*this, r2, out, n); }
+	};
+
+
+	// Desbrun and Gascuel 1996, 15/(pi h^6) (h - r)^3, gradient does not vanish near r = 0
+	struct Spiky {
+		float h, h2, w, g;
+		explicit Spiky(float h) : h(h), h2(h*h) {
+			w = 15.f/(PI*pow3(h2));
+			g = -3.f*w;
+		}
+		float W(float r2) const { return w*pow3(h - std::sqrt(r2)); }
+		vec3 grad(vec3 p, float r2) const {
+			float r = std::sqrt(r2);
+			return r > 0 ? p*(g*pow2(h - r)/r) : vec3(0);
+		}
+		void W(const float *r2, float *out, int n) const { evaluateBatch(*this, r2, out, n); }
+	};
+
+
+	// Mueller et al. 2003, laplacian 45/(pi h^6) (h - r) is positive on the whole support
+	struct Viscosity {
+		float h, h2, w, inv_h2, inv_h3, l;
+		explicit Viscosity(float h) : h(h), h2(h*h), inv_h2(1.f/(h*h)), inv_h3(1.f/pow3(h)) {
+			w = 15.f/(2.f*PI*pow3(h));
+			l = 45.f/(PI*pow3(h2));
+		}
+		// singular at r = 0
+		float W(float r2) const {
+			float r = std::sqrt(r2);
+			return w*(-.5f*r2*r*inv_h3 + r2*inv_h2 + .5f*h/r - 1.f);
+		}
+		vec3 grad(vec3 p, float r2) const {
+			float r = std::sqrt(r2);
+			return r > 0 ? p*(w*(-1.5f*r*inv_h3 + 2.f*inv_h2 - .5f*h/(r2*r))) : vec3(0);
+		}
+		float laplacian(float r2) const { return l*(h - std::sqrt(r2)); }
+		void W(const float *r2, float *out, int n) const { evaluateBatch(*this, r2, out, n); }
+	};
+
+
+	// Monaghan cubic B-spline scaled to support h, sigma = 8/(pi h^3)
+	struct CubicSpline {
+		float h, h2, inv_h, s, g;
+		explicit CubicSpline(float h) : h(h), h2(h*h), inv_h(1.f/h) {
+			s = 8.f/(PI*pow3(h));
+			g = s/h2;
+		}
+		float W(float r2) const {
+			float q = std::sqrt(r2)*inv_h;
+			return s*(q <= .5f ? 6.f*(q - 1.f)*q*q + 1.f : 2.f*pow3(1.f - q));
+		}
+		vec3 grad(vec3 p, float r2) const {
+			float q = std::sqrt(r2)*inv_h;
+			if (q <= .5f)
+				return p*(g*(18.f*q - 12.f));
+			return p*(-6.f*g*pow2(1.f - q)/q);
+		}
+		void W(const float *r2, float *out, int n) const { evaluateBatch(*this, r2, out, n); }
+	};
+
+
+	// Wendland C2 in 3D, 21/(2 pi h^3) (1 - q)^4 (1 + 4q)
+	struct WendlandC2 {
+		float h, h2, inv_h, s, g;
+		explicit WendlandC2(float h) : h(h), h2(h*h), inv_h(1.f/h) {
+			s = 21.f/(2.f*PI*pow3(h));
+			g = -20.f*s/h2;
+		}
+		float W(float r2) const {
+			float q = std::sqrt(r2)*inv_h;
+			return s*pow2(pow2(1.f - q))*(1.f + 4.f*q);
+		}
+		vec3 grad(vec3 p, float r2) const { return p*(g*pow3(1.f - std::sqrt(r2)*inv_h)); }
+		void W(const float *r2, float *out, int n) const { evaluateBatch(*this, r2, out, n); }
+	};
+
+
+	// Wendland C4 in 3D, 495/(32 pi h^3) (1 - q)^6 (1 + 6q + 35/3 q^2)
+	struct WendlandC4 {
+		float h, h2, inv_h, s, g;
+		explicit WendlandC4(float h) : h(h), h2(h*h), inv_h(1.f/h) {
+			s = 495.f/(32.f*PI*pow3(h));
+			g = -56.f/3.f*s/h2;
+		}
+		float W(float r2) const {
+			float q = std::sqrt(r2)*inv_h;
+			return s*pow3(pow2(1.f - q))*(1.f + 6.f*q + 35.f/3.f*q*q);
+		}
+		vec3 grad(vec3 p, float r2) const {
+			float q = std::sqrt(r2)*inv_h;
+			return p*(g*(1.f + 5.f*q)*pow5(1.f - q));
+		}
+		void W(const float *r2, float *out, int n) const { evaluateBatch(*this, r2, out, n); }
+	};
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include "mat.hpp"
+
+
+/**
+ * @class UniformGridIndex
+ * @brief Cell-linked-list neighbour index over a fixed box, rebuilt from scratch each step.
+ *
+ * Points are bucketed into cubic cells of given size with a counting sort, so every cell is
+ * a contiguous range of the sorted arrays and a query touches only the cells overlapping
+ * the search ball. Rebuilding is O(n + cells) and allocates only when the point count grows.
+ * Points outside the box are clamped to the border cells, they are still found by queries.
+ */
+class UniformGridIndex {
+	vec3 origin;
+	float cell;
+	ivec3 dims;
+	vector<int> cell_start;
+	vector<int> point_cell;
+	vector<int> sorted_slot;
+	vector<int> sorted_ids;
+	vector<vec3> sorted_pos;
+
+	int cellIndex(ivec3 c) const { return (c.z * dims.y + c.y) * dims.x + c.x; }
+
+public:
+	UniformGridIndex(vec3 bound_min, vec3 bound_max, float cell_size);
+
+	void rebuild(const vector<vec3> &positions);
+
+	ivec3 cellCoords(vec3 p) const { return ivec3(glm::clamp(glm::floor((p - origin) / cell), vec3(0), vec3(dims - 1))); }
+	ivec3 gridSize() const { return dims; }
+	float cellSize() const { return cell; }
+	int size() const { return sorted_ids.size(); }
+	vec3 position(int i) const { return sorted_pos[sorted_slot[i]]; }
+	// id of the point stored at each sorted slot, points of one cell are adjacent
+	const vector<int> &sortedIds() const { return sorted_ids; }
+	// to be called after the owner permuted its points into sortedIds order, the id of a point becomes its slot
+	void relabelInSortedOrder();
+
+	/**
+	 * Calls fn(j, x - p_j, |x - p_j|^2) for every indexed point p_j with |x - p_j| <= radius.
+	 * Points are visited cell by cell in sorted order, no allocation happens during the query.
+	 */
+	template<typename F>
+	void forEachNeighbour(vec3 x, float radius, F &&fn) const {
+		ivec3 lo = cellCoords(x - vec3(radius));
+		ivec3 hi = cellCoords(x + vec3(radius));
+		float r2 = radius * radius;
+		for (int cz = lo.z; cz <= hi.z; ++cz)
+			for (int cy = lo.y; cy <= hi.y; ++cy) {
+				int row = (cz * dims.y + cy) * dims.x;
+				int begin = cell_start[row + lo.x];
+				int end = cell_start[row + hi.x + 1];
+				for (int k = begin; k < end; ++k) {
+					vec3 delta = x - sorted_pos[k];
+					float d2 = dot(delta, delta);
+					if (d2 <= r2)
+						fn(sorted_ids[k], delta, d2);
+				}
+			}
+	}
+
+	// neighbours of an indexed point, the point itself is reported as well (with zero offset)
+	template<typename F>
+	void forEachNeighbour(int i, float radius, F &&fn) const {
+		forEachNeighbour(position(i), radius, std::forward<F>(fn));
+	}
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cmath>
+#include <type_traits>
+
+#include "mat.hpp"
+
+
+/**
+ * Forward mode automatic differentiation.
+ *
+ * Dual<T, N> is a first order Taylor expansion v + sum d_i e_i in N variables with e_i e_j = 0, HyperDual<T, N>
+ * keeps the second order terms as well. A function written once for a generic scalar type S, built from the
+ * arithmetic operators and the elementary functions below, evaluated at arguments seeded with variable(x, i)
+ * returns its exact partial derivatives (and Hessian) next to its value in a single pass, with no step size.
+ *
+ * Components are stored in one array c, c[0] is the value, so linear operations are the same loop for both
+ * types. The elementary functions are hidden friends: unqualified calls such as sin(t) in a generic lambda
+ * reach them by argument dependent lookup and are preferred over the glm and std templates. Vectors are the
+ * glm vectors of dual scalars, e.g. tvec3<Dual<float, 2>>, with dot, cross and norm defined here.
+ */
+template<typename X, typename T>
+struct AutodiffScalar {
+	template<typename S>
+	static constexpr bool scalar = std::is_arithmetic_v<S>;
+
+	T value() const { return static_cast<const X &>(*this).c[0]; }
+
+	friend X operator+(const X &a, const X &b) { X r; for (int k = 0; k < X::K; ++k) r.c[k] = a.c[k] + b.c[k]; return r; }
+	friend X operator-(const X &a, const X &b) { X r; for (int k = 0; k < X::K; ++k) r.c[k] = a.c[k] - b.c[k]; return r; }
+	friend X operator-(const X &a) { X r; for (int k = 0; k < X::K; ++k) r.c[k] = -a.c[k]; return r; }
+	friend X operator/(const X &a, const X &b) { return a*inverse(b); }
+	X &operator+=(const X &b) { return static_cast<X &>(*this) = static_cast<X &>(*this) + b; }
+	X &operator-=(const X &b) { return static_cast<X &>(*this) = static_cast<X &>(*this) - b; }
+	X &operator*=(const X &b) { return static_cast<X &>(*this) = static_cast<X &>(*this) * b; }
+	X &operator/=(const X &b) { return static_cast<X &>(*this) = static_cast<X &>(*this) / b; }
+
+	template<typename S> requires scalar<S>
+	friend X operator+(const X &a, S s) { X r = a; r.c[0] += T(s); return r; }
+	template<typename S> requires scalar<S>
+	friend X operator+(S s, const X &a) { return a + s; }
+	template<typename S> requires scalar<S>
+	friend X operator-(const X &a, S s) { X r = a; r.c[0] -= T(s); return r; }
+	template<typename S> requires scalar<S>
+	friend X operator-(S s, const X &a) { return -a + s; }
+	template<typename S> requires scalar<S>
+	friend X operator*(const X &a, S s) { X r; for (int k = 0; k < X::K; ++k) r.c[k] = a.c[k]*T(s); return r; }
+	template<typename S> requires scalar<S>
+	friend X operator*(S s, const X &a) { return a*s; }
+	template<typename S> requires scalar<S>
+	friend X operator/(const X &a, S s) { return a*(T(1)/T(s)); }
+	template<typename S> requires scalar<S>
+	friend X operator/(S s, const X &a) { return inverse(a)*s; }
+
+	// comparisons only look at values, so branches in generic code follow the evaluation point
+	friend bool operator<(const X &a, const X &b) { return a.c[0] < b.c[0]; }
+	friend bool operator>(const X &a, const X &b) { return a.c[0] > b.c[0]; }
+	friend bool operator<=(const X &a, const X &b) { return a.c[0] <= b.c[0]; }
+	friend bool operator>=(const X &a, const X &b) { return a.c[0] >= b.c[0]; }
+	template<typename S> requires scalar<S>
+	friend bool operator<(const X &a, S s) { return a.c[0] < s; }
+	template<typename S> requires scalar<S>
+	friend bool operator>(const X &a, S s) { return a.c[0] > s; }
+	template<typename S> requires scalar<S>
+	friend bool operator<(S s, const X &a) { return s < a.c[0]; }
+	template<typename S> requires scalar<S>
+	friend bool operator>(S s, const X &a) { return s > a.c[0]; }
+
+	// f(a) from f, f' and f'' at the value of a
+	friend X inverse(const X &a) { T v = a.c[0]; return X::chain(a, 1/v, -1/(v*v), 2/(v*v*v)); }
+	friend X sqrt(const X &a) { T s = std::sqrt(a.c[0]); return X::chain(a, s, T(.5)/s, T(-.25)/(s*a.c[0])); }
+	friend X exp(const X &a) { T e = std::exp(a.c[0]); return X::chain(a, e, e, e); }
+	friend X log(const X &a) { T v = a.c[0]; return X::chain(a, std::log(v), 1/v, -1/(v*v)); }
+	friend X sin(const X &a) { T s = std::sin(a.c[0]), c = std::cos(a.c[0]); return X::chain(a, s, c, -s); }
+	friend X cos(const X &a) { T s = std::sin(a.c[0]), c = std::cos(a.c[0]); return X::chain(a, c, -s, -c); }
+	friend X tan(const X &a) { T t = std::tan(a.c[0]), d = 1 + t*t; return X::chain(a, t, d, 2*t*d); }
+	friend X atan(const X &a) { T v = a.c[0], d = 1/(1 + v*v); return X::chain(a, std::atan(v), d, -2*v*d*d); }
+	friend X asin(const X &a) { T v = a.c[0], d = 1/std::sqrt(1 - v*v); return X::chain(a, std::asin(v), d, v*d*d*d); }
+	friend X acos(const X &a) { T v = a.c[0], d = 1/std::sqrt(1 - v*v); return X::chain(a, std::acos(v), -d, -v*d*d*d); }
+	friend X sinh(const X &a) { T s = std::sinh(a.c[0]), c = std::cosh(a.c[0]); return X::chain(a, s, c, s); }
+	friend X cosh(const X &a) { T s = std::sinh(a.c[0]), c = std::cosh(a.c[0]); return X::chain(a, c, s, c); }
+	friend X tanh(const X &a) { T t = std::tanh(a.c[0]), d = 1 - t*t; return X::chain(a, t, d, -2*t*d); }
+	friend X abs(const X &a) { return a.c[0] < 0 ? -a : a; }
+	friend X pow(const X &a, T p) { T v = a.c[0], q = std::pow(v, p - 2); return X::chain(a, q*v*v, p*q*v, p*(p - 1)*q); }
+	friend X pow2(const X &a) { return a*a; }
+	friend X pow3(const X &a) { return a*a*a; }
+	friend X min(const X &a, const X &b) { return b < a ? b : a; }
+	friend X max(const X &a, const X &b) { return a < b ? b : a; }
+
+	friend X dot(const tvec2<X, highp> &a, const tvec2<X, highp> &b) { return a.x*b.x + a.y*b.y; }
+	friend X dot(const tvec3<X, highp> &a, const tvec3<X, highp> &b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+	friend tvec3<X, highp> cross(const tvec3<X, highp> &a, const tvec3<X, highp> &b) {
+		return tvec3<X, highp>(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+	}
+	friend X norm(const tvec3<X, highp> &a) { return sqrt(dot(a, a)); }
+	friend X norm2(const tvec3<X, highp> &a) { return dot(a, a); }
+	friend tvec3<X, highp> normalise(const tvec3<X, highp> &a) { return a/norm(a); }
+
+	// glm only multiplies vectors by scalars of their own type
+	friend tvec3<X, highp> operator*(const tvec3<X, highp> &a, T s) { return a*X(s); }
+	friend tvec3<X, highp> operator*(T s, const tvec3<X, highp> &a) { return a*X(s); }
+	friend tvec3<X, highp> operator/(const tvec3<X, highp> &a, T s) { return a*X(1/s); }
+};
+
+
+template<typename T, int N=1>
+struct Dual : AutodiffScalar<Dual<T, N>, T> {
+	static constexpr int K = 1 + N;
+	T c[K] = {};
+
+	Dual() = default;
+	template<typename S> requires std::is_arithmetic_v<S>
+	Dual(S value) { c[0] = T(value); }
+
+	static Dual variable(T value, int i) { Dual x(value); x.c[1 + i] = 1; return x; }
+	T d(int i) const { return c[1 + i]; }
+
+	static Dual chain(const Dual &a, T f, T df, T) {
+		Dual r;
+		r.c[0] = f;
+		for (int i = 1; i < K; ++i)
+			r.c[i] = df*a.c[i];
+		return r;
+	}
+	friend Dual operator*(const Dual &a, const Dual &b) {
+		Dual r;
+		r.c[0] = a.c[0]*b.c[0];
+		for (int i = 1; i < K; ++i)
+			r.c[i] = a.c[i]*b.c[0] + a.c[0]*b.c[i];
+		return r;
+	}
+};
+
+
+/**
+ * @brief Second order expansion, value, gradient and the upper triangle of the Hessian packed row by row.
+ * @note HyperDual<T, 1> is the classical hyper-dual number with e1 = e2, its second component is f''.
+ */
+template<typename T, int N=1>
+struct HyperDual : AutodiffScalar<HyperDual<T, N>, T> {
+	static constexpr int H = N*(N + 1)/2;
+	static constexpr int K = 1 + N + H;
+	T c[K] = {};
+
+	HyperDual() = default;
+	template<typename S> requires std::is_arithmetic_v<S>
+	HyperDual(S value) { c[0] = T(value); }
+
+	static HyperDual variable(T value, int i) { HyperDual x(value); x.c[1 + i] = 1; return x; }
+	static constexpr int index(int i, int j) { return i <= j ? 1 + N + i*N - i*(i - 1)/2 + j - i : index(j, i); }
+	T d(int i) const { return c[1 + i]; }
+	T d2(int i, int j) const { return c[index(i, j)]; }
+
+	static HyperDual chain(const HyperDual &a, T f, T df, T d2f) {
+		HyperDual r;
+		r.c[0] = f;
+		for (int i = 0; i < N; ++i)
+			r.c[1 + i] = df*a.c[1 + i];
+		// the packed triangle is traversed in storage order, ij = index(i, j)
+		for (int i = 0, ij = 1 + N; i < N; ++i)
+			for (int j = i; j < N; ++j, ++ij)
+				r.c[ij] = df*a.c[ij] + d2f*a.c[1 + i]*a.c[1 + j];
+		return r;
+	}
+	friend HyperDual operator*(const HyperDual &a, const HyperDual &b) {
+		HyperDual r;
+		r.c[0] = a.c[0]*b.c[0];
+		for (int i = 0; i < N; ++i)
+			r.c[1 + i] = a.c[1 + i]*b.c[0] + a.c[0]*b.c[1 + i];
+		for (int i = 0, ij = 1 + N; i < N; ++i)
+			for (int j = i; j < N; ++j, ++ij)
+				r.c[ij] = a.c[ij]*b.c[0] + a.c[1 + i]*b.c[1 + j] + a.c[1 + j]*b.c[1 + i] + a.c[0]*b.c[ij];
+		return r;
+	}
+};
+
+
+// components of vectors of dual scalars
+template<typename X>
+vec3 valueOf(const tvec3<X, highp> &v) { return vec3(v.x.value(), v.y.value(), v.z.value()); }
+
+template<typename X>
+vec3 partialOf(const tvec3<X, highp> &v, int i) { return vec3(v.x.d(i), v.y.d(i), v.z.d(i)); }
+
+template<typename X>
+vec3 secondPartialOf(const tvec3<X, highp> &v, int i, int j) { return vec3(v.x.d2(i, j), v.y.d2(i, j), v.z.d2(i, j)); }
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "mat.hpp"
+
+
+enum class ExprOp : unsigned char {
+	CONSTANT,
+	VARIABLE,
+	ADD,
+	SUB,
+	MUL,
+	DIV,
+	MIN,
+	MAX,
+	NEG,
+	SQRT,
+	SIN,
+	COS,
+	EXP,
+	LOG,
+	ABS,
+	SIGN,
+	STEP, // 1 for positive arguments, 0 otherwise
+	POW   // exponent is stored as the node value
+};
+
+
+struct ExprNode {
+	ExprOp op;
+	float value = 0;
+	int variable = 0;
+	std::shared_ptr<const ExprNode> a, b;
+};
+
+
+/**
+ * @class Expr
+ * @brief Handle to an immutable node of an expression DAG over variables x_0, x_1, ...
+ *
+ * Operators and elementary functions only link new nodes to existing ones, so building an expression is cheap
+ * and shared subexpressions stay shared. Constants are folded and trivial identities (x+0, x*1, x*0, pow(x, 1), ...)
+ * are simplified while building, which keeps symbolic derivatives small. A default constructed Expr is empty,
+ * which is how function classes mark that they are not backed by a graph.
+ */
+class Expr {
+	std::shared_ptr<const ExprNode> node;
+
+	explicit Expr(std::shared_ptr<const ExprNode> node) : node(std::move(node)) {}
+	static Expr make(ExprOp op, const Expr &a, const Expr &b = Expr(), float value = 0);
+
+public:
+	Expr() = default;
+	static Expr constant(float a);
+	static Expr variable(int i);
+
+	bool empty() const { return node == nullptr; }
+	explicit operator bool() const { return node != nullptr; }
+	const ExprNode *get() const { return node.get(); }
+	ExprOp op() const { return node->op; }
+	bool isConstant() const { return node && node->op == ExprOp::CONSTANT; }
+	bool isConstant(float a) const { return isConstant() && node->value == a; }
+	float constantValue() const { return node->value; }
+
+	// number of distinct nodes reachable from this one
+	int nodeCount() const;
+	// partial derivative in i-th variable, memoised over the DAG so shared subexpressions are differentiated once
+	Expr derivative(int i) const;
+	// replaces variable i by values[i], variables outside of the span are left untouched
+	Expr substitute(std::span<const Expr> values) const;
+	// recursive reference evaluation, use ExprTape for anything performance related
+	float evaluate(std::span<const float> x) const;
+
+	friend Expr operator+(const Expr &a, const Expr &b);
+	friend Expr operator-(const Expr &a, const Expr &b);
+	friend Expr operator*(const Expr &a, const Expr &b);
+	friend Expr operator/(const Expr &a, const Expr &b);
+	friend Expr operator-(const Expr &a);
+	friend Expr operator+(const Expr &a, float b) { return a + constant(b); }
+	friend Expr operator-(const Expr &a, float b) { return a - constant(b); }
+	friend Expr operator*(const Expr &a, float b) { return a * constant(b); }
+	friend Expr operator/(const Expr &a, float b) { return a / constant(b); }
+	friend Expr operator+(float a, const Expr &b) { return constant(a) + b; }
+	friend Expr operator-(float a, const Expr &b) { return constant(a) - b; }
+	friend Expr operator*(float a, const Expr &b) { return constant(a) * b; }
+	friend Expr operator/(float a, const Expr &b) { return constant(a) / b; }
+
+	friend Expr min(const Expr &a, const Expr &b);
+	friend Expr max(const Expr &a, const Expr &b);
+	friend Expr pow(const Expr &a, float p);
+	friend Expr sqrt(const Expr &a);
+	friend Expr sin(const Expr &a);
+	friend Expr cos(const Expr &a);
+	friend Expr exp(const Expr &a);
+	friend Expr log(const Expr &a);
+	friend Expr abs(const Expr &a);
+	friend Expr sign(const Expr &a);
+	friend Expr step(const Expr &a);
+};
+
+// visible to qualified lookup as well, function classes call them from members of the same name
+Expr min(const Expr &a, const Expr &b);
+Expr max(const Expr &a, const Expr &b);
+Expr pow(const Expr &a, float p);
+Expr sqrt(const Expr &a);
+Expr sin(const Expr &a);
+Expr cos(const Expr &a);
+Expr exp(const Expr &a);
+Expr log(const Expr &a);
+Expr abs(const Expr &a);
+Expr sign(const Expr &a);
+Expr step(const Expr &a);
+
+
+struct ExprInstruction {
+	ExprOp op;
+	int dst, a, b;
+	float value;
+};
+
+
+/**
+ * @class ExprTape
+ * @brief Expressions compiled into a flat list of register instructions.
+ *
+ * Compilation numbers the values of the DAG structurally (commutative operands sorted), so equal subexpressions are
+ * computed once even if they were built as separate nodes, then assigns registers in topological order, reusing
+ * a register as soon as its value is no longer needed. Evaluation is a single loop over the instructions without
+ * any indirect calls. Batches run every instruction over a block of points at a time, so the inner loops are plain
+ * arrays the compiler can vectorise. A tape is immutable and can be shared between threads.
+ */
+class ExprTape {
+	vector<ExprInstruction> code;
+	vector<int> output_registers;
+	int n_registers = 0;
+	int n_variables = 0;
+
+	void run(const float *x, float *registers) const;
+
+public:
+	static constexpr int BATCH_BLOCK = 64;
+
+	ExprTape(const vector<Expr> &outputs, int variables);
+
+	int size() const { return code.size(); }
+	int registers() const { return n_registers; }
+	int outputs() const { return output_registers.size(); }
+	int variables() const { return n_variables; }
+	const vector<ExprInstruction> &instructions() const { return code; }
+
+	// x holds variables() values, out receives outputs() values
+	void evaluate(const float *x, float *out) const;
+	float operator()(const float *x) const;
+	float operator()(vec3 x) const { return (*this)(&x.x); }
+	// x holds n points with variables() coordinates each, out receives outputs() values per point
+	void evaluateBatch(const float *x, float *out, int n) const;
+	void evaluateBatch(std::span<const vec3> x, std::span<float> out) const;
+};
+
+
+/**
+ * @class ExprProgram
+ * @brief Tape compiled on first use from expressions produced by a generator.
+ *
+ * Function classes create programs for their values and derivatives on every operation, but only the ones that
+ * end up being evaluated are ever differentiated and compiled. Compilation is thread safe.
+ */
+class ExprProgram {
+	std::function<vector<Expr>()> generator;
+	int n_variables;
+	mutable std::atomic<const ExprTape *> compiled = nullptr;
+	mutable std::unique_ptr<const ExprTape> storage;
+	mutable std::mutex compile_mutex;
+
+	const ExprTape &compile() const;
+
+public:
+	ExprProgram(std::function<vector<Expr>()> generator, int variables) : generator(std::move(generator)), n_variables(variables) {}
+	ExprProgram(const Expr &expr, int variables) : ExprProgram([expr] { return vector{expr}; }, variables) {}
+	// values of all first order partial derivatives, the i-th output is d expr / dx_i
+	static std::shared_ptr<const ExprProgram> gradient(const Expr &expr, int variables);
+	// Jacobian of a map given coordinate-wise, in column-major order (d f_row / dx_col at col*outputs + row)
+	static std::shared_ptr<const ExprProgram> jacobian(const vector<Expr> &coordinates, int variables);
+
+	const ExprTape &tape() const {
+		const ExprTape *t = compiled.load(std::memory_order_acquire);
+		return t ? *t : compile();
+	}
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "mat.hpp"
+
+
+/**
+ * @brief Sign of the exponent used by a plan.
+ * @note FORWARD follows the convention of DiscreteComplexFunction::fft, i.e.
+ * @code
+ * X[k] = sum_j x[j] exp(+2 pi i jk/n)
+ * @endcode
+ * and BACKWARD is its unnormalised inverse (exponent with minus sign).
+ */
+enum class FFTDirection {
+	FORWARD = 1,
+	BACKWARD = -1
+};
+
+
+/**
+ * @class FFTPlan
+ * @brief Precomputed discrete Fourier transform of fixed length and direction.
+ *
+ * Lengths factoring into 2, 3, 4 and 5 are handled by an iterative in-place mixed-radix
+ * Cooley-Tukey core with precomputed digit-reversal permutation and twiddle tables.
+ * Any other length goes through Bluestein chirp-z, i.e. a cyclic convolution computed
+ * with a power of two plan, so every size runs in O(n log n).
+ * Plans are immutable after construction, so a single plan can be shared between threads;
+ * use FFTPlan::get to obtain cached instances instead of constructing them repeatedly.
+ * Results are unnormalised in both directions.
+ */
+class FFTPlan {
+	int n;
+	FFTDirection dir;
+	vector<int> radices;
+	vector<int> permutation;
+	vector<vec2> twiddles;
+	vector<int> twiddle_offsets;
+
+	bool bluestein = false;
+	int conv_size = 0;
+	vector<vec2> chirp;
+	vector<vec2> chirp_kernel_fft;
+	shared_ptr<const FFTPlan> conv_forward, conv_backward;
+
+	void init_mixed_radix();
+	void init_bluestein();
+	void run_mixed_radix(Complex *data) const;
+	void run_bluestein(const Complex *in, Complex *out) const;
+
+public:
+	FFTPlan(int n, FFTDirection dir);
+
+	int size() const { return n; }
+	FFTDirection direction() const { return dir; }
+	bool usesBluestein() const { return bluestein; }
+
+	void execute(const Complex *in, Complex *out) const;
+	void execute(Complex *data) const;
+	void execute(vector<Complex> &data) const;
+	vector<Complex> operator()(const vector<Complex> &data) const;
+
+	static shared_ptr<const FFTPlan> get(int n, FFTDirection dir);
+	static void clearCache();
+	static bool mixedRadixSize(int n);
+};
@@ -9,6 +9,9 @@
 #include <variant>
 
 // #include "file-management/filesUtils.hpp"
+#include "dual.hpp"
+#include "exprTape.hpp"
+#include "grid2D.hpp"
 #include "mat.hpp"
 #include "randomUtils.hpp"
 
@@ -157,11 +160,22 @@ public:
 };
 
 
+/**
+ * @note Functions built from projection, linear, constant and the operators below keep an expression graph
+ * next to the closures, and operators combine graphs whenever both operands have one. Such functions evaluate
+ * through a compiled ExprTape (with exact gradient) instead of a chain of nested closures, everything else
+ * falls back to closures as before.
+ */
 class RealFunctionR3 {
 	Foo31 _f;
 	Foo33 _df;
     float eps = 0.01f;
     Regularity regularity;
+	Expr _expr;
+	shared_ptr<const ExprProgram> _program;
+	// set by autodiff only, value and gradient in one pass and the exact Hessian
+	std::function<std::pair<float, vec3>(vec3)> _fdf;
+	std::function<mat3(vec3)> _d2f;
 public:
 	RealFunctionR3();
     RealFunctionR3(const RealFunctionR3 &other);
@@ -172,11 +186,51 @@ public:
 	explicit RealFunctionR3(Foo31 f, float epsilon=0.01f, Regularity regularity = Regularity::SMOOTH);;
 	RealFunctionR3(Foo1111 f,Foo1113 df, float eps=.01f, Regularity regularity = Regularity::SMOOTH);;
 	explicit RealFunctionR3(Foo1111 f, float epsilon=0.01f, Regularity regularity = Regularity::SMOOTH);;
+	// graph-backed function of variables x_0, x_1, x_2
+	explicit RealFunctionR3(const Expr &expr, float epsilon=0.01f, Regularity regularity = Regularity::SMOOTH);
+
+	/**
+	 * @brief Function with exact gradient and Hessian from a callable generic in the scalar type,
+	 * e.g. [](auto x, auto y, auto z) { return x*x + sin(y*z); }, evaluated on dual and hyper-dual numbers.
+	 * Functions derived from it by arithmetic or composition fall back to finite differences.
+	 */
+	template<typename F>
+	static RealFunctionR3 autodiff(const F &f, Regularity regularity = Regularity::SMOOTH) {
+		using D = Dual<float, 3>;
+		RealFunctionR3 res([f](vec3 v) { return float(f(v.x, v.y, v.z)); },
+						   [f](vec3 v) {
+							   D y = f(D::variable(v.x, 0), D::variable(v.y, 1), D::variable(v.z, 2));
+							   return vec3(y.d(0), y.d(1), y.d(2));
+						   }, .01f, regularity);
+		res._fdf = [f](vec3 v) {
+			D y = f(D::variable(v.x, 0), D::variable(v.y, 1), D::variable(v.z, 2));
+			return std::pair(y.value(), vec3(y.d(0), y.d(1), y.d(2)));
+		};
+		res._d2f = [f](vec3 v) {
+			using HD = HyperDual<float, 3>;
+			HD y = f(HD::variable(v.x, 0), HD::variable(v.y, 1), HD::variable(v.z, 2));
+			mat3 H;
+			for (int i = 0; i < 3; ++i)
+				for (int j = 0; j < 3; ++j)
+					H[i][j] = y.d2(i, j);
+			return H;
+		};
+		return res;
+	}
+
+	bool hasExpression() const { return !_expr.empty(); }
+	const Expr &expression() const { return _expr; }
+	// evaluates f at every point, through the batched tape if the function is graph-backed
+	void evaluate(std::span<const vec3> points, std::span<float> out) const;
 
 	float operator()(vec3 v) const;
 	vec3 df(vec3 v) const;
 	float operator()(float x, float y, float z) const;
 	vec3 df(float x, float y, float z) const;
+	std::pair<float, vec3> valueAndGradient(vec3 v) const;
+	// exact for autodiff functions, central differences of the gradient otherwise
+	mat3 hessian(vec3 v) const;
+	float Laplacian(vec3 v) const;
 	RealFunctionR3 operator-() const;
 
 	RealFunctionR3 operator*(float a) const;
@@ -235,12 +289,14 @@ const auto NORM_R3 = sqrt(NORM2_R3);
 
 
 
-// R3 -> R3
+// R3 -> R3, linear and affine maps are graph-backed and compose as graphs (see RealFunctionR3)
 class SpaceEndomorphism {
 protected:
 	Foo33 _f;
 	Foo3Foo33 _df;
     float eps = 0.01f;
+	array<Expr, 3> _expr;
+	shared_ptr<const ExprProgram> _program;
 	virtual SpaceEndomorphism compose(const SpaceEndomorphism &g) const;
 
 
@@ -255,6 +311,12 @@ public:
   SpaceEndomorphism &operator=(SpaceEndomorphism &&other) noexcept;
   explicit SpaceEndomorphism(mat3 A);
   explicit SpaceEndomorphism(mat4 A);
+	// graph-backed map with given coordinate functions of x_0, x_1, x_2
+	explicit SpaceEndomorphism(const array<Expr, 3> &coordinates, float eps=.01);
+
+	bool hasExpression() const { return !_expr[0].empty(); }
+	const array<Expr, 3> &expression() const { return _expr; }
+	void evaluate(std::span<const vec3> points, std::span<vec3> out) const;
 
 	vec3 directional_derivative(vec3 x, vec3 v) const;
 	vec3 dfdv(vec3 x, vec3 v) const;
@@ -273,14 +335,20 @@ public:
 
 
 
+// time dependent field, graph-backed fields are expressions of x_0, x_1, x_2 and time as x_3 (see RealFunctionR3)
 class ScalarField {
 	BIHOM(vec3, float, float) F;
 	float eps;
+	Expr expr;
 public:
 	ScalarField();
 	explicit ScalarField(BIHOM(vec3, float, float) F, float eps=.01);
 	explicit ScalarField(HOM(float, SteadyScalarField) pencil);
 	explicit ScalarField(SteadyScalarField steady_field);
+	explicit ScalarField(const Expr &F, float eps=.01);
+
+	bool hasExpression() const { return !expr.empty(); }
+	const Expr &expression() const { return expr; }
 
 	float operator()(vec3 x, float t) const;
 	SteadyScalarField operator()(float t) const;
@@ -389,6 +457,9 @@ class CompactlySupportedRealFunction;
  *  X_R & 2 == X_R*2
  *  SQRT_R & 4 == SQRT_R*2
  *  @endcode
+ *
+ *  @note Predefined elementary functions, constants and everything built from them by the operators above
+ *  (compositions included) are graph-backed, see RealFunctionR3.
  */
 class RealFunction {
 protected:
@@ -397,6 +468,8 @@ protected:
 	Fooo _ddf;
 	float eps = 0.01;
 	bool is_zero;
+	Expr _expr;
+	shared_ptr<const ExprProgram> _program;
 public:
 	Regularity regularity;
 
@@ -404,6 +477,11 @@ public:
 	RealFunction(Fooo f, Fooo df, float epsilon=0.01, Regularity regularity = Regularity::SMOOTH);
 	explicit RealFunction(Fooo f, float epsilon=0.01, Regularity regularity = Regularity::SMOOTH);
 	explicit RealFunction(float constant, float epsilon=0.01, Regularity regularity = Regularity::SMOOTH);
+	// graph-backed function of the variable x_0
+	explicit RealFunction(const Expr &expr, float epsilon=0.01, Regularity regularity = Regularity::SMOOTH);
+
+	bool hasExpression() const { return !_expr.empty(); }
+	const Expr &expression() const { return _expr; }
 
 	RealFunction(const RealFunction &other);
 	RealFunction(RealFunction &&other) noexcept;
@@ -1081,11 +1159,19 @@ public:
 	friend DiscreteRealFunctionNonUniform operator&(const DiscreteRealFunction &f, const DiscreteRealFunction &g);
 };
 
+/**
+ * @class DiscreteComplexFunctionR2
+ * @brief Samples on a samples_t() x samples_x() grid over domain (t) x domain_x(), row t being the function of x at time t.
+ *
+ * Values are stored row-major in one Grid2D, rows and columns are views into it. One dimensional
+ * transforms of rows and columns are run in parallel with shared FFT plans, columns through a blocked transpose.
+ */
 class DiscreteComplexFunctionR2 {
-	vector<DiscreteComplexFunction> fn;
-	vec2 domain;
+	Grid2D<Complex> grid;
+	vec2 domain, _domain_x;
 public:
 	DiscreteComplexFunctionR2(const vector<DiscreteComplexFunction> &fn, vec2 domain);
+	DiscreteComplexFunctionR2(Grid2D<Complex> values, vec2 domain_t, vec2 domain_x);
 	DiscreteComplexFunctionR2(const vector<HOM(float, Complex)> &f, vec2 domain, int sampling);
 
 	DiscreteComplexFunctionR2(const DiscreteComplexFunctionR2 &other) = default;
@@ -1101,6 +1187,13 @@ public:
 	vector<float> args_t() const;
 	vector<float> args_x() const;
 	void setDomain(vec2 dom) { this->domain = dom; }
+	vec2 domain_t() const { return domain; }
+	vec2 domain_x() const { return _domain_x; }
+
+	const Grid2D<Complex> &values() const { return grid; }
+	std::span<const Complex> row(int t) const { return grid.row(t); }
+	StridedView<const Complex> column(int x) const { return grid.column(x); }
+	Complex at(int t, int x) const { return grid(t, x); }
 
 	DiscreteComplexFunctionR2 operator+(const DiscreteComplexFunctionR2 &g) const;
 	DiscreteComplexFunctionR2 operator+(Complex a) const;
@@ -1155,11 +1248,19 @@ public:
 };
 
 
+/**
+ * @class DiscreteRealFunctionR2
+ * @brief Real valued counterpart of DiscreteComplexFunctionR2, with the same layout.
+ */
 class DiscreteRealFunctionR2 {
-	vector<DiscreteRealFunction> fn;
-	vec2 domain;
+	Grid2D<float> grid;
+	vec2 domain, _domain_x;
+
+	// applies f(t, row t) to every row in parallel, for operations defined on DiscreteRealFunction
+	DiscreteRealFunctionR2 mapRows(const std::function<DiscreteRealFunction(int, const DiscreteRealFunction &)> &f) const;
 public:
 	DiscreteRealFunctionR2(const vector<DiscreteRealFunction> &fn, vec2 domain);
+	DiscreteRealFunctionR2(Grid2D<float> values, vec2 domain_t, vec2 domain_x);
 	DiscreteRealFunctionR2(const vector<HOM(float, float)> &f, vec2 domain, int sampling);
 	DiscreteRealFunctionR2(const DiscreteRealFunctionR2 &other) = default;
 	DiscreteRealFunctionR2(DiscreteRealFunctionR2 &&other) noexcept = default;
@@ -1193,8 +1294,14 @@ public:
 	vector<float> args_t() const;
 	vector<float> args_x() const;
 	void setDomain_t(vec2 dom) { this->domain = dom; }
-	void setDomain_x(vec2 dom) { for (auto &f : fn) f.setDomain(dom); }
-	vec2 domain_x() const { return fn[0].getDomain(); }
+	void setDomain_x(vec2 dom) { _domain_x = dom; }
+	vec2 domain_t() const { return domain; }
+	vec2 domain_x() const { return _domain_x; }
+
+	const Grid2D<float> &values() const { return grid; }
+	std::span<const float> row(int t) const { return grid.row(t); }
+	StridedView<const float> column(int x) const { return grid.column(x); }
+	float at(int t, int x) const { return grid(t, x); }
 
 	DiscreteRealFunctionR2 transpose() const;
 	DiscreteRealFunction integrate_t() const;
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "parallel.hpp"
+
+
+/**
+ * @brief Allocator returning storage aligned to Alignment bytes, e.g. to cache lines.
+ */
+template<typename T, std::size_t Alignment=64>
+struct AlignedAllocator {
+	using value_type = T;
+	template<typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+	AlignedAllocator() = default;
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {}
+
+	T *allocate(std::size_t n) { return static_cast<T *>(::operator new(n*sizeof(T), std::align_val_t(Alignment))); }
+	void deallocate(T *p, std::size_t) noexcept { ::operator delete(p, std::align_val_t(Alignment)); }
+
+	template<typename U>
+	bool operator==(const AlignedAllocator<U, Alignment> &) const noexcept { return true; }
+};
+
+
+/**
+ * @class StridedView
+ * @brief Non-owning view of n elements lying stride elements apart, e.g. a column of a row-major grid.
+ */
+template<typename T>
+class StridedView {
+	T *first;
+	int n;
+	std::ptrdiff_t _stride;
+
+public:
+	StridedView(T *first, int n, std::ptrdiff_t stride) : first(first), n(n), _stride(stride) {}
+
+	int size() const { return n; }
+	std::ptrdiff_t stride() const { return _stride; }
+	T &operator[](int i) const { return first[i*_stride]; }
+
+	template<typename U=std::remove_const_t<T>>
+	std::vector<U> copy() const {
+		std::vector<U> res(n);
+		for (int i = 0; i < n; ++i)
+			res[i] = first[i*_stride];
+		return res;
+	}
+};
+
+
+/**
+ * @class Grid2D
+ * @brief Row-major rows x cols array in one aligned allocation.
+ *
+ * Element (i, j) lives at i*stride() + j. The stride equals cols(), so the whole grid is also a flat
+ * span of values() for elementwise work, while rows and columns are exposed as views without copying.
+ */
+template<typename T>
+class Grid2D {
+	std::vector<T, AlignedAllocator<T>> data;
+	int _rows = 0, _cols = 0;
+
+	// tiles of TILE x TILE elements are read and written while both fit in L1
+	static constexpr int TILE = 32;
+
+public:
+	Grid2D() = default;
+	Grid2D(int rows, int cols, const T &value=T()) : data((std::size_t)rows*cols, value), _rows(rows), _cols(cols) {}
+
+	int rows() const { return _rows; }
+	int cols() const { return _cols; }
+	std::size_t stride() const { return _cols; }
+	std::size_t size() const { return data.size(); }
+	bool empty() const { return data.empty(); }
+
+	T &operator()(int i, int j) { return data[i*stride() + j]; }
+	const T &operator()(int i, int j) const { return data[i*stride() + j]; }
+
+	T *rowData(int i) { return data.data() + i*stride(); }
+	const T *rowData(int i) const { return data.data() + i*stride(); }
+	std::span<T> row(int i) { return std::span<T>(rowData(i), _cols); }
+	std::span<const T> row(int i) const { return std::span<const T>(rowData(i), _cols); }
+	StridedView<T> column(int j) { return StridedView<T>(data.data() + j, _rows, stride()); }
+	StridedView<const T> column(int j) const { return StridedView<const T>(data.data() + j, _rows, stride()); }
+	std::span<T> values() { return std::span<T>(data); }
+	std::span<const T> values() const { return std::span<const T>(data); }
+
+	// writes the transpose into out, reallocating it only when its size differs
+	void transposeInto(Grid2D &out, int threads=0) const {
+		if (out._rows != _cols || out._cols != _rows) {
+			if (out.data.size() != data.size())
+				out.data.resize(data.size());
+			out._rows = _cols;
+			out._cols = _rows;
+		}
+		int tileRows = (_rows + TILE - 1)/TILE;
+		int blocks = std::min(resolveThreadCount(threads), std::max(tileRows, 1));
+		parallelFor(blocks, blocks, [&](int b) {
+			for (int ti = tileRows*b/blocks*TILE; ti < tileRows*(b + 1)/blocks*TILE && ti < _rows; ti += TILE)
+				for (int tj = 0; tj < _cols; tj += TILE) {
+					int ie = std::min(ti + TILE, _rows), je = std::min(tj + TILE, _cols);
+					for (int i = ti; i < ie; ++i)
+						for (int j = tj; j < je; ++j)
+							out(j, i) = (*this)(i, j);
+				}
+		});
+	}
+
+	Grid2D transposed(int threads=0) const {
+		Grid2D res;
+		transposeInto(res, threads);
+		return res;
+	}
+};
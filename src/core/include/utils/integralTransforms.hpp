@@ -1,6 +1,7 @@
 #pragma once
 
 #include "func.hpp"
+#include "stft.hpp"
 
 
 RealFunction dirichlet_kernel(int n, float L=TAU);
@@ -127,6 +128,12 @@ public:
 };
 
 
+/**
+ * @class DiscreteGaborTransform
+ * @brief Short-time Fourier transform with a Gaussian window, frames centred every step samples.
+ * @note Computed by STFTEngine; use it directly for long signals, streaming input or resynthesis,
+ * as the result here expands every frame to all frequencies.
+ */
 class DiscreteGaborTransform {
 	DiscreteRealFunction shroom_kernel;
 	int step;
@@ -135,34 +142,11 @@ public:
 	explicit DiscreteGaborTransform(int k, int step=1) : DiscreteGaborTransform(DiscreteRealFunction(EXP_R&(-X_R*X_R*PI), vec2(-1.91, 1.91), k), step) {}
 
 	int window_size() const { return shroom_kernel.samples(); }
+	STFTEngine engine() const { return STFTEngine(shroom_kernel.getVector().vec(), step); }
 
-	DiscreteComplexFunctionR2 transform(const DiscreteRealFunction &f) const {
-		vector<DiscreteComplexFunction> res;
-		int win_size = window_size();
-		auto padded = f.two_sided_zero_padding(f.samples() + win_size);
-		for (int i = 0; i < padded.samples()-win_size; i+=step) {
-			auto piece = (padded.slice(i, i+win_size)*shroom_kernel).fft();
-			piece.setDom(-1, 1);
-			// for (int j = 0; j < step; j++)
-			res.push_back(piece);
-		}
-		return DiscreteComplexFunctionR2(res, f.getDomain());
-	}
-
-	DiscreteComplexFunctionR2 transform_print(const DiscreteRealFunction &f) const {
-		vector<DiscreteComplexFunction> res;
-		int win_size = window_size();
-		auto padded = f.two_sided_zero_padding(f.samples() + win_size);
-		for (int i = 0; i < padded.samples()-win_size; i+=step) {
-			auto piece = (padded.slice(i, i+win_size)*shroom_kernel).fft();
-			piece.setDom(-1, 1);
-			res.push_back(piece);
-			if (i % ((padded.samples()-win_size)/20) < step)
-				std::cout << "progress: " << (int)100.f*(i+1)/(padded.samples()-win_size) << "%" << std::endl;
-
-		}
-		return DiscreteComplexFunctionR2(res, f.getDomain());
-	}
+	DiscreteComplexFunctionR2 transform(const DiscreteRealFunction &f, int threads=0) const;
+	// transform logging its size and duration
+	DiscreteComplexFunctionR2 transform_print(const DiscreteRealFunction &f, int threads=0) const;
 };
 
 
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+/**
+ * @class JobCounter
+ * @brief Number of unfinished jobs of a group and the first exception any of them threw.
+ */
+class JobCounter {
+	std::atomic<int> pending = 0;
+	std::mutex errorMutex;
+	std::exception_ptr error = nullptr;
+
+	friend class JobSystem;
+	void fail(std::exception_ptr e);
+
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter &) = delete;
+	JobCounter &operator=(const JobCounter &) = delete;
+
+	bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+
+template<typename T>
+class JobFuture;
+
+
+/**
+ * @class JobSystem
+ * @brief Fixed pool of workers with one work-stealing deque each, shared by the engine through global().
+ *
+ * A worker pushes and pops jobs at the back of its own deque and steals from the front of the others', so
+ * recently split work stays in cache while idle workers take the largest pieces. Threads outside of the pool
+ * submit into a shared injection queue. wait executes queued jobs until the awaited ones finish, so jobs may
+ * submit and wait for further jobs without deadlocking; idle workers sleep on a condition variable.
+ *
+ * JobSystem(1) has no workers and is the deterministic serial mode: every job runs inline when submitted,
+ * parallel loops run their chunks in ascending order and task graphs run in insertion order among ready tasks.
+ */
+class JobSystem {
+	struct Job {
+		std::function<void()> work;
+		JobCounter *counter = nullptr;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	// one queue per worker, the last one is the injection queue of outside threads
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> queued = 0, sleepers = 0;
+	bool stopping = false;
+
+	void push(Job &&job);
+	bool pop(Job &job);
+	static void execute(Job &job);
+	void workerLoop(int index);
+
+public:
+	// threads counts the calling thread, 0 uses std::thread::hardware_concurrency()
+	explicit JobSystem(int threads=0);
+	// finishes every queued job before joining the workers
+	~JobSystem();
+	JobSystem(const JobSystem &) = delete;
+	JobSystem &operator=(const JobSystem &) = delete;
+
+	// created on first use with hardware_concurrency() threads
+	static JobSystem &global();
+	// replaces the global system, e.g. configureGlobal(1) for serial debugging; no job may be running
+	static void configureGlobal(int threads);
+
+	int threads() const { return workers.size() + 1; }
+	bool serial() const { return workers.empty(); }
+	// chunk size of parallel loops giving each thread about eight chunks to balance with
+	int autoGrain(int n) const { return std::max(1, n/(8*threads())); }
+
+	void submit(JobCounter &counter, std::function<void()> work);
+	// runs jobs until the counter drops to zero, then rethrows the first exception of its jobs
+	void wait(JobCounter &counter);
+	// runs one queued job if there is any
+	bool runPending();
+
+	template<typename F>
+	auto async(F &&f) -> JobFuture<std::invoke_result_t<F>>;
+
+	/**
+	 * @brief Calls f(begin, end) on disjoint chunks covering [0, n), each of at most grain indices and starting
+	 * at a multiple of grain (autoGrain(n) when grain <= 0). Returns when all chunks are done.
+	 * @note The range is split in halves recursively, so the calling thread keeps working on the first chunk
+	 * while the other halves are stolen.
+	 */
+	template<typename F>
+	void parallelForRange(int n, F &&f, int grain=0);
+
+	// calls f(i) for every i in [0, n)
+	template<typename F>
+	void parallelFor(int n, F &&f, int grain=0) {
+		parallelForRange(n, [&f](int begin, int end) {
+			for (int i = begin; i < end; ++i)
+				f(i);
+		}, grain);
+	}
+};
+
+
+/**
+ * @class JobFuture
+ * @brief Result of JobSystem::async, get waits by helping with queued jobs and rethrows an exception of the job.
+ */
+template<typename T>
+class JobFuture {
+	struct State {
+		JobCounter counter;
+		std::conditional_t<std::is_void_v<T>, char, std::optional<T>> value;
+	};
+	std::shared_ptr<State> state;
+	JobSystem *system = nullptr;
+
+	friend class JobSystem;
+
+public:
+	JobFuture() = default;
+
+	bool valid() const { return state != nullptr; }
+	bool ready() const { return state->counter.done(); }
+	void wait() const { system->wait(state->counter); }
+
+	T get() {
+		wait();
+		if constexpr (!std::is_void_v<T>)
+			return std::move(*state->value);
+	}
+};
+
+
+/**
+ * @class TaskGraph
+ * @brief Tasks with dependencies, run so that every task starts after all tasks it depends on have finished.
+ *
+ * The graph can be run repeatedly. A task that throws is not followed by the tasks depending on it,
+ * the other branches still run and run rethrows the first exception at the end.
+ */
+class TaskGraph {
+	struct Task {
+		std::function<void()> work;
+		std::vector<int> successors;
+		int dependencies = 0;
+	};
+	std::vector<Task> tasks;
+
+public:
+	int add(std::function<void()> work, const std::vector<int> &dependencies={});
+	// after waits for before
+	void precede(int before, int after);
+	int size() const { return tasks.size(); }
+
+	// throws IllegalArgumentError when the dependencies contain a cycle
+	void run(JobSystem &system=JobSystem::global()) const;
+};
+
+
+template<typename F>
+auto JobSystem::async(F &&f) -> JobFuture<std::invoke_result_t<F>> {
+	using T = std::invoke_result_t<F>;
+	JobFuture<T> future;
+	future.state = std::make_shared<typename JobFuture<T>::State>();
+	future.system = this;
+	submit(future.state->counter, [state=future.state, f=std::forward<F>(f)]() mutable {
+		if constexpr (std::is_void_v<T>)
+			f();
+		else
+			state->value.emplace(f());
+	});
+	return future;
+}
+
+template<typename F>
+void JobSystem::parallelForRange(int n, F &&f, int grain) {
+	if (n <= 0)
+		return;
+	if (grain <= 0)
+		grain = autoGrain(n);
+	if (serial() || n <= grain) {
+		for (int begin = 0; begin < n; begin += grain)
+			f(begin, std::min(begin + grain, n));
+		return;
+	}
+	JobCounter counter;
+	auto split = [this, &f, &counter, grain](auto &self, int begin, int end) -> void {
+		while (end - begin > grain) {
+			int chunks = (end - begin + grain - 1)/grain;
+			int mid = begin + chunks/2*grain;
+			submit(counter, [&self, mid, end] { self(self, mid, end); });
+			end = mid;
+		}
+		f(begin, end);
+	};
+	try {
+		split(split, 0, n);
+	} catch (...) {
+		counter.fail(std::current_exception());
+	}
+	wait(counter);
+}
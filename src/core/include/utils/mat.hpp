@@ -451,7 +451,7 @@ FiniteSequence<T> &FiniteSequence<T>::operator=(FiniteSequence &&other) noexcept
 
 template<Rng T>
 T FiniteSequence<T>::at(int i) const {
-	if (i < -coefs_negative.size() || i >= coefs_positive.size())
+	if (i < -static_cast<int>(coefs_negative.size()) || i >= static_cast<int>(coefs_positive.size()))
 		throw IndexOutOfBounds(i, n_max() - n_min() + 1, "FiniteSequence::at: index out of bounds", __FILE__, __LINE__);
 	if (i >= 0)
 		return coefs_positive[i];
@@ -690,6 +690,9 @@ public:
 	bool square() const;
 	bool symmetric() const;
 
+	// PA = LU with partial pivoting, lu holds L below (unit diagonal implied) and U on and above the diagonal,
+	// row k of PA is row rowOrder[k] of A. Returns the sign of P, or 0 when the matrix is singular.
+	int decomposeLU(vector<R> &lu, vector<int> &rowOrder) const;
 	R det() const;
 	R minor(int i, int j) const;
 	R trace() const;
@@ -731,26 +734,6 @@ Matrix<R> norm2(const Matrix<R> &M) {
 
 
 
-class SparseMatrix {
-	vector<vector<std::pair<int, float> > > data;
-	int n, m;
-
-public:
-	SparseMatrix(int n, int m);
-
-	void set(int i, int j, float val);
-	float get(int i, int j);
-	ivec2 size() const { return ivec2(n, m); }
-
-	float operator()(int i, int j) { return get(i, j); }
-	SparseMatrix operator*(float f);
-	SparseMatrix operator+(const SparseMatrix &M);
-	SparseMatrix operator-(const SparseMatrix &M);
-};
-
-
-
-
 class FloatVector {
 	vector<float> data;
 
@@ -1441,7 +1424,7 @@ Morphism<domain, codomain> Morphism<domain, codomain>::operator*(R a) const requ
 
 template<Rng T>
 Vector<T>::Vector(vector<T> c)
-: n(c.size()), coefs(c) {}
+: n(c.size()), coefs(std::move(c)) {}
 
 template<Rng T>
 Vector<T>::Vector(int n, std::function<T(int)> f)
@@ -1664,9 +1647,9 @@ Matrix<R> Matrix<R>::operator-() const { return *this * -1; }
 template<typename R>
 Matrix<R> Matrix<R>::operator~() const {
 	if (rows != cols) throw std::format_error("Matrix must be square");
-	if (rows == 1) return Matrix(1, 1, [this](int i, int j){ return 1.f / coefs[0][0]; });
-	if (rows == 2) return Matrix(coefs[1][1], -coefs[0][1], -coefs[1][0], coefs[0][0]) / det();
-	return adjugate() / det();
+	if (rows == 1) return Matrix(1, 1, [this](int i, int j){ return R(1.f) / coefs[0]; });
+	if (rows == 2) return Matrix(coefs[3], -coefs[1], -coefs[2], coefs[0]) / det();
+	return inv();
 }
 
 template<typename R>
@@ -1689,25 +1672,57 @@ bool Matrix<R>::square() const { return rows == cols; }
 template<typename R>
 bool Matrix<R>::symmetric() const { return square() and *this == transpose(); }
 
+template<typename R>
+int Matrix<R>::decomposeLU(vector<R> &lu, vector<int> &rowOrder) const {
+	if (rows != cols) throw std::invalid_argument("Matrix must be square");
+	lu = coefs;
+	rowOrder.resize(rows);
+	for (int i = 0; i < rows; i++) rowOrder[i] = i;
+	int sign = 1;
+	for (int k = 0; k < rows; k++) {
+		int p = k;
+		for (int i = k + 1; i < rows; i++)
+			if (abs(lu[i * cols + k]) > abs(lu[p * cols + k])) p = i;
+		if (abs(lu[p * cols + k]) == 0) return 0;
+		if (p != k) {
+			std::swap_ranges(lu.begin() + k * cols, lu.begin() + (k + 1) * cols, lu.begin() + p * cols);
+			std::swap(rowOrder[k], rowOrder[p]);
+			sign = -sign;
+		}
+		for (int i = k + 1; i < rows; i++) {
+			R l = lu[i * cols + k] / lu[k * cols + k];
+			lu[i * cols + k] = l;
+			for (int j = k + 1; j < cols; j++)
+				lu[i * cols + j] = lu[i * cols + j] - l * lu[k * cols + j];
+		}
+	}
+	return sign;
+}
+
 template<typename T>
 T Matrix<T>::det() const {
 	if (rows != cols) throw std::invalid_argument("Matrix must be square");
-	if (rows == 1) return coefs[0][0];
-	if (rows == 2) return coefs[0][0] * coefs[1][1] - coefs[0][1] * coefs[1][0];
-	T result = 0;
-	for (int j = 0; j < cols; j++)
-		result += coefs[0][j] * minor(0, j) * (j % 2 == 0 ? 1 : -1);
+	if (rows == 1) return coefs[0];
+	if (rows == 2) return coefs[0] * coefs[3] - coefs[1] * coefs[2];
+	vector<T> lu;
+	vector<int> rowOrder;
+	int sign = decomposeLU(lu, rowOrder);
+	if (sign == 0) return T(0.f);
+	T result = T(float(sign));
+	for (int k = 0; k < rows; k++)
+		result = result * lu[k * cols + k];
 	return result;
 }
 
 template<typename R>
 R Matrix<R>::minor(int i, int j) const {
 	if (rows != cols) throw std::invalid_argument("Matrix must be square");
-	Matrix<R> result = Matrix<R>(rows - 1, cols - 1);
+	vector<R> sub;
+	sub.reserve((rows - 1) * (cols - 1));
 	for (int k = 0; k < rows; k++)
 		for (int l = 0; l < cols; l++)
-			if (k != i && l != j) result[k < i ? k : k - 1][l < j ? l : l - 1] = coefs[k][l];
-	return result.det();
+			if (k != i && l != j) sub.push_back(coefs[k * cols + l]);
+	return Matrix<R>(std::move(sub), rows - 1, cols - 1).det();
 }
 
 
@@ -1742,10 +1757,10 @@ Matrix<R> Matrix<R>::operator+(const Matrix &M) const {
 template<typename R>
 Matrix<R> Matrix<R>::operator*(const Matrix &M) const {
 	if (cols != M.rows) throw std::invalid_argument("Matrix dimensions must agree");
-	return Matrix(rows, M.cols, [this, M](int i, int j){
-		R sum = coefs[0][0] * 0;
-		for (int k = 0; k < cols; k++)
-			sum += coefs[i][k] * M[k][j];
+	return Matrix(rows, M.cols, [this, &M](int i, int j){
+		R sum = coefs[i * cols] * M.coefs[j];
+		for (int k = 1; k < cols; k++)
+			sum += coefs[i * cols + k] * M.coefs[k * M.cols + j];
 		return sum;
 	});
 }
@@ -1800,7 +1815,28 @@ template<typename R>
 Matrix<R> Matrix<R>::adjugate() const { return Matrix(rows, cols, [this](int i, int j){ return minor(j, i) * ((i + j) % 2 == 0 ? 1 : -1); }); }
 
 template<typename R>
-Matrix<R> Matrix<R>::inv() const { return adjugate() / det(); }
+Matrix<R> Matrix<R>::inv() const {
+	vector<R> lu;
+	vector<int> rowOrder;
+	if (decomposeLU(lu, rowOrder) == 0) throw std::invalid_argument("Matrix must be invertible");
+	// column j of the inverse solves LU x = P e_j
+	vector<R> res(rows * cols);
+	vector<R> x(rows);
+	for (int j = 0; j < cols; j++) {
+		for (int i = 0; i < rows; i++) {
+			R s = R(rowOrder[i] == j ? 1.f : 0.f);
+			for (int k = 0; k < i; k++) s = s - lu[i * cols + k] * x[k];
+			x[i] = s;
+		}
+		for (int i = rows - 1; i >= 0; i--) {
+			R s = x[i];
+			for (int k = i + 1; k < cols; k++) s = s - lu[i * cols + k] * x[k];
+			x[i] = s / lu[i * cols + i];
+		}
+		for (int i = 0; i < rows; i++) res[i * cols + j] = x[i];
+	}
+	return Matrix(std::move(res), rows, cols);
+}
 
 template<typename R>
 Matrix<R> Matrix<R>::pow(int p) const {
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "jobSystem.hpp"
+
+
+/**
+ * @brief Thread count convention of the parallel engine routines: 0 (or less) picks std::thread::hardware_concurrency(),
+ * 1 runs serially on the calling thread and n keeps at most n threads of the global JobSystem busy with the call.
+ */
+inline int resolveThreadCount(int threads) {
+	return threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+/**
+ * @brief Runs f(k) for k in [0, n) on at most threads threads (a count already resolved by resolveThreadCount).
+ * @note Runs inline and in order when one thread suffices. With fewer threads than the JobSystem has, only that many jobs
+ * are submitted and each takes the next unclaimed index until none is left. The first exception thrown by any f(k)
+ * is rethrown after all jobs finished.
+ */
+template<typename F>
+void parallelFor(int n, int threads, F &&f) {
+	threads = std::min(threads, n);
+	if (threads <= 1) {
+		for (int k = 0; k < n; ++k)
+			f(k);
+		return;
+	}
+	JobSystem &jobs = JobSystem::global();
+	if (threads >= jobs.threads()) {
+		jobs.parallelFor(n, f, 1);
+		return;
+	}
+	std::atomic<int> next = 0;
+	jobs.parallelFor(threads, [&](int) {
+		for (int k = next++; k < n; k = next++)
+			f(k);
+	}, 1);
+}
+
+
+/**
+ * @class WorkerPool
+ * @brief Handle of a subsystem on the global JobSystem for loops run every frame.
+ *
+ * forRange(n, grain, f) calls f(begin, end) on chunks of [0, n) of at most grain indices starting at multiples of grain,
+ * run by at most threads() workers of the job system at a time. It returns when all chunks are done and rethrows the first exception.
+ * A pool of one thread runs f(0, n) inline, otherwise forRange may be nested and called from several threads.
+ */
+class WorkerPool {
+	int _threads;
+
+public:
+	explicit WorkerPool(int threads=0) : _threads(std::min(resolveThreadCount(threads), JobSystem::global().threads())) {}
+
+	int threads() const { return _threads; }
+
+	template<typename F>
+	void forRange(int n, int grain, F &&f) {
+		if (n <= 0)
+			return;
+		if (_threads <= 1 || n <= grain) {
+			f(0, n);
+			return;
+		}
+		grain = std::max(1, grain);
+		if (_threads >= JobSystem::global().threads()) {
+			JobSystem::global().parallelForRange(n, f, grain);
+			return;
+		}
+		parallelFor((n + grain - 1)/grain, _threads, [&](int chunk) { f(chunk*grain, std::min(n, (chunk + 1)*grain)); });
+	}
+};
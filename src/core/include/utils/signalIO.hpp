@@ -0,0 +1,90 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "filesUtils.hpp"
+#include "func.hpp"
+#include "stft.hpp"
+
+
+// sample encodings of signal files, integer PCM is scaled to [-1, 1) on reading
+enum class SampleFormat { PCM_U8, PCM_S16, PCM_S24, PCM_S32, FLOAT32, FLOAT64 };
+
+int bytesPerSample(SampleFormat format);
+
+
+/**
+ * @struct SignalInfo
+ * @brief Layout of a signal file, frames of channels interleaved samples each, starting at dataOffset.
+ */
+struct SignalInfo {
+	SampleFormat format = SampleFormat::FLOAT32;
+	int channels = 1;
+	int sampleRate = 0; // 0 when the file does not store one
+	long long frames = 0;
+	size_t dataOffset = 0;
+	size_t frameBytes() const { return (size_t)channels*bytesPerSample(format); }
+};
+
+
+/**
+ * @class SignalReader
+ * @brief Reads one channel of a binary signal file, mapped into memory and converted in chunks.
+ *
+ * The format is recognised by the extension:
+ *  - .wav, PCM with 8, 16, 24 or 32 bit samples and IEEE float (also WAVE_FORMAT_EXTENSIBLE), any number of channels;
+ *  - .npy, little endian float32 or float64 arrays of shape (n,) or (n, channels) in C order;
+ *  - .f32, .raw, .bin and .f64, headerless little endian float32 and float64 samples.
+ * Only the pages touched by read are loaded, so files longer than memory can be processed in a loop of reads.
+ */
+class SignalReader {
+	ReadOnlyFileMapping file;
+	const char *base = nullptr;
+	SignalInfo _info;
+	int _channel;
+	long long position = 0;
+
+	void openRaw(SampleFormat format, int channels, int channel);
+	void selectChannel(int channel);
+
+public:
+	explicit SignalReader(const Path &path, int channel=0);
+	// headerless file of interleaved samples in given format, whatever its extension
+	SignalReader(const Path &path, SampleFormat format, int channels, int channel=0);
+
+	const SignalInfo &info() const { return _info; }
+	int channel() const { return _channel; }
+	long long frames() const { return _info.frames; }
+	long long tell() const { return position; }
+	long long remaining() const { return _info.frames - position; }
+	void seek(long long frame);
+
+	// converts the next min(out.size(), remaining()) samples of the channel into out and returns their number
+	size_t read(std::span<float> out);
+	// all remaining samples, blocks are converted in parallel
+	vector<float> readAll(int threads=0);
+};
+
+
+// whether the extension is one read by SignalReader
+bool isBinarySignalFile(const Path &path);
+
+DiscreteRealFunction loadSignal(const Path &path, vec2 domain, int channel=0);
+// domain is [0, duration in seconds] when the file stores a sample rate and [0, 1] otherwise
+DiscreteRealFunction loadSignal(const Path &path, int channel=0);
+
+// binary signal files go through loadSignal, anything else is read as text with one number per line,
+// skipping empty lines and those starting with #, /, space or tab
+DiscreteRealFunction loadSequence(const CodeFileDescriptor &file, vec2 domain, int channel=0);
+
+
+// samples are interleaved when channels > 1, integer formats clamp to [-1, 1]
+void writeWav(const Path &path, std::span<const float> samples, int sampleRate, SampleFormat format=SampleFormat::PCM_S16, int channels=1);
+void writeRaw(const Path &path, std::span<const float> samples, SampleFormat format=SampleFormat::FLOAT32);
+// float32 array of shape (n,)
+void writeNpy(const Path &path, std::span<const float> samples);
+// complex64 array of shape (frames, bins)
+void writeNpy(const Path &path, const Spectrogram &spectra);
+Spectrogram loadSpectrogram(const Path &path);
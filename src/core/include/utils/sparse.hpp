@@ -0,0 +1,138 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "mat.hpp"
+#include "parallel.hpp"
+
+
+// entry of a matrix in coordinate (COO) form
+struct SparseEntry {
+	int row, col;
+	float value;
+};
+
+
+/**
+ * @class SparseMatrix
+ * @brief n x m matrix in compressed sparse row (CSR) form.
+ *
+ * Row i occupies [offsets[i], offsets[i+1]) of the column and value arrays, columns of a row are sorted
+ * and unique, so a lookup costs O(log degree) and a product touches every stored entry once.
+ * The pattern is fixed after assembly, arithmetic returns new matrices.
+ */
+class SparseMatrix {
+	int n = 0, m = 0;
+	vector<int> offsets = {0};
+	vector<int> columns;
+	vector<float> entries;
+
+	// rows [begin, end) of y = Ax
+	template<typename T>
+	void multiplyRows(std::span<const T> x, std::span<T> y, int begin, int end) const;
+
+public:
+	SparseMatrix() = default;
+	// zero matrix
+	SparseMatrix(int n, int m);
+	// assembles the triplets, duplicates are summed and explicit zeros are kept in the pattern
+	SparseMatrix(int n, int m, std::span<const SparseEntry> triplets);
+	static SparseMatrix identity(int n);
+	static SparseMatrix diagonal(std::span<const float> d);
+
+	int rows() const { return n; }
+	int cols() const { return m; }
+	ivec2 size() const { return ivec2(n, m); }
+	int nonZeros() const { return columns.size(); }
+	bool square() const { return n == m; }
+
+	float get(int i, int j) const;
+	float operator()(int i, int j) const { return get(i, j); }
+	std::span<const int> rowColumns(int i) const { return {columns.data() + offsets[i], columns.data() + offsets[i+1]}; }
+	std::span<const float> rowValues(int i) const { return {entries.data() + offsets[i], entries.data() + offsets[i+1]}; }
+	std::span<float> rowValues(int i) { return {entries.data() + offsets[i], entries.data() + offsets[i+1]}; }
+	vector<float> diagonal() const;
+	bool samePattern(const SparseMatrix &M) const { return n == M.n && m == M.m && offsets == M.offsets && columns == M.columns; }
+	bool symmetric(float tolerance=0) const;
+
+	// y = Ax, rows are split into blocks of similar entry counts run on given number of threads
+	void multiply(std::span<const float> x, std::span<float> y, int threads=0) const;
+	void multiply(std::span<const float> x, std::span<float> y, WorkerPool &pool) const;
+	void multiply(std::span<const double> x, std::span<double> y, WorkerPool &pool) const;
+	vector<float> operator*(std::span<const float> x) const;
+
+	SparseMatrix transpose() const;
+	SparseMatrix operator*(float f) const;
+	SparseMatrix operator+(const SparseMatrix &M) const;
+	SparseMatrix operator-(const SparseMatrix &M) const;
+	SparseMatrix operator*(const SparseMatrix &M) const;
+	SparseMatrix operator-() const { return *this * -1.f; }
+};
+
+
+enum class SparsePreconditioner { NONE, JACOBI, ILU0 };
+
+struct IterativeSolverSettings {
+	float tolerance = 1e-6f; // on the residual relative to the right hand side
+	int maxIterations = 1000;
+	SparsePreconditioner preconditioner = SparsePreconditioner::JACOBI;
+	int threads = 0;
+};
+
+struct IterativeSolverReport {
+	int iterations = 0;
+	float residual = 0; // |b - Ax| / |b| at exit
+	bool converged = false;
+};
+
+/**
+ * @brief Preconditioned conjugate gradient for symmetric positive definite A, x holds the initial guess.
+ * @note ILU(0) of a symmetric matrix is its incomplete LDLᵀ factorisation, so it is a valid preconditioner here.
+ */
+IterativeSolverReport conjugateGradient(const SparseMatrix &A, std::span<const float> b, std::span<float> x, const IterativeSolverSettings &settings={});
+// right preconditioned BiCGSTAB for general square A, x holds the initial guess
+IterativeSolverReport biCGSTAB(const SparseMatrix &A, std::span<const float> b, std::span<float> x, const IterativeSolverSettings &settings={});
+
+
+enum class FillReducingOrdering { NATURAL, MINIMUM_DEGREE, NESTED_DISSECTION };
+
+/**
+ * @class SparseLDLT
+ * @brief Simplicial LDLᵀ factorisation PAPᵀ = LDLᵀ of a symmetric matrix with nonzero pivots.
+ *
+ * The constructor orders the unknowns, computes the elimination tree and the pattern of L once,
+ * then factorize refills the values of any matrix with the same pattern, e.g. a Laplacian with a new
+ * time step, and each solve is two triangular sweeps. A is either stored in full, then it has to be
+ * symmetric up to a relative 1e-6, or as its lower or upper triangle, which is mirrored before the analysis.
+ * Positive definite matrices never meet a zero pivot, indefinite ones may, which throws a ValueError.
+ */
+class SparseLDLT {
+	SparseMatrix pattern;
+	vector<int> permutation, inversePermutation;
+	vector<int> parent, columnOffsets, rowIds;
+	vector<double> factor, pivots;
+
+	// A itself, or its stored triangle mirrored into the given matrix; throws if A is stored in full and not symmetric
+	static const SparseMatrix &fullStorage(const SparseMatrix &A, SparseMatrix &mirrored);
+	void factorizeFull(const SparseMatrix &A);
+
+public:
+	explicit SparseLDLT(const SparseMatrix &A, FillReducingOrdering ordering=FillReducingOrdering::NESTED_DISSECTION);
+
+	void factorize(const SparseMatrix &A);
+	void solve(std::span<const float> b, std::span<float> x) const;
+	vector<float> solve(std::span<const float> b) const;
+
+	int size() const { return pivots.size(); }
+	int factorNonZeros() const { return rowIds.size(); }
+	const vector<int> &ordering() const { return permutation; }
+	// log |det A| and the sign of det A
+	std::pair<double, int> logDeterminant() const;
+};
+
+// minimum degree elimination order of the pattern of A + Aᵀ, the elimination graph is explicit,
+// so it suits small or irregular patterns better than large meshes
+vector<int> minimumDegreeOrdering(const SparseMatrix &A);
+// recursive bisection of the graph of A + Aᵀ by breadth first level separators, each separator is ordered after both halves
+vector<int> nestedDissectionOrdering(const SparseMatrix &A);
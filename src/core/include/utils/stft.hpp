@@ -0,0 +1,120 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "fft.hpp"
+#include "func.hpp"
+#include "parallel.hpp"
+
+
+/**
+ * @class Spectrogram
+ * @brief Short-time spectra stored contiguously, one row of bins per frame.
+ */
+class Spectrogram {
+	vector<Complex> data;
+	int _frames = 0, _bins = 0;
+
+public:
+	Spectrogram() = default;
+	Spectrogram(int frames, int bins) : data((size_t)frames*bins), _frames(frames), _bins(bins) {}
+
+	int frames() const { return _frames; }
+	int bins() const { return _bins; }
+	size_t bytes() const { return data.size()*sizeof(Complex); }
+
+	Complex *frame(int t) { return data.data() + (size_t)t*_bins; }
+	const Complex *frame(int t) const { return data.data() + (size_t)t*_bins; }
+	Complex &operator()(int t, int k) { return data[(size_t)t*_bins + k]; }
+	Complex operator()(int t, int k) const { return data[(size_t)t*_bins + k]; }
+};
+
+
+/**
+ * @class STFTEngine
+ * @brief Short-time Fourier transform of real signals with a fixed window, hop and transform length.
+ *
+ * Frame t starts at sample t*hop - padding and covers windowSize() samples, zero outside of the signal,
+ * which are multiplied by the window and zero padded at the end to fftSize(). A signal of n samples has
+ * ceil(n/hop) frames. The convention is that of DiscreteRealFunction::fft; as the input is real, only the
+ * fftSize()/2 + 1 non-negative frequencies are kept, the others are their conjugates.
+ *
+ * The window and FFT plans are built once. Frames are transformed two at a time, as real and imaginary
+ * part of one complex FFT, into thread local scratch, so analysis allocates nothing but its output.
+ */
+class STFTEngine {
+	vector<float> _window;
+	int _hop, _fft_size, _padding;
+	shared_ptr<const FFTPlan> forward, backward;
+
+public:
+	// fftSize 0 takes the window size, negative padding centres frames at multiples of hop
+	STFTEngine(vector<float> window, int hop, int fftSize=0, int padding=-1);
+
+	static vector<float> hannWindow(int n);
+	// exp(-pi x^2) sampled on [-width, width], the kernel of DiscreteGaborTransform
+	static vector<float> gaussianWindow(int n, float width=1.91f);
+
+	int windowSize() const { return _window.size(); }
+	int hop() const { return _hop; }
+	int fftSize() const { return _fft_size; }
+	int padding() const { return _padding; }
+	int bins() const { return _fft_size/2 + 1; }
+	const vector<float> &window() const { return _window; }
+	int frameCount(long long samples) const { return (samples + _hop - 1)/_hop; }
+	long long frameStart(int t) const { return (long long)t*_hop - _padding; }
+
+	/**
+	 * @brief Spectra of frames [first, first + count) into out, count rows of bins().
+	 * @param samples signal samples with indices [offset, offset + samples.size()), the signal is zero elsewhere
+	 */
+	void transformFrames(std::span<const float> samples, long long offset, int first, int count, Complex *out) const;
+
+	Spectrogram analyse(std::span<const float> signal, int threads=0) const;
+	// weighted overlap-add of the inverse transforms of the frames, exact for unmodified spectra wherever the windows cover the signal
+	vector<float> synthesise(const Spectrogram &spectra, int samples, int threads=0) const;
+
+	// all fftSize() frequencies of every frame, for the function algebra of DiscreteComplexFunctionR2
+	DiscreteComplexFunctionR2 fullSpectrum(const Spectrogram &spectra, vec2 domain) const;
+};
+
+
+/**
+ * @class STFTStream
+ * @brief Incremental analysis, frames are emitted in order as soon as the samples they cover arrived.
+ *
+ * Only the samples still needed by the next frame are kept, and frames ready after a push are computed
+ * in batches of at most batchFrames, so memory does not grow with the length of the stream.
+ */
+class STFTStream {
+public:
+	using Emit = std::function<void(int frame, std::span<const Complex> spectrum)>;
+
+private:
+	STFTEngine engine;
+	Emit emit;
+	int batch_frames;
+	unique_ptr<WorkerPool> pool;
+	vector<float> buffer;
+	long long buffer_start;
+	long long received = 0;
+	int next_frame = 0;
+	bool finished = false;
+	Spectrogram scratch;
+
+	void emitFrames(int end);
+
+public:
+	STFTStream(const STFTEngine &engine, Emit emit, int threads=1, int batchFrames=64);
+
+	void push(std::span<const float> samples);
+	// emits the remaining frames of the ceil(n/hop) covering the received samples, with zeros after the end
+	void finish();
+
+	int framesEmitted() const { return next_frame; }
+	long long samplesReceived() const { return received; }
+	int bufferedSamples() const { return buffer.size(); }
+};
@@ -60,7 +60,7 @@ void RigidBodyTriangulated2D::approximateInertiaTensor(vec3 p) {
 	mat3 result = mat3(0);
 	float totalArea = 0;
 	for (auto &id: mesh->getPolyGroupIDs())
-		for (auto &tr: mesh->getTriangles(id)) {
+		for (auto tr: mesh->triangleView(id)) {
 			vec3 center = tr.center();
 			vec3 r = center - p;
 			result += mat3(r.y * r.y + r.z * r.z, -r.x * r.y, -r.x * r.z, -r.x * r.y, r.x * r.x + r.z * r.z, -r.y * r.z, -r.x * r.z, -r.y * r.z, r.x * r.x + r.y * r.y) * tr.area();
@@ -77,7 +77,7 @@ void RigidBodyTriangulated2D::calculateCenterOfMass() {
 	vec3 sum = vec3(0);
 	float totalArea = .01;
 	for (auto &id: mesh->getPolyGroupIDs())
-		for (auto &tr: mesh->getTriangles(id)) {
+		for (auto tr: mesh->triangleView(id)) {
 			vec3 center = tr.center();
 			sum += center * tr.area();
 			totalArea += tr.area();
@@ -139,7 +139,7 @@ float RollingBody::I_zz(vec3 p) {
 float RollingBody::I_0() {
 	float result = 0;
 	float totalArea = 0;
-	for (auto &tr: mesh->getTriangles(boundaryID)) {
+	for (auto tr: mesh->triangleView(boundaryID)) {
 		vec3 center = tr.center();
 		vec3 r = center - centerOfMass;
 		result += tr.area() * (r.x * r.x + r.y * r.y);
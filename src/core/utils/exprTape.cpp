@@ -0,0 +1,428 @@
+#include "exprTape.hpp"
+
+#include <bit>
+#include <climits>
+#include <unordered_map>
+#include <unordered_set>
+
+
+namespace {
+	float applyOp(ExprOp op, float a, float b, float value) {
+		switch (op) {
+			case ExprOp::ADD: return a + b;
+			case ExprOp::SUB: return a - b;
+			case ExprOp::MUL: return a * b;
+			case ExprOp::DIV: return a / b;
+			case ExprOp::MIN: return std::min(a, b);
+			case ExprOp::MAX: return std::max(a, b);
+			case ExprOp::NEG: return -a;
+			case ExprOp::SQRT: return std::sqrt(a);
+			case ExprOp::SIN: return std::sin(a);
+			case ExprOp::COS: return std::cos(a);
+			case ExprOp::EXP: return std::exp(a);
+			case ExprOp::LOG: return std::log(a);
+			case ExprOp::ABS: return std::abs(a);
+			case ExprOp::SIGN: return (a > 0) - (a < 0);
+			case ExprOp::STEP: return a > 0 ? 1.f : 0.f;
+			case ExprOp::POW: return std::pow(a, value);
+			default: return value;
+		}
+	}
+
+	bool isBinary(ExprOp op) {
+		return op >= ExprOp::ADD && op <= ExprOp::MAX;
+	}
+
+	bool isCommutative(ExprOp op) {
+		return op == ExprOp::ADD || op == ExprOp::MUL || op == ExprOp::MIN || op == ExprOp::MAX;
+	}
+
+	// rebuilds a node of given kind from new operands, going through the simplifying operators
+	Expr apply(ExprOp op, const Expr &a, const Expr &b, float value) {
+		switch (op) {
+			case ExprOp::ADD: return a + b;
+			case ExprOp::SUB: return a - b;
+			case ExprOp::MUL: return a * b;
+			case ExprOp::DIV: return a / b;
+			case ExprOp::MIN: return min(a, b);
+			case ExprOp::MAX: return max(a, b);
+			case ExprOp::NEG: return -a;
+			case ExprOp::SQRT: return sqrt(a);
+			case ExprOp::SIN: return sin(a);
+			case ExprOp::COS: return cos(a);
+			case ExprOp::EXP: return exp(a);
+			case ExprOp::LOG: return log(a);
+			case ExprOp::ABS: return abs(a);
+			case ExprOp::SIGN: return sign(a);
+			case ExprOp::STEP: return step(a);
+			case ExprOp::POW: return pow(a, value);
+			default: THROW(IllegalArgumentError, "Expr: node without operands cannot be rebuilt");
+		}
+	}
+
+	struct ValueKey {
+		ExprOp op;
+		int a, b, variable;
+		unsigned value;
+		bool operator==(const ValueKey &other) const = default;
+	};
+
+	struct ValueKeyHash {
+		size_t operator()(const ValueKey &k) const {
+			size_t h = static_cast<size_t>(k.op);
+			for (size_t x: {size_t(k.a), size_t(k.b), size_t(k.variable), size_t(k.value)})
+				h ^= x + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+}
+
+
+Expr Expr::make(ExprOp op, const Expr &a, const Expr &b, float value) {
+	THROW_IF(a.empty() || (isBinary(op) && b.empty()), IllegalArgumentError, "Expr: operation on an empty expression");
+	if (a.isConstant() && (!isBinary(op) || b.isConstant()))
+		return constant(applyOp(op, a.constantValue(), isBinary(op) ? b.constantValue() : 0, value));
+	return Expr(std::make_shared<const ExprNode>(ExprNode{op, value, 0, a.node, b.node}));
+}
+
+Expr Expr::constant(float a) {
+	return Expr(std::make_shared<const ExprNode>(ExprNode{ExprOp::CONSTANT, a, 0, nullptr, nullptr}));
+}
+
+Expr Expr::variable(int i) {
+	THROW_IF(i < 0, IllegalArgumentError, "Expr: variable index has to be nonnegative");
+	return Expr(std::make_shared<const ExprNode>(ExprNode{ExprOp::VARIABLE, 0, i, nullptr, nullptr}));
+}
+
+int Expr::nodeCount() const {
+	std::unordered_set<const ExprNode *> visited;
+	vector<const ExprNode *> stack;
+	if (node)
+		stack.push_back(node.get());
+	while (!stack.empty()) {
+		const ExprNode *n = stack.back();
+		stack.pop_back();
+		if (!visited.insert(n).second)
+			continue;
+		if (n->a) stack.push_back(n->a.get());
+		if (n->b) stack.push_back(n->b.get());
+	}
+	return visited.size();
+}
+
+Expr operator+(const Expr &a, const Expr &b) {
+	if (a.isConstant(0)) return b;
+	if (b.isConstant(0)) return a;
+	return Expr::make(ExprOp::ADD, a, b);
+}
+
+Expr operator-(const Expr &a, const Expr &b) {
+	if (b.isConstant(0)) return a;
+	if (a.isConstant(0)) return -b;
+	return Expr::make(ExprOp::SUB, a, b);
+}
+
+Expr operator*(const Expr &a, const Expr &b) {
+	if (a.isConstant(0) || b.isConstant(1)) return a;
+	if (b.isConstant(0) || a.isConstant(1)) return b;
+	if (a.isConstant(-1)) return -b;
+	if (b.isConstant(-1)) return -a;
+	return Expr::make(ExprOp::MUL, a, b);
+}
+
+Expr operator/(const Expr &a, const Expr &b) {
+	if (a.isConstant(0) || b.isConstant(1)) return a;
+	if (b.isConstant() && !a.isConstant())
+		return a * (1 / b.constantValue());
+	return Expr::make(ExprOp::DIV, a, b);
+}
+
+Expr operator-(const Expr &a) {
+	if (!a.empty() && a.op() == ExprOp::NEG)
+		return Expr(a.node->a);
+	return Expr::make(ExprOp::NEG, a);
+}
+
+Expr min(const Expr &a, const Expr &b) { return Expr::make(ExprOp::MIN, a, b); }
+Expr max(const Expr &a, const Expr &b) { return Expr::make(ExprOp::MAX, a, b); }
+
+Expr pow(const Expr &a, float p) {
+	if (p == 0) return Expr::constant(1);
+	if (p == 1) return a;
+	if (p == 2) return a * a;
+	if (p == .5f) return sqrt(a);
+	if (p == -1) return 1 / a;
+	return Expr::make(ExprOp::POW, a, Expr(), p);
+}
+
+Expr sqrt(const Expr &a) { return Expr::make(ExprOp::SQRT, a); }
+Expr sin(const Expr &a) { return Expr::make(ExprOp::SIN, a); }
+Expr cos(const Expr &a) { return Expr::make(ExprOp::COS, a); }
+Expr exp(const Expr &a) { return Expr::make(ExprOp::EXP, a); }
+Expr log(const Expr &a) { return Expr::make(ExprOp::LOG, a); }
+Expr abs(const Expr &a) { return Expr::make(ExprOp::ABS, a); }
+Expr sign(const Expr &a) { return Expr::make(ExprOp::SIGN, a); }
+Expr step(const Expr &a) { return Expr::make(ExprOp::STEP, a); }
+
+
+Expr Expr::derivative(int i) const {
+	std::unordered_map<const ExprNode *, Expr> memo;
+	std::function<Expr(const Expr &)> d = [&](const Expr &e) -> Expr {
+		if (auto it = memo.find(e.get()); it != memo.end())
+			return it->second;
+		Expr a = e.node->a ? Expr(e.node->a) : Expr();
+		Expr b = e.node->b ? Expr(e.node->b) : Expr();
+		Expr res;
+		switch (e.op()) {
+			case ExprOp::CONSTANT: res = constant(0); break;
+			case ExprOp::VARIABLE: res = constant(e.node->variable == i); break;
+			case ExprOp::ADD: res = d(a) + d(b); break;
+			case ExprOp::SUB: res = d(a) - d(b); break;
+			case ExprOp::MUL: res = d(a)*b + a*d(b); break;
+			case ExprOp::DIV: res = (d(a) - e*d(b)) / b; break;
+			// std::min returns the first operand on ties, so does the derivative
+			case ExprOp::MIN: res = d(a) + step(a - b)*(d(b) - d(a)); break;
+			case ExprOp::MAX: res = d(a) + step(b - a)*(d(b) - d(a)); break;
+			case ExprOp::NEG: res = -d(a); break;
+			case ExprOp::SQRT: res = d(a) / (2*e); break;
+			case ExprOp::SIN: res = cos(a)*d(a); break;
+			case ExprOp::COS: res = -sin(a)*d(a); break;
+			case ExprOp::EXP: res = e*d(a); break;
+			case ExprOp::LOG: res = d(a) / a; break;
+			case ExprOp::ABS: res = sign(a)*d(a); break;
+			case ExprOp::SIGN:
+			case ExprOp::STEP: res = constant(0); break;
+			case ExprOp::POW: res = e.node->value*pow(a, e.node->value - 1)*d(a); break;
+		}
+		memo.emplace(e.get(), res);
+		return res;
+	};
+	THROW_IF(empty(), IllegalArgumentError, "Expr: derivative of an empty expression");
+	return d(*this);
+}
+
+Expr Expr::substitute(std::span<const Expr> values) const {
+	std::unordered_map<const ExprNode *, Expr> memo;
+	std::function<Expr(const Expr &)> s = [&](const Expr &e) -> Expr {
+		if (auto it = memo.find(e.get()); it != memo.end())
+			return it->second;
+		Expr res;
+		if (e.op() == ExprOp::CONSTANT)
+			res = e;
+		else if (e.op() == ExprOp::VARIABLE)
+			res = e.node->variable < values.size() ? values[e.node->variable] : e;
+		else
+			res = apply(e.op(), s(Expr(e.node->a)), e.node->b ? s(Expr(e.node->b)) : Expr(), e.node->value);
+		THROW_IF(res.empty(), IllegalArgumentError, "Expr: variable substituted by an empty expression");
+		memo.emplace(e.get(), res);
+		return res;
+	};
+	THROW_IF(empty(), IllegalArgumentError, "Expr: substitution into an empty expression");
+	return s(*this);
+}
+
+float Expr::evaluate(std::span<const float> x) const {
+	THROW_IF(empty(), IllegalArgumentError, "Expr: evaluation of an empty expression");
+	switch (op()) {
+		case ExprOp::CONSTANT: return node->value;
+		case ExprOp::VARIABLE:
+			THROW_IF(node->variable >= x.size(), IndexOutOfBounds, node->variable, x.size(), "Expr variables");
+			return x[node->variable];
+		default:
+			return applyOp(op(), Expr(node->a).evaluate(x), node->b ? Expr(node->b).evaluate(x) : 0, node->value);
+	}
+}
+
+
+ExprTape::ExprTape(const vector<Expr> &outputs, int variables) : n_variables(variables) {
+	// value numbering, equal (op, operand values, immediate) get the same number
+	vector<ExprInstruction> values;
+	std::unordered_map<ValueKey, int, ValueKeyHash> numbers;
+	std::unordered_map<const ExprNode *, int> visited;
+	std::function<int(const ExprNode *)> number = [&](const ExprNode *n) -> int {
+		if (auto it = visited.find(n); it != visited.end())
+			return it->second;
+		ValueKey key{n->op, -1, -1, 0, 0};
+		if (n->op == ExprOp::CONSTANT)
+			key.value = std::bit_cast<unsigned>(n->value);
+		else if (n->op == ExprOp::VARIABLE) {
+			THROW_IF(n->variable >= variables, IndexOutOfBounds, n->variable, variables, "ExprTape variables");
+			key.variable = n->variable;
+		} else {
+			key.a = number(n->a.get());
+			if (n->b)
+				key.b = number(n->b.get());
+			if (isCommutative(n->op) && key.b < key.a)
+				std::swap(key.a, key.b);
+			key.value = std::bit_cast<unsigned>(n->value);
+		}
+		auto [it, inserted] = numbers.emplace(key, values.size());
+		if (inserted)
+			values.push_back(ExprInstruction{n->op, int(values.size()), n->op == ExprOp::VARIABLE ? n->variable : key.a, key.b, n->value});
+		visited.emplace(n, it->second);
+		return it->second;
+	};
+	vector<int> output_values;
+	for (const Expr &e: outputs) {
+		THROW_IF(e.empty(), IllegalArgumentError, "ExprTape: empty output expression");
+		output_values.push_back(number(e.get()));
+	}
+
+	// linear scan register allocation over the topological order of values
+	auto reads = [](const ExprInstruction &v) {
+		if (v.op == ExprOp::CONSTANT || v.op == ExprOp::VARIABLE)
+			return 0;
+		return isBinary(v.op) ? 2 : 1;
+	};
+	vector<int> lastUse(values.size(), -1);
+	for (int k = 0; k < values.size(); ++k) {
+		if (reads(values[k]) > 0) lastUse[values[k].a] = k;
+		if (reads(values[k]) > 1) lastUse[values[k].b] = k;
+	}
+	for (int v: output_values)
+		lastUse[v] = INT_MAX;
+
+	vector<int> reg(values.size(), -1);
+	vector<int> freeRegisters;
+	code.reserve(values.size());
+	for (int k = 0; k < values.size(); ++k) {
+		ExprInstruction ins = values[k];
+		int n = reads(ins);
+		if (n > 0) ins.a = reg[ins.a]; else if (ins.op == ExprOp::CONSTANT) ins.a = 0;
+		ins.b = n > 1 ? reg[ins.b] : 0;
+		if (n > 0 && lastUse[values[k].a] == k) freeRegisters.push_back(ins.a);
+		if (n > 1 && lastUse[values[k].b] == k && values[k].b != values[k].a) freeRegisters.push_back(ins.b);
+		if (freeRegisters.empty())
+			ins.dst = n_registers++;
+		else {
+			ins.dst = freeRegisters.back();
+			freeRegisters.pop_back();
+		}
+		reg[k] = ins.dst;
+		code.push_back(ins);
+	}
+	for (int v: output_values)
+		output_registers.push_back(reg[v]);
+}
+
+void ExprTape::run(const float *x, float *r) const {
+	for (const ExprInstruction &ins: code)
+		switch (ins.op) {
+			case ExprOp::CONSTANT: r[ins.dst] = ins.value; break;
+			case ExprOp::VARIABLE: r[ins.dst] = x[ins.a]; break;
+			case ExprOp::ADD: r[ins.dst] = r[ins.a] + r[ins.b]; break;
+			case ExprOp::SUB: r[ins.dst] = r[ins.a] - r[ins.b]; break;
+			case ExprOp::MUL: r[ins.dst] = r[ins.a] * r[ins.b]; break;
+			case ExprOp::DIV: r[ins.dst] = r[ins.a] / r[ins.b]; break;
+			default: r[ins.dst] = applyOp(ins.op, r[ins.a], r[ins.b], ins.value); break;
+		}
+}
+
+void ExprTape::evaluate(const float *x, float *out) const {
+	constexpr int STACK_REGISTERS = 64;
+	if (n_registers <= STACK_REGISTERS) {
+		float r[STACK_REGISTERS];
+		run(x, r);
+		for (int k = 0; k < output_registers.size(); ++k)
+			out[k] = r[output_registers[k]];
+		return;
+	}
+	thread_local vector<float> r;
+	r.resize(n_registers);
+	run(x, r.data());
+	for (int k = 0; k < output_registers.size(); ++k)
+		out[k] = r[output_registers[k]];
+}
+
+float ExprTape::operator()(const float *x) const {
+	THROW_IF(output_registers.empty(), IllegalArgumentError, "ExprTape has no outputs");
+	if (output_registers.size() == 1) {
+		float res;
+		evaluate(x, &res);
+		return res;
+	}
+	vector<float> res(output_registers.size());
+	evaluate(x, res.data());
+	return res[0];
+}
+
+void ExprTape::evaluateBatch(const float *x, float *out, int n) const {
+	constexpr int B = BATCH_BLOCK;
+	thread_local vector<float> registers;
+	registers.resize(n_registers * B);
+	float *R = registers.data();
+	int nOut = output_registers.size();
+
+	for (int start = 0; start < n; start += B) {
+		int m = std::min(B, n - start);
+		const float *xs = x + start * n_variables;
+		for (const ExprInstruction &ins: code) {
+			float *d = R + ins.dst * B;
+			// variable instructions keep the variable index in a, everything else reads registers
+			const float *a = R + (ins.op == ExprOp::VARIABLE ? 0 : ins.a) * B;
+			const float *b = R + ins.b * B;
+			switch (ins.op) {
+				case ExprOp::CONSTANT: for (int p = 0; p < m; ++p) d[p] = ins.value; break;
+				case ExprOp::VARIABLE: for (int p = 0; p < m; ++p) d[p] = xs[p * n_variables + ins.a]; break;
+				case ExprOp::ADD: for (int p = 0; p < m; ++p) d[p] = a[p] + b[p]; break;
+				case ExprOp::SUB: for (int p = 0; p < m; ++p) d[p] = a[p] - b[p]; break;
+				case ExprOp::MUL: for (int p = 0; p < m; ++p) d[p] = a[p] * b[p]; break;
+				case ExprOp::DIV: for (int p = 0; p < m; ++p) d[p] = a[p] / b[p]; break;
+				case ExprOp::MIN: for (int p = 0; p < m; ++p) d[p] = std::min(a[p], b[p]); break;
+				case ExprOp::MAX: for (int p = 0; p < m; ++p) d[p] = std::max(a[p], b[p]); break;
+				case ExprOp::NEG: for (int p = 0; p < m; ++p) d[p] = -a[p]; break;
+				case ExprOp::SQRT: for (int p = 0; p < m; ++p) d[p] = std::sqrt(a[p]); break;
+				default: for (int p = 0; p < m; ++p) d[p] = applyOp(ins.op, a[p], 0, ins.value); break;
+			}
+		}
+		for (int k = 0; k < nOut; ++k) {
+			const float *src = R + output_registers[k] * B;
+			for (int p = 0; p < m; ++p)
+				out[(start + p) * nOut + k] = src[p];
+		}
+	}
+}
+
+void ExprTape::evaluateBatch(std::span<const vec3> x, std::span<float> out) const {
+	THROW_IF(n_variables > 3, IllegalArgumentError, "ExprTape: points in R3 given to a tape of more than 3 variables");
+	THROW_IF(out.size() < x.size() * outputs(), IndexOutOfBounds, out.size(), x.size() * outputs(), "ExprTape batch output");
+	if (n_variables == 3) {
+		evaluateBatch(&x.data()->x, out.data(), x.size());
+		return;
+	}
+	vector<float> packed;
+	packed.reserve(x.size() * n_variables);
+	for (vec3 v: x)
+		for (int i = 0; i < n_variables; ++i)
+			packed.push_back(v[i]);
+	evaluateBatch(packed.data(), out.data(), x.size());
+}
+
+
+const ExprTape &ExprProgram::compile() const {
+	std::lock_guard lock(compile_mutex);
+	if (const ExprTape *t = compiled.load(std::memory_order_acquire))
+		return *t;
+	storage = std::make_unique<const ExprTape>(generator(), n_variables);
+	compiled.store(storage.get(), std::memory_order_release);
+	return *storage;
+}
+
+std::shared_ptr<const ExprProgram> ExprProgram::gradient(const Expr &expr, int variables) {
+	return std::make_shared<const ExprProgram>([expr, variables] {
+		vector<Expr> partials;
+		for (int i = 0; i < variables; ++i)
+			partials.push_back(expr.derivative(i));
+		return partials;
+	}, variables);
+}
+
+std::shared_ptr<const ExprProgram> ExprProgram::jacobian(const vector<Expr> &coordinates, int variables) {
+	return std::make_shared<const ExprProgram>([coordinates, variables] {
+		vector<Expr> partials;
+		for (int col = 0; col < variables; ++col)
+			for (const Expr &f: coordinates)
+				partials.push_back(f.derivative(col));
+		return partials;
+	}, variables);
+}
@@ -0,0 +1,257 @@
+#include "fft.hpp"
+
+#include <map>
+#include <mutex>
+
+
+static_assert(sizeof(Complex) == sizeof(vec2), "FFTPlan assumes Complex is a bare vec2");
+
+namespace {
+	constexpr double PI_D = 3.14159265358979323846;
+
+	std::mutex plan_cache_mutex;
+	std::map<pair<int, int>, shared_ptr<const FFTPlan>> plan_cache;
+
+	// twiddles are computed in double precision, only the result is rounded to float
+	vec2 unit_root(long long num, long long den, int sign) {
+		double a = sign * 2.0 * PI_D * static_cast<double>(num % den) / static_cast<double>(den);
+		return vec2(static_cast<float>(std::cos(a)), static_cast<float>(std::sin(a)));
+	}
+
+	inline vec2 cmul(vec2 a, vec2 b) { return vec2(a.x*b.x - a.y*b.y, a.x*b.y + a.y*b.x); }
+	inline vec2 cconj(vec2 a) { return vec2(a.x, -a.y); }
+	inline vec2 mul_i(vec2 a, int sign) { return sign > 0 ? vec2(-a.y, a.x) : vec2(a.y, -a.x); }
+
+	thread_local vector<Complex> permutation_scratch;
+	thread_local vector<Complex> bluestein_scratch;
+}
+
+
+bool FFTPlan::mixedRadixSize(int n) {
+	if (n < 1) return false;
+	for (int p : {2, 3, 5})
+		while (n % p == 0) n /= p;
+	return n == 1;
+}
+
+FFTPlan::FFTPlan(int n, FFTDirection dir) : n(n), dir(dir) {
+	THROW_IF(n < 1, IllegalArgumentError, "FFTPlan: size must be positive, got " + to_string(n));
+	if (mixedRadixSize(n))
+		init_mixed_radix();
+	else
+		init_bluestein();
+}
+
+void FFTPlan::init_mixed_radix() {
+	int sign = static_cast<int>(dir);
+	int m = n;
+	for (int p : {4, 2, 3, 5})
+		while (m % p == 0) {
+			radices.push_back(p);
+			m /= p;
+		}
+
+	// radices are listed top-down (as in the recursive decimation in time), stages run bottom-up
+	permutation.resize(n);
+	for (int i = 0; i < n; ++i) {
+		int pos = 0, stride = n, idx = i;
+		for (int p : radices) {
+			stride /= p;
+			pos += (idx % p) * stride;
+			idx /= p;
+		}
+		permutation[i] = pos;
+	}
+
+	twiddles.reserve(n);
+	int len = 1;
+	for (int s = radices.size() - 1; s >= 0; --s) {
+		int p = radices[s];
+		int sub = len;
+		len *= p;
+		twiddle_offsets.push_back(twiddles.size());
+		for (int k = 0; k < sub; ++k)
+			for (int j = 1; j < p; ++j)
+				twiddles.push_back(unit_root(1LL * j * k, len, sign));
+	}
+}
+
+void FFTPlan::init_bluestein() {
+	bluestein = true;
+	int sign = static_cast<int>(dir);
+	conv_size = 1;
+	while (conv_size < 2*n - 1)
+		conv_size <<= 1;
+
+	// jk = (j^2 + k^2 - (k-j)^2)/2, with j^2 reduced mod 2n to keep the phase exact
+	chirp.resize(n);
+	for (int j = 0; j < n; ++j)
+		chirp[j] = unit_root((1LL * j * j) % (2LL * n), 2LL * n, sign);
+
+	conv_forward = get(conv_size, FFTDirection::FORWARD);
+	conv_backward = get(conv_size, FFTDirection::BACKWARD);
+
+	vector<Complex> kernel(conv_size, Complex(0.f, 0.f));
+	kernel[0].z = cconj(chirp[0]);
+	for (int t = 1; t < n; ++t) {
+		kernel[t].z = cconj(chirp[t]);
+		kernel[conv_size - t].z = cconj(chirp[t]);
+	}
+	conv_forward->execute(kernel);
+
+	// normalisation of the backward convolution transform is folded into the kernel
+	float scale = 1.f / conv_size;
+	chirp_kernel_fft.resize(conv_size);
+	for (int i = 0; i < conv_size; ++i)
+		chirp_kernel_fft[i] = kernel[i].z * scale;
+}
+
+void FFTPlan::run_mixed_radix(Complex *d) const {
+	int sign = static_cast<int>(dir);
+	const float s3 = sign * 0.86602540378443864676f;
+	vec2 w5[5];
+	for (int q = 0; q < 5; ++q)
+		w5[q] = unit_root(q, 5, sign);
+
+	int len = 1;
+	for (int st = 0; st < radices.size(); ++st) {
+		int p = radices[radices.size() - 1 - st];
+		int sub = len;
+		len *= p;
+		const vec2 *tw = twiddles.data() + twiddle_offsets[st];
+
+		switch (p) {
+			case 2:
+				for (int b = 0; b < n; b += len)
+					for (int k = 0; k < sub; ++k) {
+						vec2 &a0 = d[b + k].z;
+						vec2 &a1 = d[b + k + sub].z;
+						vec2 t1 = cmul(a1, tw[k]);
+						a1 = a0 - t1;
+						a0 = a0 + t1;
+					}
+				break;
+			case 3:
+				for (int b = 0; b < n; b += len)
+					for (int k = 0; k < sub; ++k) {
+						vec2 &a0 = d[b + k].z;
+						vec2 &a1 = d[b + k + sub].z;
+						vec2 &a2 = d[b + k + 2*sub].z;
+						vec2 t1 = cmul(a1, tw[2*k]);
+						vec2 t2 = cmul(a2, tw[2*k + 1]);
+						vec2 s = t1 + t2;
+						vec2 m = a0 - s * .5f;
+						vec2 r = vec2(-(t1.y - t2.y), t1.x - t2.x) * s3;
+						a0 = a0 + s;
+						a1 = m + r;
+						a2 = m - r;
+					}
+				break;
+			case 4:
+				for (int b = 0; b < n; b += len)
+					for (int k = 0; k < sub; ++k) {
+						vec2 &a0 = d[b + k].z;
+						vec2 &a1 = d[b + k + sub].z;
+						vec2 &a2 = d[b + k + 2*sub].z;
+						vec2 &a3 = d[b + k + 3*sub].z;
+						vec2 t1 = cmul(a1, tw[3*k]);
+						vec2 t2 = cmul(a2, tw[3*k + 1]);
+						vec2 t3 = cmul(a3, tw[3*k + 2]);
+						vec2 e0 = a0 + t2;
+						vec2 e1 = a0 - t2;
+						vec2 o0 = t1 + t3;
+						vec2 o1 = mul_i(t1 - t3, sign);
+						a0 = e0 + o0;
+						a1 = e1 + o1;
+						a2 = e0 - o0;
+						a3 = e1 - o1;
+					}
+				break;
+			default:
+				for (int b = 0; b < n; b += len)
+					for (int k = 0; k < sub; ++k) {
+						vec2 t[5];
+						t[0] = d[b + k].z;
+						for (int j = 1; j < p; ++j)
+							t[j] = cmul(d[b + k + j*sub].z, tw[(p - 1)*k + j - 1]);
+						for (int q = 0; q < p; ++q) {
+							vec2 y = t[0];
+							for (int j = 1; j < p; ++j)
+								y += cmul(t[j], w5[(j*q) % p]);
+							d[b + k + q*sub].z = y;
+						}
+					}
+				break;
+		}
+	}
+}
+
+void FFTPlan::run_bluestein(const Complex *in, Complex *out) const {
+	auto &buf = bluestein_scratch;
+	if (buf.size() < 2*conv_size)
+		buf.resize(2*conv_size);
+	Complex *a = buf.data();
+	Complex *A = buf.data() + conv_size;
+
+	for (int j = 0; j < n; ++j)
+		a[j].z = cmul(in[j].z, chirp[j]);
+	for (int j = n; j < conv_size; ++j)
+		a[j].z = vec2(0);
+
+	conv_forward->execute(a, A);
+	for (int i = 0; i < conv_size; ++i)
+		A[i].z = cmul(A[i].z, chirp_kernel_fft[i]);
+	conv_backward->execute(A, a);
+
+	for (int k = 0; k < n; ++k)
+		out[k].z = cmul(a[k].z, chirp[k]);
+}
+
+void FFTPlan::execute(const Complex *in, Complex *out) const {
+	if (bluestein) {
+		run_bluestein(in, out);
+		return;
+	}
+	if (in == out) {
+		auto &buf = permutation_scratch;
+		buf.assign(in, in + n);
+		in = buf.data();
+	}
+	for (int i = 0; i < n; ++i)
+		out[permutation[i]] = in[i];
+	run_mixed_radix(out);
+}
+
+void FFTPlan::execute(Complex *data) const {
+	execute(data, data);
+}
+
+void FFTPlan::execute(vector<Complex> &data) const {
+	THROW_IF(data.size() != n, IllegalArgumentError, "FFTPlan: plan of size " + to_string(n) + " applied to data of size " + to_string(data.size()));
+	execute(data.data(), data.data());
+}
+
+vector<Complex> FFTPlan::operator()(const vector<Complex> &data) const {
+	THROW_IF(data.size() != n, IllegalArgumentError, "FFTPlan: plan of size " + to_string(n) + " applied to data of size " + to_string(data.size()));
+	vector<Complex> res(n);
+	execute(data.data(), res.data());
+	return res;
+}
+
+shared_ptr<const FFTPlan> FFTPlan::get(int n, FFTDirection dir) {
+	auto key = pair(n, static_cast<int>(dir));
+	{
+		std::lock_guard lock(plan_cache_mutex);
+		if (auto it = plan_cache.find(key); it != plan_cache.end())
+			return it->second;
+	}
+	// constructed outside the lock, Bluestein plans request their power of two subplans from the cache
+	auto plan = make_shared<const FFTPlan>(n, dir);
+	std::lock_guard lock(plan_cache_mutex);
+	return plan_cache.emplace(key, plan).first->second;
+}
+
+void FFTPlan::clearCache() {
+	std::lock_guard lock(plan_cache_mutex);
+	plan_cache.clear();
+}
@@ -1,6 +1,8 @@
 #include "func.hpp"
+#include "fft.hpp"
 #include "randomUtils.hpp"
 #include "abstractNonsense.hpp"
+#include "parallel.hpp"
 
 
 #include <chrono>
@@ -96,13 +98,7 @@ std::function<codomain(domain)> directionalDerivativeOperator(std::function<codo
 
 
 RealFunctionR3::RealFunctionR3()
-: _f([](vec3 v) {
-	  return 0;
-  }),
-  _df([](vec3 v) {
-	  return vec3(0);
-  }),
-  regularity(Regularity::ANALYTIC) {}
+: RealFunctionR3(Expr::constant(0), 0.01f, Regularity::ANALYTIC) {}
 
 RealFunctionR3::RealFunctionR3(const RealFunctionR3 &other) = default;
 
@@ -130,6 +126,31 @@ RealFunctionR3::RealFunctionR3(std::function<float(float, float, float)> f, floa
   eps(epsilon),
   regularity(regularity) {}
 
+RealFunctionR3::RealFunctionR3(const Expr &expr, float epsilon, Regularity regularity)
+: eps(epsilon),
+  regularity(regularity),
+  _expr(expr),
+  _program(make_shared<const ExprProgram>(expr, 3)) {
+	_f = [p=_program](vec3 v) {
+		return p->tape()(v);
+	};
+	_df = [g=ExprProgram::gradient(expr, 3)](vec3 v) {
+		vec3 res;
+		g->tape().evaluate(&v.x, &res.x);
+		return res;
+	};
+}
+
+void RealFunctionR3::evaluate(std::span<const vec3> points, std::span<float> out) const {
+	THROW_IF(out.size() < points.size(), IndexOutOfBounds, out.size(), points.size(), "RealFunctionR3::evaluate output");
+	if (_program) {
+		_program->tape().evaluateBatch(points, out);
+		return;
+	}
+	for (int i = 0; i < points.size(); ++i)
+		out[i] = _f(points[i]);
+}
+
 float RealFunctionR3::operator()(float x, float y, float z) const {
 	return _f(vec3(x, y, z));
 }
@@ -162,15 +183,31 @@ RealFunctionR3 operator/(float a, const RealFunctionR3 &f) {
 	return RealFunctionR3::constant(a) / f;
 }
 
-RealFunctionR3 min(const RealFunctionR3 &f, float a) { return RealFunctionR3([f, a](vec3 x) { return std::min(f(x), a); }, f.getEps(), f.regularity); }
+RealFunctionR3 min(const RealFunctionR3 &f, float a) {
+	if (f.hasExpression())
+		return RealFunctionR3(min(f._expr, Expr::constant(a)), f.getEps(), f.regularity);
+	return RealFunctionR3([f, a](vec3 x) { return std::min(f(x), a); }, f.getEps(), f.regularity);
+}
 
-RealFunctionR3 min(const RealFunctionR3 &f, const RealFunctionR3 &g) { return RealFunctionR3([f, g](vec3 x) { return std::min(f(x),g(x)); }, f.getEps(), f.regularity); }
+RealFunctionR3 min(const RealFunctionR3 &f, const RealFunctionR3 &g) {
+	if (f.hasExpression() && g.hasExpression())
+		return RealFunctionR3(min(f._expr, g._expr), f.getEps(), f.regularity);
+	return RealFunctionR3([f, g](vec3 x) { return std::min(f(x),g(x)); }, f.getEps(), f.regularity);
+}
 
 RealFunctionR3 min(float a, const RealFunctionR3 &f) { return min(f, a); }
 
-RealFunctionR3 max(const RealFunctionR3 &f, float a) { return RealFunctionR3([f, a](vec3 x) { return std::max(f(x), a); }, f.getEps(), f.regularity); }
+RealFunctionR3 max(const RealFunctionR3 &f, float a) {
+	if (f.hasExpression())
+		return RealFunctionR3(max(f._expr, Expr::constant(a)), f.getEps(), f.regularity);
+	return RealFunctionR3([f, a](vec3 x) { return std::max(f(x), a); }, f.getEps(), f.regularity);
+}
 
-RealFunctionR3 max(const RealFunctionR3 &f, const RealFunctionR3 &g) { return RealFunctionR3([f, g](vec3 x) { return std::max(f(x),g(x)); }, f.getEps(), f.regularity); }
+RealFunctionR3 max(const RealFunctionR3 &f, const RealFunctionR3 &g) {
+	if (f.hasExpression() && g.hasExpression())
+		return RealFunctionR3(max(f._expr, g._expr), f.getEps(), f.regularity);
+	return RealFunctionR3([f, g](vec3 x) { return std::max(f(x),g(x)); }, f.getEps(), f.regularity);
+}
 
 RealFunctionR3 max(float a, const RealFunctionR3 &f) {
 	return max(f, a);
@@ -187,10 +224,12 @@ RealFunctionR3 RealFunctionR3::operator~() const {
 }
 
 RealFunctionR3 RealFunctionR3::pow(float a) const {
-	return RealFunctionR3([this, a](vec3 v) {
-							  return std::pow(this->operator()(v), a);
-						  }, [this, a](vec3 v) {
-							  return this->df(v) * a * std::pow(this->operator()(v), a - 1);
+	if (hasExpression())
+		return RealFunctionR3(::pow(_expr, a), eps, regularity);
+	return RealFunctionR3([f=_f, a](vec3 v) {
+							  return std::pow(f(v), a);
+						  }, [f=_f, df=_df, a](vec3 v) {
+							  return df(v) * a * std::pow(f(v), a - 1);
 						  });
 }
 
@@ -218,32 +257,63 @@ SpaceEndomorphism::~SpaceEndomorphism() = default;
 
 SpaceEndomorphism::SpaceEndomorphism(const SpaceEndomorphism &other)
 : _f(other._f),
-  _df(other._df) {}
+  _df(other._df),
+  eps(other.eps),
+  _expr(other._expr),
+  _program(other._program) {}
 
 SpaceEndomorphism::SpaceEndomorphism(SpaceEndomorphism &&other) noexcept
 : _f(std::move(other._f)),
-  _df(std::move(other._df)) {}
+  _df(std::move(other._df)),
+  eps(other.eps),
+  _expr(std::move(other._expr)),
+  _program(std::move(other._program)) {}
 
 SpaceEndomorphism::SpaceEndomorphism(std::function<vec3(vec3)> f, std::function<mat3(vec3)> df, float eps)
 : _f(std::move(f)),
   _df(std::move(df)),
   eps(eps) {}
 
+namespace {
+	array<Expr, 3> affineCoordinates(const mat3 &A, vec3 v) {
+		array<Expr, 3> res;
+		for (int row = 0; row < 3; ++row)
+			res[row] = Expr::variable(0)*A[0][row] + Expr::variable(1)*A[1][row] + Expr::variable(2)*A[2][row] + v[row];
+		return res;
+	}
+}
+
 SpaceEndomorphism::SpaceEndomorphism(mat3 A)
-: _f([A](vec3 x) {
-	  return A * x;
-  }),
-  _df([A](vec3 x) {
-	  return A;
-  }) {}
+: SpaceEndomorphism(affineCoordinates(A, vec3(0))) {}
 
 SpaceEndomorphism::SpaceEndomorphism(mat4 A)
-: _f([A](vec3 x) {
-	  return vec3(A * vec4(x, 1));
-  }),
-  _df([A](vec3 x) {
-	  return mat3(A);
-  }) {}
+: SpaceEndomorphism(affineCoordinates(mat3(A), vec3(A[3]))) {}
+
+SpaceEndomorphism::SpaceEndomorphism(const array<Expr, 3> &coordinates, float eps)
+: eps(eps),
+  _expr(coordinates),
+  _program(make_shared<const ExprProgram>([coordinates] { return vector<Expr>(coordinates.begin(), coordinates.end()); }, 3)) {
+	_f = [p=_program](vec3 x) {
+		vec3 res;
+		p->tape().evaluate(&x.x, &res.x);
+		return res;
+	};
+	_df = [J=ExprProgram::jacobian(vector<Expr>(coordinates.begin(), coordinates.end()), 3)](vec3 x) {
+		mat3 res;
+		J->tape().evaluate(&x.x, &res[0][0]);
+		return res;
+	};
+}
+
+void SpaceEndomorphism::evaluate(std::span<const vec3> points, std::span<vec3> out) const {
+	THROW_IF(out.size() < points.size(), IndexOutOfBounds, out.size(), points.size(), "SpaceEndomorphism::evaluate output");
+	if (_program) {
+		_program->tape().evaluateBatch(points, std::span(&out.data()->x, 3*out.size()));
+		return;
+	}
+	for (int i = 0; i < points.size(); ++i)
+		out[i] = _f(points[i]);
+}
 
 vec3 SpaceEndomorphism::directional_derivative(vec3 x, vec3 v) const {
 	return _df(x) * v;
@@ -339,14 +409,25 @@ RealFunction::RealFunction(std::function<float(float)> f, std::function<float(fl
 RealFunction::RealFunction(std::function<float(float)> f, float epsilon, Regularity regularity)
 : RealFunction(f, derivativeOperator(f, epsilon), epsilon, regularity) {}
 
-RealFunction::RealFunction(float constant, float epsilon, Regularity regularity): RealFunction([constant](float x) {
-	return constant;
-}, epsilon, regularity) {
+RealFunction::RealFunction(float constant, float epsilon, Regularity regularity): RealFunction(Expr::constant(constant), epsilon, regularity) {
 	if (abs(constant) < epsilon) {
 		is_zero = true;
 	}
 }
 
+RealFunction::RealFunction(const Expr &expr, float epsilon, Regularity regularity)
+: eps(epsilon),
+  is_zero(false),
+  _expr(expr),
+  _program(make_shared<const ExprProgram>(expr, 1)),
+  regularity(regularity) {
+	auto df = make_shared<const ExprProgram>([expr] { return vector{expr.derivative(0)}; }, 1);
+	auto ddf = make_shared<const ExprProgram>([expr] { return vector{expr.derivative(0).derivative(0)}; }, 1);
+	_f = [p=_program](float x) { return p->tape()(&x); };
+	_df = [p=df](float x) { return p->tape()(&x); };
+	_ddf = [p=ddf](float x) { return p->tape()(&x); };
+}
+
 float RealFunction::operator()(float x) const {
 	return _f(x);
 }
@@ -432,7 +513,9 @@ RealFunction RealFunction::operator/(float a) const {
 }
 
 RealFunction RealFunction::pow(float a) const {
-	return RealFunction([this, a](float x) { return std::pow(this->operator()(x), a); }, eps, regularity);
+	if (hasExpression())
+		return RealFunction(::pow(_expr, a), eps, regularity);
+	return RealFunction([f=_f, a](float x) { return std::pow(f(x), a); }, eps, regularity);
 }
 
 RealFunction pow(const RealFunction &f, float a) {
@@ -440,18 +523,26 @@ RealFunction pow(const RealFunction &f, float a) {
 }
 
 RealFunction max(const RealFunction &f, const RealFunction &g) {
+	if (f.hasExpression() && g.hasExpression())
+		return RealFunction(max(f._expr, g._expr), f.eps, min(f.regularity, g.regularity));
 	return RealFunction([f, g](float x) { return std::max(f(x), g(x)); }, f.eps, min(f.regularity, g.regularity));
 }
 
 RealFunction max(const RealFunction &f, float a) {
+	if (f.hasExpression())
+		return RealFunction(max(f._expr, Expr::constant(a)), f.eps, f.regularity);
 	return RealFunction([f, a](float x) { return std::max(f(x), a); }, f.eps, f.regularity);
 }
 
 RealFunction min(const RealFunction &f, const RealFunction &g) {
+	if (f.hasExpression() && g.hasExpression())
+		return RealFunction(min(f._expr, g._expr), f.eps, min(f.regularity, g.regularity));
 	return RealFunction([f, g](float x) { return std::min(f(x), g(x)); }, f.eps, min(f.regularity, g.regularity));
 }
 
 RealFunction min(const RealFunction &f, float a) {
+	if (f.hasExpression())
+		return RealFunction(min(f._expr, Expr::constant(a)), f.eps, f.regularity);
 	return RealFunction([f, a](float x) { return std::min(f(x), a); }, f.eps, f.regularity);
 }
 
@@ -515,18 +606,7 @@ RealFunction RealFunction::constant(float a) {
 }
 
 RealFunction RealFunction::x() {
-	return RealFunction(
-			[](float x) {
-				return x;
-			},
-			[](float) {
-				return 1.0f;
-			},
-			[](float) {
-				return 0.0f;
-			},
-			.01,
-			Regularity::ANALYTIC);
+	return RealFunction(Expr::variable(0), .01, Regularity::ANALYTIC);
 }
 
 RealFunction RealFunction::one() {
@@ -546,78 +626,23 @@ RealFunction RealFunction::quadratic(float a, float b, float c) {
 }
 
 RealFunction RealFunction::sin() {
-	return RealFunction(
-			[](float x) {
-				return std::sin(x);
-			},
-			[](float x) {
-				return std::cos(x);
-			},
-			[](float x) {
-				return -std::sin(x);
-			},
-			.01,
-			Regularity::ANALYTIC);
+	return RealFunction(::sin(Expr::variable(0)), .01, Regularity::ANALYTIC);
 }
 
 RealFunction RealFunction::cos() {
-	return RealFunction(
-			[](float x) {
-				return std::cos(x);
-			},
-			[](float x) {
-				return -std::sin(x);
-			},
-			[](float x) {
-				return -std::cos(x);
-			},
-			.01,
-			Regularity::ANALYTIC);
+	return RealFunction(::cos(Expr::variable(0)), .01, Regularity::ANALYTIC);
 }
 
 RealFunction RealFunction::exp() {
-	return RealFunction(
-			[](float x) {
-				return std::exp(x);
-			},
-			[](float x) {
-				return std::exp(x);
-			},
-			[](float x) {
-				return std::exp(x);
-			},
-			.001,
-			Regularity::ANALYTIC);
+	return RealFunction(::exp(Expr::variable(0)), .001, Regularity::ANALYTIC);
 }
 
 RealFunction RealFunction::log() {
-	return RealFunction(
-			[](float x) {
-				return std::log(x);
-			},
-			[](float x) {
-				return 1 / x;
-			},
-			[](float x) {
-				return -1 / sq(x);
-			},
-			.001,
-			Regularity::ANALYTIC);
+	return RealFunction(::log(Expr::variable(0)), .001, Regularity::ANALYTIC);
 }
 
 RealFunction RealFunction::SQRT() {
-	return RealFunction(
-			[](float x) {
-				return std::sqrt(x);
-			},
-			[](float x) {
-				return 1 / (2 * std::sqrt(x));
-			},
-			[](float x) {
-				return -1 / (4 * x * std::sqrt(x));
-			},
-			.001,
-			Regularity::ANALYTIC);
+	return RealFunction(::sqrt(Expr::variable(0)), .001, Regularity::ANALYTIC);
 }
 
 vec2 CompactlySupportedRealFunction::support_sum(vec2 other) const {
@@ -1127,55 +1152,15 @@ DiscreteComplexFunction DiscreteComplexFunction::conj() const {
 }
 
 DiscreteComplexFunction DiscreteComplexFunction::fft() const {
-	if (samples() == 1) {
-		return DiscreteComplexFunction(vector{fn[0]}, domain());
-	}
-	if (samples() % 2 == 0) {
-		auto f_e = downsample(2).fft();
-		auto f_o = downsample(2, 1).fft();
-		Complex w = exp(1.0i * TAU / samples());
-		vector<Complex> res = vector<Complex>(samples());
-		for (int k = 0; k < samples()/2; ++k) {
-			res[k] = f_e[k] + w.pow(k) * f_o[k];
-			res[k + samples()/2] = f_e[k] - w.pow(k) * f_o[k];
-		}
-		return DiscreteComplexFunction(res, domain());
-	}
-
-	auto v = Vector<Complex>(samples(), [fn=fn, n=samples()](int k) {
-		Complex c = 0i;
-		for (int j=0; j<n; j++)
-			c = c + exp(-1.0i * TAU/n  * k * j)*fn[j];
-		return c;
-	});
-	return DiscreteComplexFunction(v, domain());
+	vector<Complex> res = fn.vec();
+	FFTPlan::get(samples(), FFTDirection::FORWARD)->execute(res);
+	return DiscreteComplexFunction(res, domain());
 }
 
 DiscreteComplexFunction DiscreteComplexFunction::ifft_() const {
-	float d = dom_b;
-	if (samples() == 1) {
-		return DiscreteComplexFunction(vector{fn[0]},domain());
-	}
-	if (samples() % 2 == 0) {
-		auto f_e = downsample(2).ifft_();
-		auto f_o = downsample(2, 1).ifft_();
-		Complex w = exp(-1.0i * TAU / samples());
-		vector<Complex> res = vector<Complex>(samples());
-		for (int k = 0; k < samples()/2; ++k) {
-			res[k] = f_e[k] + w.pow(k) * f_o[k];
-			res[k + samples()/2] = f_e[k] - w.pow(k) * f_o[k];
-		}
-		return DiscreteComplexFunction(res,domain());
-	}
-	auto v = Vector<Complex>(samples(), [fn=fn, n=samples()](int i) {
-		Complex c = 0i;
-		Complex w = exp(1.0i * (TAU/n  * i));
-		for (int j=0; j<n; ++j) {
-			c += w.pow(j)*fn[j];
-		}
-		return c;
-	});
-	return DiscreteComplexFunction(v, domain());
+	vector<Complex> res = fn.vec();
+	FFTPlan::get(samples(), FFTDirection::BACKWARD)->execute(res);
+	return DiscreteComplexFunction(res, domain());
 }
 
 DiscreteComplexFunction DiscreteComplexFunction::shift_domain_left() const {
@@ -1276,28 +1261,12 @@ DiscreteRealFunction DiscreteRealFunction::two_sided_zero_padding(int target_siz
 }
 
 DiscreteComplexFunction DiscreteRealFunction::fft() const {
-	if (samples() == 1) {
-		return DiscreteComplexFunction(vector{Complex(fn[0])}, domain);
-	}
-	if (samples() % 2 == 0) {
-		auto f_e = downsample(2, 0).fft();
-		auto f_o = downsample(2, 1).fft();
-		Complex w = exp(1.0i * TAU / samples());
-		vector<Complex> res = vector<Complex>(samples());
-		for (int k = 0; k < samples()/2; ++k) {
-			res[k] = f_e[k] + w.pow(k) * f_o[k];
-			res[k + samples()/2] = f_e[k] - w.pow(k) * f_o[k];
-		}
-		return DiscreteComplexFunction(res, domain);
-	}
-
-	auto v = Vector<Complex>(samples(), [fn=fn, n=samples()](int k) {
-		Complex c = 0i;
-		for (int j=0; j<n; j++)
-			c = c + exp(-1.0i * TAU/n  * k * j)*fn[j];
-		return c;
-	});
-	return DiscreteComplexFunction(v, domain);
+	vector<Complex> res;
+	res.reserve(samples());
+	for (int i = 0; i < samples(); ++i)
+		res.emplace_back(fn[i], 0.f);
+	FFTPlan::get(samples(), FFTDirection::FORWARD)->execute(res);
+	return DiscreteComplexFunction(res, domain);
 }
 
 DiscreteRealFunction DiscreteRealFunction::convolve(const DiscreteRealFunction &kernel) const {
@@ -1551,42 +1520,104 @@ DiscreteRealFunctionNonUniform operator&(const DiscreteRealFunction &f, const Di
 	return DiscreteRealFunctionNonUniform(args, values);
 }
 
-DiscreteComplexFunctionR2::DiscreteComplexFunctionR2(const vector<DiscreteComplexFunction> &fn, vec2 domain): fn(fn), domain(domain) {}
+namespace {
+	// rows [0, rows) split into contiguous blocks, one per hardware thread
+	template<typename F>
+	void forRowBlocks(int rows, F &&f) {
+		int blocks = std::min(resolveThreadCount(0), std::max(rows, 1));
+		parallelFor(blocks, blocks, [&](int b) {
+			for (int i = rows*b/blocks; i < rows*(b + 1)/blocks; ++i)
+				f(i);
+		});
+	}
+
+	void fftRows(Grid2D<Complex> &grid, FFTDirection direction) {
+		auto plan = FFTPlan::get(grid.cols(), direction);
+		forRowBlocks(grid.rows(), [&](int i) { plan->execute(grid.rowData(i)); });
+	}
+
+	// columns are transformed as rows of the transpose, kept in scratch
+	void fftColumns(Grid2D<Complex> &grid, Grid2D<Complex> &scratch, FFTDirection direction) {
+		grid.transposeInto(scratch);
+		fftRows(scratch, direction);
+		scratch.transposeInto(grid);
+	}
+
+	void scaleValues(Grid2D<Complex> &grid, float a) {
+		for (Complex &c: grid.values())
+			c.z *= a;
+	}
+
+	template<typename T, typename U, typename F>
+	Grid2D<T> mapValues(const Grid2D<U> &grid, F &&f) {
+		Grid2D<T> res(grid.rows(), grid.cols());
+		auto in = grid.values();
+		auto out = res.values();
+		for (size_t i = 0; i < in.size(); ++i)
+			out[i] = f(in[i]);
+		return res;
+	}
+
+	template<typename T, typename F>
+	Grid2D<T> zipValues(const Grid2D<T> &a, const Grid2D<T> &b, F &&f) {
+		THROW_IF(a.rows() != b.rows() || a.cols() != b.cols(), ValueError,
+				 "incompatible grids " + to_string(a.rows()) + "x" + to_string(a.cols()) + " and " + to_string(b.rows()) + "x" + to_string(b.cols()));
+		Grid2D<T> res(a.rows(), a.cols());
+		auto x = a.values(), y = b.values();
+		auto out = res.values();
+		for (size_t i = 0; i < x.size(); ++i)
+			out[i] = f(x[i], y[i]);
+		return res;
+	}
+
+	template<typename T, typename Row>
+	Grid2D<T> gridOfRows(const vector<Row> &rows) {
+		int cols = rows.empty() ? 0 : rows[0].samples();
+		Grid2D<T> grid(rows.size(), cols);
+		for (int i = 0; i < rows.size(); ++i) {
+			THROW_IF(rows[i].samples() != cols, ValueError, "row " + to_string(i) + " has " + to_string(rows[i].samples()) + " samples, expected " + to_string(cols));
+			for (int j = 0; j < cols; ++j)
+				grid(i, j) = rows[i][j];
+		}
+		return grid;
+	}
+
+	// linear interpolation of DiscreteComplexFunction::operator()
+	Complex interpolateRow(std::span<const Complex> row, vec2 domain, float x) {
+		float L = domain[1] - domain[0];
+		int n_x = floor(row.size()*(x - domain[0])/L);
+		float delta_x = (x - domain[0])*row.size()/L - n_x;
+		return row[n_x] + delta_x * (row[n_x+1] - row[n_x]);
+	}
+}
+
+DiscreteComplexFunctionR2::DiscreteComplexFunctionR2(const vector<DiscreteComplexFunction> &fn, vec2 domain)
+: grid(gridOfRows<Complex>(fn)), domain(domain), _domain_x(fn.empty() ? vec2(0, 1) : fn[0].getDomain()) {}
 
-// DiscreteComplexFunctionR2::DiscreteComplexFunctionR2(const vector<std::function<Complex(float)>> &_f, vec2 domain, int sampling)
-// : fn(_f.size(), [_f, domain, sampling](int i) {
-// 		return DiscreteComplexFunction(_f[i], domain, sampling);
-// 	})
-// {}
+DiscreteComplexFunctionR2::DiscreteComplexFunctionR2(Grid2D<Complex> values, vec2 domain_t, vec2 domain_x)
+: grid(std::move(values)), domain(domain_t), _domain_x(domain_x) {}
 
-int DiscreteComplexFunctionR2::samples_t() const { return fn.size(); }
+int DiscreteComplexFunctionR2::samples_t() const { return grid.rows(); }
 
-int DiscreteComplexFunctionR2::samples_x() const { return fn[0].samples(); }
+int DiscreteComplexFunctionR2::samples_x() const { return grid.cols(); }
 
 float DiscreteComplexFunctionR2::sampling_step_t() const { return (domain[1] - domain[0]) / (samples_t()-1); }
 
-float DiscreteComplexFunctionR2::sampling_step_x() const { return fn[0].sampling_step(); }
+float DiscreteComplexFunctionR2::sampling_step_x() const {
+	if (samples_x() < 2) return _domain_x[1] - _domain_x[0];
+	return (_domain_x[1] - _domain_x[0]) / (samples_x()-1);
+}
 
 vector<float> DiscreteComplexFunctionR2::args_t() const { return linspace(domain[0], domain[1], samples_t()); }
 
-vector<float> DiscreteComplexFunctionR2::args_x() const { return fn[0].args(); }
+vector<float> DiscreteComplexFunctionR2::args_x() const { return linspace(_domain_x[0], _domain_x[1], samples_x()); }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator+(const DiscreteComplexFunctionR2 &g) const {
-	vector<DiscreteComplexFunction> result;
-	result.reserve(samples_t());
-	for (int i = 0; i < samples_t(); ++i) {
-		result.push_back(fn[i] + g.fn[i]);
-	}
-	return DiscreteComplexFunctionR2(result, domain);
+	return DiscreteComplexFunctionR2(zipValues(grid, g.grid, [](Complex a, Complex b) { return a + b; }), domain, _domain_x);
 }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator+(Complex a) const {
-	vector<DiscreteComplexFunction> result;
-	result.reserve(samples_t());
-	for (int i = 0; i < samples_t(); ++i) {
-		result.push_back(fn[i] + a);
-	}
-	return DiscreteComplexFunctionR2(result, domain);
+	return DiscreteComplexFunctionR2(mapValues<Complex>(grid, [a](Complex c) { return c + a; }), domain, _domain_x);
 }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator+(float a) const {return this->operator+(Complex(a));}
@@ -1654,7 +1685,7 @@ DiscreteComplexFunctionR2 operator+(float a, const DiscreteComplexFunctionR2 &f)
 DiscreteComplexFunctionR2 operator+(Complex a, const DiscreteComplexFunctionR2 &f) { return f + a; }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator-() const {
-	return DiscreteComplexFunctionR2(map<DiscreteComplexFunction, DiscreteComplexFunction>(fn, [](const DiscreteComplexFunction &f) { return -f; }), domain);
+	return DiscreteComplexFunctionR2(mapValues<Complex>(grid, [](Complex c) { return -c; }), domain, _domain_x);
 }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator-(const DiscreteComplexFunctionR2 &g) const { return (*this) + (-g); }
@@ -1664,20 +1695,11 @@ DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator-(float a) const {
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator-(Complex a) const { return (*this) + (-a); }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator*(const DiscreteComplexFunctionR2 &g) const {
-	vector<DiscreteComplexFunction> res;
-	res.reserve(samples_t());
-	for (int i = 0; i < samples_t(); ++i) {
-		res.push_back(fn[i] * g.fn[i]);
-	}
-	return DiscreteComplexFunctionR2(res, domain);
+	return DiscreteComplexFunctionR2(zipValues(grid, g.grid, [](Complex a, Complex b) { return a * b; }), domain, _domain_x);
 }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator*(Complex a) const {
-	vector<DiscreteComplexFunction> res;
-	for (int i = 0; i < samples_t(); ++i) {
-		res.push_back(fn[i] * a);
-	}
-	return DiscreteComplexFunctionR2(res, domain);
+	return DiscreteComplexFunctionR2(mapValues<Complex>(grid, [a](Complex c) { return c * a; }), domain, _domain_x);
 }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator*(float a) const { return this->operator*(Complex(a)); }
@@ -1692,77 +1714,68 @@ DiscreteComplexFunctionR2 operator-(Complex a, const DiscreteComplexFunctionR2 &
 
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator/(const DiscreteComplexFunctionR2 &g) const {
-	vector<DiscreteComplexFunction> res;
-	for (int i = 0; i < samples_t(); ++i) {
-		res.push_back(fn[i] / g.fn[i]);
-	}
-	return DiscreteComplexFunctionR2(res, domain);
+	return DiscreteComplexFunctionR2(zipValues(grid, g.grid, [](Complex a, Complex b) { return a / b; }), domain, _domain_x);
 }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator/(float a) const { return this->operator*(1.0f/a); }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::operator/(Complex a) const { return this->operator*(1.0f/a); }
 
-DiscreteComplexFunction DiscreteComplexFunctionR2::operator[](int t) const { return fn[t]; }
+DiscreteComplexFunction DiscreteComplexFunctionR2::operator[](int t) const {
+	auto values = grid.row(t);
+	return DiscreteComplexFunction(vector<Complex>(values.begin(), values.end()), _domain_x);
+}
 
 Complex DiscreteComplexFunctionR2::operator()(float t, float x) const {
 	int t1 = (int) ::floor((t - domain[0]) / sampling_step_t());
 	int t2 = (int) ::ceil((t - domain[0]) / sampling_step_t());
 	float u = (t - domain[0]) / sampling_step_t() - t1;
-	return fn[t1](x) * (1 - u) + fn[t2](x) * u;
+	return interpolateRow(grid.row(t1), _domain_x, x) * (1 - u) + interpolateRow(grid.row(t2), _domain_x, x) * u;
 }
 
 Complex DiscreteComplexFunctionR2::operator()(vec2 x) const { return operator()(x.x, x.y); }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::transpose() const {
-		vector<DiscreteComplexFunction> res = vector<DiscreteComplexFunction>();
-		for (int i=0; i<samples_x(); i++) {
-			res.push_back(DiscreteComplexFunction(Vector<Complex>(samples_t(), [&](int j) { return fn[j][i]; }), domain));
-		}
-		return DiscreteComplexFunctionR2(res, fn[0].getDomain());
-	}
+	return DiscreteComplexFunctionR2(grid.transposed(), _domain_x, domain);
+}
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::fft_t() const {
-	vector<DiscreteComplexFunction> res = vector<DiscreteComplexFunction>();
-	for (auto &f : fn) {
-		res.push_back(f.fft());
-	}
-	return DiscreteComplexFunctionR2(res, domain);
+	auto res = grid;
+	fftRows(res, FFTDirection::FORWARD);
+	return DiscreteComplexFunctionR2(std::move(res), domain, _domain_x);
 }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::ifft_t() const {
-	vector<DiscreteComplexFunction> res = vector<DiscreteComplexFunction>();
-	for (auto &f : fn) {
-		res.push_back(f.ifft());
-	}
-	return DiscreteComplexFunctionR2(res, domain);
+	auto res = grid;
+	fftRows(res, FFTDirection::BACKWARD);
+	scaleValues(res, 1.f/samples_x());
+	return DiscreteComplexFunctionR2(std::move(res), domain, _domain_x);
 }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::fft_x() const {
-	return transpose().fft_t().transpose();
+	auto res = grid;
+	Grid2D<Complex> scratch;
+	fftColumns(res, scratch, FFTDirection::FORWARD);
+	return DiscreteComplexFunctionR2(std::move(res), domain, _domain_x);
 }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::ifft_x() const {
-	return transpose().ifft_t().transpose();
+	auto res = grid;
+	Grid2D<Complex> scratch;
+	fftColumns(res, scratch, FFTDirection::BACKWARD);
+	scaleValues(res, 1.f/samples_t());
+	return DiscreteComplexFunctionR2(std::move(res), domain, _domain_x);
 }
 
+// sum over both indices of exp(-i (TAU/nx ix jx + TAU/nt it kt)) f[kt][jx], the opposite sign of the one dimensional fft
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::fft() const {
 	float Lt=domain[1]-domain[0];
-	float Lx=fn[0].domain()[1]-fn[0].domain()[0];
-	vector<DiscreteComplexFunction> res = vector<DiscreteComplexFunction>();
-
-
-	for (int it=0; it<samples_t(); ++it) {
-		const vector<Complex> v = Vector<Complex>(samples_x(), [fn=fn, nx=samples_x(), Lx, Lt, nt=samples_t(), it](int ix) {
-			Complex c = 0i;
-			for (int jx = 0; jx < nx; ++jx)
-				for (int kt = 0; kt < nt; ++kt)
-					c += exp(-1.0i * (TAU / nx * ix * jx) - 1.0i * (TAU / nt * it * kt)) * fn[kt][jx];
-			return c;
-		}).vec();
-		res.push_back(DiscreteComplexFunction(v, vec2(0, TAU/Lx)));
-	}
-	return DiscreteComplexFunctionR2(res, vec2(0, TAU/Lt));
+	float Lx=_domain_x[1]-_domain_x[0];
+	auto res = grid;
+	Grid2D<Complex> scratch;
+	fftRows(res, FFTDirection::BACKWARD);
+	fftColumns(res, scratch, FFTDirection::BACKWARD);
+	return DiscreteComplexFunctionR2(std::move(res), vec2(0, TAU/Lt), vec2(0, TAU/Lx));
 }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::fft(int var) const {
@@ -1777,90 +1790,85 @@ DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::ifft(int var) const {
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::ifft() const {
 	float wt=domain[1];
-	float wx=fn[0].domain()[1];
-	vector<DiscreteComplexFunction> res = vector<DiscreteComplexFunction>();
-	res.reserve(samples_t());
-
-	for (int it=0; it<samples_t(); ++it) {
-		auto v = Vector<Complex>(samples_x(), [fn=fn, nx=samples_x(), nt=samples_t(), it](int ix) {
-			Complex c = 0i;
-			for (int jx=0; jx<nx; ++jx)
-				for (int kt=0; kt<nt; ++kt)
-					c += exp(1.0i * (TAU/nx  * ix*jx) + 1.0i * (TAU/nt * it*kt))*fn[kt][jx];
-			return c/(nt*nx);
-		}).vec();
-		res.push_back(DiscreteComplexFunction(v, vec2(0, TAU/wx)));
-	}
-	return DiscreteComplexFunctionR2(res, vec2(0, TAU/wt));
+	float wx=_domain_x[1];
+	auto res = grid;
+	Grid2D<Complex> scratch;
+	fftRows(res, FFTDirection::FORWARD);
+	fftColumns(res, scratch, FFTDirection::FORWARD);
+	scaleValues(res, 1.f/(samples_t()*samples_x()));
+	return DiscreteComplexFunctionR2(std::move(res), vec2(0, TAU/wt), vec2(0, TAU/wx));
 }
 
 DiscreteRealFunctionR2 DiscreteComplexFunctionR2::re() const {
-	vector<DiscreteRealFunction> res;
-	res.reserve(fn.size());
-	for (int i=0; i<fn.size(); i++) {
-		res.emplace_back(fn[i].re());
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(mapValues<float>(grid, [](Complex c) { return c.real(); }), domain, _domain_x);
 }
 
 DiscreteRealFunctionR2 DiscreteComplexFunctionR2::im() const {
-	vector<DiscreteRealFunction> res;
-	res.reserve(fn.size());
-	for (int i=0; i<fn.size(); i++) {
-		res.emplace_back(fn[i].im());
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(mapValues<float>(grid, [](Complex c) { return c.imag(); }), domain, _domain_x);
 }
 
 DiscreteRealFunctionR2 DiscreteComplexFunctionR2::abs() const {
-	vector<DiscreteRealFunction> res;
-	res.reserve(fn.size());
-	for (int i=0; i<fn.size(); i++) {
-		res.push_back(fn[i].abs());
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(mapValues<float>(grid, [](Complex c) { return norm(c.z); }), domain, _domain_x);
 }
 
 DiscreteRealFunctionR2 DiscreteComplexFunctionR2::arg() const {
-	vector<DiscreteRealFunction> res;
-	res.reserve(fn.size());
-	for (int i=0; i<fn.size(); i++) {
-		res.push_back(fn[i].arg());
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(mapValues<float>(grid, [](Complex c) { return c.arg(); }), domain, _domain_x);
 }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::downsample_t(int factor) const {
-	vector<DiscreteComplexFunction> res = vector<DiscreteComplexFunction>();
-	for (int i=0; i<fn.size(); i+=factor) {
-		res.push_back(fn[i]);
-	}
-	return DiscreteComplexFunctionR2(res, domain);
+	Grid2D<Complex> res((samples_t() + factor - 1)/factor, samples_x());
+	for (int i = 0; i < res.rows(); ++i)
+		std::copy_n(grid.rowData(i*factor), samples_x(), res.rowData(i));
+	return DiscreteComplexFunctionR2(std::move(res), domain, _domain_x);
 }
 
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::downsample_x(int factor) const {
-	vector<DiscreteComplexFunction> res = vector<DiscreteComplexFunction>();
-	for (auto &f : fn) {
-		res.push_back(f.downsample(factor));
-	}
-	return DiscreteComplexFunctionR2(res, domain);
+	Grid2D<Complex> res(samples_t(), (samples_x() + factor - 1)/factor);
+	for (int i = 0; i < res.rows(); ++i)
+		for (int j = 0; j < res.cols(); ++j)
+			res(i, j) = grid(i, j*factor);
+	return DiscreteComplexFunctionR2(std::move(res), domain, _domain_x);
 }
 
 DiscreteComplexFunctionR2 DiscreteComplexFunctionR2::downsample(int factor_t, int factor_x) const {
 	return downsample_x(factor_x).downsample_t(factor_t);
 }
 
-DiscreteRealFunctionR2::DiscreteRealFunctionR2(const vector<DiscreteRealFunction> &fn, vec2 domain): fn(fn), domain(domain) {}
+DiscreteRealFunctionR2::DiscreteRealFunctionR2(const vector<DiscreteRealFunction> &fn, vec2 domain)
+: grid(gridOfRows<float>(fn)), domain(domain), _domain_x(fn.empty() ? vec2(0, 1) : fn[0].getDomain()) {}
 
-DiscreteRealFunctionR2::DiscreteRealFunctionR2(const vector<std::function<float(float)>> &f, vec2 domain, int sampling) {
-	fn = vector<DiscreteRealFunction>();
+DiscreteRealFunctionR2::DiscreteRealFunctionR2(Grid2D<float> values, vec2 domain_t, vec2 domain_x)
+: grid(std::move(values)), domain(domain_t), _domain_x(domain_x) {}
+
+// the functions are sampled on domain, their index runs over [0, 1] until setDomain_t
+DiscreteRealFunctionR2::DiscreteRealFunctionR2(const vector<std::function<float(float)>> &f, vec2 domain, int sampling)
+: grid(f.size(), sampling), domain(vec2(0, 1)), _domain_x(domain) {
 	for (int i=0; i<f.size(); i++) {
-		fn.emplace_back(f[i], domain, sampling);
+		auto row = DiscreteRealFunction(f[i], domain, sampling);
+		for (int j = 0; j < sampling; ++j)
+			grid(i, j) = row[j];
 	}
 }
 
-DiscreteRealFunction DiscreteRealFunctionR2::operator[](int t) const { return fn[t]; }
+DiscreteRealFunctionR2 DiscreteRealFunctionR2::mapRows(const std::function<DiscreteRealFunction(int, const DiscreteRealFunction &)> &f) const {
+	if (samples_t() == 0)
+		return *this;
+	auto first = f(0, (*this)[0]);
+	Grid2D<float> res(samples_t(), first.samples());
+	forRowBlocks(samples_t(), [&](int i) {
+		auto row = i == 0 ? first : f(i, (*this)[i]);
+		THROW_IF(row.samples() != res.cols(), ValueError, "rows mapped to different lengths");
+		for (int j = 0; j < res.cols(); ++j)
+			res(i, j) = row[j];
+	});
+	return DiscreteRealFunctionR2(std::move(res), domain, first.getDomain());
+}
+
+DiscreteRealFunction DiscreteRealFunctionR2::operator[](int t) const {
+	auto values = grid.row(t);
+	return DiscreteRealFunction(vector<float>(values.begin(), values.end()), _domain_x);
+}
 
 DiscreteRealFunction DiscreteRealFunctionR2::operator()(float t) const {
 	int i0 = ::floor((t-domain[0]) / (domain[1]-domain[0]) * (samples_t()-1));
@@ -1869,136 +1877,86 @@ DiscreteRealFunction DiscreteRealFunctionR2::operator()(float t) const {
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::operator+(const DiscreteRealFunctionR2 &g) const {
-	vector<DiscreteRealFunction> res;
-	for (int i=0; i<fn.size(); i++)
-		res.push_back(fn[i] + g.fn[i]);
-
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(zipValues(grid, g.grid, [](float a, float b) { return a + b; }), domain, _domain_x);
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::operator+(float a) const {
-	vector<DiscreteRealFunction> res;
-	for (int i=0; i<fn.size(); i++) {
-		res.push_back(fn[i] + a);
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(mapValues<float>(grid, [a](float x) { return x + a; }), domain, _domain_x);
 }
 
 DiscreteRealFunctionR2 operator+(float a, const DiscreteRealFunctionR2 &f) { return f + a; }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::operator-() const {
-	vector<DiscreteRealFunction> res;
-	for (int i=0; i<fn.size(); i++) {
-		res.push_back(-fn[i]);
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(mapValues<float>(grid, [](float x) { return -x; }), domain, _domain_x);
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::operator-(const DiscreteRealFunctionR2 &g) const {
-	vector<DiscreteRealFunction> res;
-	for (int i=0; i<fn.size(); i++) {
-		res.push_back(fn[i] - g.fn[i]);
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(zipValues(grid, g.grid, [](float a, float b) { return a - b; }), domain, _domain_x);
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::operator-(float a) const {
-	vector<DiscreteRealFunction> res;
-	for (int i=0; i<fn.size(); i++) {
-		res.push_back(fn[i] - a);
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(mapValues<float>(grid, [a](float x) { return x - a; }), domain, _domain_x);
 }
 
 DiscreteRealFunctionR2 operator-(float a, const DiscreteRealFunctionR2 &f) { return f + -a; }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::operator*(float a) const {
-	vector<DiscreteRealFunction> res;
-	for (int i=0; i<fn.size(); i++) {
-		res.push_back(fn[i] * a);
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(mapValues<float>(grid, [a](float x) { return x * a; }), domain, _domain_x);
 }
 
 DiscreteRealFunctionR2 operator*(float a, const DiscreteRealFunctionR2 &f) { return f * a; }
 
-DiscreteRealFunctionR2 DiscreteRealFunctionR2::operator/(float a) const {
-	vector<DiscreteRealFunction> res;
-	for (int i=0; i<fn.size(); i++) {
-		res.push_back(fn[i] / a);
-	}
-	return DiscreteRealFunctionR2(res, domain);
-}
+DiscreteRealFunctionR2 DiscreteRealFunctionR2::operator/(float a) const { return this->operator*(1.0f/a); }
 
 DiscreteRealFunctionR2 operator/(float a, const DiscreteRealFunctionR2 &f) {
-	vector<DiscreteRealFunction> res;
-	for (int i=0; i<f.fn.size(); i++) {
-		res.push_back(DiscreteRealFunction([a](float x) { return a/x; }, f.domain, f.fn[i].samples()));
-	}
-	return DiscreteRealFunctionR2(res, f.domain);
+	return DiscreteRealFunctionR2(mapValues<float>(f.grid, [a](float x) { return a / x; }), f.domain, f._domain_x);
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::operator/(const DiscreteRealFunctionR2 &g) const {
-	vector<DiscreteRealFunction> res;
-	for (int i=0; i<fn.size(); i++) {
-		res.push_back(fn[i] / g.fn[i]);
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(zipValues(grid, g.grid, [](float a, float b) { return a / b; }), domain, _domain_x);
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::dfdx() const {
-	vector<DiscreteRealFunction> res;
-	for (int i=0; i<fn.size(); i++) {
-		res.push_back(fn[i].derivative());
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return mapRows([](int, const DiscreteRealFunction &f) { return f.derivative(); });
 }
 
-int DiscreteRealFunctionR2::samples_t() const { return fn.size(); }
+int DiscreteRealFunctionR2::samples_t() const { return grid.rows(); }
 
-int DiscreteRealFunctionR2::samples_x() const { return fn[0].samples(); }
+int DiscreteRealFunctionR2::samples_x() const { return grid.cols(); }
 
 float DiscreteRealFunctionR2::sampling_step_t() const { return (domain[1] - domain[0]) / (samples_t()-1); }
 
-float DiscreteRealFunctionR2::sampling_step_x() const { return fn[0].sampling_step(); }
+float DiscreteRealFunctionR2::sampling_step_x() const { return (_domain_x[1] - _domain_x[0]) / (samples_x()-1); }
 
 vector<float> DiscreteRealFunctionR2::args_t() const { return linspace(domain[0], domain[1], samples_t()); }
 
-vector<float> DiscreteRealFunctionR2::args_x() const { return fn[0].args(); }
+vector<float> DiscreteRealFunctionR2::args_x() const { return linspace(_domain_x[0], _domain_x[1], samples_x()); }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::operator*(const DiscreteRealFunctionR2 &g) const {
-	vector<DiscreteRealFunction> res;
-	res.reserve(fn.size());
-	for (int i=0; i<fn.size(); i++)
-		res.emplace_back(fn[i] + g.fn[i]);
-
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(zipValues(grid, g.grid, [](float a, float b) { return a * b; }), domain, _domain_x);
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::transpose() const {
-	vector<DiscreteRealFunction> res = vector<DiscreteRealFunction>();
-	res.reserve(samples_x());
-	for (int i=0; i<samples_x(); i++)
-		res.emplace_back(Vector<float>(samples_t(), [&](int j) { return fn[j][i]; }), domain);
-
-	return DiscreteRealFunctionR2(res, fn[0].getDomain());
+	return DiscreteRealFunctionR2(grid.transposed(), _domain_x, domain);
 }
 
 DiscreteRealFunction DiscreteRealFunctionR2::integrate_t() const {return transpose().integrate_x(); }
 
-DiscreteRealFunction DiscreteRealFunctionR2::integrate_x() const {return DiscreteRealFunction(Vector<float>(fn.size(), [&](int i) { return fn[i].integral(); }), domain); }
+DiscreteRealFunction DiscreteRealFunctionR2::integrate_x() const {
+	return DiscreteRealFunction(Vector<float>(samples_t(), [&](int i) {
+		float s = 0;
+		for (float x: grid.row(i))
+			s += x;
+		return s * sampling_step_x();
+	}), domain);
+}
 
 float DiscreteRealFunctionR2::double_integral() const { return integrate_x().integral(); }
 
 float DiscreteRealFunctionR2::double_integral(int i_t) const { return integrate_x().integral(i_t); }
 
 DiscreteComplexFunctionR2 DiscreteRealFunctionR2::complexify() const {
-	vector<DiscreteComplexFunction> res = vector<DiscreteComplexFunction>();
-	res.reserve(fn.size());
-	for (auto &f : fn)
-		res.emplace_back(f);
-
-	return DiscreteComplexFunctionR2(res, domain);
+	return DiscreteComplexFunctionR2(mapValues<Complex>(grid, [](float x) { return Complex(x, 0.f); }), domain, _domain_x);
 }
 
 DiscreteComplexFunctionR2 DiscreteRealFunctionR2::fft_t() const {
@@ -2018,28 +1976,17 @@ DiscreteRealFunctionR2 DiscreteRealFunctionR2::double_convolve(const DiscreteRea
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::convolve_x(const DiscreteRealFunction &kernel) const {
-	vector<DiscreteRealFunction> convolved;
-	convolved.reserve(fn.size());
 	auto k_ = kernel;
 	if (kernel.samples() > samples_x()) throw std::runtime_error("DiscreteRealFunction: kernel too long to convolve");
 	if (kernel.samples() < samples_x()) {
 		k_ = k_.two_sided_zero_padding(samples_x());
 	}
 	auto k_fft = k_.fft();
-	for (const auto &f : fn) {
-		convolved.push_back((f.fft() * k_fft).ifft().re());
-	}
-	return DiscreteRealFunctionR2(convolved, domain);
+	return mapRows([&k_fft](int, const DiscreteRealFunction &f) { return (f.fft() * k_fft).ifft().re(); });
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::convolve_x(const DiscreteRealFunctionR2 &kernel) const {
-	vector<DiscreteRealFunction> convolved;
-	convolved.reserve(fn.size());
-
-	for (int i = 0; i < fn.size(); ++i) {
-		convolved.push_back(fn[i].convolve(kernel[i]));
-	}
-	return DiscreteRealFunctionR2(convolved, domain);
+	return mapRows([&kernel](int i, const DiscreteRealFunction &f) { return f.convolve(kernel[i]); });
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::smoothen_x(float L) const {
@@ -2058,51 +2005,36 @@ DiscreteComplexFunctionR2 DiscreteRealFunctionR2::fft(int var) const {
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::downsample_t(int factor) const {
-	vector<DiscreteRealFunction> res = vector<DiscreteRealFunction>();
-	res.reserve(fn.size()/factor);
-	for (int i=0; i<fn.size(); i+=factor) {
-		res.push_back(fn[i]);
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return downsample_t(factor, 0);
 }
+
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::downsample_t(int factor, int shift) const {
-	vector<DiscreteRealFunction> res = vector<DiscreteRealFunction>();
-	res.reserve(fn.size()/factor);
-	for (int i=shift; i<fn.size(); i+=factor) {
-		res.push_back(fn[i]);
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	Grid2D<float> res(std::max(0, (samples_t() - shift + factor - 1)/factor), samples_x());
+	for (int i = 0; i < res.rows(); ++i)
+		std::copy_n(grid.rowData(shift + i*factor), samples_x(), res.rowData(i));
+	return DiscreteRealFunctionR2(std::move(res), domain, _domain_x);
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::downsample_t_max(int factor) const {
-	vector<DiscreteRealFunction> res = vector<DiscreteRealFunction>();
-	res.reserve(fn.size()/factor);
-	for (int i=0; i<fn.size(); i+=factor) {
-		auto a = fn[i];
-		for (int j=1; j<factor; ++j)
-			a = max(a, fn[(j+i)%fn.size()]);
-		res.push_back(a);
+	Grid2D<float> res((samples_t() + factor - 1)/factor, samples_x());
+	for (int i = 0; i < res.rows(); ++i) {
+		std::copy_n(grid.rowData(i*factor), samples_x(), res.rowData(i));
+		for (int j=1; j<factor; ++j) {
+			auto next = grid.row((i*factor + j) % samples_t());
+			for (int k = 0; k < samples_x(); ++k)
+				res(i, k) = std::max(res(i, k), next[k]);
+		}
 	}
-	return DiscreteRealFunctionR2(res, domain);
+	return DiscreteRealFunctionR2(std::move(res), domain, _domain_x);
 }
 
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::downsample_x(int factor) const {
-	vector<DiscreteRealFunction> res = vector<DiscreteRealFunction>();
-	res.reserve(fn.size());
-	for (auto &f : fn) {
-		res.push_back(f.downsample(factor));
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return mapRows([factor](int, const DiscreteRealFunction &f) { return f.downsample(factor); });
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::downsample_x(int factor, int shift) const {
-	vector<DiscreteRealFunction> res = vector<DiscreteRealFunction>();
-	res.reserve(fn.size());
-	for (auto &f : fn) {
-		res.push_back(f.downsample(factor, shift));
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return mapRows([factor, shift](int, const DiscreteRealFunction &f) { return f.downsample(factor, shift); });
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::downsample(int factor_t, int factor_x) const {
@@ -2110,12 +2042,7 @@ DiscreteRealFunctionR2 DiscreteRealFunctionR2::downsample(int factor_t, int fact
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::downsample_x_max(int factor) const {
-	vector<DiscreteRealFunction> res = vector<DiscreteRealFunction>();
-	res.reserve(fn.size());
-	for (auto &f : fn) {
-		res.push_back(f.downsample_max(factor));
-	}
-	return DiscreteRealFunctionR2(res, domain);
+	return mapRows([factor](int, const DiscreteRealFunction &f) { return f.downsample_max(factor); });
 }
 
 DiscreteRealFunctionR2 DiscreteRealFunctionR2::downsample_max(int factor_t, int factor_x) const {
@@ -2344,7 +2271,11 @@ RealFunctionR3::RealFunctionR3(RealFunctionR3 &&other) noexcept
 : _f(std::move(other._f)),
   _df(std::move(other._df)),
   eps(other.eps),
-  regularity(other.regularity) {}
+  regularity(other.regularity),
+  _expr(std::move(other._expr)),
+  _program(std::move(other._program)),
+  _fdf(std::move(other._fdf)),
+  _d2f(std::move(other._d2f)) {}
 
 RealFunctionR3 &RealFunctionR3::operator=(const RealFunctionR3 &other) {
 	if (this == &other)
@@ -2353,6 +2284,10 @@ RealFunctionR3 &RealFunctionR3::operator=(const RealFunctionR3 &other) {
 	_df = other._df;
 	eps = other.eps;
 	regularity = other.regularity;
+	_expr = other._expr;
+	_program = other._program;
+	_fdf = other._fdf;
+	_d2f = other._d2f;
 	return *this;
 }
 
@@ -2363,6 +2298,10 @@ RealFunctionR3 &RealFunctionR3::operator=(RealFunctionR3 &&other) noexcept {
 	_df = std::move(other._df);
 	eps = other.eps;
 	regularity = other.regularity;
+	_expr = std::move(other._expr);
+	_program = std::move(other._program);
+	_fdf = std::move(other._fdf);
+	_d2f = std::move(other._d2f);
 	return *this;
 }
 
@@ -2374,43 +2313,67 @@ vec3 RealFunctionR3::df(vec3 v) const {
 	return _df(v);
 }
 
+std::pair<float, vec3> RealFunctionR3::valueAndGradient(vec3 v) const {
+	if (_fdf)
+		return _fdf(v);
+	return {_f(v), _df(v)};
+}
+
+mat3 RealFunctionR3::hessian(vec3 v) const {
+	if (_d2f)
+		return _d2f(v);
+	mat3 H;
+	for (int i = 0; i < 3; ++i) {
+		vec3 e = vec3(0);
+		e[i] = eps;
+		H[i] = (_df(v + e) - _df(v - e)) / (2*eps);
+	}
+	return (H + transpose(H)) / 2.f;
+}
+
+float RealFunctionR3::Laplacian(vec3 v) const {
+	mat3 H = hessian(v);
+	return H[0][0] + H[1][1] + H[2][2];
+}
+
 
 RealFunctionR3 RealFunctionR3::operator*(float a) const {
-	return RealFunctionR3([this, a](vec3 v) {
-							  return this->_f(v) * a;
+	if (hasExpression())
+		return RealFunctionR3(_expr * a, eps, regularity);
+	return RealFunctionR3([f=_f, a](vec3 v) {
+							  return f(v) * a;
 						  },
-						  [this, a](vec3 v) {
-							  return this->_df(v) * a;
+						  [df=_df, a](vec3 v) {
+							  return df(v) * a;
 						  });
 }
 
 RealFunctionR3 RealFunctionR3::operator+(float a) const {
-	return RealFunctionR3([this, a](vec3 v) {
-							  return this->_f(v) + a;
+	if (hasExpression())
+		return RealFunctionR3(_expr + a, eps, regularity);
+	return RealFunctionR3([f=_f, a](vec3 v) {
+							  return f(v) + a;
 						  },
-						  [this](vec3 v) {
-							  return this->_df(v);
-						  });
+						  _df);
 }
 
 RealFunctionR3 RealFunctionR3::operator-(float a) const {
-	return RealFunctionR3([this, a](vec3 v) {
-							  return this->_f(v) - a;
-						  },
-						  [this](vec3 v) {
-							  return this->_df(v);
-						  });
+	return *this + (-a);
 }
 
 RealFunctionR3 RealFunctionR3::operator/(float a) const {
-	return RealFunctionR3([this, a](vec3 v) {
-							  return this->_f(v) / a;
-						  }, [this, a](vec3 v) {
-							  return this->_df(v) / a;
+	if (hasExpression())
+		return RealFunctionR3(_expr / a, eps, regularity);
+	return RealFunctionR3([f=_f, a](vec3 v) {
+							  return f(v) / a;
+						  }, [df=_df, a](vec3 v) {
+							  return df(v) / a;
 						  });
 }
 
 RealFunctionR3 RealFunctionR3::operator+(const RealFunctionR3 &g) const {
+	if (hasExpression() && g.hasExpression())
+		return RealFunctionR3(_expr + g._expr, eps, min(regularity, g.regularity));
 	return RealFunctionR3([f=_f, g_=g](vec3 x) {
 							  return f(x) + g_(x);
 						  },
@@ -2421,6 +2384,8 @@ RealFunctionR3 RealFunctionR3::operator+(const RealFunctionR3 &g) const {
 
 
 RealFunctionR3 RealFunctionR3::operator*(const RealFunctionR3 &g) const {
+	if (hasExpression() && g.hasExpression())
+		return RealFunctionR3(_expr * g._expr, eps, min(regularity, g.regularity));
 	return RealFunctionR3([f=_f, g_=g](vec3 x) {
 							  return f(x) * g_(x);
 						  },
@@ -2430,29 +2395,23 @@ RealFunctionR3 RealFunctionR3::operator*(const RealFunctionR3 &g) const {
 }
 
 RealFunctionR3 RealFunctionR3::operator/(const RealFunctionR3 &g) const {
+	if (hasExpression() && g.hasExpression())
+		return RealFunctionR3(_expr / g._expr, eps, min(regularity, g.regularity));
 	return RealFunctionR3([f=_f, g_=g](vec3 x) {
 							  return f(x) / g_(x);
 						  },
 						  [f=_f, df=_df, g_=g](vec3 x) {
-							  return (f(x) * g_.df(x) - df(x) * g_(x)) / (g_(x) * g_(x));
+							  return (df(x) * g_(x) - f(x) * g_.df(x)) / (g_(x) * g_(x));
 						  });
 }
 
 RealFunctionR3 RealFunctionR3::linear(vec3 v) {
-	return RealFunctionR3([v](vec3 x) {
-							  return dot(x, v);
-						  },
-						  [v](vec3 x) {
-							  return v;
-						  });
+	return RealFunctionR3(Expr::variable(0)*v.x + Expr::variable(1)*v.y + Expr::variable(2)*v.z, 0.01f, Regularity::ANALYTIC);
 }
 
 RealFunctionR3 RealFunctionR3::projection(int i) {
-	return RealFunctionR3([i](vec3 x) {
-							  return x[i];
-						  }, [](vec3) {
-							  return vec3(0, 0, 0);
-						  });
+	THROW_IF(i < 0 || i > 2, IndexOutOfBounds, i, 3, "RealFunctionR3::projection coordinates");
+	return RealFunctionR3(Expr::variable(i), 0.01f, Regularity::ANALYTIC);
 }
 
 SpaceEndomorphism &SpaceEndomorphism::operator=(const SpaceEndomorphism &other) {
@@ -2460,6 +2419,9 @@ SpaceEndomorphism &SpaceEndomorphism::operator=(const SpaceEndomorphism &other)
 		return *this;
 	_f = other._f;
 	_df = other._df;
+	eps = other.eps;
+	_expr = other._expr;
+	_program = other._program;
 	return *this;
 }
 
@@ -2468,17 +2430,15 @@ SpaceEndomorphism &SpaceEndomorphism::operator=(SpaceEndomorphism &&other) noexc
 		return *this;
 	_f = std::move(other._f);
 	_df = std::move(other._df);
+	eps = other.eps;
+	_expr = std::move(other._expr);
+	_program = std::move(other._program);
 	return *this;
 }
 
 
 RealFunctionR3 RealFunctionR3::constant(float a) {
-	return RealFunctionR3([a](vec3 x) {
-							  return a;
-						  },
-						  [a](vec3 x) {
-							  return vec3(0, 0, 0);
-						  });
+	return RealFunctionR3(Expr::constant(a), 0.01f, Regularity::ANALYTIC);
 }
 
 
@@ -2488,13 +2448,21 @@ RealFunction::RealFunction(const RealFunction &other)
 : _f(other._f),
   _df(other._df),
   _ddf(other._ddf),
-  eps(other.eps) {}
+  eps(other.eps),
+  is_zero(other.is_zero),
+  _expr(other._expr),
+  _program(other._program),
+  regularity(other.regularity) {}
 
 RealFunction::RealFunction(RealFunction &&other) noexcept
 : _f(std::move(other._f)),
   _df(std::move(other._df)),
   _ddf(std::move(other._ddf)),
-  eps(other.eps) {}
+  eps(other.eps),
+  is_zero(other.is_zero),
+  _expr(std::move(other._expr)),
+  _program(std::move(other._program)),
+  regularity(other.regularity) {}
 
 RealFunction &RealFunction::operator=(const RealFunction &other) {
 	if (this == &other)
@@ -2503,6 +2471,10 @@ RealFunction &RealFunction::operator=(const RealFunction &other) {
 	_df = other._df;
 	_ddf = other._ddf;
 	eps = other.eps;
+	is_zero = other.is_zero;
+	_expr = other._expr;
+	_program = other._program;
+	regularity = other.regularity;
 	return *this;
 }
 
@@ -2513,10 +2485,16 @@ RealFunction &RealFunction::operator=(RealFunction &&other) noexcept {
 	_df = std::move(other._df);
 	_ddf = std::move(other._ddf);
 	eps = other.eps;
+	is_zero = other.is_zero;
+	_expr = std::move(other._expr);
+	_program = std::move(other._program);
+	regularity = other.regularity;
 	return *this;
 }
 
 RealFunction RealFunction::operator+(const RealFunction &g) const {
+	if (hasExpression() && g.hasExpression())
+		return RealFunction(_expr + g._expr, eps, min(regularity, g.regularity));
 	return RealFunction([f=_f, g](float x) {
 							return f(x) + g(x);
 						},
@@ -2529,6 +2507,8 @@ RealFunction RealFunction::operator+(const RealFunction &g) const {
 }
 
 RealFunction RealFunction::operator*(float a) const {
+	if (hasExpression())
+		return RealFunction(_expr * a, eps, regularity);
 	return RealFunction([f=_f, a](float x) {
 							return f(x) * a;
 						},
@@ -2541,6 +2521,8 @@ RealFunction RealFunction::operator*(float a) const {
 }
 
 RealFunction RealFunction::operator+(float a) const {
+	if (hasExpression())
+		return RealFunction(_expr + a, eps, regularity);
 	return RealFunction([_f=_f, a](float x) {
 							return _f(x) + a;
 						},
@@ -2553,6 +2535,8 @@ RealFunction RealFunction::operator+(float a) const {
 }
 
 RealFunction RealFunction::operator*(const RealFunction &g_) const {
+	if (hasExpression() && g_.hasExpression())
+		return RealFunction(_expr * g_._expr, eps, min(regularity, g_.regularity));
 	return RealFunction(
 						[f=_f, g=g_._f](float x) {
 							return f(x) * g(x);
@@ -2566,19 +2550,23 @@ RealFunction RealFunction::operator*(const RealFunction &g_) const {
 }
 
 RealFunction RealFunction::operator/(const RealFunction &g_) const {
+	if (hasExpression() && g_.hasExpression())
+		return RealFunction(_expr / g_._expr, eps, min(regularity, g_.regularity));
 	return RealFunction(
 						[f=_f, g=g_._f](float x) {
 							return f(x) / g(x);
 						},
 						[f=_f, g=g_._f, df=_df, dg=g_._df](float x) {
-							return (f(x) * dg(x) - g(x) * df(x)) / (g(x) * g(x));
+							return (df(x) * g(x) - f(x) * dg(x)) / (g(x) * g(x));
 						},
 						[f=_f, g=g_._f, df=_df, dg=g_._df, ddf=_ddf, ddg=g_._ddf](float x) {
-							return (ddf(x) * g(x) * g(x) - 2 * df(x) * dg(x) * g(x) + f(x) * ddg(x) * g(x) * g(x) - f(x) * g(x) * g(x) * g(x) * g(x)) / (g(x) * g(x) * g(x) * g(x));
+							return (ddf(x) * g(x) * g(x) - 2 * df(x) * dg(x) * g(x) - f(x) * ddg(x) * g(x) + 2 * f(x) * dg(x) * dg(x)) / (g(x) * g(x) * g(x));
 						}, eps);
 }
 
 RealFunction RealFunction::operator&(const RealFunction &g_) const {
+	if (hasExpression() && g_.hasExpression())
+		return RealFunction(_expr.substitute(std::span(&g_._expr, 1)), eps, min(regularity, g_.regularity));
 	return RealFunction([f=_f, g=g_._f](float x) {
 							return f(g(x));
 						},
@@ -2591,6 +2579,8 @@ RealFunction RealFunction::operator&(const RealFunction &g_) const {
 }
 
 RealFunctionR3 RealFunction::operator&(const RealFunctionR3 &g_) const {
+	if (hasExpression() && g_.hasExpression())
+		return RealFunctionR3(_expr.substitute(std::span(&g_.expression(), 1)), eps);
 	return RealFunctionR3([f=*this, g=g_](vec3 v) {
 		return f(g(v));
 	}, eps);
@@ -2629,13 +2619,7 @@ RealFunction RealFunction::repeated_antiderivative(float a, int prec) const { re
 
 RealFunction RealFunction::monomial(float n) {
 	if (n == 0) return constant(1);
-	return RealFunction([n](float x) {
-							return std::pow(x, n);
-						}, [n](float x) {
-							return n * std::pow(x, n - 1);
-						}, [n](float x) {
-							return n * (n - 1) * std::pow(x, n - 2);
-						});
+	return RealFunction(::pow(Expr::variable(0), n));
 }
 
 RealFunction RealFunction::polynomial(std::vector<float> coeffs) {
@@ -2737,6 +2721,8 @@ SpaceEndomorphism::SpaceEndomorphism(std::function<vec3(vec3)> f, float epsilon)
 
 
 SpaceEndomorphism SpaceEndomorphism::compose(const SpaceEndomorphism &g) const {
+	if (hasExpression() && g.hasExpression())
+		return SpaceEndomorphism({_expr[0].substitute(g._expr), _expr[1].substitute(g._expr), _expr[2].substitute(g._expr)}, eps);
 	return SpaceEndomorphism([f=_f, g](vec3 v) {
 								 return f(g(v));
 							 },
@@ -2754,12 +2740,7 @@ SpaceEndomorphism SpaceEndomorphism::scaling(float x, float y, float z) {
 }
 
 SpaceEndomorphism SpaceEndomorphism::affine(mat3 A, vec3 v) {
-	return SpaceEndomorphism([A, v](vec3 x) {
-								 return A * x + v;
-							 },
-							 [A](vec3 x) {
-								 return A;
-							 });
+	return SpaceEndomorphism(affineCoordinates(A, v));
 }
 
 SpaceAutomorphism SpaceAutomorphism::linear(mat3 A) {
@@ -2827,10 +2808,7 @@ SpaceAutomorphism SpaceAutomorphism::rotation(vec3 axis, float angle) {
 
 
 ScalarField::ScalarField()
-: F([](vec3 x, float t) {
-	  return 0;
-  }),
-  eps(0.01) {}
+: ScalarField(Expr::constant(0)) {}
 
 ScalarField::ScalarField(std::function<float(vec3, float)> F, float eps)
 : F(F),
@@ -2846,39 +2824,74 @@ ScalarField::ScalarField(SteadyScalarField steady_field)
 : F([steady_field](vec3 x, float t) {
 	  return steady_field(x);
   }),
-  eps(steady_field.getEps()) {}
+  eps(steady_field.getEps()),
+  expr(steady_field.expression()) {}
+
+ScalarField::ScalarField(const Expr &F, float eps)
+: F([p=make_shared<const ExprProgram>(F, 4)](vec3 x, float t) {
+	  float v[4] = {x.x, x.y, x.z, t};
+	  return p->tape()(v);
+  }),
+  eps(eps),
+  expr(F) {}
 
 float ScalarField::operator()(vec3 x, float t) const { return F(x, t); }
 
-SteadyScalarField ScalarField::operator()(float t) const { return SteadyScalarField([F=F, t](vec3 x) { return F(x, t); }, eps); }
+SteadyScalarField ScalarField::operator()(float t) const {
+	if (hasExpression()) {
+		Expr values[] = {Expr::variable(0), Expr::variable(1), Expr::variable(2), Expr::constant(t)};
+		return SteadyScalarField(expr.substitute(values), eps);
+	}
+	return SteadyScalarField([F=F, t](vec3 x) { return F(x, t); }, eps);
+}
 
 SteadyScalarField ScalarField::fix_time(float t) const { return operator()(t); }
 
-ScalarField ScalarField::operator+(const ScalarField &Y) const { return ScalarField([F=F, Y=Y.F](vec3 x, float t) { return F(x, t) + Y(x, t); }, eps); }
+ScalarField ScalarField::operator+(const ScalarField &Y) const {
+	if (hasExpression() && Y.hasExpression())
+		return ScalarField(expr + Y.expr, eps);
+	return ScalarField([F=F, Y=Y.F](vec3 x, float t) { return F(x, t) + Y(x, t); }, eps);
+}
 
-ScalarField ScalarField::operator*(float a) const { return ScalarField([F=F, a=a](vec3 x, float t) { return F(x, t) * a; }, eps); }
+ScalarField ScalarField::operator*(float a) const {
+	if (hasExpression())
+		return ScalarField(expr * a, eps);
+	return ScalarField([F=F, a=a](vec3 x, float t) { return F(x, t) * a; }, eps);
+}
 
 ScalarField ScalarField::operator-() const { return *this * -1; }
 
 ScalarField ScalarField::operator-(const ScalarField &Y) const { return *this + (-Y); }
 
-ScalarField ScalarField::operator*(const SteadyScalarField &f) const { return ScalarField([F=F, f=f](vec3 x, float t) { return F(x, t) * f(x); }, eps); }
+ScalarField ScalarField::operator*(const SteadyScalarField &f) const { return *this * ScalarField(f); }
 
-ScalarField ScalarField::operator/(const SteadyScalarField &f) const { return ScalarField([F=F, f=f](vec3 x, float t) { return F(x, t) * f(x); }, eps); }
+ScalarField ScalarField::operator/(const SteadyScalarField &f) const { return *this / ScalarField(f); }
 
-ScalarField ScalarField::operator*(const ScalarField &f) const { return ScalarField([F=F, f=f](vec3 x, float t) { return F(x, t) * f(x, t); }, eps); }
+ScalarField ScalarField::operator*(const ScalarField &f) const {
+	if (hasExpression() && f.hasExpression())
+		return ScalarField(expr * f.expr, eps);
+	return ScalarField([F=F, f=f](vec3 x, float t) { return F(x, t) * f(x, t); }, eps);
+}
 
-ScalarField ScalarField::operator/(const ScalarField &f) const { return ScalarField([F=F, f=f](vec3 x, float t) { return F(x, t) * f(x, t); }, eps); }
+ScalarField ScalarField::operator/(const ScalarField &f) const {
+	if (hasExpression() && f.hasExpression())
+		return ScalarField(expr / f.expr, eps);
+	return ScalarField([F=F, f=f](vec3 x, float t) { return F(x, t) / f(x, t); }, eps);
+}
 
 ScalarField ScalarField::time_derivative() const {
+	if (hasExpression())
+		return ScalarField(expr.derivative(3), eps);
 	return ScalarField([F=F, e=eps](vec3 x, float t) {
 		return derivativeOperator(curry(F)(x), e)(t);
 	}, eps);
 }
 
 ScalarField ScalarField::spatial_partial(int i) const {
-	return ScalarField([F=F, e=eps](vec3 x, float t) {
-		return derivativeOperator(curry(F)(x), e)(t);
+	if (hasExpression())
+		return ScalarField(expr.derivative(i), eps);
+	return ScalarField([F=F, i, e=eps](vec3 x, float t) {
+		return partialDerivativeOperator([&F, t](vec3 y) { return F(y, t); }, i, e)(x);
 	}, eps);
 }
 
@@ -2928,23 +2941,6 @@ SpaceAutomorphism SpaceAutomorphism::compose(SpaceAutomorphism g) const {
 							 });
 }
 
-DiscreteRealFunction loadSequence(const CodeFileDescriptor &file, vec2 domain) {
-	string code = file.readCode();
-	vector<string> lines = split(code, '\n');
-	vector<float> values;
-	for (const auto &line: lines) {
-		if (line.empty()) continue;
-		if (line[0] == '#') continue;
-		if (line[0] == '/') continue;
-		if (line[0] == ' ') continue;
-		if (line[0] == '\t') continue;
-		values.push_back(stof(line));
-	}
-	return DiscreteRealFunction(values, domain);
-}
-
-
-
 float smoothstep(float x0, float x1, float x) {
 	if (x < x0) return 0;
 	if (x > x1) return 1;
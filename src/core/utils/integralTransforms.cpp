@@ -1,5 +1,10 @@
 #include "integralTransforms.hpp"
 
+#include <chrono>
+
+#include "fft.hpp"
+#include "logging.hpp"
+
 RealFunction dirichlet_kernel(int n, float L)  {
 	return RealFunction([n, L](float x) {
 		if (x == 0) return 2.f*n+1;
@@ -152,25 +157,30 @@ FiniteSequence<Complex> DiscreteTransform::operator()(const FiniteSequence<float
 	return operator()(fn.base_change<Complex>());
 }
 
+// indices run over [n_min, n_max], so the plan output picks up a phase exp(-+2pi i k n_min/N)
 FiniteSequence<Complex> DFT::operator()(FiniteSequence<Complex> fn) const {
+	vector<Complex> buf;
+	buf.reserve(N);
+	for (int n = n_min; n <= n_max; ++n)
+		buf.push_back(fn[n]);
+	FFTPlan::get(N, FFTDirection::BACKWARD)->execute(buf);
+
 	FiniteSequence<Complex> res = FiniteSequence<Complex>();
-	for (int k = n_min; k <= n_max; ++k) {
-		Complex sum = Complex(0);
-		for (int n = n_min; n <= n_max; ++n)
-			sum += fn[n] * exp(-TAU*1.0i*k*n/N);
-		res.set(k, sum);
-	}
+	for (int k = n_min; k <= n_max; ++k)
+		res.set(k, buf[(k % N + N) % N] * exp(-TAU*1.0i*k*n_min/N));
 	return res;
 }
 
 FiniteSequence<Complex> DFT::inv(FiniteSequence<Complex> fn) const {
+	vector<Complex> buf;
+	buf.reserve(N);
+	for (int n = n_min; n <= n_max; ++n)
+		buf.push_back(fn[n]);
+	FFTPlan::get(N, FFTDirection::FORWARD)->execute(buf);
+
 	FiniteSequence<Complex> res = FiniteSequence<Complex>();
-	for (int k = n_min; k <= n_max; ++k) {
-		Complex sum = Complex(0);
-		for (int n = n_min; n <= n_max; ++n)
-			sum += fn[n] * exp(TAU*1.0i*k*n/N);
-		res.set(k, sum);
-	}
+	for (int k = n_min; k <= n_max; ++k)
+		res.set(k, buf[(k % N + N) % N] * exp(TAU*1.0i*k*n_min/N));
 	return res/Complex(N);
 }
 
@@ -210,3 +220,18 @@ FiniteSequence<float> DFT::frequencies() const {
 // RealFunctionR2 FourierTransform::inv(RealFunctionR2 _f, int var) {
 // 	throw std::logic_error("Not implemented");
 // }
+
+
+DiscreteComplexFunctionR2 DiscreteGaborTransform::transform(const DiscreteRealFunction &f, int threads) const {
+	STFTEngine stft = engine();
+	vector<float> samples = f.getVector().vec();
+	return stft.fullSpectrum(stft.analyse(samples, threads), f.getDomain());
+}
+
+DiscreteComplexFunctionR2 DiscreteGaborTransform::transform_print(const DiscreteRealFunction &f, int threads) const {
+	auto start = std::chrono::steady_clock::now();
+	auto res = transform(f, threads);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	LOG("Gabor transform of " + to_string(f.samples()) + " samples: " + to_string(res.samples_t()) + " frames of " + to_string(window_size()) + " in " + to_string(ms) + "ms");
+	return res;
+}
@@ -0,0 +1,250 @@
+#include "jobSystem.hpp"
+
+#include <deque>
+#include <string>
+
+#include "exceptions.hpp"
+
+
+namespace {
+	// the worker the current thread is, -1 outside of any pool
+	thread_local const JobSystem *currentSystem = nullptr;
+	thread_local int currentWorker = -1;
+
+	// yields an idle worker makes before going to sleep
+	constexpr int IDLE_SPINS = 64;
+
+	std::mutex globalMutex;
+	std::unique_ptr<JobSystem> globalSystem;
+}
+
+
+void JobCounter::fail(std::exception_ptr e) {
+	std::lock_guard lock(errorMutex);
+	if (!error)
+		error = e;
+}
+
+
+JobSystem::JobSystem(int threads) {
+	int workerCount = (threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency())) - 1;
+	for (int w = 0; w <= workerCount; ++w)
+		queues.push_back(std::make_unique<Queue>());
+	for (int w = 0; w < workerCount; ++w)
+		workers.emplace_back([this, w] { workerLoop(w); });
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto &worker: workers)
+		worker.join();
+	// jobs submitted by outside threads after the workers left
+	while (runPending());
+}
+
+JobSystem &JobSystem::global() {
+	std::lock_guard lock(globalMutex);
+	if (!globalSystem)
+		globalSystem = std::make_unique<JobSystem>();
+	return *globalSystem;
+}
+
+void JobSystem::configureGlobal(int threads) {
+	std::lock_guard lock(globalMutex);
+	globalSystem.reset();
+	globalSystem = std::make_unique<JobSystem>(threads);
+}
+
+
+void JobSystem::push(Job &&job) {
+	Queue &queue = currentSystem == this ? *queues[currentWorker] : *queues.back();
+	{
+		std::lock_guard lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+	queued.fetch_add(1);
+	// a worker about to sleep counted itself before checking queued, so it either sees the job or gets notified
+	if (sleepers.load() > 0) {
+		{ std::lock_guard lock(sleepMutex); }
+		wake.notify_one();
+	}
+}
+
+bool JobSystem::pop(Job &job) {
+	if (queued.load(std::memory_order_relaxed) == 0)
+		return false;
+	int own = currentSystem == this ? currentWorker : -1;
+	auto take = [&](Queue &queue, bool back) {
+		std::lock_guard lock(queue.mutex);
+		if (queue.jobs.empty())
+			return false;
+		if (back) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		} else {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+		queued.fetch_sub(1);
+		return true;
+	};
+	if (own >= 0 && take(*queues[own], true))
+		return true;
+	if (take(*queues.back(), false))
+		return true;
+	// steal the oldest, thus largest, piece of work starting from the next worker to spread the thieves
+	int n = workers.size();
+	for (int k = 1; k <= n; ++k) {
+		int victim = (std::max(own, 0) + k) % n;
+		if (victim != own && take(*queues[victim], false))
+			return true;
+	}
+	return false;
+}
+
+void JobSystem::execute(Job &job) {
+	try {
+		job.work();
+	} catch (...) {
+		job.counter->fail(std::current_exception());
+	}
+	job.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::workerLoop(int index) {
+	currentSystem = this;
+	currentWorker = index;
+	Job job;
+	while (true) {
+		if (pop(job)) {
+			execute(job);
+			job.work = nullptr;
+			continue;
+		}
+		for (int spin = 0; spin < IDLE_SPINS && queued.load() == 0; ++spin)
+			std::this_thread::yield();
+		if (queued.load() > 0)
+			continue;
+		std::unique_lock lock(sleepMutex);
+		if (stopping)
+			return;
+		sleepers.fetch_add(1);
+		wake.wait(lock, [&] { return stopping || queued.load() > 0; });
+		sleepers.fetch_sub(1);
+		if (stopping && queued.load() == 0)
+			return;
+	}
+}
+
+
+void JobSystem::submit(JobCounter &counter, std::function<void()> work) {
+	Job job{std::move(work), &counter};
+	counter.pending.fetch_add(1, std::memory_order_relaxed);
+	if (serial())
+		execute(job);
+	else
+		push(std::move(job));
+}
+
+void JobSystem::wait(JobCounter &counter) {
+	Job job;
+	while (!counter.done()) {
+		if (pop(job)) {
+			execute(job);
+			job.work = nullptr;
+		} else
+			std::this_thread::yield();
+	}
+	std::exception_ptr error;
+	{
+		std::lock_guard lock(counter.errorMutex);
+		std::swap(error, counter.error);
+	}
+	if (error)
+		std::rethrow_exception(error);
+}
+
+bool JobSystem::runPending() {
+	Job job;
+	if (!pop(job))
+		return false;
+	execute(job);
+	return true;
+}
+
+
+int TaskGraph::add(std::function<void()> work, const std::vector<int> &dependencies) {
+	int id = tasks.size();
+	tasks.push_back({std::move(work), {}, 0});
+	for (int d: dependencies)
+		precede(d, id);
+	return id;
+}
+
+void TaskGraph::precede(int before, int after) {
+	THROW_IF(before < 0 || before >= size(), IndexOutOfBounds, before, size(), "TaskGraph");
+	THROW_IF(after < 0 || after >= size(), IndexOutOfBounds, after, size(), "TaskGraph");
+	tasks[before].successors.push_back(after);
+	++tasks[after].dependencies;
+}
+
+void TaskGraph::run(JobSystem &system) const {
+	int n = size();
+	// Kahn's algorithm in insertion order, it is the serial schedule and proves the graph acyclic
+	std::vector<int> order, remaining(n);
+	order.reserve(n);
+	for (int i = 0; i < n; ++i)
+		if ((remaining[i] = tasks[i].dependencies) == 0)
+			order.push_back(i);
+	for (int k = 0; k < (int)order.size(); ++k)
+		for (int s: tasks[order[k]].successors)
+			if (--remaining[s] == 0)
+				order.push_back(s);
+	THROW_IF((int)order.size() < n, IllegalArgumentError, "TaskGraph: dependencies of " + std::to_string(n - order.size()) + " tasks form a cycle");
+
+	if (system.serial()) {
+		// a failed task skips its successors like in the parallel schedule
+		std::vector<bool> skipped(n, false);
+		std::exception_ptr error;
+		for (int i: order) {
+			if (skipped[i]) {
+				for (int s: tasks[i].successors)
+					skipped[s] = true;
+				continue;
+			}
+			try {
+				tasks[i].work();
+			} catch (...) {
+				if (!error)
+					error = std::current_exception();
+				for (int s: tasks[i].successors)
+					skipped[s] = true;
+			}
+		}
+		if (error)
+			std::rethrow_exception(error);
+		return;
+	}
+
+	std::unique_ptr<std::atomic<int>[]> waiting(new std::atomic<int>[n]);
+	for (int i = 0; i < n; ++i)
+		waiting[i].store(tasks[i].dependencies, std::memory_order_relaxed);
+	JobCounter counter;
+	auto launch = [&](auto &self, int i) -> void {
+		system.submit(counter, [&self, &waiting, i, this] {
+			tasks[i].work();
+			// successors are submitted before this job is done, so the counter stays positive until the graph is
+			for (int s: tasks[i].successors)
+				if (waiting[s].fetch_sub(1, std::memory_order_acq_rel) == 1)
+					self(self, s);
+		});
+	};
+	for (int i = 0; i < n; ++i)
+		if (tasks[i].dependencies == 0)
+			launch(launch, i);
+	system.wait(counter);
+}
@@ -598,41 +598,6 @@ float pseudorandomizer(float x, float seed) {
 }
 
 
-SparseMatrix::SparseMatrix(int n, int m) {
-	this->n = n;
-	this->m = m;
-	this->data = vector<vector<pair<int, float> > >(n);
-}
-
-void SparseMatrix::set(int i, int j, float val) {
-	this->data[i].emplace_back(j, val);
-}
-
-float SparseMatrix::get(int i, int j) {
-	for (auto p: this->data[i]) if (p.first == j) return p.second;
-	return 0;
-}
-
-SparseMatrix SparseMatrix::operator*(float f) {
-	SparseMatrix result = SparseMatrix(this->n, this->m);
-	for (int i = 0; i < this->n; i++) for (auto p: this->data[i]) result.set(i, p.first, p.second * f);
-	return result;
-}
-
-SparseMatrix SparseMatrix::operator+(const SparseMatrix &M) {
-	SparseMatrix result = SparseMatrix(this->n, this->m);
-	for (int i = 0; i < this->n; i++) for (auto p: this->data[i]) result.set(i, p.first, p.second);
-	for (int i = 0; i < M.n; i++) for (auto p: M.data[i]) result.set(i, p.first, result.get(i, p.first) + p.second);
-	return result;
-}
-
-SparseMatrix SparseMatrix::operator-(const SparseMatrix &M) {
-	SparseMatrix result = SparseMatrix(this->n, this->m);
-	for (int i = 0; i < this->n; i++) for (auto p: this->data[i]) result.set(i, p.first, p.second);
-	for (int i = 0; i < M.n; i++) for (auto p: M.data[i]) result.set(i, p.first, result.get(i, p.first) - p.second);
-	return result;
-}
-
 FloatVector::FloatVector(vec2 data) {
 	this->data = vecToVecHeHe(data);
 }
@@ -824,11 +789,44 @@ bool FloatMatrix::isSquare() const {
 	return this->n() == this->m();
 }
 
+namespace {
+	// in place LU factorisation with partial pivoting in double, returns the sign of the row permutation or 0 when singular
+	int decomposeLU(vector<vector<double>> &lu, vector<int> &rowOrder) {
+		int n = lu.size();
+		rowOrder.resize(n);
+		for (int i = 0; i < n; i++) rowOrder[i] = i;
+		int sign = 1;
+		for (int k = 0; k < n; k++) {
+			int p = k;
+			for (int i = k + 1; i < n; i++) if (std::abs(lu[i][k]) > std::abs(lu[p][k])) p = i;
+			if (lu[p][k] == 0) return 0;
+			if (p != k) {
+				std::swap(lu[p], lu[k]);
+				std::swap(rowOrder[p], rowOrder[k]);
+				sign = -sign;
+			}
+			for (int i = k + 1; i < n; i++) {
+				double l = lu[i][k] /= lu[k][k];
+				for (int j = k + 1; j < n; j++) lu[i][j] -= l * lu[k][j];
+			}
+		}
+		return sign;
+	}
+
+	vector<vector<double>> toDouble(const MATR$X &data) {
+		vector<vector<double>> res;
+		res.reserve(data.size());
+		for (const auto &row: data) res.emplace_back(row.begin(), row.end());
+		return res;
+	}
+}
+
 float FloatMatrix::det() {
 	if (n() != m()) throw std::invalid_argument("Matrix must be square");
-	if (n() == 1) return this->data[0][0];
-	float result = 0;
-	for (int j = 0; j < m(); j++) if (this->data[0][j] != 0) result += this->data[0][j] * submatrix(0, j).det() * (j % 2 == 0 ? 1 : -1);
+	auto lu = toDouble(this->data);
+	vector<int> rowOrder;
+	double result = decomposeLU(lu, rowOrder);
+	for (int k = 0; k < n() && result != 0; k++) result *= lu[k][k];
 	return result;
 }
 
@@ -908,11 +906,24 @@ FloatMatrix operator*(const vector<vector<float> > &M, const FloatMatrix &B) {
 
 FloatMatrix FloatMatrix::inv() {
 	if (n() != m()) throw std::invalid_argument("Matrix must be square");
-	float d = det();
-	if (d == 0) throw std::invalid_argument("Matrix must be invertible");
+	auto lu = toDouble(this->data);
+	vector<int> rowOrder;
+	if (decomposeLU(lu, rowOrder) == 0) throw std::invalid_argument("Matrix must be invertible");
+	// column j of the inverse solves LU x = P e_j
 	FloatMatrix result = FloatMatrix(n(), m());
-	for (int i = 0; i < n(); i++) for (int j = 0; j < m(); j++) result.data[i][j] = submatrix(j, i).det() * ((i + j) % 2 == 0 ? 1 : -1);
-	return result / d;
+	vector<double> x(n());
+	for (int j = 0; j < n(); j++) {
+		for (int i = 0; i < n(); i++) {
+			x[i] = rowOrder[i] == j ? 1 : 0;
+			for (int k = 0; k < i; k++) x[i] -= lu[i][k] * x[k];
+		}
+		for (int i = n() - 1; i >= 0; i--) {
+			for (int k = i + 1; k < n(); k++) x[i] -= lu[i][k] * x[k];
+			x[i] /= lu[i][i];
+		}
+		for (int i = 0; i < n(); i++) result.data[i][j] = x[i];
+	}
+	return result;
 }
 
 FloatMatrix FloatMatrix::pow(int p) {
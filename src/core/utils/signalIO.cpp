@@ -0,0 +1,445 @@
+#include "signalIO.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <string_view>
+
+#include "parallel.hpp"
+#include "stringUtils.hpp"
+
+
+namespace {
+	// samples converted per parallel block of readAll and per buffer of the writers
+	constexpr size_t SIGNAL_BLOCK = 1 << 18;
+
+	template<typename T>
+	T loadLE(const char *p) {
+		T x;
+		std::memcpy(&x, p, sizeof x);
+		return x;
+	}
+
+	template<typename T>
+	void storeLE(vector<char> &out, T x) {
+		char bytes[sizeof x];
+		std::memcpy(bytes, &x, sizeof x);
+		out.insert(out.end(), bytes, bytes + sizeof x);
+	}
+
+	// n samples with given stride in bytes, integer PCM scaled to [-1, 1)
+	void decode(SampleFormat format, const char *src, size_t stride, float *out, size_t n) {
+		switch (format) {
+			case SampleFormat::PCM_U8:
+				for (size_t i = 0; i < n; ++i)
+					out[i] = ((int)(unsigned char)src[i*stride] - 128)/128.f;
+				break;
+			case SampleFormat::PCM_S16:
+				for (size_t i = 0; i < n; ++i)
+					out[i] = loadLE<int16_t>(src + i*stride)/32768.f;
+				break;
+			case SampleFormat::PCM_S24:
+				for (size_t i = 0; i < n; ++i) {
+					auto b = reinterpret_cast<const unsigned char *>(src + i*stride);
+					int32_t x = (int32_t)((uint32_t)b[0] << 8 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 24) >> 8;
+					out[i] = x/8388608.f;
+				}
+				break;
+			case SampleFormat::PCM_S32:
+				for (size_t i = 0; i < n; ++i)
+					out[i] = (float)(loadLE<int32_t>(src + i*stride)/2147483648.);
+				break;
+			case SampleFormat::FLOAT32:
+				if (stride == sizeof(float))
+					std::memcpy(out, src, n*sizeof(float));
+				else
+					for (size_t i = 0; i < n; ++i)
+						out[i] = loadLE<float>(src + i*stride);
+				break;
+			case SampleFormat::FLOAT64:
+				for (size_t i = 0; i < n; ++i)
+					out[i] = (float)loadLE<double>(src + i*stride);
+				break;
+		}
+	}
+
+	template<typename T>
+	T quantise(float x, float scale, float lo, float hi) {
+		return (T)std::clamp(std::nearbyint(x*scale), lo, hi);
+	}
+
+	void encode(SampleFormat format, std::span<const float> samples, vector<char> &out) {
+		size_t start = out.size();
+		out.resize(start + samples.size()*bytesPerSample(format));
+		char *dst = out.data() + start;
+		for (float x: samples)
+			switch (format) {
+				case SampleFormat::PCM_U8:
+					*dst++ = (char)(uint8_t)(quantise<int>(x, 128, -128, 127) + 128);
+					break;
+				case SampleFormat::PCM_S16: {
+					auto y = quantise<int16_t>(x, 32768, -32768, 32767);
+					std::memcpy(dst, &y, 2);
+					dst += 2;
+					break;
+				}
+				case SampleFormat::PCM_S24: {
+					auto y = (uint32_t)quantise<int32_t>(x, 8388608, -8388608, 8388607);
+					*dst++ = (char)(y & 0xFF);
+					*dst++ = (char)(y >> 8 & 0xFF);
+					*dst++ = (char)(y >> 16 & 0xFF);
+					break;
+				}
+				case SampleFormat::PCM_S32: {
+					auto y = (int32_t)std::clamp(std::nearbyint(x*2147483648.), -2147483648., 2147483647.);
+					std::memcpy(dst, &y, 4);
+					dst += 4;
+					break;
+				}
+				case SampleFormat::FLOAT32:
+					std::memcpy(dst, &x, 4);
+					dst += 4;
+					break;
+				case SampleFormat::FLOAT64: {
+					double y = x;
+					std::memcpy(dst, &y, 8);
+					dst += 8;
+					break;
+				}
+			}
+	}
+
+	// writes header followed by the encoded samples, converted in blocks
+	void writeSignalFile(const Path &path, const vector<char> &header, std::span<const float> samples, SampleFormat format, size_t padding=0) {
+		std::ofstream out(path, std::ios::binary);
+		out.write(header.data(), header.size());
+		vector<char> buffer;
+		for (size_t i = 0; i < samples.size(); i += SIGNAL_BLOCK) {
+			buffer.clear();
+			encode(format, samples.subspan(i, std::min(SIGNAL_BLOCK, samples.size() - i)), buffer);
+			out.write(buffer.data(), buffer.size());
+		}
+		for (size_t i = 0; i < padding; ++i)
+			out.put(0);
+		if (!out)
+			THROW(FileSystemError, "Writing signal file " + path.string() + " failed");
+	}
+
+	string lowercaseExtension(const Path &path) {
+		string ext = path.extension().string();
+		for (char &c: ext)
+			c = (char)std::tolower((unsigned char)c);
+		return ext;
+	}
+
+	SignalInfo parseWav(const char *base, size_t size, const string &filename) {
+		if (size < 12 || std::memcmp(base, "RIFF", 4) != 0 || std::memcmp(base + 8, "WAVE", 4) != 0)
+			throw InvalidFileError(filename, "not a RIFF WAVE file", __FILE__, __LINE__);
+		SignalInfo info;
+		bool hasFormat = false;
+		int tag = 0, bits = 0, blockAlign = 0;
+		size_t offset = 12;
+		while (offset + 8 <= size) {
+			const char *chunk = base + offset;
+			size_t length = loadLE<uint32_t>(chunk + 4);
+			size_t body = offset + 8;
+			if (std::memcmp(chunk, "fmt ", 4) == 0) {
+				if (length < 16 || body + length > size)
+					throw InvalidFileError(filename, "truncated fmt chunk", __FILE__, __LINE__);
+				tag = loadLE<uint16_t>(base + body);
+				info.channels = loadLE<uint16_t>(base + body + 2);
+				info.sampleRate = (int)loadLE<uint32_t>(base + body + 4);
+				blockAlign = loadLE<uint16_t>(base + body + 12);
+				bits = loadLE<uint16_t>(base + body + 14);
+				// WAVE_FORMAT_EXTENSIBLE keeps the actual format tag at the start of the subformat GUID
+				if (tag == 0xFFFE) {
+					if (length < 40)
+						throw InvalidFileError(filename, "truncated extensible fmt chunk", __FILE__, __LINE__);
+					tag = loadLE<uint16_t>(base + body + 24);
+				}
+				hasFormat = true;
+			}
+			else if (std::memcmp(chunk, "data", 4) == 0) {
+				if (!hasFormat)
+					throw InvalidFileError(filename, "data chunk before fmt chunk", __FILE__, __LINE__);
+				// streamed recordings leave the length at 0 or 0xFFFFFFFF, the data then runs to the end of the file
+				if (length == 0 || body + length > size)
+					length = size - body;
+				info.dataOffset = body;
+				info.frames = blockAlign > 0 ? length/blockAlign : 0;
+				break;
+			}
+			offset = body + length + (length & 1);
+		}
+		if (!hasFormat || info.dataOffset == 0)
+			throw InvalidFileError(filename, "missing fmt or data chunk", __FILE__, __LINE__);
+
+		if (tag == 1 && bits == 8) info.format = SampleFormat::PCM_U8;
+		else if (tag == 1 && bits == 16) info.format = SampleFormat::PCM_S16;
+		else if (tag == 1 && bits == 24) info.format = SampleFormat::PCM_S24;
+		else if (tag == 1 && bits == 32) info.format = SampleFormat::PCM_S32;
+		else if (tag == 3 && bits == 32) info.format = SampleFormat::FLOAT32;
+		else if (tag == 3 && bits == 64) info.format = SampleFormat::FLOAT64;
+		else
+			throw InvalidFileError(filename, std::format("unsupported format tag {} with {} bit samples", tag, bits), __FILE__, __LINE__);
+		if (info.channels < 1 || blockAlign != info.frameBytes())
+			throw InvalidFileError(filename, std::format("block of {} bytes for {} channels", blockAlign, info.channels), __FILE__, __LINE__);
+		return info;
+	}
+
+	struct NpyHeader {
+		string descr;
+		bool fortranOrder = false;
+		vector<long long> shape;
+		size_t dataOffset = 0;
+	};
+
+	// the header is a python dict literal, {'descr': '<f4', 'fortran_order': False, 'shape': (n, m), }
+	NpyHeader parseNpyHeader(const char *base, size_t size, const string &filename) {
+		if (size < 10 || std::memcmp(base, "\x93NUMPY", 6) != 0)
+			throw InvalidFileError(filename, "not a .npy file", __FILE__, __LINE__);
+		int major = (unsigned char)base[6];
+		size_t length = major == 1 ? loadLE<uint16_t>(base + 8) : size >= 12 ? loadLE<uint32_t>(base + 8) : size;
+		size_t start = major == 1 ? 10 : 12;
+		if (major < 1 || major > 3 || start + length > size)
+			throw InvalidFileError(filename, "corrupted .npy header", __FILE__, __LINE__);
+		std::string_view literal(base + start, length);
+
+		auto valueOf = [&](std::string_view key) {
+			size_t k = literal.find(key);
+			if (k == std::string_view::npos)
+				throw InvalidFileError(filename, ".npy header without " + string(key), __FILE__, __LINE__);
+			size_t colon = literal.find(':', k + key.size());
+			size_t v = literal.find_first_not_of(' ', colon + 1);
+			if (colon == std::string_view::npos || v == std::string_view::npos)
+				throw InvalidFileError(filename, "corrupted .npy header", __FILE__, __LINE__);
+			return literal.substr(v);
+		};
+
+		NpyHeader header;
+		std::string_view descr = valueOf("'descr'");
+		size_t close = descr.find(descr[0], 1);
+		if ((descr[0] != '\'' && descr[0] != '"') || close == std::string_view::npos)
+			throw InvalidFileError(filename, "structured .npy arrays are not supported", __FILE__, __LINE__);
+		header.descr = string(descr.substr(1, close - 1));
+		header.fortranOrder = valueOf("'fortran_order'").starts_with("True");
+
+		std::string_view shape = valueOf("'shape'");
+		shape = shape.substr(1, shape.find(')') - 1);
+		for (size_t i = 0; i < shape.size();) {
+			size_t j = shape.find(',', i);
+			std::string_view dim = shape.substr(i, j == std::string_view::npos ? string::npos : j - i);
+			if (dim.find_first_not_of(' ') != std::string_view::npos)
+				header.shape.push_back(std::stoll(string(dim)));
+			if (j == std::string_view::npos)
+				break;
+			i = j + 1;
+		}
+		header.dataOffset = start + length;
+		return header;
+	}
+
+	SignalInfo parseNpy(const char *base, size_t size, const string &filename) {
+		NpyHeader header = parseNpyHeader(base, size, filename);
+		SignalInfo info;
+		info.dataOffset = header.dataOffset;
+		if (header.descr == "<f4") info.format = SampleFormat::FLOAT32;
+		else if (header.descr == "<f8") info.format = SampleFormat::FLOAT64;
+		else
+			throw InvalidFileError(filename, "unsupported .npy dtype " + header.descr + ", expected <f4 or <f8", __FILE__, __LINE__);
+		if (header.shape.empty() || header.shape.size() > 2 || (header.shape.size() == 2 && header.fortranOrder))
+			throw InvalidFileError(filename, "expected an array of shape (n,) or (n, channels) in C order", __FILE__, __LINE__);
+		info.frames = header.shape[0];
+		info.channels = header.shape.size() == 2 ? (int)header.shape[1] : 1;
+		if (info.channels < 1 || info.dataOffset + info.frames*info.frameBytes() > size)
+			throw InvalidFileError(filename, "array larger than the file", __FILE__, __LINE__);
+		return info;
+	}
+
+	vector<char> npyHeader(const string &descr, const string &shape) {
+		string dict = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': " + shape + ", }";
+		// magic, version and length take 10 bytes, the header ends with a newline at a multiple of 64
+		size_t total = (10 + dict.size() + 1 + 63)/64*64;
+		dict.append(total - 10 - dict.size() - 1, ' ');
+		dict.push_back('\n');
+		vector<char> header = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0};
+		storeLE<uint16_t>(header, (uint16_t)dict.size());
+		header.insert(header.end(), dict.begin(), dict.end());
+		return header;
+	}
+}
+
+
+int bytesPerSample(SampleFormat format) {
+	switch (format) {
+		case SampleFormat::PCM_U8: return 1;
+		case SampleFormat::PCM_S16: return 2;
+		case SampleFormat::PCM_S24: return 3;
+		case SampleFormat::PCM_S32:
+		case SampleFormat::FLOAT32: return 4;
+		case SampleFormat::FLOAT64: return 8;
+	}
+	return 0;
+}
+
+
+SignalReader::SignalReader(const Path &path, int channel)
+: file(path) {
+	string filename = path.string();
+	string ext = lowercaseExtension(path);
+	if (ext == ".f32" || ext == ".raw" || ext == ".bin" || ext == ".f64") {
+		openRaw(ext == ".f64" ? SampleFormat::FLOAT64 : SampleFormat::FLOAT32, 1, channel);
+		return;
+	}
+	size_t size = file.size();
+	if (size == 0)
+		throw InvalidFileError(filename, "empty file", __FILE__, __LINE__);
+	base = file.data();
+	if (ext == ".wav" || ext == ".wave")
+		_info = parseWav(base, size, filename);
+	else if (ext == ".npy")
+		_info = parseNpy(base, size, filename);
+	else
+		THROW(IllegalArgumentError, "SignalReader: unknown signal file extension " + ext);
+	selectChannel(channel);
+}
+
+SignalReader::SignalReader(const Path &path, SampleFormat format, int channels, int channel)
+: file(path) {
+	openRaw(format, channels, channel);
+}
+
+void SignalReader::openRaw(SampleFormat format, int channels, int channel) {
+	THROW_IF(channels < 1, IllegalArgumentError, "SignalReader: " + to_string(channels) + " channels");
+	_info.format = format;
+	_info.channels = channels;
+	_info.frames = file.size()/_info.frameBytes();
+	base = file.data();
+	selectChannel(channel);
+}
+
+void SignalReader::selectChannel(int channel) {
+	THROW_IF(channel < 0 || channel >= _info.channels, IllegalArgumentError, std::format("SignalReader: channel {} of a signal with {} channels", channel, _info.channels));
+	_channel = channel;
+}
+
+void SignalReader::seek(long long frame) {
+	THROW_IF(frame < 0 || frame > _info.frames, IllegalArgumentError, std::format("SignalReader: seek to frame {} of {}", frame, _info.frames));
+	position = frame;
+}
+
+size_t SignalReader::read(std::span<float> out) {
+	size_t n = std::min<long long>(out.size(), remaining());
+	if (n == 0)
+		return 0;
+	size_t stride = _info.frameBytes();
+	decode(_info.format, base + _info.dataOffset + position*stride + (size_t)_channel*bytesPerSample(_info.format), stride, out.data(), n);
+	position += n;
+	return n;
+}
+
+vector<float> SignalReader::readAll(int threads) {
+	vector<float> samples(remaining());
+	if (samples.empty())
+		return samples;
+	size_t stride = _info.frameBytes();
+	const char *first = base + _info.dataOffset + position*stride + (size_t)_channel*bytesPerSample(_info.format);
+	int blocks = (int)((samples.size() + SIGNAL_BLOCK - 1)/SIGNAL_BLOCK);
+	parallelFor(blocks, resolveThreadCount(threads), [&](int b) {
+		size_t start = b*SIGNAL_BLOCK, n = std::min(SIGNAL_BLOCK, samples.size() - start);
+		decode(_info.format, first + start*stride, stride, samples.data() + start, n);
+	});
+	position = _info.frames;
+	return samples;
+}
+
+
+bool isBinarySignalFile(const Path &path) {
+	string ext = lowercaseExtension(path);
+	return ext == ".wav" || ext == ".wave" || ext == ".npy" || ext == ".f32" || ext == ".raw" || ext == ".bin" || ext == ".f64";
+}
+
+DiscreteRealFunction loadSignal(const Path &path, vec2 domain, int channel) {
+	return DiscreteRealFunction(Vector<float>(SignalReader(path, channel).readAll()), domain);
+}
+
+DiscreteRealFunction loadSignal(const Path &path, int channel) {
+	SignalReader reader(path, channel);
+	vec2 domain = reader.info().sampleRate > 0 ? vec2(0, (float)reader.frames()/reader.info().sampleRate) : vec2(0, 1);
+	return DiscreteRealFunction(Vector<float>(reader.readAll()), domain);
+}
+
+DiscreteRealFunction loadSequence(const CodeFileDescriptor &file, vec2 domain, int channel) {
+	if (isBinarySignalFile(file.getPath()))
+		return loadSignal(file.getPath(), domain, channel);
+	string code = file.readCode();
+	vector<string> lines = split(code, '\n');
+	vector<float> values;
+	for (const auto &line: lines) {
+		if (line.empty()) continue;
+		if (line[0] == '#') continue;
+		if (line[0] == '/') continue;
+		if (line[0] == ' ') continue;
+		if (line[0] == '\t') continue;
+		values.push_back(stof(line));
+	}
+	return DiscreteRealFunction(values, domain);
+}
+
+
+void writeWav(const Path &path, std::span<const float> samples, int sampleRate, SampleFormat format, int channels) {
+	THROW_IF(channels < 1 || samples.size() % channels != 0, IllegalArgumentError, std::format("writeWav: {} samples do not split into {} channels", samples.size(), channels));
+	size_t dataBytes = samples.size()*bytesPerSample(format);
+	THROW_IF(dataBytes > 0xFFFFFFFFull - 64, IllegalArgumentError, "writeWav: more than 4GB of samples");
+	bool isFloat = format == SampleFormat::FLOAT32 || format == SampleFormat::FLOAT64;
+	uint16_t blockAlign = (uint16_t)(channels*bytesPerSample(format));
+
+	vector<char> header = {'R', 'I', 'F', 'F'};
+	storeLE<uint32_t>(header, (uint32_t)(4 + 8 + 16 + 8 + dataBytes + (dataBytes & 1)));
+	header.insert(header.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+	storeLE<uint32_t>(header, 16);
+	storeLE<uint16_t>(header, isFloat ? 3 : 1);
+	storeLE<uint16_t>(header, (uint16_t)channels);
+	storeLE<uint32_t>(header, (uint32_t)sampleRate);
+	storeLE<uint32_t>(header, (uint32_t)sampleRate*blockAlign);
+	storeLE<uint16_t>(header, blockAlign);
+	storeLE<uint16_t>(header, (uint16_t)(8*bytesPerSample(format)));
+	header.insert(header.end(), {'d', 'a', 't', 'a'});
+	storeLE<uint32_t>(header, (uint32_t)dataBytes);
+	writeSignalFile(path, header, samples, format, dataBytes & 1);
+}
+
+void writeRaw(const Path &path, std::span<const float> samples, SampleFormat format) {
+	writeSignalFile(path, {}, samples, format);
+}
+
+void writeNpy(const Path &path, std::span<const float> samples) {
+	writeSignalFile(path, npyHeader("<f4", std::format("({},)", samples.size())), samples, SampleFormat::FLOAT32);
+}
+
+void writeNpy(const Path &path, const Spectrogram &spectra) {
+	// complex64 is a pair of float32, as Complex
+	static_assert(sizeof(Complex) == 2*sizeof(float));
+	auto values = std::span<const float>(reinterpret_cast<const float *>(spectra.frame(0)), spectra.bytes()/sizeof(float));
+	writeSignalFile(path, npyHeader("<c8", std::format("({}, {})", spectra.frames(), spectra.bins())), values, SampleFormat::FLOAT32);
+}
+
+Spectrogram loadSpectrogram(const Path &path) {
+	string filename = path.string();
+	ReadOnlyFileMapping file = ReadOnlyFileMapping(path);
+	size_t size = file.size();
+	if (size == 0)
+		throw InvalidFileError(filename, "empty file", __FILE__, __LINE__);
+	const char *base = file.data();
+	NpyHeader header = parseNpyHeader(base, size, filename);
+	if (header.descr != "<c8" || header.shape.size() != 2 || header.fortranOrder)
+		throw InvalidFileError(filename, "expected a complex64 array of shape (frames, bins) in C order", __FILE__, __LINE__);
+	Spectrogram spectra((int)header.shape[0], (int)header.shape[1]);
+	if (header.dataOffset + spectra.bytes() > size)
+		throw InvalidFileError(filename, "array larger than the file", __FILE__, __LINE__);
+	if (spectra.bytes() > 0)
+		std::memcpy(spectra.frame(0), base + header.dataOffset, spectra.bytes());
+	return spectra;
+}
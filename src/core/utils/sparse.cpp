@@ -0,0 +1,758 @@
+#include "sparse.hpp"
+
+#include <numeric>
+#include <queue>
+
+
+namespace {
+	// products with fewer stored entries run on the calling thread
+	constexpr int PARALLEL_NONZEROS = 1 << 15;
+	// rows per chunk claimed by a worker in vector kernels
+	constexpr int VECTOR_GRAIN = 1 << 13;
+
+	// sums of products are accumulated in double, one partial sum per chunk keeps them deterministic
+	template<typename F>
+	double reduce(WorkerPool &pool, int n, F &&term) {
+		vector<double> partial((n + VECTOR_GRAIN - 1)/VECTOR_GRAIN, 0.);
+		pool.forRange(n, VECTOR_GRAIN, [&](int begin, int end) {
+			double s = 0;
+			for (int i = begin; i < end; ++i)
+				s += term(i);
+			partial[begin/VECTOR_GRAIN] = s;
+		});
+		return std::accumulate(partial.begin(), partial.end(), 0.);
+	}
+
+	double dotProduct(WorkerPool &pool, const vector<double> &a, const vector<double> &b) {
+		return reduce(pool, a.size(), [&](int i) { return a[i]*b[i]; });
+	}
+
+	double norm2(WorkerPool &pool, const vector<double> &a) {
+		return dotProduct(pool, a, a);
+	}
+
+	template<typename F>
+	void forEach(WorkerPool &pool, int n, F &&f) {
+		pool.forRange(n, VECTOR_GRAIN, [&](int begin, int end) {
+			for (int i = begin; i < end; ++i)
+				f(i);
+		});
+	}
+
+
+	class Preconditioner {
+		SparsePreconditioner type;
+		vector<double> inverseDiagonal;
+		// ILU(0) factors share the pattern of A, L has a unit diagonal and U starts at diagonalSlot
+		vector<int> offsets, columns, diagonalSlot;
+		vector<double> lu;
+
+	public:
+		Preconditioner(const SparseMatrix &A, SparsePreconditioner type) : type(type) {
+			int n = A.rows();
+			if (type == SparsePreconditioner::JACOBI) {
+				inverseDiagonal.resize(n);
+				for (int i = 0; i < n; ++i) {
+					float d = A.get(i, i);
+					THROW_IF(d == 0, ValueError, "Jacobi preconditioner: zero diagonal entry in row " + to_string(i));
+					inverseDiagonal[i] = 1./d;
+				}
+			}
+			if (type == SparsePreconditioner::ILU0)
+				factorizeILU0(A);
+		}
+
+		void factorizeILU0(const SparseMatrix &A) {
+			int n = A.rows();
+			offsets.assign(n + 1, 0);
+			diagonalSlot.assign(n, -1);
+			for (int i = 0; i < n; ++i) {
+				auto cols = A.rowColumns(i);
+				auto vals = A.rowValues(i);
+				for (int p = 0; p < (int)cols.size(); ++p) {
+					if (cols[p] == i)
+						diagonalSlot[i] = columns.size();
+					columns.push_back(cols[p]);
+					lu.push_back(vals[p]);
+				}
+				offsets[i+1] = columns.size();
+				THROW_IF(diagonalSlot[i] < 0, ValueError, "ILU(0) preconditioner: no diagonal entry in row " + to_string(i));
+			}
+			// IKJ variant restricted to the pattern, slot[j] locates column j of the current row
+			vector<int> slot(n, -1);
+			for (int i = 0; i < n; ++i) {
+				for (int p = offsets[i]; p < offsets[i+1]; ++p)
+					slot[columns[p]] = p;
+				for (int p = offsets[i]; p < diagonalSlot[i]; ++p) {
+					int k = columns[p];
+					THROW_IF(lu[diagonalSlot[k]] == 0, ValueError, "ILU(0) preconditioner: zero pivot in row " + to_string(k));
+					lu[p] /= lu[diagonalSlot[k]];
+					for (int q = diagonalSlot[k] + 1; q < offsets[k+1]; ++q)
+						if (slot[columns[q]] >= 0)
+							lu[slot[columns[q]]] -= lu[p]*lu[q];
+				}
+				for (int p = offsets[i]; p < offsets[i+1]; ++p)
+					slot[columns[p]] = -1;
+				THROW_IF(lu[diagonalSlot[i]] == 0, ValueError, "ILU(0) preconditioner: zero pivot in row " + to_string(i));
+			}
+		}
+
+		// z = M^-1 r
+		void apply(WorkerPool &pool, const vector<double> &r, vector<double> &z) const {
+			int n = r.size();
+			switch (type) {
+				case SparsePreconditioner::NONE:
+					std::copy(r.begin(), r.end(), z.begin());
+					return;
+				case SparsePreconditioner::JACOBI:
+					forEach(pool, n, [&](int i) { z[i] = r[i]*inverseDiagonal[i]; });
+					return;
+				case SparsePreconditioner::ILU0:
+					// triangular sweeps are sequential
+					for (int i = 0; i < n; ++i) {
+						double s = r[i];
+						for (int p = offsets[i]; p < diagonalSlot[i]; ++p)
+							s -= lu[p]*z[columns[p]];
+						z[i] = s;
+					}
+					for (int i = n - 1; i >= 0; --i) {
+						double s = z[i];
+						for (int p = diagonalSlot[i] + 1; p < offsets[i+1]; ++p)
+							s -= lu[p]*z[columns[p]];
+						z[i] = s/lu[diagonalSlot[i]];
+					}
+			}
+		}
+	};
+
+
+	void checkSystem(const SparseMatrix &A, std::span<const float> b, std::span<float> x, const string &solver) {
+		THROW_IF(!A.square(), IllegalArgumentError, solver + ": matrix of size " + to_string(A.rows()) + "x" + to_string(A.cols()) + " is not square");
+		THROW_IF(b.size() != A.rows() || x.size() != A.rows(), IllegalArgumentError, solver + ": vectors of size " + to_string(b.size()) + " and " + to_string(x.size()) + " do not match the matrix size " + to_string(A.rows()));
+	}
+
+	// r = b - Ax
+	void residual(WorkerPool &pool, const SparseMatrix &A, const vector<double> &b, const vector<double> &x, vector<double> &r) {
+		A.multiply(std::span<const double>(x), std::span<double>(r), pool);
+		forEach(pool, b.size(), [&](int i) { r[i] = b[i] - r[i]; });
+	}
+}
+
+
+SparseMatrix::SparseMatrix(int n, int m) : n(n), m(m), offsets(n + 1, 0) {
+	THROW_IF(n < 0 || m < 0, IllegalArgumentError, "SparseMatrix: negative size " + to_string(n) + "x" + to_string(m));
+}
+
+SparseMatrix::SparseMatrix(int n, int m, std::span<const SparseEntry> triplets) : SparseMatrix(n, m) {
+	// counting sort by row, then each row is sorted by column and duplicates are merged in place
+	for (const auto &t: triplets) {
+		THROW_IF(t.row < 0 || t.row >= n || t.col < 0 || t.col >= m, IndexOutOfBounds, std::format("({}, {})", t.row, t.col), std::format("({}, {})", n, m), "SparseMatrix");
+		++offsets[t.row + 1];
+	}
+	std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+	vector<int> next(offsets.begin(), offsets.end() - 1);
+	vector<std::pair<int, float>> sorted(triplets.size());
+	for (const auto &t: triplets)
+		sorted[next[t.row]++] = {t.col, t.value};
+
+	columns.reserve(sorted.size());
+	entries.reserve(sorted.size());
+	for (int i = 0; i < n; ++i) {
+		auto first = sorted.begin() + offsets[i], last = sorted.begin() + offsets[i+1];
+		std::sort(first, last, [](const auto &a, const auto &b) { return a.first < b.first; });
+		offsets[i] = columns.size();
+		for (auto it = first; it != last; ++it)
+			if (columns.size() > (size_t)offsets[i] && columns.back() == it->first)
+				entries.back() += it->second;
+			else {
+				columns.push_back(it->first);
+				entries.push_back(it->second);
+			}
+	}
+	offsets[n] = columns.size();
+}
+
+SparseMatrix SparseMatrix::identity(int n) {
+	return diagonal(vector<float>(n, 1.f));
+}
+
+SparseMatrix SparseMatrix::diagonal(std::span<const float> d) {
+	SparseMatrix res(d.size(), d.size());
+	std::iota(res.offsets.begin(), res.offsets.end(), 0);
+	res.columns.resize(d.size());
+	std::iota(res.columns.begin(), res.columns.end(), 0);
+	res.entries.assign(d.begin(), d.end());
+	return res;
+}
+
+float SparseMatrix::get(int i, int j) const {
+	THROW_IF(i < 0 || i >= n || j < 0 || j >= m, IndexOutOfBounds, std::format("({}, {})", i, j), std::format("({}, {})", n, m), "SparseMatrix");
+	auto cols = rowColumns(i);
+	auto it = std::lower_bound(cols.begin(), cols.end(), j);
+	return it != cols.end() && *it == j ? entries[offsets[i] + (it - cols.begin())] : 0.f;
+}
+
+vector<float> SparseMatrix::diagonal() const {
+	vector<float> d(std::min(n, m));
+	for (int i = 0; i < (int)d.size(); ++i)
+		d[i] = get(i, i);
+	return d;
+}
+
+bool SparseMatrix::symmetric(float tolerance) const {
+	if (!square())
+		return false;
+	for (int i = 0; i < n; ++i)
+		for (int p = offsets[i]; p < offsets[i+1]; ++p)
+			if (std::abs(entries[p] - get(columns[p], i)) > tolerance)
+				return false;
+	return true;
+}
+
+template<typename T>
+void SparseMatrix::multiplyRows(std::span<const T> x, std::span<T> y, int begin, int end) const {
+	for (int i = begin; i < end; ++i) {
+		T s = 0;
+		for (int p = offsets[i]; p < offsets[i+1]; ++p)
+			s += entries[p]*x[columns[p]];
+		y[i] = s;
+	}
+}
+
+void SparseMatrix::multiply(std::span<const float> x, std::span<float> y, int threads) const {
+	THROW_IF(x.size() != m || y.size() != n, IllegalArgumentError, "SparseMatrix: product of a " + to_string(n) + "x" + to_string(m) + " matrix with vector of size " + to_string(x.size()));
+	int blocks = nonZeros() < PARALLEL_NONZEROS ? 1 : std::min(resolveThreadCount(threads), n);
+	// block boundaries split the entries evenly rather than the rows
+	parallelFor(blocks, blocks, [&](int b) {
+		int begin = std::upper_bound(offsets.begin(), offsets.end(), (long long)nonZeros()*b/blocks) - offsets.begin() - 1;
+		int end = b == blocks - 1 ? n : std::upper_bound(offsets.begin(), offsets.end(), (long long)nonZeros()*(b + 1)/blocks) - offsets.begin() - 1;
+		multiplyRows(x, y, b == 0 ? 0 : begin, end);
+	});
+}
+
+void SparseMatrix::multiply(std::span<const float> x, std::span<float> y, WorkerPool &pool) const {
+	THROW_IF(x.size() != m || y.size() != n, IllegalArgumentError, "SparseMatrix: product of a " + to_string(n) + "x" + to_string(m) + " matrix with vector of size " + to_string(x.size()));
+	pool.forRange(n, nonZeros() < PARALLEL_NONZEROS ? n : VECTOR_GRAIN, [&](int begin, int end) { multiplyRows(x, y, begin, end); });
+}
+
+void SparseMatrix::multiply(std::span<const double> x, std::span<double> y, WorkerPool &pool) const {
+	THROW_IF(x.size() != m || y.size() != n, IllegalArgumentError, "SparseMatrix: product of a " + to_string(n) + "x" + to_string(m) + " matrix with vector of size " + to_string(x.size()));
+	pool.forRange(n, nonZeros() < PARALLEL_NONZEROS ? n : VECTOR_GRAIN, [&](int begin, int end) { multiplyRows(x, y, begin, end); });
+}
+
+vector<float> SparseMatrix::operator*(std::span<const float> x) const {
+	vector<float> y(n);
+	multiply(x, y);
+	return y;
+}
+
+SparseMatrix SparseMatrix::transpose() const {
+	SparseMatrix res(m, n);
+	for (int c: columns)
+		++res.offsets[c + 1];
+	std::partial_sum(res.offsets.begin(), res.offsets.end(), res.offsets.begin());
+	res.columns.resize(nonZeros());
+	res.entries.resize(nonZeros());
+	vector<int> next(res.offsets.begin(), res.offsets.end() - 1);
+	// rows are visited in order, so the columns of the transpose come out sorted
+	for (int i = 0; i < n; ++i)
+		for (int p = offsets[i]; p < offsets[i+1]; ++p) {
+			int q = next[columns[p]]++;
+			res.columns[q] = i;
+			res.entries[q] = entries[p];
+		}
+	return res;
+}
+
+SparseMatrix SparseMatrix::operator*(float f) const {
+	SparseMatrix res = *this;
+	for (float &v: res.entries)
+		v *= f;
+	return res;
+}
+
+SparseMatrix SparseMatrix::operator+(const SparseMatrix &M) const {
+	THROW_IF(size() != M.size(), IllegalArgumentError, "SparseMatrix: sum of matrices of different sizes");
+	vector<SparseEntry> triplets;
+	triplets.reserve(nonZeros() + M.nonZeros());
+	for (const SparseMatrix *A: {this, &M})
+		for (int i = 0; i < n; ++i)
+			for (int p = A->offsets[i]; p < A->offsets[i+1]; ++p)
+				triplets.push_back({i, A->columns[p], A->entries[p]});
+	return SparseMatrix(n, m, triplets);
+}
+
+SparseMatrix SparseMatrix::operator-(const SparseMatrix &M) const {
+	return *this + M*(-1.f);
+}
+
+SparseMatrix SparseMatrix::operator*(const SparseMatrix &M) const {
+	THROW_IF(m != M.n, IllegalArgumentError, "SparseMatrix: product of " + to_string(n) + "x" + to_string(m) + " and " + to_string(M.n) + "x" + to_string(M.m) + " matrices");
+	// Gustavson's row by row product with a dense accumulator
+	SparseMatrix res(n, M.m);
+	vector<float> accumulator(M.m, 0.f);
+	vector<int> slot(M.m, -1);
+	vector<int> pattern;
+	for (int i = 0; i < n; ++i) {
+		pattern.clear();
+		for (int p = offsets[i]; p < offsets[i+1]; ++p)
+			for (int q = M.offsets[columns[p]]; q < M.offsets[columns[p] + 1]; ++q) {
+				int j = M.columns[q];
+				if (slot[j] != i) {
+					slot[j] = i;
+					pattern.push_back(j);
+				}
+				accumulator[j] += entries[p]*M.entries[q];
+			}
+		std::sort(pattern.begin(), pattern.end());
+		for (int j: pattern) {
+			res.columns.push_back(j);
+			res.entries.push_back(accumulator[j]);
+			accumulator[j] = 0;
+		}
+		res.offsets[i+1] = res.columns.size();
+	}
+	return res;
+}
+
+
+IterativeSolverReport conjugateGradient(const SparseMatrix &A, std::span<const float> b, std::span<float> x, const IterativeSolverSettings &settings) {
+	checkSystem(A, b, x, "conjugateGradient");
+	int n = A.rows();
+	WorkerPool pool(settings.threads);
+	Preconditioner M(A, settings.preconditioner);
+	vector<double> bd(b.begin(), b.end()), xd(x.begin(), x.end()), r(n), z(n), p(n), Ap(n);
+
+	IterativeSolverReport report;
+	double bNorm = std::sqrt(norm2(pool, bd));
+	if (bNorm == 0) {
+		std::fill(x.begin(), x.end(), 0.f);
+		report.converged = true;
+		return report;
+	}
+	residual(pool, A, bd, xd, r);
+	report.residual = std::sqrt(norm2(pool, r))/bNorm;
+	M.apply(pool, r, z);
+	std::copy(z.begin(), z.end(), p.begin());
+	double rz = dotProduct(pool, r, z);
+
+	while (report.residual > settings.tolerance && report.iterations < settings.maxIterations) {
+		A.multiply(std::span<const double>(p), std::span<double>(Ap), pool);
+		double pAp = dotProduct(pool, p, Ap);
+		if (pAp <= 0)
+			break;
+		double alpha = rz/pAp;
+		forEach(pool, n, [&](int i) {
+			xd[i] += alpha*p[i];
+			r[i] -= alpha*Ap[i];
+		});
+		++report.iterations;
+		report.residual = std::sqrt(norm2(pool, r))/bNorm;
+		if (report.residual <= settings.tolerance)
+			break;
+		M.apply(pool, r, z);
+		double rzNext = dotProduct(pool, r, z);
+		double beta = rzNext/rz;
+		rz = rzNext;
+		forEach(pool, n, [&](int i) { p[i] = z[i] + beta*p[i]; });
+	}
+	report.converged = report.residual <= settings.tolerance;
+	std::copy(xd.begin(), xd.end(), x.begin());
+	return report;
+}
+
+IterativeSolverReport biCGSTAB(const SparseMatrix &A, std::span<const float> b, std::span<float> x, const IterativeSolverSettings &settings) {
+	checkSystem(A, b, x, "biCGSTAB");
+	int n = A.rows();
+	WorkerPool pool(settings.threads);
+	Preconditioner M(A, settings.preconditioner);
+	vector<double> bd(b.begin(), b.end()), xd(x.begin(), x.end()), r(n), shadow(n), p(n, 0.), v(n, 0.), s(n), t(n), pHat(n), sHat(n);
+
+	IterativeSolverReport report;
+	double bNorm = std::sqrt(norm2(pool, bd));
+	if (bNorm == 0) {
+		std::fill(x.begin(), x.end(), 0.f);
+		report.converged = true;
+		return report;
+	}
+	residual(pool, A, bd, xd, r);
+	std::copy(r.begin(), r.end(), shadow.begin());
+	report.residual = std::sqrt(norm2(pool, r))/bNorm;
+	double rho = 1, alpha = 1, omega = 1;
+
+	while (report.residual > settings.tolerance && report.iterations < settings.maxIterations) {
+		double rhoNext = dotProduct(pool, shadow, r);
+		// breakdown, the shadow residual became orthogonal to the residual
+		if (rhoNext == 0 || omega == 0)
+			break;
+		double beta = rhoNext/rho*alpha/omega;
+		rho = rhoNext;
+		forEach(pool, n, [&](int i) { p[i] = r[i] + beta*(p[i] - omega*v[i]); });
+		M.apply(pool, p, pHat);
+		A.multiply(std::span<const double>(pHat), std::span<double>(v), pool);
+		double shadowV = dotProduct(pool, shadow, v);
+		if (shadowV == 0)
+			break;
+		alpha = rho/shadowV;
+		forEach(pool, n, [&](int i) { s[i] = r[i] - alpha*v[i]; });
+		++report.iterations;
+		double sNorm = std::sqrt(norm2(pool, s))/bNorm;
+		if (sNorm <= settings.tolerance) {
+			forEach(pool, n, [&](int i) { xd[i] += alpha*pHat[i]; });
+			report.residual = sNorm;
+			break;
+		}
+		M.apply(pool, s, sHat);
+		A.multiply(std::span<const double>(sHat), std::span<double>(t), pool);
+		double tt = norm2(pool, t);
+		omega = tt == 0 ? 0 : dotProduct(pool, t, s)/tt;
+		forEach(pool, n, [&](int i) {
+			xd[i] += alpha*pHat[i] + omega*sHat[i];
+			r[i] = s[i] - omega*t[i];
+		});
+		report.residual = std::sqrt(norm2(pool, r))/bNorm;
+	}
+	report.converged = report.residual <= settings.tolerance;
+	std::copy(xd.begin(), xd.end(), x.begin());
+	return report;
+}
+
+
+vector<int> minimumDegreeOrdering(const SparseMatrix &A) {
+	THROW_IF(!A.square(), IllegalArgumentError, "minimumDegreeOrdering: matrix is not square");
+	int n = A.rows();
+	// explicit elimination graph, eliminating v turns its neighbourhood into a clique
+	vector<vector<int>> adjacency(n);
+	for (int i = 0; i < n; ++i)
+		for (int j: A.rowColumns(i))
+			if (i != j) {
+				adjacency[i].push_back(j);
+				adjacency[j].push_back(i);
+			}
+	using Candidate = std::pair<int, int>;
+	std::priority_queue<Candidate, vector<Candidate>, std::greater<>> queue;
+	for (int i = 0; i < n; ++i) {
+		auto &adj = adjacency[i];
+		std::sort(adj.begin(), adj.end());
+		adj.erase(std::unique(adj.begin(), adj.end()), adj.end());
+		queue.emplace(adj.size(), i);
+	}
+
+	vector<int> order;
+	order.reserve(n);
+	vector<char> eliminated(n, 0);
+	vector<int> merged;
+	while (!queue.empty()) {
+		auto [degree, v] = queue.top();
+		queue.pop();
+		// entries are not removed when a degree changes, stale ones are skipped here
+		if (eliminated[v] || degree != (int)adjacency[v].size())
+			continue;
+		eliminated[v] = 1;
+		order.push_back(v);
+		const auto &clique = adjacency[v];
+		for (int u: clique) {
+			merged.clear();
+			std::set_union(adjacency[u].begin(), adjacency[u].end(), clique.begin(), clique.end(), std::back_inserter(merged));
+			std::erase_if(merged, [&](int w) { return w == u || w == v; });
+			adjacency[u].swap(merged);
+			queue.emplace(adjacency[u].size(), u);
+		}
+		vector<int>().swap(adjacency[v]);
+	}
+	return order;
+}
+
+
+namespace {
+	// pattern of A + Aᵀ without the diagonal, in CSR form
+	void symmetricAdjacency(const SparseMatrix &A, vector<int> &offsets, vector<int> &ids) {
+		int n = A.rows();
+		vector<SparseEntry> edges;
+		edges.reserve(2*A.nonZeros());
+		for (int i = 0; i < n; ++i)
+			for (int j: A.rowColumns(i))
+				if (i != j) {
+					edges.push_back({i, j, 1});
+					edges.push_back({j, i, 1});
+				}
+		SparseMatrix pattern(n, n, edges);
+		offsets.resize(n + 1);
+		ids.clear();
+		ids.reserve(pattern.nonZeros());
+		for (int i = 0; i < n; ++i) {
+			offsets[i] = ids.size();
+			ids.insert(ids.end(), pattern.rowColumns(i).begin(), pattern.rowColumns(i).end());
+		}
+		offsets[n] = ids.size();
+	}
+
+	class NestedDissection {
+		// parts this small are appended in their current order
+		static constexpr int LEAF = 64;
+
+		vector<int> offsets, ids;
+		vector<int> member, level;
+		int stamp = 0;
+
+		// breadth first level structure of the component of root inside the current part, returns the visit order
+		vector<int> levels(int root, int part, vector<int> &levelStarts) {
+			vector<int> visited = {root};
+			levelStarts = {0};
+			level[root] = ++stamp;
+			for (size_t head = 0; head < visited.size(); ) {
+				size_t end = visited.size();
+				levelStarts.push_back(end);
+				for (; head < end; ++head)
+					for (int p = offsets[visited[head]]; p < offsets[visited[head] + 1]; ++p) {
+						int u = ids[p];
+						if (member[u] == part && level[u] != stamp) {
+							level[u] = stamp;
+							visited.push_back(u);
+						}
+					}
+			}
+			levelStarts.back() = visited.size();
+			if (levelStarts.size() > 1 && levelStarts[levelStarts.size() - 2] == (int)visited.size())
+				levelStarts.pop_back();
+			return visited;
+		}
+
+	public:
+		vector<int> order;
+
+		explicit NestedDissection(const SparseMatrix &A) : member(A.rows(), 0), level(A.rows(), 0) {
+			symmetricAdjacency(A, offsets, ids);
+			order.reserve(A.rows());
+		}
+
+		void dissect(vector<int> vertices, int &parts) {
+			if ((int)vertices.size() <= LEAF) {
+				order.insert(order.end(), vertices.begin(), vertices.end());
+				return;
+			}
+			int part = ++parts;
+			for (int v: vertices)
+				member[v] = part;
+			vector<int> starts;
+			auto visited = levels(vertices[0], part, starts);
+			if (visited.size() < vertices.size()) {
+				// disconnected, the components are independent
+				vector<int> rest;
+				for (int v: vertices)
+					if (level[v] != stamp)
+						rest.push_back(v);
+				dissect(std::move(visited), parts);
+				dissect(std::move(rest), parts);
+				return;
+			}
+			// pseudo-peripheral root, deepest level structures give the thinnest levels
+			for (int attempt = 0; attempt < 4; ++attempt) {
+				int root = visited.back();
+				for (int k = starts[starts.size() - 2]; k < starts.back(); ++k)
+					if (offsets[visited[k] + 1] - offsets[visited[k]] < offsets[root + 1] - offsets[root])
+						root = visited[k];
+				vector<int> deeperStarts;
+				auto deeper = levels(root, part, deeperStarts);
+				if (deeperStarts.size() <= starts.size())
+					break;
+				visited = std::move(deeper);
+				starts = std::move(deeperStarts);
+			}
+			levels(visited[0], part, starts);
+			int depth = starts.size() - 1;
+			if (depth < 3) {
+				order.insert(order.end(), vertices.begin(), vertices.end());
+				return;
+			}
+			// smallest level among those leaving at least a quarter of the part on each side
+			int n = visited.size(), separator = -1;
+			for (int l = 1; l < depth - 1; ++l)
+				if (starts[l] >= n/4 && n - starts[l+1] >= n/4 && (separator < 0 || starts[l+1] - starts[l] < starts[separator+1] - starts[separator]))
+					separator = l;
+			if (separator < 0)
+				separator = depth/2;
+			vector<int> first(visited.begin(), visited.begin() + starts[separator]);
+			vector<int> second(visited.begin() + starts[separator+1], visited.end());
+			vector<int> cut(visited.begin() + starts[separator], visited.begin() + starts[separator+1]);
+			dissect(std::move(first), parts);
+			dissect(std::move(second), parts);
+			order.insert(order.end(), cut.begin(), cut.end());
+		}
+	};
+}
+
+vector<int> nestedDissectionOrdering(const SparseMatrix &A) {
+	THROW_IF(!A.square(), IllegalArgumentError, "nestedDissectionOrdering: matrix is not square");
+	NestedDissection dissection(A);
+	vector<int> all(A.rows());
+	std::iota(all.begin(), all.end(), 0);
+	int parts = 0;
+	dissection.dissect(std::move(all), parts);
+	return std::move(dissection.order);
+}
+
+
+namespace {
+	bool storesOneTriangle(const SparseMatrix &A) {
+		bool lower = true, upper = true;
+		for (int i = 0; i < A.rows(); ++i) {
+			auto cols = A.rowColumns(i);
+			if (!cols.empty()) {
+				lower &= cols.back() <= i;
+				upper &= cols.front() >= i;
+			}
+		}
+		return lower || upper;
+	}
+
+	SparseMatrix mirroredTriangle(const SparseMatrix &A) {
+		vector<SparseEntry> triplets;
+		triplets.reserve(2*A.nonZeros());
+		for (int i = 0; i < A.rows(); ++i) {
+			auto cols = A.rowColumns(i);
+			auto vals = A.rowValues(i);
+			for (int p = 0; p < (int)cols.size(); ++p) {
+				triplets.push_back({i, cols[p], vals[p]});
+				if (cols[p] != i)
+					triplets.push_back({cols[p], i, vals[p]});
+			}
+		}
+		return SparseMatrix(A.rows(), A.cols(), triplets);
+	}
+}
+
+const SparseMatrix &SparseLDLT::fullStorage(const SparseMatrix &A, SparseMatrix &mirrored) {
+	if (storesOneTriangle(A)) {
+		mirrored = mirroredTriangle(A);
+		return mirrored;
+	}
+	float largest = 0;
+	for (int i = 0; i < A.rows(); ++i)
+		for (float v: A.rowValues(i))
+			largest = std::max(largest, std::abs(v));
+	THROW_IF(!A.symmetric(1e-6f*largest), IllegalArgumentError, "SparseLDLT: matrix is neither symmetric nor stored as one triangle");
+	return A;
+}
+
+SparseLDLT::SparseLDLT(const SparseMatrix &A, FillReducingOrdering ordering) : pattern(A) {
+	THROW_IF(!A.square(), IllegalArgumentError, "SparseLDLT: matrix of size " + to_string(A.rows()) + "x" + to_string(A.cols()) + " is not square");
+	int n = A.rows();
+	SparseMatrix mirrored;
+	const SparseMatrix &S = fullStorage(A, mirrored);
+	if (ordering == FillReducingOrdering::MINIMUM_DEGREE)
+		permutation = minimumDegreeOrdering(S);
+	else if (ordering == FillReducingOrdering::NESTED_DISSECTION)
+		permutation = nestedDissectionOrdering(S);
+	else {
+		permutation.resize(n);
+		std::iota(permutation.begin(), permutation.end(), 0);
+	}
+	inversePermutation.resize(n);
+	for (int k = 0; k < n; ++k)
+		inversePermutation[permutation[k]] = k;
+
+	// elimination tree and column counts of L (Liu), row k of L is the set of etree paths
+	// from the entries of row k of the permuted lower triangle up to k
+	parent.assign(n, -1);
+	vector<int> counts(n, 0), flag(n, -1);
+	for (int k = 0; k < n; ++k) {
+		flag[k] = k;
+		for (int c: S.rowColumns(permutation[k]))
+			for (int i = inversePermutation[c]; i < k && flag[i] != k; i = parent[i]) {
+				if (parent[i] == -1)
+					parent[i] = k;
+				++counts[i];
+				flag[i] = k;
+			}
+	}
+	columnOffsets.assign(n + 1, 0);
+	std::partial_sum(counts.begin(), counts.end(), columnOffsets.begin() + 1);
+	rowIds.resize(columnOffsets[n]);
+	factor.resize(columnOffsets[n]);
+	pivots.resize(n);
+	factorizeFull(S);
+}
+
+void SparseLDLT::factorize(const SparseMatrix &A) {
+	THROW_IF(!A.samePattern(pattern), IllegalArgumentError, "SparseLDLT: matrix pattern differs from the analysed one");
+	SparseMatrix mirrored;
+	factorizeFull(fullStorage(A, mirrored));
+}
+
+void SparseLDLT::factorizeFull(const SparseMatrix &A) {
+	int n = size();
+	// up-looking factorisation, row k of L solves a triangular system whose pattern is found in the etree
+	vector<double> y(n, 0.);
+	vector<int> flag(n, -1), filled(n, 0), stack(n);
+	for (int k = 0; k < n; ++k) {
+		int top = n;
+		flag[k] = k;
+		auto cols = A.rowColumns(permutation[k]);
+		auto vals = A.rowValues(permutation[k]);
+		for (int p = 0; p < (int)cols.size(); ++p) {
+			int i = inversePermutation[cols[p]];
+			if (i > k)
+				continue;
+			y[i] += vals[p];
+			int len = 0;
+			for (; flag[i] != k; i = parent[i]) {
+				stack[len++] = i;
+				flag[i] = k;
+			}
+			while (len > 0)
+				stack[--top] = stack[--len];
+		}
+		pivots[k] = y[k];
+		y[k] = 0;
+		for (; top < n; ++top) {
+			int i = stack[top];
+			double yi = y[i];
+			y[i] = 0;
+			int end = columnOffsets[i] + filled[i];
+			for (int p = columnOffsets[i]; p < end; ++p)
+				y[rowIds[p]] -= factor[p]*yi;
+			double l = yi/pivots[i];
+			pivots[k] -= l*yi;
+			rowIds[end] = k;
+			factor[end] = l;
+			++filled[i];
+		}
+		THROW_IF(pivots[k] == 0, ValueError, "SparseLDLT: zero pivot at step " + to_string(k) + ", the matrix is singular or needs pivoting");
+	}
+}
+
+void SparseLDLT::solve(std::span<const float> b, std::span<float> x) const {
+	THROW_IF(b.size() != size() || x.size() != size(), IllegalArgumentError, "SparseLDLT: vectors of size " + to_string(b.size()) + " and " + to_string(x.size()) + " for a system of size " + to_string(size()));
+	int n = size();
+	vector<double> z(n);
+	for (int k = 0; k < n; ++k)
+		z[k] = b[permutation[k]];
+	for (int j = 0; j < n; ++j)
+		for (int p = columnOffsets[j]; p < columnOffsets[j+1]; ++p)
+			z[rowIds[p]] -= factor[p]*z[j];
+	for (int j = 0; j < n; ++j)
+		z[j] /= pivots[j];
+	for (int j = n - 1; j >= 0; --j)
+		for (int p = columnOffsets[j]; p < columnOffsets[j+1]; ++p)
+			z[j] -= factor[p]*z[rowIds[p]];
+	for (int k = 0; k < n; ++k)
+		x[permutation[k]] = z[k];
+}
+
+vector<float> SparseLDLT::solve(std::span<const float> b) const {
+	vector<float> x(size());
+	solve(b, x);
+	return x;
+}
+
+std::pair<double, int> SparseLDLT::logDeterminant() const {
+	double logDet = 0;
+	int sign = 1;
+	for (double d: pivots) {
+		logDet += std::log(std::abs(d));
+		if (d < 0)
+			sign = -sign;
+	}
+	return {logDet, sign};
+}
@@ -0,0 +1,198 @@
+#include "stft.hpp"
+
+
+namespace {
+	thread_local vector<vec2> stft_scratch;
+
+	// inverse transforms of this many frames are kept at once during synthesis
+	constexpr int SYNTHESIS_BLOCK = 256;
+}
+
+
+STFTEngine::STFTEngine(vector<float> window, int hop, int fftSize, int padding)
+: _window(std::move(window)), _hop(hop), _fft_size(fftSize > 0 ? fftSize : _window.size()), _padding(padding >= 0 ? padding : _window.size()/2) {
+	THROW_IF(_window.empty(), IllegalArgumentError, "STFTEngine: empty window");
+	THROW_IF(_hop < 1, IllegalArgumentError, "STFTEngine: hop must be positive, got " + to_string(_hop));
+	THROW_IF(_fft_size < windowSize(), IllegalArgumentError, "STFTEngine: transform of " + to_string(_fft_size) + " samples is shorter than the window");
+	forward = FFTPlan::get(_fft_size, FFTDirection::FORWARD);
+	backward = FFTPlan::get(_fft_size, FFTDirection::BACKWARD);
+}
+
+vector<float> STFTEngine::hannWindow(int n) {
+	vector<float> w(n);
+	for (int j = 0; j < n; ++j)
+		w[j] = .5f - .5f*std::cos(TAU*j/n);
+	return w;
+}
+
+vector<float> STFTEngine::gaussianWindow(int n, float width) {
+	vector<float> w(n);
+	for (int j = 0; j < n; ++j) {
+		float x = -width + 2*width*j/(n - 1);
+		w[j] = std::exp(-x*x*PI);
+	}
+	return w;
+}
+
+void STFTEngine::transformFrames(std::span<const float> samples, long long offset, int first, int count, Complex *out) const {
+	int n = _fft_size, w = windowSize(), K = bins();
+	auto &z = stft_scratch;
+	z.resize(n);
+	// frame samples [lo, hi) are known, the rest is zero
+	auto known = [&](long long start) {
+		long long lo = std::clamp(offset - start, 0LL, (long long)w);
+		long long hi = std::clamp(offset + (long long)samples.size() - start, lo, (long long)w);
+		return std::pair((int)lo, (int)hi);
+	};
+
+	for (int t = first; t < first + count; t += 2) {
+		bool pair = t + 1 < first + count;
+		std::fill(z.begin(), z.end(), vec2(0));
+		long long a = frameStart(t);
+		auto [lo, hi] = known(a);
+		for (int j = lo; j < hi; ++j)
+			z[j].x = _window[j]*samples[a + j - offset];
+		if (pair) {
+			long long b = frameStart(t + 1);
+			auto [lo_b, hi_b] = known(b);
+			for (int j = lo_b; j < hi_b; ++j)
+				z[j].y = _window[j]*samples[b + j - offset];
+		}
+		forward->execute(reinterpret_cast<Complex *>(z.data()));
+
+		// spectra of the real and imaginary parts, A = (Z[k] + conj Z[n-k])/2, B = (Z[k] - conj Z[n-k])/2i
+		vec2 *A = reinterpret_cast<vec2 *>(out + (size_t)(t - first)*K);
+		vec2 *B = A + K;
+		for (int k = 0; k < K; ++k) {
+			vec2 zk = z[k];
+			vec2 zn = z[k == 0 ? 0 : n - k];
+			zn.y = -zn.y;
+			A[k] = (zk + zn)*.5f;
+			if (pair) {
+				vec2 d = (zk - zn)*.5f;
+				B[k] = vec2(d.y, -d.x);
+			}
+		}
+	}
+}
+
+Spectrogram STFTEngine::analyse(std::span<const float> signal, int threads) const {
+	int frames = frameCount(signal.size());
+	Spectrogram res(frames, bins());
+	int pairs = (frames + 1)/2;
+	int blocks = std::min(resolveThreadCount(threads), std::max(pairs, 1));
+	parallelFor(blocks, blocks, [&](int b) {
+		int first = 2*(pairs*b/blocks);
+		int last = std::min(frames, 2*(pairs*(b + 1)/blocks));
+		if (last > first)
+			transformFrames(signal, 0, first, last - first, res.frame(first));
+	});
+	return res;
+}
+
+vector<float> STFTEngine::synthesise(const Spectrogram &spectra, int samples, int threads) const {
+	THROW_IF(spectra.bins() != bins(), IllegalArgumentError, "STFTEngine::synthesise: spectra have " + to_string(spectra.bins()) + " bins, expected " + to_string(bins()));
+	int n = _fft_size, w = windowSize(), K = bins();
+	threads = resolveThreadCount(threads);
+	vector<float> out(samples, 0), weight(samples, 0);
+	vector<float> block((size_t)SYNTHESIS_BLOCK*w);
+
+	for (int first = 0; first < spectra.frames(); first += SYNTHESIS_BLOCK) {
+		int count = std::min(SYNTHESIS_BLOCK, spectra.frames() - first);
+		// two real frames per inverse transform, as real and imaginary part of A + iB
+		parallelFor((count + 1)/2, threads, [&](int p) {
+			int t = first + 2*p;
+			bool pair = t + 1 < first + count;
+			auto &z = stft_scratch;
+			z.resize(n);
+			auto A = reinterpret_cast<const vec2 *>(spectra.frame(t));
+			auto B = pair ? reinterpret_cast<const vec2 *>(spectra.frame(t + 1)) : nullptr;
+			for (int k = 0; k < n; ++k) {
+				bool upper = k >= K;
+				int m = upper ? n - k : k;
+				vec2 a = A[m], b = pair ? B[m] : vec2(0);
+				if (upper) {
+					a.y = -a.y;
+					b.y = -b.y;
+				}
+				z[k] = vec2(a.x - b.y, a.y + b.x);
+			}
+			backward->execute(reinterpret_cast<Complex *>(z.data()));
+			float *fa = block.data() + (size_t)2*p*w;
+			for (int j = 0; j < w; ++j) {
+				fa[j] = z[j].x/n*_window[j];
+				if (pair)
+					fa[w + j] = z[j].y/n*_window[j];
+			}
+		});
+
+		for (int i = 0; i < count; ++i) {
+			long long start = frameStart(first + i);
+			const float *f = block.data() + (size_t)i*w;
+			int lo = std::max(0LL, -start), hi = std::min((long long)w, samples - start);
+			for (int j = lo; j < hi; ++j) {
+				out[start + j] += f[j];
+				weight[start + j] += _window[j]*_window[j];
+			}
+		}
+	}
+	for (int i = 0; i < samples; ++i)
+		out[i] = weight[i] > 1e-8f ? out[i]/weight[i] : 0;
+	return out;
+}
+
+DiscreteComplexFunctionR2 STFTEngine::fullSpectrum(const Spectrogram &spectra, vec2 domain) const {
+	int n = _fft_size, K = bins();
+	Grid2D<Complex> frames(spectra.frames(), n);
+	for (int t = 0; t < spectra.frames(); ++t)
+		for (int k = 0; k < n; ++k)
+			frames(t, k) = k < K ? spectra(t, k) : spectra(t, n - k).conj();
+	return DiscreteComplexFunctionR2(std::move(frames), domain, vec2(-1, 1));
+}
+
+
+STFTStream::STFTStream(const STFTEngine &engine, Emit emit, int threads, int batchFrames)
+: engine(engine), emit(std::move(emit)), batch_frames(std::max(2, batchFrames)), buffer_start(0), scratch(batch_frames, engine.bins()) {
+	if (resolveThreadCount(threads) > 1)
+		pool = make_unique<WorkerPool>(threads);
+}
+
+void STFTStream::emitFrames(int end) {
+	std::span<const float> known(buffer);
+	while (next_frame < end) {
+		int count = std::min(batch_frames, end - next_frame);
+		if (pool)
+			pool->forRange((count + 1)/2, 1, [&](int begin, int stop) {
+				int first = 2*begin, last = std::min(count, 2*stop);
+				engine.transformFrames(known, buffer_start, next_frame + first, last - first, scratch.frame(first));
+			});
+		else
+			engine.transformFrames(known, buffer_start, next_frame, count, scratch.frame(0));
+		for (int i = 0; i < count; ++i)
+			emit(next_frame + i, std::span<const Complex>(scratch.frame(i), engine.bins()));
+		next_frame += count;
+	}
+	// samples before the next frame are not needed anymore
+	long long keep = std::clamp(engine.frameStart(next_frame), buffer_start, received);
+	buffer.erase(buffer.begin(), buffer.begin() + (keep - buffer_start));
+	buffer_start = keep;
+}
+
+void STFTStream::push(std::span<const float> samples) {
+	THROW_IF(finished, ValueError, "STFTStream: samples pushed after finish");
+	buffer.insert(buffer.end(), samples.begin(), samples.end());
+	received += samples.size();
+	// frame t is complete when its last sample arrived
+	long long complete = received - engine.windowSize() + engine.padding();
+	if (complete >= 0)
+		emitFrames(std::min<long long>(complete/engine.hop() + 1, engine.frameCount(received)));
+}
+
+void STFTStream::finish() {
+	if (finished)
+		return;
+	finished = true;
+	emitFrames(engine.frameCount(received));
+	buffer.clear();
+	buffer.shrink_to_fit();
+}
@@ -69,7 +69,7 @@ int main() {
 
 
 	float r = .045;
-	auto particle_mesh = make_shared<IndexedMesh>(fluid.particle_mesh(r, 1));
+	auto particles = make_shared<InstancedMesh>(fluid.particle_instances(r, 1));
 	// auto march = fluid.boundary_surface_march(ivec3(50, 50, 50));
 	// auto march = fluid.free_surface_march(ivec3(50, 50, 50), 0.1f);
 	// auto bd_mesh = make_shared<IndexedMesh>(march, 100, 100);
@@ -77,7 +77,7 @@ int main() {
 
 
 	auto shader = ShaderProgram(
-	R"(C:\Users\PC\Desktop\ogl-master\src\shaders2\basic.vert)",
+	R"(C:\Users\PC\Desktop\ogl-master\src\shaders2\instancedOffset.vert)",
 	R"(C:\Users\PC\Desktop\ogl-master\src\shaders2\fluids.frag)");
 
 	auto shader_bd_back = ShaderProgram(
@@ -96,20 +96,13 @@ R"(C:\Users\PC\Desktop\ogl-master\src\shaders2\glass_front.frag)");
 	renderer.setLights(lights);
 
 	renderer.addMeshStep(shader_bd_front, bd_mesh, bdmat);
-	renderer.addMeshStep(shader, particle_mesh, ballmat);
+	renderer.addInstancedMeshStep(shader, particles, ballmat);
 	renderer.addMeshStep(shader_bd_back, bd_mesh, bdmat);
 
 
 	renderer.addCustomAction([&](float t, float dt) {
 		fluid.update(dt);
-		particle_mesh->deformPerId([&](BufferedVertex &b, PolyGroupID id) {
-			int i = std::get<int>(id);
-			vec4 col = b.getColor();
-			vec3 pos0 = vec3(col.y, col.z, col.w);
-			vec3 pos1 = fluid[i].pos();
-			b.setPosition(b.getPosition() + (pos1 - pos0));
-			b.setColor(vec4(fluid[i].p(), pos1.x, pos1.y, pos1.z));
-		});
+		fluid.update_particle_instances(particles->instances());
 
 	});
 
@@ -1,5 +1,6 @@
 #include "../engine/specific.hpp"
 #include "../engine/interface.hpp"
+#include "../utils/signalIO.hpp"
 
 using namespace glm;
 using std::vector, std::string, std::shared_ptr, std::unique_ptr, std::pair, std::make_unique, std::make_shared, std::cout, std::endl;
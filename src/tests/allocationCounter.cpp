@@ -0,0 +1,39 @@
+#include "allocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+
+// per thread, so workers and the logger do not disturb a measurement on the test thread
+static thread_local size_t allocations = 0;
+
+size_t threadAllocations() {
+	return allocations;
+}
+
+void *operator new(std::size_t size) {
+	++allocations;
+	if (void *p = std::malloc(size == 0 ? 1 : size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+	std::free(p);
+}
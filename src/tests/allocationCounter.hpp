@@ -0,0 +1,6 @@
+#pragma once
+#include <cstddef>
+
+
+// calls of the global operator new made by the calling thread, counted by the replacement in allocationCounter.cpp
+size_t threadAllocations();
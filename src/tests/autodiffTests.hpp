@@ -0,0 +1,108 @@
+#pragma once
+#include "unittests.hpp"
+#include "../utils/dual.hpp"
+#include "../utils/func.hpp"
+#include "../geometry/smoothImplicit.hpp"
+
+using namespace glm;
+
+
+constexpr float TORUS_R = 2, TORUS_r = .5f;
+
+// closed forms on the torus at tube angle u
+inline float torusGaussianCurvature(float u) { return cos(u) / (TORUS_r*(TORUS_R + TORUS_r*cos(u))); }
+inline float torusMeanCurvature(float u) { return (TORUS_R + 2*TORUS_r*cos(u)) / (2*TORUS_r*(TORUS_R + TORUS_r*cos(u))); }
+
+inline auto torusParametrisation = [](auto t, auto u) {
+	using S = decltype(t);
+	return tvec3<S>((TORUS_R + TORUS_r*cos(u))*cos(t), (TORUS_R + TORUS_r*cos(u))*sin(t), TORUS_r*sin(u));
+};
+inline auto torusEquation = [](auto x, auto y, auto z) {
+	auto rho = sqrt(x*x + y*y) - TORUS_R;
+	return rho*rho + z*z - TORUS_r*TORUS_r;
+};
+
+
+inline bool dualDerivativesTest()
+{
+	bool passed = true;
+	auto f = [](auto x, auto y, auto z) { return exp(x*y)*sin(z) + x*x*x/(1 + y*y); };
+	RealFunctionR3 F = RealFunctionR3::autodiff(f);
+	RealFunctionR3 F_fd = RealFunctionR3([f](vec3 v) { return f(v.x, v.y, v.z); }, .01f);
+
+	for (vec3 p: {vec3(.3f, -.2f, 1.1f), vec3(-.7f, .5f, .4f), vec3(1, 1, -1)}) {
+		// d/dx of exp(xy)sin(z) + x^3/(1+y^2)
+		float dx = p.y*exp(p.x*p.y)*sin(p.z) + 3*p.x*p.x/(1 + p.y*p.y);
+		passed &= assertLessOrEqual_UT(abs(F.df(p).x - dx), 1e-5f*(1 + abs(dx)));
+		passed &= assertLessOrEqual_UT(norm(F.df(p) - F_fd.df(p)), 1e-2f);
+		auto [value, gradient] = F.valueAndGradient(p);
+		passed &= assertLessOrEqual_UT(abs(value - F(p)) + norm(gradient - F.df(p)), 1e-6f);
+
+		mat3 H = F.hessian(p), H_fd = F_fd.hessian(p);
+		float d2xz = p.y*exp(p.x*p.y)*cos(p.z);
+		passed &= assertLessOrEqual_UT(abs(H[0][2] - d2xz), 1e-5f*(1 + abs(d2xz)));
+		passed &= assertLessOrEqual_UT(abs(H[2][0] - d2xz), 1e-5f*(1 + abs(d2xz)));
+		for (int i = 0; i < 3; ++i)
+			passed &= assertLessOrEqual_UT(norm(H[i] - H_fd[i]), 2e-2f);
+	}
+
+	// second derivative of a helix from one hyper-dual evaluation
+	auto helix = SmoothParametricCurve::autodiff([](auto t) { return tvec3<decltype(t)>(cos(t), sin(t), .5f*t); });
+	passed &= assertLessOrEqual_UT(norm(helix.ddf(1) - vec3(-cos(1.f), -sin(1.f), 0)), 1e-6f);
+	passed &= assertLessOrEqual_UT(norm(helix.df(1) - vec3(-sin(1.f), cos(1.f), .5f)), 1e-6f);
+	return passed;
+}
+
+
+inline bool parametricCurvatureAutodiffTest()
+{
+	bool passed = true;
+	auto torus = SmoothParametricSurface::autodiff(torusParametrisation, vec2(0, TAU), vec2(0, TAU), true, true);
+	auto torus_fd = SmoothParametricSurface([](float t, float u) { return torusParametrisation(t, u); }, vec2(0, TAU), vec2(0, TAU), true, true);
+
+	float error = 0, error_fd = 0;
+	for (int i = 0; i < 16; ++i) {
+		float t = .4f*i, u = .1f + .37f*i;
+		float K = torusGaussianCurvature(u), H = torusMeanCurvature(u);
+		error = max(error, abs(torus.gaussianCurvature(t, u) - K) + abs(abs(torus.meanCurvature(t, u)) - H));
+		error_fd = max(error_fd, abs(torus_fd.gaussianCurvature(t, u) - K) + abs(abs(torus_fd.meanCurvature(t, u)) - H));
+
+		auto [k1, k2] = torus.principalCurvatures(t, u);
+		passed &= assertLessOrEqual_UT(abs(k1*k2 - K) + abs(abs(k1 + k2) - 2*H), 1e-5f);
+		mat2 S = torus.shapeOperator(t, u);
+		passed &= assertLessOrEqual_UT(abs(determinant(S) - K), 1e-5f);
+		passed &= assertLessOrEqual_UT(abs(abs(S[0][0] + S[1][1]) - 2*H), 1e-5f);
+		passed &= assertLessOrEqual_UT(abs(norm(torus.Laplacian(t, u)) - 2*H), 1e-5f);
+	}
+	passed &= assertLessOrEqual_UT(error, 1e-5f);
+	passed &= assertLess_UT(error, error_fd);
+	return passed;
+}
+
+
+inline bool implicitCurvatureAutodiffTest()
+{
+	bool passed = true;
+	auto torus = SmoothImplicitSurface::autodiff(torusEquation);
+	for (int i = 0; i < 16; ++i) {
+		float t = .4f*i, u = .1f + .37f*i;
+		vec3 p = torusParametrisation(t, u);
+		passed &= assertLessOrEqual_UT(abs(torus.gaussianCurvature(p) - torusGaussianCurvature(u)), 1e-5f);
+		// the gradient points out of the tube
+		passed &= assertLessOrEqual_UT(abs(torus.meanCurvature(p) + torusMeanCurvature(u)), 1e-5f);
+
+		vec3 q = torus.newtonStepProject(p*1.1f, 1e-6f, 20);
+		passed &= assertLessOrEqual_UT(abs(torus(q)), 1e-5f);
+	}
+	return passed;
+}
+
+
+inline UnitTestResult autodiffTests__all()
+{
+	UnitTestResult result;
+	result.runTest(dualDerivativesTest);
+	result.runTest(parametricCurvatureAutodiffTest);
+	result.runTest(implicitCurvatureAutodiffTest);
+	return result;
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include <fstream>
+#include <iterator>
+
+#include "unittests.hpp"
+#include "../engine/frameCapture.hpp"
+#include "../utils/logging.hpp"
+
+
+// bottom-up RGBA test pattern depending on the frame index
+inline vector<uint8_t> capturePattern(int width, int height, int frame)
+{
+	vector<uint8_t> rgba(4 * width * height);
+	for (int y = 0; y < height; ++y)
+		for (int x = 0; x < width; ++x) {
+			uint8_t *p = rgba.data() + 4 * (y * width + x);
+			p[0] = (x * 7 + frame) & 0xFF;
+			p[1] = (y * 13) & 0xFF;
+			p[2] = (x ^ y ^ frame) & 0xFF;
+			p[3] = 255;
+		}
+	return rgba;
+}
+
+inline uint32_t readBE32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+inline vector<uint8_t> readAll(const Path &path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+
+// decodes the stored deflate blocks back and compares with the flipped input rows
+inline bool pngEncodingTest()
+{
+	bool passed = true;
+	int w = 300, h = 250;
+	vector<uint8_t> rgba = capturePattern(w, h, 3);
+	vector<uint8_t> png;
+	encodePNG(rgba.data(), w, h, png);
+
+	passed &= assertEqual_UT(png[0], 0x89);
+	passed &= assertEqual_UT(string(png.begin() + 1, png.begin() + 4), string("PNG"));
+	passed &= assertEqual_UT(readBE32(png.data() + 16), w);
+	passed &= assertEqual_UT(readBE32(png.data() + 20), h);
+	// IEND chunk and its fixed CRC
+	passed &= assertEqual_UT(readBE32(png.data() + png.size() - 4), 0xAE426082u);
+
+	size_t idat = 8 + 12 + 13;
+	size_t idatLength = readBE32(png.data() + idat);
+	passed &= assertEqual_UT(string(png.begin() + idat + 4, png.begin() + idat + 8), string("IDAT"));
+	const uint8_t *z = png.data() + idat + 8 + 2;
+	vector<uint8_t> raw;
+	bool last = false;
+	while (!last) {
+		last = z[0] & 1;
+		size_t len = z[1] | z[2] << 8;
+		passed &= assertEqual_UT((z[3] | z[4] << 8), (~len & 0xFFFF));
+		raw.insert(raw.end(), z + 5, z + 5 + len);
+		z += 5 + len;
+	}
+	passed &= assertEqual_UT(raw.size(), (size_t)h * (1 + 3 * w));
+	passed &= assertEqual_UT((size_t)(z + 4 - (png.data() + idat + 8)), idatLength);
+
+	bool same = true;
+	for (int y = 0; y < h; ++y)
+		for (int x = 0; x < w; ++x)
+			for (int c = 0; c < 3; ++c)
+				same &= raw[y * (1 + 3 * w) + 1 + 3 * x + c] == rgba[4 * ((h - 1 - y) * w + x) + c];
+	passed &= assertTrue_UT(same);
+	return passed;
+}
+
+
+inline bool y4mEncodingTest()
+{
+	bool passed = true;
+	uint8_t rgba[4 * 4] = {
+		0, 0, 0, 255,      255, 255, 255, 255,
+		255, 0, 0, 255,    0, 0, 255, 255
+	};
+	vector<uint8_t> frame;
+	encodeY4MFrame(rgba, 2, 2, frame);
+	passed &= assertEqual_UT(frame.size(), 6 + 12);
+	passed &= assertEqual_UT(string(frame.begin(), frame.begin() + 6), string("FRAME\n"));
+	const uint8_t *Y = frame.data() + 6, *U = Y + 4, *V = U + 4;
+	// top row is the second input row
+	passed &= assertEqual_UT((int)Y[0], 77);
+	passed &= assertEqual_UT((int)V[0], 255);
+	passed &= assertEqual_UT((int)U[1], 255);
+	passed &= assertEqual_UT((int)Y[2], 0);
+	passed &= assertEqual_UT((int)Y[3], 255);
+	passed &= assertEqual_UT((int)U[3], 128);
+	passed &= assertEqual_UT((int)V[3], 128);
+	passed &= assertEqual_UT(y4mHeader(2, 2, 24), string("YUV4MPEG2 W2 H2 F24:1 Ip A1:1 C444 XCOLORRANGE=FULL\n"));
+	return passed;
+}
+
+
+// frames go through the writer thread with a short queue, output has to equal direct encoding in frame order
+inline bool frameWriterTest()
+{
+	bool passed = true;
+	int w = 96, h = 64, frames = 40;
+	Path video = filesystem::temp_directory_path() / "frameWriterTest.y4m";
+	Path sequence = filesystem::temp_directory_path() / "frameWriterTest";
+	{
+		FrameWriter y4m(w, h, video, Y4M_VIDEO, 30, 2);
+		FrameWriter png(w, h, sequence, PNG_SEQUENCE, 30, 2);
+		for (int f = 0; f < frames; ++f) {
+			vector<uint8_t> a = y4m.acquireBuffer(), b = png.acquireBuffer();
+			vector<uint8_t> pattern = capturePattern(w, h, f);
+			std::copy(pattern.begin(), pattern.end(), a.begin());
+			std::copy(pattern.begin(), pattern.end(), b.begin());
+			y4m.push(f, std::move(a));
+			png.push(f, std::move(b));
+		}
+		y4m.finish();
+		png.finish();
+		passed &= assertEqual_UT(y4m.framesWritten(), frames);
+		passed &= assertEqual_UT(png.framesWritten(), frames);
+	}
+
+	string header = y4mHeader(w, h, 30);
+	vector<uint8_t> expected(header.begin(), header.end());
+	for (int f = 0; f < frames; ++f)
+		encodeY4MFrame(capturePattern(w, h, f).data(), w, h, expected);
+	passed &= assertTrue_UT(readAll(video) == expected);
+
+	vector<uint8_t> png;
+	encodePNG(capturePattern(w, h, 17).data(), w, h, png);
+	passed &= assertTrue_UT(readAll(sequence / "frame_000017.png") == png);
+	passed &= assertTrue_UT(filesystem::exists(sequence / "frame_000039.png"));
+
+	bool thrown = false;
+	FrameWriter y4m(w, h, video, Y4M_VIDEO, 30);
+	try { y4m.push(0, vector<uint8_t>(5)); } catch (const IllegalArgumentError &) { thrown = true; }
+	passed &= assertTrue_UT(thrown);
+	y4m.finish();
+
+	filesystem::remove(video);
+	filesystem::remove_all(sequence);
+	return passed;
+}
+
+
+inline UnitTestResult captureTests__all()
+{
+	UnitTestResult result;
+	result.runTest(pngEncodingTest);
+	result.runTest(y4mEncodingTest);
+	result.runTest(frameWriterTest);
+	return result;
+}
@@ -2,6 +2,7 @@
 #include "unittests.hpp"
 #include "../utils/func.hpp"
 #include "../utils/integralTransforms.hpp"
+#include "../geometry/pdeDiscrete.hpp"
 #include "../utils/logging.hpp"
 
 using namespace glm;
@@ -43,6 +44,48 @@ inline bool fftRealDomainSymmetryDFTTest()
 
 }
 
+inline bool fftArbitraryLengthTest()
+{
+  bool passed = true;
+  for (int n : {12, 15, 45, 17, 97})
+  {
+    auto fn = DiscreteComplexFunction(Vector<Complex>(n, [](int j) { return Complex(std::sin(1.3f*j), std::cos(.7f*j)); }), vec2(0, 1));
+    auto fn_fft = fn.fft();
+    for (int k = 0; k < n; ++k)
+    {
+      Complex c = Complex(0.f, 0.f);
+      for (int j = 0; j < n; ++j)
+        c += fn[j] * exp(Complex(0.f, TAU*(j*k % n)/n));
+      passed &= assertLess_UT(abs(c - fn_fft[k]), 1e-3f*n);
+    }
+    passed &= assertLess_UT((fn - fn_fft.ifft()).L2_norm(), 0.001);
+  }
+  return passed;
+}
+
+
+inline bool dftMatchesFFTTest()
+{
+  bool passed = true;
+  int N = 20;
+  auto dft = DFT(N);
+  auto seq = FiniteSequence<Complex>();
+  for (int n = -10; n <= 9; ++n)
+    seq.set(n, Complex(1.f*n, 1.f/(abs(n)+1)));
+  auto res = dft(seq);
+  for (int k = -10; k <= 9; ++k)
+  {
+    Complex c = Complex(0.f, 0.f);
+    for (int n = -10; n <= 9; ++n)
+      c += seq[n] * exp(Complex(0.f, -TAU*k*n/N));
+    passed &= assertLess_UT(abs(c - res[k]), 1e-3f);
+  }
+  auto back = dft.inv(res);
+  for (int n = -10; n <= 9; ++n)
+    passed &= assertLess_UT(abs(back[n] - seq[n]), 1e-4f);
+  return passed;
+}
+
 inline bool paddingTest()
 {
 
@@ -92,14 +135,162 @@ inline bool quaternionTest() {
   return passed;
 }
 
+// max error against exact solution of all slices
+inline float heatMaxError(const DiscreteRealFunctionR2 &u, float t_max, const std::function<float(float, float)> &exact)
+{
+  float error = 0;
+  int t_res = u.samples_t();
+  for (int j = 0; j < t_res; ++j)
+  {
+    auto slice = u[j];
+    float t = t_max*j/(t_res-1);
+    for (int i = 0; i < slice.samples(); ++i)
+      error = std::max(error, abs(slice[i] - exact(t, slice.getDomain().x + i*slice.sampling_step())));
+  }
+  return error;
+}
+
+
+inline bool heatSolverBackendsTest()
+{
+  // spreading gaussian u = sqrt(t0/(t0+t)) exp(-x^2/(4k(t0+t))), negligible at the boundary
+  bool passed = true;
+  float k = .5f, t0 = .25f, t_max = 1;
+  auto exact = [=](float t, float x) { return std::sqrt(t0/(t0+t)) * std::exp(-x*x/(4*k*(t0+t))); };
+  auto u0 = DiscreteRealFunction([=](float x) { return exact(0, x); }, vec2(-10, 10), 400);
+
+  auto spectral = HeatRealLineHomoDiscrete(u0, k, t_max, 21, HeatSolverBackend::SPECTRAL).solution();
+  passed &= assertEqual_UT(spectral.samples_t(), 21);
+  passed &= assertEqual_UT(spectral.samples_x(), 400);
+  passed &= assertLess_UT(heatMaxError(spectral, t_max, exact), 1e-4f);
+
+  auto solver = HeatRealLineHomoDiscrete(u0, k, t_max, 20, HeatSolverBackend::CRANK_NICOLSON);
+  solver.setCrankNicolsonSubsteps(4);
+  passed &= assertLess_UT(heatMaxError(solver.solution(), t_max, exact), 1e-3f);
+  return passed;
+}
+
+
+inline bool heatSolverSourceTest()
+{
+  // u = (1+t) exp(-x^2) solves u_t = k u_xx + f with f = (1 - k(1+t)(4x^2-2)) exp(-x^2)
+  bool passed = true;
+  float k = .3f, t_max = 1;
+  int t_res = 41;
+  auto exact = [](float t, float x) { return (1+t) * std::exp(-x*x); };
+  vector<DiscreteRealFunction> source;
+  for (int j = 0; j < t_res; ++j)
+  {
+    float t = t_max*j/(t_res-1);
+    source.emplace_back([=](float x) { return (1 - k*(1+t)*(4*x*x-2)) * std::exp(-x*x); }, vec2(-8, 8), 256);
+  }
+  auto f = DiscreteRealFunctionR2(source, vec2(0, t_max));
+  auto u0 = DiscreteRealFunction([=](float x) { return exact(0, x); }, vec2(-8, 8), 256);
+
+  passed &= assertLess_UT(heatMaxError(HeatRealLineDiscreteNotHomo(f, u0, k, t_max, t_res, HeatSolverBackend::SPECTRAL).solution(), t_max, exact), 1e-3f);
+  passed &= assertLess_UT(heatMaxError(HeatRealLineDiscreteNotHomo(f, u0, k, t_max, t_res, HeatSolverBackend::CRANK_NICOLSON).solution(), t_max, exact), 2e-3f);
+  return passed;
+}
+
+
+inline bool fft2DMatchesDFTTest()
+{
+  // sizes with mixed radix and Bluestein factors, against the defining double sum
+  bool passed = true;
+  int nt = 12, nx = 7;
+  Grid2D<Complex> values(nt, nx);
+  for (int t = 0; t < nt; ++t)
+    for (int x = 0; x < nx; ++x)
+      values(t, x) = Complex(std::sin(.3f*t + .1f*x*x), std::cos(.7f*x - .2f*t));
+  auto f = DiscreteComplexFunctionR2(values, vec2(0, 2), vec2(-1, 1));
+  auto f_fft = f.fft();
+  float error = 0;
+  for (int it = 0; it < nt; ++it)
+    for (int ix = 0; ix < nx; ++ix)
+    {
+      Complex c = Complex(0.f, 0.f);
+      for (int kt = 0; kt < nt; ++kt)
+        for (int jx = 0; jx < nx; ++jx)
+          c += exp(Complex(0.f, -TAU*(ix*jx % nx)/nx - TAU*(it*kt % nt)/nt)) * values(kt, jx);
+      error = std::max(error, abs(c - f_fft.at(it, ix)));
+    }
+  passed &= assertLess_UT(error, 1e-3f);
+  passed &= assertNearlyEqual_UT(f_fft.domain_x(), vec2(0, TAU/2));
+
+  // columns transformed one by one agree with fft_x, and everything inverts
+  auto f_x = f.fft_x();
+  for (int x = 0; x < nx; ++x)
+  {
+    auto column = DiscreteComplexFunction(f.column(x).copy(), vec2(0, 2)).fft();
+    for (int t = 0; t < nt; ++t)
+      error = std::max(error, abs(column[t] - f_x.at(t, x)));
+  }
+  passed &= assertLess_UT(error, 1e-3f);
+  float back = 0, back_x = 0;
+  auto f_back = f_fft.ifft(), f_back_x = f_x.ifft_x();
+  for (int t = 0; t < nt; ++t)
+    for (int x = 0; x < nx; ++x)
+    {
+      back = std::max(back, abs(f_back.at(t, x) - f.at(t, x)));
+      back_x = std::max(back_x, abs(f_back_x.at(t, x) - f.at(t, x)));
+    }
+  passed &= assertLess_UT(back, 1e-4f);
+  passed &= assertLess_UT(back_x, 1e-4f);
+  return passed;
+}
+
+
+inline bool functionR2LayoutTest()
+{
+  bool passed = true;
+  vector<DiscreteRealFunction> rows;
+  for (int t = 0; t < 37; ++t)
+    rows.emplace_back([t](float x) { return t + x; }, vec2(0, 1), 45);
+  auto f = DiscreteRealFunctionR2(rows, vec2(0, 3));
+  passed &= assertEqual_UT(f.samples(), ivec2(37, 45));
+  passed &= assertNearlyEqual_UT(f.domain_x(), vec2(0, 1));
+  passed &= assertEqual_UT(f.values().stride(), (size_t)45);
+  passed &= assertEqual_UT(f.row(5).data(), f.values().rowData(5));
+  passed &= assertEqual_UT(f.column(3).stride(), (std::ptrdiff_t)45);
+  passed &= assertNearlyEqual_UT(f[5][3], f.column(3)[5]);
+
+  // tiles of the blocked transpose do not divide the sizes
+  auto ft = f.transpose();
+  bool same = true;
+  for (int t = 0; t < 37; ++t)
+    for (int x = 0; x < 45; ++x)
+      same &= ft.at(x, t) == f.at(t, x);
+  passed &= assertTrue_UT(same);
+  passed &= assertNearlyEqual_UT(ft.domain_x(), vec2(0, 3));
+
+  auto product = f * f, sum = f + f, quotient = 1.f / (f + 1);
+  passed &= assertNearlyEqual_UT(product.at(7, 9), f.at(7, 9)*f.at(7, 9));
+  passed &= assertNearlyEqual_UT(sum.at(7, 9), 2*f.at(7, 9));
+  passed &= assertNearlyEqual_UT(quotient.at(7, 9), 1/(f.at(7, 9) + 1));
+
+  bool threw = false;
+  rows.emplace_back([](float x) { return x; }, vec2(0, 1), 44);
+  try { DiscreteRealFunctionR2(rows, vec2(0, 3)); }
+  catch (const ValueError &) { threw = true; }
+  passed &= assertTrue_UT(threw);
+  return passed;
+}
+
+
 inline UnitTestResult discreteFuncTests__all()
 {
 	UnitTestResult result;
 	result.runTest(fftInverseTest);
 	result.runTest(fftRealDomainSymmetryDFTTest);
+	result.runTest(fftArbitraryLengthTest);
+	result.runTest(dftMatchesFFTTest);
 	result.runTest(paddingTest);
 	result.runTest(gaborTest);
 	result.runTest(quaternionTest);
+	result.runTest(heatSolverBackendsTest);
+	result.runTest(heatSolverSourceTest);
+	result.runTest(fft2DMatchesDFTTest);
+	result.runTest(functionR2LayoutTest);
 
 	return result;
 
@@ -0,0 +1,177 @@
+#pragma once
+#include "unittests.hpp"
+#include "../engine/framePacer.hpp"
+#include "../utils/exceptions.hpp"
+#include "../utils/randomUtils.hpp"
+
+using namespace glm;
+
+
+// simulated time, sleeps wake up late by up to maxOversleep in a fixed pattern and a spin iteration costs spinStep
+class ManualFrameClock : public FrameClock {
+public:
+	double time = 0, maxOversleep, spinStep;
+	double slept = 0, spun = 0;
+	int sleeps = 0;
+
+	explicit ManualFrameClock(double maxOversleep=0, double spinStep=1e-6) : maxOversleep(maxOversleep), spinStep(spinStep) {}
+
+	double now() override { return time; }
+	void sleepFor(double seconds) override {
+		double late = maxOversleep*(sleeps++*7 % 10)/9.;
+		time += seconds + late;
+		slept += seconds + late;
+	}
+	void relax() override {
+		time += spinStep;
+		spun += spinStep;
+	}
+	void work(double seconds) { time += seconds; }
+};
+
+
+inline bool cappedPacingSleepsMostOfTheBudgetTest()
+{
+	bool passed = true;
+	auto clock = std::make_shared<ManualFrameClock>(3e-4);
+	FramePacer pacer(FramePacing::CAPPED, 60, clock);
+	double period = 1/60.;
+
+	passed &= assertEqual_UT(pacer.beginFrame(), 0.);
+	for (int frame = 0; frame < 300; ++frame) {
+		clock->work(2e-3);
+		pacer.markSimulationDone();
+		clock->work(3e-3);
+		pacer.endFrame();
+		double dt = pacer.beginFrame();
+		// never early, late only when a sleep overshoots the margin learned from the previous ones
+		passed &= assertLessOrEqual_UT(period, dt + 1e-12);
+		if (frame > 0)
+			passed &= assertLessOrEqual_UT(dt, period + 5e-5);
+	}
+	passed &= assertLessOrEqual_UT(pacer.frameTimes().quantile(.9), period + 2e-6);
+	// the thread spins for a few percent of the wait at most
+	passed &= assertLess_UT(clock->spun, .05*clock->slept);
+	passed &= assertLessOrEqual_UT(pacer.currentSpinMargin(), 1e-3);
+
+	passed &= assertEqual_UT(pacer.frameTimes().count(), 300);
+	passed &= assertLessOrEqual_UT(abs(pacer.simulationTimes().mean() - 2e-3), 1e-9);
+	passed &= assertLessOrEqual_UT(abs(pacer.renderTimes().mean() - 3e-3), 1e-9);
+	passed &= assertLessOrEqual_UT(abs(pacer.waitTimes().quantile(.5) - (period - 5e-3)), 1e-5);
+
+	// a slow frame is not followed by a short one
+	clock->work(.05);
+	passed &= assertLessOrEqual_UT(abs(pacer.beginFrame() - .05), 1e-9);
+	clock->work(1e-3);
+	passed &= assertLessOrEqual_UT(period, pacer.beginFrame() + 1e-12);
+	return passed;
+}
+
+
+inline bool fixedAndUncappedPacingTest()
+{
+	bool passed = true;
+	auto clock = std::make_shared<ManualFrameClock>(1e-4);
+	double period = 1/50.;
+	FramePacer fixed(FramePacing::FIXED, 50, clock);
+
+	// frames start on a grid, dt is the period whatever the work took
+	double origin = clock->now();
+	passed &= assertEqual_UT(fixed.beginFrame(), period);
+	for (int frame = 1; frame <= 100; ++frame) {
+		clock->work(randomFloat(1e-3, 1.5e-2));
+		passed &= assertEqual_UT(fixed.beginFrame(), period);
+		passed &= assertLessOrEqual_UT(abs(clock->now() - (origin + frame*period)), 2e-6);
+	}
+	// one late frame is absorbed by the grid
+	clock->work(period*1.5);
+	fixed.beginFrame();
+	clock->work(1e-3);
+	fixed.beginFrame();
+	passed &= assertLessOrEqual_UT(abs(clock->now() - (origin + 102*period)), 2e-6);
+	// a long stall moves the grid instead of producing a burst of frames
+	clock->work(period*10);
+	double resumed = clock->now();
+	fixed.beginFrame();
+	clock->work(1e-3);
+	fixed.beginFrame();
+	passed &= assertLessOrEqual_UT(abs(clock->now() - (resumed + period)), 2e-6);
+
+	auto uncappedClock = std::make_shared<ManualFrameClock>(1e-4);
+	FramePacer uncapped(FramePacing::UNCAPPED, 0, uncappedClock);
+	uncapped.beginFrame();
+	for (int frame = 0; frame < 10; ++frame) {
+		uncappedClock->work(4e-3);
+		passed &= assertLessOrEqual_UT(abs(uncapped.beginFrame() - 4e-3), 1e-9);
+	}
+	passed &= assertEqual_UT(uncappedClock->slept + uncappedClock->spun, 0.);
+	// without markSimulationDone the frame counts as rendering
+	uncapped.endFrame();
+	passed &= assertTrue_UT(uncapped.simulationTimes().empty());
+	passed &= assertEqual_UT(uncapped.renderTimes().count(), 1);
+
+	bool threw = false;
+	try { FramePacer(FramePacing::CAPPED, 0, clock); }
+	catch (const IllegalArgumentError &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+	return passed;
+}
+
+
+inline bool frameTimeHistogramTest()
+{
+	bool passed = true;
+	FrameTimeHistogram times(100);
+	passed &= assertTrue_UT(times.empty());
+	for (int i = 1; i <= 250; ++i)
+		times.record(i*1e-3);
+
+	// only the last 100 samples remain, oldest first
+	passed &= assertEqual_UT(times.count(), 100);
+	auto window = times.window();
+	passed &= assertLessOrEqual_UT(abs(window.front() - .151), 1e-12);
+	passed &= assertLessOrEqual_UT(abs(times.last() - .25), 1e-12);
+	passed &= assertLessOrEqual_UT(abs(times.min() - .151), 1e-12);
+	passed &= assertLessOrEqual_UT(abs(times.mean() - .2005), 1e-9);
+	passed &= assertLessOrEqual_UT(abs(times.quantile(.5) - .2), 1e-12);
+	passed &= assertLessOrEqual_UT(abs(times.quantile(.99) - .249), 1e-12);
+	passed &= assertLessOrEqual_UT(abs(times.quantile(1) - .25), 1e-12);
+
+	auto buckets = times.histogram();
+	int total = 0;
+	for (int b = 0; b < FrameTimeHistogram::BUCKETS; ++b) {
+		total += buckets[b];
+		if (buckets[b] > 0) {
+			passed &= assertLessOrEqual_UT(FrameTimeHistogram::bucketLowerBound(b), .25);
+			passed &= assertLessOrEqual_UT(.151, FrameTimeHistogram::bucketLowerBound(b + 1));
+		}
+	}
+	passed &= assertEqual_UT(total, 100);
+	passed &= assertEqual_UT(FrameTimeHistogram::bucketOf(0), 0);
+	passed &= assertEqual_UT(FrameTimeHistogram::bucketOf(1e3), FrameTimeHistogram::BUCKETS - 1);
+
+	auto clock = std::make_shared<ManualFrameClock>();
+	FramePacer pacer(FramePacing::CAPPED, 30, clock, 10);
+	for (int frame = 0; frame < 20; ++frame) {
+		pacer.beginFrame();
+		clock->work(1e-3);
+		pacer.markSimulationDone();
+		pacer.endFrame();
+	}
+	std::ostringstream dump;
+	pacer.dump(dump);
+	passed &= assertTrue_UT(pacer.summary().starts_with("frame"));
+	passed &= assertTrue_UT(dump.str().find("simulation histogram") != string::npos);
+	passed &= assertEqual_UT(pacer.frameTimes().count(), 10);
+	return passed;
+}
+
+
+inline UnitTestResult framePacerTests__all()
+{
+	UnitTestResult result;
+	result.runTest(cappedPacingSleepsMostOfTheBudgetTest);
+	result.runTest(fixedAndUncappedPacingTest);
+	result.runTest(frameTimeHistogramTest);
+	return result;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "unittests.hpp"
+#include "../utils/func.hpp"
+#include "../utils/randomUtils.hpp"
+#include "../utils/logging.hpp"
+
+using namespace glm;
+
+
+// same formula for graph-backed and closure-backed coordinates, f enters every step once, x*y and x*x + 1 are rebuilt every step
+inline RealFunctionR3 composedTestFunction(const RealFunctionR3 &x, const RealFunctionR3 &y, const RealFunctionR3 &z)
+{
+	RealFunctionR3 f = x;
+	for (int k = 0; k < 7; ++k)
+		f = (f*(1 + .1f*k) + x*y - z) / (x*x + 1) + max(y, z)*.5f;
+	return f;
+}
+
+
+inline bool exprTapeMatchesClosuresTest()
+{
+	bool passed = true;
+	RealFunctionR3 fx = RealFunctionR3([](vec3 v) { return v.x; }, [](vec3) { return vec3(1, 0, 0); });
+	RealFunctionR3 fy = RealFunctionR3([](vec3 v) { return v.y; }, [](vec3) { return vec3(0, 1, 0); });
+	RealFunctionR3 fz = RealFunctionR3([](vec3 v) { return v.z; }, [](vec3) { return vec3(0, 0, 1); });
+
+	RealFunctionR3 graph = composedTestFunction(X_R3, Y_R3, Z_R3);
+	RealFunctionR3 closure = composedTestFunction(fx, fy, fz);
+	passed &= assertTrue_UT(graph.hasExpression());
+	passed &= assertFalse_UT(closure.hasExpression());
+	passed &= assertFalse_UT((graph + fx).hasExpression());
+
+	vector<vec3> pts;
+	for (int i = 0; i < 1000; ++i)
+		pts.push_back(random_vec3(vec3(-2), vec3(2)));
+	vector<float> batch(pts.size());
+	graph.evaluate(pts, batch);
+
+	for (int i = 0; i < pts.size(); ++i) {
+		float expected = closure(pts[i]);
+		float tolerance = 1e-4f * (1 + std::abs(expected));
+		passed &= assertLess_UT(std::abs(graph(pts[i]) - expected), tolerance);
+		passed &= assertLess_UT(std::abs(batch[i] - expected), tolerance);
+		// closures differentiate max(y, z) numerically, which smears the kink over eps
+		if (std::abs(pts[i].y - pts[i].z) > .05f)
+			passed &= assertLess_UT(length(graph.df(pts[i]) - closure.df(pts[i])), 1e-3f * (1 + length(closure.df(pts[i]))));
+	}
+
+	RealFunctionR3 r = NORM_R3;
+	passed &= assertNearlyEqual_UT(r.df(vec3(3, 0, 4)), vec3(.6f, 0, .8f));
+	passed &= assertNearlyEqual_UT((SIN_R & NORM2_R3)(vec3(1, 1, 0)), std::sin(2.f));
+	passed &= assertTrue_UT((SIN_R & NORM2_R3).hasExpression());
+	return passed;
+}
+
+
+inline bool exprTapeCommonSubexpressionTest()
+{
+	bool passed = true;
+	RealFunctionR3 f = (X_R3 + Y_R3) * (Y_R3 + X_R3) + (X_R3 + Y_R3) * 0;
+	passed &= assertEqual_UT(f.expression().nodeCount(), 5);
+	ExprTape tape = ExprTape({f.expression()}, 3);
+	passed &= assertEqual_UT(tape.size(), 4);
+	passed &= assertNearlyEqual_UT(f(1, 2, 7), 9.f);
+
+	// gradient shares x + y with the value
+	Expr e = f.expression();
+	ExprTape both = ExprTape({e, e.derivative(0), e.derivative(1)}, 3);
+	float x[3] = {1, 2, 7}, out[3];
+	both.evaluate(x, out);
+	passed &= assertLessOrEqual_UT(both.size(), 7);
+	passed &= assertNearlyEqual_UT(vec3(out[0], out[1], out[2]), vec3(9, 6, 6));
+	return passed;
+}
+
+
+inline bool graphBackedCompositionTest()
+{
+	bool passed = true;
+	mat3 A = mat3(1, 2, 0, -1, 0, 3, 0, 1, 1);
+	vec3 v = vec3(.5, -1, 2);
+	SpaceEndomorphism g = SpaceEndomorphism::affine(A, v) & SpaceEndomorphism::scaling(2, 3, 4);
+	passed &= assertTrue_UT(g.hasExpression());
+	vec3 p = vec3(.3, -.7, 1.1);
+	passed &= assertNearlyEqual_UT(g(p), A * (vec3(2, 3, 4) * p) + v);
+	mat3 J = A * mat3(2, 0, 0, 0, 3, 0, 0, 0, 4);
+	for (int i = 0; i < 3; ++i)
+		passed &= assertNearlyEqual_UT(g.df(p)[i], J[i]);
+
+	ScalarField F = ScalarField(Expr::variable(0) * Expr::variable(3) + Expr::variable(1));
+	passed &= assertNearlyEqual_UT(F(vec3(2, 5, 0), 3), 11.f);
+	passed &= assertNearlyEqual_UT(F.time_derivative()(vec3(2, 5, 0), 3), 2.f);
+	passed &= assertNearlyEqual_UT(F.spatial_partial(0)(vec3(2, 5, 0), 3), 3.f);
+	passed &= assertNearlyEqual_UT(F.fix_time(3)(vec3(2, 5, 0)), 11.f);
+	passed &= assertTrue_UT(F.fix_time(3).hasExpression());
+
+	RealFunction h = RealFunction::sin() & (X_R*X_R);
+	passed &= assertTrue_UT(h.hasExpression());
+	passed &= assertNearlyEqual_UT(h.df(.5f), std::cos(.25f));
+	passed &= assertNearlyEqual_UT(h.ddf(.5f), 2*std::cos(.25f) - std::sin(.25f));
+	return passed;
+}
+
+
+// per point and batch evaluation of the tape agree with the closure chain, timings are in the benchmarks target
+inline bool exprTapeBatchMatchesClosuresTest()
+{
+	RealFunctionR3 fx = RealFunctionR3([](vec3 v) { return v.x; }, [](vec3) { return vec3(1, 0, 0); });
+	RealFunctionR3 fy = RealFunctionR3([](vec3 v) { return v.y; }, [](vec3) { return vec3(0, 1, 0); });
+	RealFunctionR3 fz = RealFunctionR3([](vec3 v) { return v.z; }, [](vec3) { return vec3(0, 0, 1); });
+	RealFunctionR3 graph = composedTestFunction(X_R3, Y_R3, Z_R3);
+	RealFunctionR3 closure = composedTestFunction(fx, fy, fz);
+
+	vector<vec3> pts;
+	for (int i = 0; i < 20000; ++i)
+		pts.push_back(random_vec3(vec3(-2), vec3(2)));
+	vector<float> batch(pts.size());
+	graph.evaluate(pts, batch);
+
+	float worst = 0;
+	for (int i = 0; i < pts.size(); ++i)
+	{
+		float expected = closure(pts[i]);
+		float tolerance = 1e-3f*(1 + std::abs(expected));
+		worst = std::max(worst, std::max(std::abs(graph(pts[i]) - expected), std::abs(batch[i] - expected))/tolerance);
+	}
+	return assertLess_UT(worst, 1);
+}
+
+
+inline UnitTestResult funcTests__all()
+{
+	UnitTestResult result;
+	result.runTest(exprTapeMatchesClosuresTest);
+	result.runTest(exprTapeCommonSubexpressionTest);
+	result.runTest(graphBackedCompositionTest);
+	result.runTest(exprTapeBatchMatchesClosuresTest);
+	return result;
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include "unittests.hpp"
+#include "../engine/instancing.hpp"
+#include "../engine/specific.hpp"
+#include "../utils/logging.hpp"
+
+
+// GL calls replaced by records of the buffers, attribute pointers and draws
+struct RecordedInstanceCalls {
+	int buffers = 0, draws = 0;
+	size_t uploadedBytes = 0;
+	GLsizei lastIndexCount = 0, lastInstanceCount = 0;
+	vector<ivec3> attributes;  // location, stride, offset
+	vector<GLuint> enabled;
+
+	InstanceCalls calls() {
+		InstanceCalls c;
+		c.createBuffer = [this] { return (GLuint)++buffers; };
+		c.bufferData = [this](GLuint, GLsizeiptr bytes, const void *) { uploadedBytes += bytes; };
+		c.bufferSubData = [this](GLuint, GLintptr, GLsizeiptr bytes, const void *) { uploadedBytes += bytes; };
+		c.instanceAttribute = [this](GLuint, GLuint location, GLsizei stride, GLintptr offset) {
+			attributes.emplace_back(location, stride, offset);
+			enabled.push_back(location);
+		};
+		c.disableAttribute = [this](GLuint location) { std::erase(enabled, location); };
+		c.drawInstanced = [this](GLsizei indexCount, GLsizei instanceCount) {
+			++draws;
+			lastIndexCount = indexCount;
+			lastInstanceCount = instanceCount;
+		};
+		c.deleteBuffer = [](GLuint) {};
+		return c;
+	}
+};
+
+
+inline bool instanceTableUploadsTest()
+{
+	bool passed = true;
+	const int n = 100000;
+	RecordedInstanceCalls gl;
+	InstanceBuffers buffers(gl.calls());
+	InstanceTable table({INSTANCE_OFFSET, INSTANCE_COLOR}, n);
+	for (int i = 0; i < n; i++)
+		table.setOffset(i, vec3(i, 0, 0), .1f);
+
+	buffers.load(table);
+	buffers.draw(table, 60);
+	passed &= assertEqual_UT(gl.draws, 1);
+	passed &= assertEqual_UT((int)gl.lastInstanceCount, n);
+	passed &= assertEqual_UT((int)gl.lastIndexCount, 60);
+	passed &= assertEqual_UT(gl.uploadedBytes, (size_t)n*2*sizeof(vec4));
+	passed &= assertEqual_UT(gl.attributes.size(), (size_t)2);
+	passed &= assertTrue_UT(gl.attributes[0] == ivec3(9, 16, 0));
+	passed &= assertTrue_UT(gl.attributes[1] == ivec3(13, 16, 0));
+	passed &= assertTrue_UT(gl.enabled.empty());
+
+	// unchanged table, nothing is transferred
+	gl.uploadedBytes = 0;
+	buffers.load(table);
+	passed &= assertEqual_UT(gl.uploadedBytes, (size_t)0);
+
+	// moving a thousand instances sends only their offsets
+	for (int i = 5000; i < 6000; i++)
+		table.setOffset(i, vec3(0, i, 0), .1f);
+	buffers.resetUploadStatistics();
+	buffers.load(table);
+	passed &= assertEqual_UT(gl.uploadedBytes, (size_t)1000*sizeof(vec4));
+	passed &= assertEqual_UT(buffers.uploadStatistics().uploadCalls(), 1);
+	passed &= assertEqual_UT(buffers.uploadStatistics().respecifiedBuffers(), 0);
+
+	table.resize(n + 1);
+	buffers.resetUploadStatistics();
+	buffers.load(table);
+	passed &= assertEqual_UT(buffers.uploadStatistics().respecifiedBuffers(), 2);
+	passed &= assertTrue_UT(table.get(INSTANCE_OFFSET, n) == vec4(0, 0, 0, 1));
+	passed &= assertEqual_UT(gl.buffers, 2);
+	return passed;
+}
+
+
+// two sets of buffers drawing the same table, e.g. in two rendering steps, both have to follow every change
+inline bool instanceTableSharedByBuffersTest()
+{
+	bool passed = true;
+	const int n = 10000;
+	RecordedInstanceCalls firstGL, secondGL;
+	InstanceBuffers first(firstGL.calls()), second(secondGL.calls());
+	InstanceTable table({INSTANCE_OFFSET, INSTANCE_COLOR}, n);
+	first.load(table);
+	second.load(table);
+	passed &= assertEqual_UT(secondGL.uploadedBytes, (size_t)n*2*sizeof(vec4));
+
+	firstGL.uploadedBytes = secondGL.uploadedBytes = 0;
+	for (int i = 100; i < 200; i++)
+		table.setOffset(i, vec3(i, 1, 0));
+	first.load(table);
+	second.load(table);
+	passed &= assertEqual_UT(firstGL.uploadedBytes, (size_t)100*sizeof(vec4));
+	passed &= assertEqual_UT(secondGL.uploadedBytes, (size_t)100*sizeof(vec4));
+
+	// the second one skips a frame and gets the changes of both
+	firstGL.uploadedBytes = secondGL.uploadedBytes = 0;
+	second.resetUploadStatistics();
+	table.setColor(7, vec4(1, 0, 0, 1));
+	first.load(table);
+	table.setColor(9000, vec4(0, 1, 0, 1));
+	first.load(table);
+	second.load(table);
+	passed &= assertEqual_UT(firstGL.uploadedBytes, (size_t)2*sizeof(vec4));
+	passed &= assertEqual_UT(secondGL.uploadedBytes, (size_t)2*sizeof(vec4));
+	passed &= assertEqual_UT(second.uploadStatistics().uploadCalls(), 2);
+	passed &= assertEqual_UT(second.uploadStatistics().respecifiedBuffers(), 0);
+	return passed;
+}
+
+
+inline bool instanceTransformLayoutTest()
+{
+	bool passed = true;
+	RecordedInstanceCalls gl;
+	InstanceBuffers buffers(gl.calls());
+	InstanceTable table({INSTANCE_TRANSFORM, INSTANCE_COLOR, INSTANCE_EXTRA1}, 10);
+	buffers.load(table);
+	buffers.draw(table, 3);
+	passed &= assertEqual_UT(gl.uploadedBytes, (size_t)10*(sizeof(mat4) + 2*sizeof(vec4)));
+	vector<ivec3> expected = {ivec3(9, 64, 0), ivec3(10, 64, 16), ivec3(11, 64, 32), ivec3(12, 64, 48), ivec3(13, 16, 0), ivec3(15, 16, 0)};
+	passed &= assertEqual_UT(gl.attributes.size(), expected.size());
+	for (int i = 0; i < expected.size(); i++)
+		passed &= assertTrue_UT(gl.attributes[i] == expected[i]);
+
+	bool threw = false;
+	try { table.setOffset(0, vec3(1)); }
+	catch (const ValueError &) { threw = true; }
+	passed &= assertEqual_UT(threw, true);
+
+	threw = false;
+	try { InstanceTable({INSTANCE_TRANSFORM, INSTANCE_OFFSET}); }
+	catch (const IllegalArgumentError &) { threw = true; }
+	passed &= assertEqual_UT(threw, true);
+	return passed;
+}
+
+
+inline bool instancedArrowsTest()
+{
+	bool passed = true;
+	const int n = 100000;
+	vector<vec3> points;
+	for (int i = 0; i < n; i++)
+		points.emplace_back(i % 100, i / 100 % 100, i / 10000);
+	auto rotation = VectorField([](vec3 p) { return vec3(-p.y, p.x, 1); }, .01f);
+	auto len = [](float s) { return .5f*s; };
+	auto radius = [](float s) { return .01f; };
+	auto arrows = instancedVectorFieldArrows(rotation, points, len, radius, .2f, 2, 5, 5, .01f);
+
+	for (int i = 0; i < n; i += 997) {
+		vec3 f = rotation(points[i]);
+		vec3 head = vec3(arrows.instances().transform(i)*vec4(0, 0, 1, 1));
+		passed &= assertLessOrEqual_UT(norm(head - points[i] - .5f*f), 1e-3f*norm(f));
+	}
+
+	RecordedInstanceCalls gl;
+	InstanceBuffers buffers(gl.calls());
+	buffers.load(arrows.instances());
+	buffers.draw(arrows.instances(), *arrows.getShape());
+	passed &= assertEqual_UT(gl.draws, 1);
+	passed &= assertEqual_UT((int)gl.lastInstanceCount, n);
+	// one index per face corner, not the byte size of the index buffer
+	passed &= assertEqual_UT((int)gl.lastIndexCount, arrows.getShape()->bufferIndexLength()*3);
+
+	// a new field rewrites the transforms only, the template mesh and colours stay on the GPU
+	gl.uploadedBytes = 0;
+	updateVectorFieldArrows(arrows.instances(), VectorField([](vec3 p) { return vec3(1, 0, 0); }, .01f), points, len, radius);
+	buffers.load(arrows.instances());
+	passed &= assertEqual_UT(gl.uploadedBytes, (size_t)n*sizeof(mat4));
+	return passed;
+}
+
+
+inline UnitTestResult instancingTests__all()
+{
+	UnitTestResult result;
+	result.runTest(instanceTableUploadsTest);
+	result.runTest(instanceTableSharedByBuffersTest);
+	result.runTest(instanceTransformLayoutTest);
+	result.runTest(instancedArrowsTest);
+	return result;
+}
@@ -0,0 +1,197 @@
+#pragma once
+#include <chrono>
+#include <thread>
+#include "unittests.hpp"
+#include "../utils/jobSystem.hpp"
+#include "../utils/parallel.hpp"
+#include "../utils/exceptions.hpp"
+
+using namespace glm;
+
+
+inline bool parallelLoopsCoverEveryIndexOnceTest()
+{
+	bool passed = true;
+	JobSystem jobs(4);
+	passed &= assertEqual_UT(jobs.threads(), 4);
+
+	int n = 100000;
+	vector<std::atomic<int>> hits(n);
+	jobs.parallelFor(n, [&](int i) { hits[i].fetch_add(1); });
+	bool once = true;
+	for (int i = 0; i < n; ++i)
+		once &= hits[i].load() == 1;
+	passed &= assertTrue_UT(once);
+
+	// chunks start at multiples of the grain and never exceed it
+	std::atomic<int> covered = 0, misaligned = 0;
+	jobs.parallelForRange(1000, [&](int begin, int end) {
+		if (begin % 7 != 0 || end - begin > 7 || end - begin < 1)
+			misaligned.fetch_add(1);
+		covered.fetch_add(end - begin);
+	}, 7);
+	passed &= assertEqual_UT(covered.load(), 1000);
+	passed &= assertEqual_UT(misaligned.load(), 0);
+
+	// loops nested in jobs help instead of blocking the workers
+	std::atomic<long> sum = 0;
+	jobs.parallelFor(16, [&](int i) {
+		jobs.parallelFor(1000, [&](int j) { sum.fetch_add(i*1000 + j); }, 10);
+	}, 1);
+	passed &= assertEqual_UT(sum.load(), 16000l*15999/2);
+
+	bool threw = false;
+	try { jobs.parallelFor(1000, [](int i) { if (i == 617) THROW(ValueError, "job 617"); }); }
+	catch (const ValueError &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+
+	// the engine helpers run on the global system
+	vector<int> squares(500);
+	parallelFor(500, 4, [&](int k) { squares[k] = k*k; });
+	WorkerPool pool(4);
+	std::atomic<int> poolCovered = 0;
+	pool.forRange(500, 16, [&](int begin, int end) { poolCovered.fetch_add(end - begin); });
+	passed &= assertEqual_UT(squares[499], 499*499);
+	passed &= assertEqual_UT(poolCovered.load(), 500);
+	return passed;
+}
+
+
+// a thread count below the size of the job system bounds the calls running at once
+inline bool threadCountLimitsConcurrencyTest()
+{
+	bool passed = true;
+	int previous = JobSystem::global().threads();
+	JobSystem::configureGlobal(4);
+	std::atomic<int> active = 0, peak = 0, covered = 0;
+	auto enter = [&](int items) {
+		int now = active.fetch_add(1) + 1;
+		for (int seen = peak.load(); now > seen && !peak.compare_exchange_weak(seen, now);) {}
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+		covered.fetch_add(items);
+		active.fetch_sub(1);
+	};
+
+	parallelFor(64, 2, [&](int) { enter(1); });
+	passed &= assertEqual_UT(covered.load(), 64);
+	passed &= assertLessOrEqual_UT(peak.load(), 2);
+
+	covered = 0;
+	peak = 0;
+	WorkerPool pool(3);
+	pool.forRange(1000, 10, [&](int begin, int end) { enter(end - begin); });
+	passed &= assertEqual_UT(covered.load(), 1000);
+	passed &= assertLessOrEqual_UT(peak.load(), 3);
+
+	JobSystem::configureGlobal(previous);
+	return passed;
+}
+
+
+inline bool futuresAndTaskGraphsTest()
+{
+	bool passed = true;
+	JobSystem jobs(4);
+
+	auto answer = jobs.async([] { return 6*7; });
+	std::atomic<int> sideEffect = 0;
+	auto done = jobs.async([&] { sideEffect = 1; });
+	auto failed = jobs.async([]() -> int { THROW(ValueError, "failed job"); });
+	passed &= assertEqual_UT(answer.get(), 42);
+	done.get();
+	passed &= assertEqual_UT(sideEffect.load(), 1);
+	bool threw = false;
+	try { failed.get(); }
+	catch (const ValueError &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+
+	// diamond a -> (b, c) -> d, every task sees the results of its dependencies
+	std::atomic<int> a = 0, b = 0, c = 0, d = 0;
+	TaskGraph graph;
+	int ta = graph.add([&] { a = 1; });
+	int tb = graph.add([&] { b = a + 1; }, {ta});
+	int tc = graph.add([&] { c = a + 2; }, {ta});
+	graph.add([&] { d = b*c; }, {tb, tc});
+	for (int run = 0; run < 20; ++run) {
+		a = b = c = d = 0;
+		graph.run(jobs);
+		passed &= assertEqual_UT(d.load(), 6);
+	}
+
+	// a chain of 1000 tasks keeps its order
+	TaskGraph chain;
+	vector<int> order;
+	for (int i = 0; i < 1000; ++i)
+		chain.add([&order, i] { order.push_back(i); }, i > 0 ? vector<int>{i - 1} : vector<int>{});
+	chain.run(jobs);
+	bool sorted = order.size() == 1000;
+	for (int i = 0; sorted && i < 1000; ++i)
+		sorted &= order[i] == i;
+	passed &= assertTrue_UT(sorted);
+
+	// a failing task skips what depends on it but not the other branch
+	TaskGraph failing;
+	std::atomic<int> skipped = 0, other = 0;
+	int bad = failing.add([] { THROW(ValueError, "failed task"); });
+	failing.add([&] { skipped = 1; }, {bad});
+	failing.add([&] { other = 1; });
+	threw = false;
+	try { failing.run(jobs); }
+	catch (const ValueError &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+	passed &= assertEqual_UT(skipped.load(), 0);
+	passed &= assertEqual_UT(other.load(), 1);
+
+	TaskGraph cycle;
+	int x = cycle.add([] {});
+	int y = cycle.add([] {}, {x});
+	cycle.precede(y, x);
+	threw = false;
+	try { cycle.run(jobs); }
+	catch (const IllegalArgumentError &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+	return passed;
+}
+
+
+inline bool serialModeIsDeterministicTest()
+{
+	bool passed = true;
+	JobSystem serial(1);
+	passed &= assertTrue_UT(serial.serial());
+
+	vector<int> chunks;
+	serial.parallelForRange(100, [&](int begin, int end) { chunks.push_back(begin); }, 10);
+	passed &= assertEqual_UT(chunks.size(), 10);
+	bool ascending = true;
+	for (int k = 0; k < (int)chunks.size(); ++k)
+		ascending &= chunks[k] == 10*k;
+	passed &= assertTrue_UT(ascending);
+
+	// jobs run when submitted
+	auto future = serial.async([] { return 3; });
+	passed &= assertTrue_UT(future.ready());
+	passed &= assertEqual_UT(future.get(), 3);
+
+	// ready tasks run in insertion order
+	vector<int> order;
+	TaskGraph graph;
+	int a = graph.add([&] { order.push_back(0); });
+	int b = graph.add([&] { order.push_back(1); });
+	graph.add([&] { order.push_back(2); }, {b});
+	graph.add([&] { order.push_back(3); }, {a});
+	graph.run(serial);
+	passed &= assertTrue_UT(order == vector<int>({0, 1, 3, 2}));
+	return passed;
+}
+
+
+inline UnitTestResult jobSystemTests__all()
+{
+	UnitTestResult result;
+	result.runTest(parallelLoopsCoverEveryIndexOnceTest);
+	result.runTest(threadCountLimitsConcurrencyTest);
+	result.runTest(futuresAndTaskGraphsTest);
+	result.runTest(serialModeIsDeterministicTest);
+	return result;
+}
@@ -0,0 +1,744 @@
+#pragma once
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "unittests.hpp"
+#include "allocationCounter.hpp"
+#include "../engine/indexedRendering.hpp"
+#include "../engine/specific.hpp"
+#include "../geometry/marchingCubes.hpp"
+#include "../geometry/smoothImplicit.hpp"
+
+using namespace glm;
+
+
+inline IndexedMesh gridPolygroupsMesh(int n, int groups)
+{
+	IndexedMesh mesh = IndexedMesh();
+	for (int g = 0; g < groups; ++g)
+	{
+		vector<Vertex> verts;
+		vector<ivec3> faces;
+		for (int i = 0; i < n; ++i)
+			for (int j = 0; j < n; ++j)
+				verts.emplace_back(vec3(i, j, g), vec2(1.f*i/n, 1.f*j/n));
+		for (int i = 0; i < n-1; ++i)
+			for (int j = 0; j < n-1; ++j)
+			{
+				faces.emplace_back(i*n + j, (i+1)*n + j, i*n + j+1);
+				faces.emplace_back((i+1)*n + j, (i+1)*n + j+1, i*n + j+1);
+			}
+		mesh.addNewPolygroup(verts, faces, g);
+	}
+	return mesh;
+}
+
+// OBJ of an n x n grid of quads split into triangles, with per-vertex uvs and normals when full
+inline string objGridText(int n, bool full)
+{
+	string text;
+	text.reserve(n*n*(full ? 120 : 60));
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < n; ++j)
+			text += std::format("v {} {} {}\n", .01f*i, .01f*j, .1f*sin(.1f*i)*cos(.07f*j));
+	if (full)
+	{
+		for (int i = 0; i < n; ++i)
+			for (int j = 0; j < n; ++j)
+				text += std::format("vt {} {}\n", 1.f*i/n, 1.f*j/n);
+		for (int i = 0; i < n; ++i)
+			for (int j = 0; j < n; ++j)
+				text += std::format("vn {} {} {}\n", 0, 0, 1);
+	}
+	for (int i = 0; i < n-1; ++i)
+		for (int j = 0; j < n-1; ++j)
+		{
+			int a = i*n + j + 1, b = (i+1)*n + j + 1, c = i*n + j + 2, d = (i+1)*n + j + 2;
+			if (full)
+				text += std::format("f {0}/{0}/{0} {1}/{1}/{1} {2}/{2}/{2}\nf {1}/{1}/{1} {3}/{3}/{3} {2}/{2}/{2}\n", a, b, c, d);
+			else
+				text += std::format("f {} {} {} {}\n", a, b, d, c);
+		}
+	return text;
+}
+
+// GPU side of one RenderingStep, reduced to allocated sizes and the generations its buffers were uploaded at
+struct SimulatedStepBuffers {
+	std::map<CommonBufferType, size_t> allocated;
+	std::map<CommonBufferType, unsigned long> generation;
+};
+
+// one frame of RenderingStep::loadMeshAttributes + loadElementBuffer
+inline void simulateUploadFrame(BufferManager &boss, SimulatedStepBuffers &step, BufferUploadLog &log)
+{
+	for (CommonBufferType type : {POSITION, NORMAL, UV, COLOR, INDEX})
+		for (const auto &u : boss.collectUploads(type, step.allocated[type], step.generation[type], &log))
+			if (u.respecify)
+				step.allocated[type] = u.size;
+}
+
+
+inline bool dirtyRangesMergeTest()
+{
+	bool passed = true;
+	DirtyRanges d;
+	passed &= assertTrue_UT(d.wholeBuffer());
+	d.clear();
+	passed &= assertTrue_UT(d.empty());
+
+	for (int i = 10; i < 20; ++i)
+		d.mark(i);
+	passed &= assertEqual_UT(d.getRanges().size(), 1);
+	d.mark(30, 40);
+	d.mark(0, 5);
+	passed &= assertEqual_UT(d.getRanges().size(), 3);
+	passed &= assertEqual_UT(d.dirtyElements(), 25);
+	d.mark(5, 10);
+	passed &= assertEqual_UT(d.getRanges().size(), 2);
+	passed &= assertEqual_UT(d.getRanges()[0], ivec2(0, 20));
+
+	// two ranges so far, one more than MAX_RANGES collapses everything into the hull
+	for (int i = 0; i < DirtyRanges::MAX_RANGES - 1; ++i)
+		d.mark(100 + 3*i);
+	passed &= assertEqual_UT(d.getRanges().size(), 1);
+	passed &= assertEqual_UT(d.getRanges()[0], ivec2(0, 100 + 3*(DirtyRanges::MAX_RANGES - 2) + 1));
+	return passed;
+}
+
+
+inline bool staticMeshUploadsOnceTest()
+{
+	bool passed = true;
+	IndexedMesh mesh = gridPolygroupsMesh(20, 3);
+	BufferManager &boss = mesh.getBufferBoss();
+	SimulatedStepBuffers step;
+	BufferUploadLog log;
+
+	simulateUploadFrame(boss, step, log);
+	size_t expected = 0;
+	for (CommonBufferType type : {POSITION, NORMAL, UV, COLOR, INDEX})
+		expected += boss.bufferSize(type);
+	passed &= assertEqual_UT(log.totalBytes(), expected);
+	passed &= assertEqual_UT(log.respecifiedBuffers(), 5);
+
+	for (int frame = 0; frame < 10; ++frame)
+	{
+		log.reset();
+		simulateUploadFrame(boss, step, log);
+		passed &= assertEqual_UT(log.totalBytes(), 0);
+		passed &= assertEqual_UT(log.uploadCalls(), 0);
+	}
+	return passed;
+}
+
+
+inline bool deformedPolygroupUploadsOnlyItsRangeTest()
+{
+	bool passed = true;
+	int n = 20;
+	IndexedMesh mesh = gridPolygroupsMesh(n, 3);
+	BufferManager &boss = mesh.getBufferBoss();
+	SimulatedStepBuffers step;
+	BufferUploadLog log;
+	simulateUploadFrame(boss, step, log);
+
+	log.reset();
+	mesh.deformPerVertex(1, [](BufferedVertex &v) { v.setPosition(v.getPosition() + vec3(0, 0, 1)); });
+	passed &= assertTrue_UT(boss.isDirty(POSITION, step.generation[POSITION]));
+	passed &= assertFalse_UT(boss.isDirty(NORMAL, step.generation[NORMAL]));
+	simulateUploadFrame(boss, step, log);
+	passed &= assertEqual_UT(log.bytes(POSITION), n*n*sizeof(vec3));
+	passed &= assertEqual_UT(log.totalBytes(), n*n*sizeof(vec3));
+	passed &= assertEqual_UT(log.respecifiedBuffers(), 0);
+
+	// touching most of a buffer orphans it instead of writing many ranges
+	log.reset();
+	mesh.deformPerVertex([](BufferedVertex &v) { v.setColor(.5f, 3); });
+	auto uploads = boss.collectUploads(COLOR, step.allocated[COLOR], step.generation[COLOR], &log);
+	passed &= assertEqual_UT(uploads.size(), 1);
+	passed &= assertTrue_UT(uploads[0].respecify);
+	passed &= assertEqual_UT(log.bytes(COLOR), boss.bufferSize(COLOR));
+
+	// growing the mesh changes buffer sizes, so everything is respecified
+	log.reset();
+	mesh.addNewPolygroup({Vertex(vec3(0), vec2(0)), Vertex(vec3(1), vec2(0)), Vertex(vec3(2), vec2(0))}, {ivec3(0, 1, 2)}, 3);
+	simulateUploadFrame(boss, step, log);
+	passed &= assertEqual_UT(log.respecifiedBuffers(), 5);
+	return passed;
+}
+
+
+// a mesh drawn by two rendering steps, each has to receive every write however the uploads of the other interleave
+inline bool sharedMeshUploadsToEveryStepTest()
+{
+	bool passed = true;
+	int n = 20;
+	IndexedMesh mesh = gridPolygroupsMesh(n, 4);
+	BufferManager &boss = mesh.getBufferBoss();
+	SimulatedStepBuffers first, second;
+	BufferUploadLog firstLog, secondLog;
+	simulateUploadFrame(boss, first, firstLog);
+	simulateUploadFrame(boss, second, secondLog);
+	passed &= assertEqual_UT(firstLog.totalBytes(), secondLog.totalBytes());
+
+	firstLog.reset();
+	secondLog.reset();
+	mesh.deformPerVertex(1, [](BufferedVertex &v) { v.setPosition(v.getPosition() + vec3(0, 0, 1)); });
+	simulateUploadFrame(boss, first, firstLog);
+	simulateUploadFrame(boss, second, secondLog);
+	passed &= assertEqual_UT(firstLog.bytes(POSITION), n*n*sizeof(vec3));
+	passed &= assertEqual_UT(secondLog.bytes(POSITION), n*n*sizeof(vec3));
+	passed &= assertEqual_UT(secondLog.totalBytes(), n*n*sizeof(vec3));
+
+	// the second step skips a frame and catches up with the writes of both
+	firstLog.reset();
+	secondLog.reset();
+	mesh.deformPerVertex(0, [](BufferedVertex &v) { v.setPosition(v.getPosition() + vec3(0, 0, 1)); });
+	simulateUploadFrame(boss, first, firstLog);
+	mesh.deformPerVertex(2, [](BufferedVertex &v) { v.setPosition(v.getPosition() + vec3(0, 0, 1)); });
+	simulateUploadFrame(boss, first, firstLog);
+	simulateUploadFrame(boss, second, secondLog);
+	passed &= assertEqual_UT(firstLog.bytes(POSITION), 2*n*n*sizeof(vec3));
+	passed &= assertEqual_UT(secondLog.bytes(POSITION), 2*n*n*sizeof(vec3));
+	passed &= assertEqual_UT(secondLog.respecifiedBuffers(), 0);
+
+	// one lagging behind more generations than are kept gets the whole buffer
+	secondLog.reset();
+	for (int frame = 0; frame <= DirtyHistory::MAX_GENERATIONS; ++frame) {
+		mesh.deformPerVertex(1, [](BufferedVertex &v) { v.setPosition(v.getPosition() + vec3(0, 0, .1f)); });
+		simulateUploadFrame(boss, first, firstLog);
+	}
+	simulateUploadFrame(boss, second, secondLog);
+	passed &= assertEqual_UT(secondLog.bytes(POSITION), boss.bufferSize(POSITION));
+
+	firstLog.reset();
+	secondLog.reset();
+	simulateUploadFrame(boss, first, firstLog);
+	simulateUploadFrame(boss, second, secondLog);
+	passed &= assertEqual_UT(firstLog.totalBytes() + secondLog.totalBytes(), 0);
+	return passed;
+}
+
+
+inline bool polygroupViewsTest()
+{
+	static_assert(std::random_access_iterator<PolygroupVertices::iterator>);
+	bool passed = true;
+	int n = 10;
+	IndexedMesh mesh = gridPolygroupsMesh(n, 3);
+	PolygroupVertices vertices = mesh.vertexView(1);
+	PolygroupTriangles triangles = mesh.triangleView(1);
+	vector<Vertex> copied = mesh.getVertices(1);
+	vector<ivec3> faces = mesh.getIndices(1);
+
+	passed &= assertEqual_UT(vertices.size(), n*n, (int)copied.size(), (int)(vertices.end() - vertices.begin()));
+	passed &= assertEqual_UT(vertices.firstIndex(), mesh.getBufferedVertices(1).front().getIndex(), n*n);
+	passed &= assertEqual_UT(vertices[5].getIndex(), vertices.firstIndex() + 5);
+	int i = 0;
+	for (const BufferedVertex &v: vertices)
+		passed &= assertNearlyEqual_UT(v.getPosition(), copied[i++].getPosition());
+	passed &= assertEqual_UT(triangles.size(), (int)faces.size());
+	for (int t = 0; t < faces.size(); t++)
+		passed &= assertTrue_UT(triangles[t].getVertexIndices() == faces[t]);
+
+	// views read the buffers, writes through proxies are seen by every view and adding polygroups keeps them valid
+	std::ranges::for_each(vertices, [](BufferedVertex v) { v.setColor(.25f, 3); });
+	mesh.addNewPolygroup({Vertex(vec3(0), vec2(0)), Vertex(vec3(1), vec2(0)), Vertex(vec3(2), vec2(0))}, {ivec3(0, 1, 2)}, 3);
+	passed &= assertNearlyEqual_UT(vertices.back().getColor().w, .25f);
+	passed &= assertEqual_UT(mesh.vertexView(3).firstIndex(), 3*n*n);
+	passed &= assertTrue_UT(mesh.triangleView(3).front().getVertexIndices() == ivec3(3*n*n, 3*n*n + 1, 3*n*n + 2));
+
+	// copies own their buffers
+	IndexedMesh copy = IndexedMesh(mesh);
+	copy.shift(vec3(1), 1);
+	passed &= assertNearlyEqual_UT(mesh.vertexView(1)[0].getPosition(), copied[0].getPosition());
+	passed &= assertNearlyEqual_UT(copy.vertexView(1)[0].getPosition(), copied[0].getPosition() + vec3(1));
+	return passed;
+}
+
+
+// the views read the buffers in place, so a full traversal makes no heap allocations
+inline bool polygroupViewsDoNotAllocateTest()
+{
+	bool passed = true;
+	IndexedMesh mesh = gridPolygroupsMesh(300, 2);
+	PolyGroupID id = 1;
+	vec3 positions = vec3(0), expectedPositions = vec3(0);
+	ivec3 indices = ivec3(0), expectedIndices = ivec3(0);
+	for (const Vertex &v: mesh.getVertices(id))
+		expectedPositions += v.getPosition();
+	for (ivec3 f: mesh.getIndices(id))
+		expectedIndices ^= f;
+
+	size_t before = threadAllocations();
+	for (const BufferedVertex &v: mesh.vertexView(id))
+		positions += v.getPosition();
+	for (const IndexedTriangle &t: mesh.triangleView(id))
+		indices ^= t.getVertexIndices();
+	size_t allocations = threadAllocations() - before;
+
+	passed &= assertEqual_UT(allocations, (size_t)0);
+	passed &= assertTrue_UT(positions == expectedPositions);
+	passed &= assertTrue_UT(indices == expectedIndices);
+	return passed;
+}
+
+
+inline bool adjacencyMatchesBruteForceTest()
+{
+	bool passed = true;
+	int n = 8;
+	IndexedMesh mesh = gridPolygroupsMesh(n, 2);
+	int shift = mesh.getBufferedVertices(1).front().getIndex();
+	vector<ivec3> faces = mesh.getIndices(1);
+
+	for (int i = 0; i < n*n; ++i)
+	{
+		std::set<int> neighbours, parents;
+		for (int t = 0; t < faces.size(); ++t)
+			for (int k = 0; k < 3; ++k)
+				if (faces[t][k] - shift == i)
+				{
+					parents.insert(t);
+					neighbours.insert(faces[t][(k+1)%3] - shift);
+					neighbours.insert(faces[t][(k+2)%3] - shift);
+				}
+		passed &= assertTrue_UT(mesh.findVertexNeighbours(i, 1) == vector(neighbours.begin(), neighbours.end()));
+		passed &= assertTrue_UT(mesh.findVertexParentTriangles(i, 1) == vector(parents.begin(), parents.end()));
+
+		int x = i / n, y = i % n;
+		bool interior = x > 0 && y > 0 && x < n-1 && y < n-1;
+		passed &= assertEqual_UT(mesh.checkIfHasCompleteNeighbourhood(i, 1), interior);
+	}
+
+	const MeshAdjacency &adj = mesh.adjacency(1);
+	passed &= assertEqual_UT(adj.edgeOpposites(n+1, n+2).size(), 2);
+	passed &= assertEqual_UT(adj.edgeOpposites(0, 1).size(), 1);
+	passed &= assertTrue_UT(adj.edgeOpposites(0, 2).empty());
+
+	// rewiring a face has to be visible in the next query
+	mesh.getTriangles(1)[0].setVertexIndices(ivec3(shift, shift + n*n - 1, shift + 1));
+	auto nb = mesh.findVertexNeighbours(0, 1);
+	passed &= assertTrue_UT(std::ranges::find(nb, n*n - 1) != nb.end());
+	return passed;
+}
+
+
+inline bool recalculateNormalsOnLargeMeshTest()
+{
+	bool passed = true;
+	int n = 300;
+	IndexedMesh mesh = gridPolygroupsMesh(n, 1);
+	mesh.deformPerVertex([](BufferedVertex &v) { v.setNormal(vec3(1, 0, 0)); });
+
+	mesh.recalculateNormals();
+	for (const Vertex &v : mesh.getVertices(0))
+		passed &= assertNearlyEqual_UT(v.getNormal(), vec3(0, 0, 1));
+	return passed;
+}
+
+
+inline bool marchingCubesWatertightTest()
+{
+	bool passed = true;
+	float r = .7f;
+	auto sphere = make_shared<SmoothImplicitSurface>([r](vec3 p) { return r*r - dot(p, p); });
+	auto chunk = MarchingCubeChunk(vec3(-1), vec3(1), ivec3(30, 27, 33), sphere);
+	IndexedMesh mesh = chunk.generateMesh(false);
+	auto verts = mesh.getVertices(chunk.getID());
+	auto faces = mesh.getIndices(chunk.getID());
+	passed &= assertLess_UT(0, faces.size());
+
+	// interpolated vertices lie close to the surface, edge midpoints would be off by up to half a cell
+	for (const Vertex &v : verts)
+		passed &= assertLess_UT(abs(length(v.getPosition()) - r), 2e-3f);
+
+	// closed sphere: every directed edge appears once and its reverse once, faces point to f > 0, i.e. inwards
+	std::map<pair<int, int>, int> edges;
+	for (ivec3 f : faces)
+	{
+		for (int k = 0; k < 3; ++k)
+			edges[{f[k], f[(k+1)%3]}]++;
+		vec3 a = verts[f.x].getPosition(), b = verts[f.y].getPosition(), c = verts[f.z].getPosition();
+		passed &= assertLess_UT(dot(cross(b - a, c - a), a + b + c), 0.f);
+	}
+	for (const auto &[e, count] : edges)
+		passed &= assertTrue_UT(count == 1 && edges.contains({e.second, e.first}));
+
+	auto single = marchingCubes([r](vec3 p) { return r*r - dot(p, p); }, vec3(-1), vec3(1), ivec3(30, 27, 33), 0, 1);
+	auto multi = marchingCubes([r](vec3 p) { return r*r - dot(p, p); }, vec3(-1), vec3(1), ivec3(30, 27, 33), 0, 4);
+	passed &= assertTrue_UT(single.positions == multi.positions && single.triangles == multi.triangles);
+	passed &= assertEqual_UT(single.triangles.size(), faces.size());
+	return passed;
+}
+
+
+inline bool objImportTest()
+{
+	bool passed = true;
+	string text =
+		"# quad, pentagon and a triangle with relative indices\r\n"
+		"v 0 0 0\r\nv 1 0 0\r\nv 1 1 0\r\nv 0 1 0\r\nv 2 .5 0\r\n"
+		"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+		"vn 0 0 1\nvn 0 0 -1\n"
+		"o something\ns off\n"
+		"f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+		"f 1//2 2//2 5//2 3//2 4//2 # comment\n"
+		"  f -5/1/1 -4/2/1 -1//2\n";
+	OBJData data = parseOBJ(text, 1);
+	passed &= assertTrue_UT(data.hasNormals && data.hasUVs);
+	passed &= assertEqual_UT(data.faces.size(), 6);
+	// positions 1-4 with normal 1 come first, 1-4 with normal 2 are appended, 5 only appears with normal 2
+	passed &= assertEqual_UT(data.positions.size(), 9);
+	passed &= assertTrue_UT(data.faces[0] == ivec3(0, 1, 2) && data.faces[1] == ivec3(0, 2, 3));
+	passed &= assertTrue_UT(data.faces[2] == ivec3(5, 6, 4) && data.faces[5] == ivec3(0, 1, 4));
+	passed &= assertNearlyEqual_UT(data.positions[4], vec3(2, .5, 0));
+	passed &= assertNearlyEqual_UT(data.normals[4], vec3(0, 0, -1));
+	passed &= assertNearlyEqual_UT(data.positions[7], vec3(1, 1, 0));
+	passed &= assertNearlyEqual_UT(data.uvs[2], vec2(1, 1));
+	passed &= assertNearlyEqual_UT(data.uvs[7], vec2(0, 0));
+
+	OBJData plain = parseOBJ("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n", 1);
+	passed &= assertFalse_UT(plain.hasNormals);
+	passed &= assertNearlyEqual_UT(plain.normals[1], vec3(0, 0, 1));
+
+	bool thrown = false;
+	try { parseOBJ("v 0 0 0\nf 1 2 3\n", 1); } catch (const ValueError &) { thrown = true; }
+	passed &= assertTrue_UT(thrown);
+
+	string grid = objGridText(200, true);
+	OBJData single = parseOBJ(grid, 1);
+	OBJData multi = parseOBJ(grid, 8);
+	passed &= assertEqual_UT(single.faces.size(), 2*199*199);
+	passed &= assertTrue_UT(single.faces == multi.faces && single.positions == multi.positions && single.normals == multi.normals && single.uvs == multi.uvs);
+
+	// index buffer holds indices shifted past the 9 vertices of the first polygroup
+	IndexedMesh mesh = gridPolygroupsMesh(3, 1);
+	mesh.addNewPolygroup(single, "grid");
+	passed &= assertEqual_UT(mesh.getIndices("grid").size(), single.faces.size());
+	passed &= assertTrue_UT(mesh.getIndices("grid")[7] == single.faces[7] + ivec3(9));
+	passed &= assertNearlyEqual_UT(mesh.getVertices("grid")[250].getPosition(), single.positions[250]);
+	return passed;
+}
+
+
+inline bool meshBinaryCacheRoundTripTest()
+{
+	bool passed = true;
+	IndexedMesh mesh = gridPolygroupsMesh(20, 3);
+	mesh.addNewPolygroup(parseOBJ(objGridText(10, false), 1), "obj");
+	Path path = filesystem::temp_directory_path() / "meshCacheRoundTrip.meshcache";
+	mesh.saveBinaryCache(path);
+
+	// caches are only ever read, shipped ones may well be read-only
+	filesystem::permissions(path, filesystem::perms::owner_read, filesystem::perm_options::replace);
+	IndexedMesh loaded = IndexedMesh::loadBinaryCache(path);
+	filesystem::permissions(path, filesystem::perms::owner_read | filesystem::perms::owner_write, filesystem::perm_options::replace);
+	passed &= assertEqual_UT(loaded.getPolyGroupIDs().size(), 4);
+	for (const PolyGroupID &id : mesh.getPolyGroupIDs())
+	{
+		passed &= assertTrue_UT(loaded.getIndices(id) == mesh.getIndices(id));
+		auto a = mesh.getVertices(id), b = loaded.getVertices(id);
+		passed &= assertEqual_UT(a.size(), b.size());
+		for (int i = 0; i < a.size(); ++i)
+			passed &= assertTrue_UT(a[i].getPosition() == b[i].getPosition() && a[i].getNormal() == b[i].getNormal() && a[i].getUV() == b[i].getUV() && a[i].getColor() == b[i].getColor());
+	}
+	passed &= assertTrue_UT(loaded.getBufferBoss().isDirty(POSITION, 0));
+
+	bool thrown = false;
+	std::ofstream(path, std::ios::binary) << "SEMC but not really a cache";
+	try { IndexedMesh::loadBinaryCache(path); } catch (const InvalidFileError &) { thrown = true; }
+	passed &= assertTrue_UT(thrown);
+	filesystem::remove(path);
+	return passed;
+}
+
+
+// the importer and the cache it leaves behind against the getline/istringstream importer IndexedMesh used before,
+// on its only accepted input (v/vt/vn triangles), timings are in the benchmarks target
+inline bool objImportCachedMatchesGetlineTest()
+{
+	int n = 100;
+	string text = objGridText(n, true);
+	Path obj = filesystem::temp_directory_path() / "objImportCached.obj";
+	Path cache = filesystem::temp_directory_path() / "objImportCached.obj.meshcache";
+	std::ofstream(obj, std::ios::binary) << text;
+	filesystem::remove(cache);
+
+	std::istringstream in(text);
+	string line;
+	vector<vec3> pos;
+	vector<ivec3> faces;
+	while (getline(in, line))
+	{
+		if (line.substr(0, 2) == "v ")
+		{
+			std::istringstream s(line.substr(2));
+			vec3 v;
+			s >> v.x >> v.y >> v.z;
+			pos.push_back(v);
+		}
+		else if (line.substr(0, 2) == "f ")
+		{
+			ivec3 v, t, nr;
+			sscanf(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d", &v[0], &t[0], &nr[0], &v[1], &t[1], &nr[1], &v[2], &t[2], &nr[2]);
+			faces.push_back(v - ivec3(1));
+		}
+	}
+
+	IndexedMesh imported = IndexedMesh::fromOBJCached(obj, "obj");
+	bool passed = assertTrue_UT(filesystem::exists(cache));
+	IndexedMesh cached = IndexedMesh::fromOBJCached(obj, "obj");
+
+	passed &= assertEqual_UT(imported.getIndices("obj").size(), 2*(n-1)*(n-1));
+	passed &= assertTrue_UT(cached.getIndices("obj") == imported.getIndices("obj"));
+	passed &= assertTrue_UT(faces == imported.getIndices("obj"));
+	auto vertices = imported.getVertices("obj");
+	passed &= assertEqual_UT(vertices.size(), pos.size());
+	for (int i = 0; i < (int)pos.size(); i += 97)
+		passed &= assertEqual_UT(vertices[i].getPosition(), pos[i]);
+	filesystem::remove(obj);
+	filesystem::remove(cache);
+	return passed;
+}
+
+
+inline SmoothParametricSurface testTorus(float R, float r)
+{
+	return SmoothParametricSurface([R, r](float t, float u) { return vec3((R + r*cos(u))*cos(t), (R + r*cos(u))*sin(t), r*sin(u)); },
+								   vec2(0, TAU), vec2(0, TAU), true, true);
+}
+
+
+inline bool uniformSurfaceTessellationTest()
+{
+	bool passed = true;
+	auto torus = testTorus(2, .7f);
+	IndexedMesh mesh = IndexedMesh(torus, 40, 30, "torus");
+	auto verts = mesh.getVertices("torus");
+	auto faces = mesh.getIndices("torus");
+	passed &= assertEqual_UT(verts.size(), 40*30);
+	passed &= assertEqual_UT(faces.size(), 2*40*30);
+
+	// stencil normals agree with the analytic ones, vertices sit on the surface at the parameters kept in the colour
+	for (const Vertex &v : verts)
+	{
+		vec2 tu = vec2(v.getColor());
+		passed &= assertLess_UT(length(v.getPosition() - torus(tu)), 1e-6f);
+		passed &= assertLess_UT(.995f, dot(v.getNormal(), torus.normal(tu)));
+	}
+	// both seams are closed: every edge is shared by two faces
+	std::map<pair<int, int>, int> edges;
+	for (ivec3 f : faces)
+		for (int k = 0; k < 3; ++k)
+			edges[{std::min(f[k], f[(k+1)%3]), std::max(f[k], f[(k+1)%3])}]++;
+	for (const auto &[e, count] : edges)
+		passed &= assertEqual_UT(count, 2);
+
+	// open in u with both poles collapsed to a point, where the normal falls back to the surface
+	auto ball = SmoothParametricSurface([](float t, float u) { return vec3(cos(t)*sin(u), sin(t)*sin(u), cos(u)); },
+										vec2(0, TAU), vec2(0, PI), true, false);
+	mesh.addUniformSurface(ball, 32, 17, "ball");
+	passed &= assertEqual_UT(mesh.getIndices("ball").size(), 2*32*16);
+	passed &= assertEqual_UT(mesh.getIndices("ball").front(), ivec3(40*30 + 18, 40*30 + 1, 40*30));
+	for (const Vertex &v : mesh.getVertices("ball"))
+	{
+		passed &= assertLess_UT(abs(length(v.getNormal()) - 1), 1e-5f);
+		passed &= assertLess_UT(.99f, dot(v.getNormal(), ball.normal(vec2(v.getColor()))));
+	}
+
+	bool threw = false;
+	try { mesh.addUniformSurface(ball, 1, 10, "line"); }
+	catch (const IllegalArgumentError &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+	return passed;
+}
+
+
+// compares the grid resampling of adjustToNewSurface with the per vertex path it replaces for uniform surfaces
+inline bool adjustToNewSurfaceOnGridTest()
+{
+	bool passed = true;
+	int n = 128;
+	IndexedMesh grid = IndexedMesh(testTorus(2, .7f), n, n, "torus");
+	IndexedMesh reference = IndexedMesh(grid);
+	auto deformed = testTorus(2.5f, .4f);
+
+	BufferManager &boss = grid.getBufferBoss();
+	unsigned long uploaded = 0;
+	boss.collectUploads(POSITION, boss.bufferSize(POSITION), uploaded);
+	reference.deformPerVertex("torus", [&](BufferedVertex &v) { IndexedMesh::encodeSurfacePoint(v, deformed, IndexedMesh::getSurfaceParameters(v)); });
+	grid.adjustToNewSurface(deformed, "torus");
+
+	auto a = grid.getVertices("torus"), b = reference.getVertices("torus");
+	float worst = 1;
+	for (int k = 0; k < (int)a.size(); ++k)
+	{
+		passed &= assertEqual_UT(a[k].getPosition(), b[k].getPosition());
+		passed &= assertLess_UT(length(a[k].getUV() - b[k].getUV()), 1e-6f);
+		worst = std::min(worst, dot(a[k].getNormal(), b[k].getNormal()));
+	}
+	passed &= assertLess_UT(.9999f, worst);
+	passed &= assertTrue_UT(boss.isDirty(POSITION, uploaded));
+	return passed;
+}
+
+
+// bulk kernels against the per vertex deformations they replace, chunk offsets and the buffers they mark dirty
+inline bool deformBulkMatchesPerVertexTest()
+{
+	bool passed = true;
+	int n = 100;
+	IndexedMesh mesh = gridPolygroupsMesh(n, 3);
+	IndexedMesh reference = IndexedMesh(mesh);
+	mat3 M = mat3(vec3(1, .2f, 0), vec3(0, 2, .1f), vec3(.3f, 0, .5f));
+	vec3 v = vec3(1, -2, 3);
+	auto bend = SpaceEndomorphism([](vec3 p) { return vec3(p.x, p.y + .01f*p.x*p.x, p.z + sin(.1f*p.y)); });
+
+	mesh.affineTransform(M, v, 0);
+	reference.deformPerVertex(0, [&](BufferedVertex &w) { w.applyFunction(SpaceEndomorphism::affine(M, v)); });
+	mesh.deformWithAmbientMap(1, bend);
+	reference.deformPerVertex(1, [&](BufferedVertex &w) { w.applyFunction(bend); });
+	for (int g : {0, 1})
+	{
+		auto a = mesh.getVertices(g), b = reference.getVertices(g);
+		float worst = 1;
+		for (int k = 0; k < (int)a.size(); ++k)
+		{
+			passed &= assertEqual_UT(a[k].getPosition(), b[k].getPosition());
+			worst = std::min(worst, dot(a[k].getNormal(), b[k].getNormal()));
+		}
+		passed &= assertLess_UT(.999f, worst);
+	}
+
+	// every vertex lands in exactly one chunk at its buffer index
+	mesh.deformBulk(2, [](const VertexSpans &vs) {
+		for (int k = 0; k < vs.size(); ++k)
+			vs.colors[k] += vec4(vs.first + k, 1, 0, 0);
+	}, {COLOR});
+	bool indexed = true;
+	for (BufferedVertex w : mesh.vertexView(2))
+		indexed &= w.getColor().x == w.getIndex() && w.getColor().y == 1;
+	passed &= assertTrue_UT(indexed);
+
+	// a translation writes positions of its polygroup only
+	BufferManager &boss = mesh.getBufferBoss();
+	SimulatedStepBuffers step;
+	BufferUploadLog log;
+	simulateUploadFrame(boss, step, log);
+	log.reset();
+	vec3 before = mesh.vertexView(1)[17].getPosition();
+	mesh.shift(vec3(0, 0, 1), 1);
+	passed &= assertEqual_UT(mesh.vertexView(1)[17].getPosition(), before + vec3(0, 0, 1));
+	simulateUploadFrame(boss, step, log);
+	passed &= assertEqual_UT(log.bytes(POSITION), n*n*sizeof(vec3));
+	passed &= assertEqual_UT(log.totalBytes(), n*n*sizeof(vec3));
+
+	mesh.deformBulk(vertexKernels::flipNormals(), {NORMAL});
+	mesh.deformBulk(vertexKernels::renormaliseNormals(), {NORMAL});
+	passed &= assertEqual_UT(mesh.vertexView(0)[5].getNormal(), -reference.vertexView(0)[5].getNormal());
+	return passed;
+}
+
+
+// triangles with corners rotated to start at the smallest position, sorted, so equal meshes compare equal under any face and vertex order
+inline vector<std::array<float, 9>> canonicalTriangles(const IndexedMesh &mesh, const PolyGroupID &id)
+{
+	vector<std::array<float, 9>> triangles;
+	for (const IndexedTriangle &t : mesh.triangleView(id))
+	{
+		std::array<vec3, 3> corners = {t.getVertex(0).getPosition(), t.getVertex(1).getPosition(), t.getVertex(2).getPosition()};
+		auto less = [](vec3 a, vec3 b) { return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); };
+		std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end(), less), corners.end());
+		triangles.push_back({corners[0].x, corners[0].y, corners[0].z, corners[1].x, corners[1].y, corners[1].z, corners[2].x, corners[2].y, corners[2].z});
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+
+inline bool vertexCacheOptimisationTest()
+{
+	bool passed = true;
+
+	// FIFO keeps evicting a vertex that LRU refreshes on the hit
+	vector<ivec3> faces = {ivec3(0, 1, 2), ivec3(0, 3, 4), ivec3(0, 3, 4)};
+	VertexCacheStats fifo = simulateVertexCache(faces, 5, 3, VertexCacheModel::FIFO);
+	VertexCacheStats lru = simulateVertexCache(faces, 5, 3, VertexCacheModel::LRU);
+	passed &= assertEqual_UT(fifo.transforms, 6);
+	passed &= assertEqual_UT(lru.transforms, 5);
+	passed &= assertEqual_UT(lru.acmr, 5.f/3);
+	passed &= assertEqual_UT(lru.atvr, 1.f);
+	passed &= assertTrue_UT(vertexFetchOrder(faces, 6) == vector<int>({0, 1, 2, 3, 4, 5}));
+
+	IndexedMesh mesh = IndexedMesh(testTorus(2, .7f), 200, 200, "torus");
+	mesh.mergeAndKeepID(icosphere(1, 4, vec3(5, 0, 0), "sphere"));
+	auto torusBefore = canonicalTriangles(mesh, "torus"), sphereBefore = canonicalTriangles(mesh, "sphere");
+	vector<Vertex> sphereVertices = mesh.getVertices("sphere");
+	VertexCacheStats torusStats = mesh.vertexCacheStats("torus"), sphereStats = mesh.vertexCacheStats("sphere");
+
+	mesh.optimiseVertexCache("torus");
+	VertexCacheStats torusOptimised = mesh.vertexCacheStats("torus");
+	passed &= assertLessOrEqual_UT(torusOptimised.acmr, .7f);
+	passed &= assertLess_UT(torusOptimised.acmr, torusStats.acmr);
+	passed &= assertTrue_UT(canonicalTriangles(mesh, "torus") == torusBefore);
+	// vertices come in order of first use
+	passed &= assertEqual_UT(mesh.triangleView("torus")[0].getVertexIndices(), ivec3(0, 1, 2));
+	bool sphereKept = true;
+	vector<Vertex> sphereAfter = mesh.getVertices("sphere");
+	for (int k = 0; k < (int)sphereVertices.size(); ++k)
+		sphereKept &= sphereAfter[k].getPosition() == sphereVertices[k].getPosition();
+	passed &= assertTrue_UT(sphereKept);
+
+	// subdivideEdgecentric does not weld, so the icosphere has about a vertex per triangle and an ACMR near 1 at best
+	IndexedMesh cacheOnly = IndexedMesh(mesh);
+	cacheOnly.optimiseVertexCache("sphere");
+	mesh.optimiseVertexCache("sphere", {.overdraw = true});
+	VertexCacheStats sphereOptimised = mesh.vertexCacheStats("sphere");
+	passed &= assertLessOrEqual_UT(cacheOnly.vertexCacheStats("sphere").acmr, sphereStats.acmr);
+	passed &= assertLessOrEqual_UT(sphereOptimised.acmr, MeshOptimisationSettings().overdrawThreshold*cacheOnly.vertexCacheStats("sphere").acmr + .01f);
+	passed &= assertTrue_UT(canonicalTriangles(mesh, "sphere") == sphereBefore);
+	passed &= assertEqual_UT(sphereOptimised.vertices, sphereStats.vertices);
+
+	auto gyroid = marchingCubes([](vec3 p) { return sin(6*p.x)*cos(6*p.y) + sin(6*p.y)*cos(6*p.z) + sin(6*p.z)*cos(6*p.x); }, vec3(-1), vec3(1), ivec3(40));
+	VertexCacheStats gyroidStats = simulateVertexCache(gyroid.triangles, gyroid.positions.size());
+	vector<int> order = vertexCacheTriangleOrder(gyroid.triangles, gyroid.positions.size());
+	vector<ivec3> reordered;
+	for (int t : order)
+		reordered.push_back(gyroid.triangles[t]);
+	VertexCacheStats gyroidOptimised = simulateVertexCache(reordered, gyroid.positions.size());
+	passed &= assertLessOrEqual_UT(gyroidOptimised.acmr, .7f);
+	passed &= assertLess_UT(gyroidOptimised.acmr, gyroidStats.acmr);
+	vector<int> clustered = overdrawTriangleOrder(gyroid.triangles, gyroid.positions, order);
+	std::sort(clustered.begin(), clustered.end());
+	bool permutation = (int)clustered.size() == (int)gyroid.triangles.size();
+	for (int k = 0; permutation && k < (int)clustered.size(); ++k)
+		permutation &= clustered[k] == k;
+	passed &= assertTrue_UT(permutation);
+	return passed;
+}
+
+
+inline UnitTestResult meshTests__all()
+{
+	UnitTestResult result;
+	result.runTest(dirtyRangesMergeTest);
+	result.runTest(staticMeshUploadsOnceTest);
+	result.runTest(deformedPolygroupUploadsOnlyItsRangeTest);
+	result.runTest(sharedMeshUploadsToEveryStepTest);
+	result.runTest(polygroupViewsTest);
+	result.runTest(polygroupViewsDoNotAllocateTest);
+	result.runTest(adjacencyMatchesBruteForceTest);
+	result.runTest(recalculateNormalsOnLargeMeshTest);
+	result.runTest(marchingCubesWatertightTest);
+	result.runTest(objImportTest);
+	result.runTest(meshBinaryCacheRoundTripTest);
+	result.runTest(objImportCachedMatchesGetlineTest);
+	result.runTest(uniformSurfaceTessellationTest);
+	result.runTest(adjustToNewSurfaceOnGridTest);
+	result.runTest(deformBulkMatchesPerVertexTest);
+	result.runTest(vertexCacheOptimisationTest);
+	return result;
+}
@@ -5,6 +5,18 @@
 #include "filesystemTests.hpp"
 #include "quatGLSLModuleTests.hpp"
 #include "shaderParsingTests.hpp"
+#include "sphTests.hpp"
+#include "meshTests.hpp"
+#include "funcTests.hpp"
+#include "captureTests.hpp"
+#include "uniformTests.hpp"
+#include "instancingTests.hpp"
+#include "autodiffTests.hpp"
+#include "stftTests.hpp"
+#include "signalIOTests.hpp"
+#include "sparseTests.hpp"
+#include "framePacerTests.hpp"
+#include "jobSystemTests.hpp"
 
 
 #include "logging.hpp"
@@ -21,6 +33,18 @@ int main()
 	runTest("Filesystem Tests", filesystemTests__all, total_result);
 	runTest("Quaternion GLSL Module Tests", quatGLSLModuleTests__all, total_result);
 	runTest("Shader Parsing Tests", shaderParsingTests__all, total_result);
+	runTest("SPH Tests", sphTests__all, total_result);
+	runTest("Mesh Tests", meshTests__all, total_result);
+	runTest("Function Tests", funcTests__all, total_result);
+	runTest("Capture Tests", captureTests__all, total_result);
+	runTest("Uniform Tests", uniformTests__all, total_result);
+	runTest("Instancing Tests", instancingTests__all, total_result);
+	runTest("Autodiff Tests", autodiffTests__all, total_result);
+	runTest("STFT Tests", stftTests__all, total_result);
+	runTest("Signal IO Tests", signalIOTests__all, total_result);
+	runTest("Sparse Tests", sparseTests__all, total_result);
+	runTest("Frame Pacer Tests", framePacerTests__all, total_result);
+	runTest("Job System Tests", jobSystemTests__all, total_result);
 	LOG_PURE("--------------------------------");
 	printTestResult("All Tests", total_result);
   }
@@ -0,0 +1,133 @@
+#pragma once
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "unittests.hpp"
+#include "../utils/signalIO.hpp"
+
+using namespace glm;
+
+
+inline bool wavRoundTripTest()
+{
+	bool passed = true;
+	int frames = 5003, channels = 3;
+	auto interleaved = testSignal(frames*channels);
+	Path path = std::filesystem::temp_directory_path() / "signalIOTest.wav";
+
+	// quantisation step of each format
+	for (auto [format, step] : {std::pair(SampleFormat::PCM_U8, 1/128.f), std::pair(SampleFormat::PCM_S16, 1/32768.f),
+								std::pair(SampleFormat::PCM_S24, 1/8388608.f), std::pair(SampleFormat::PCM_S32, 1e-7f),
+								std::pair(SampleFormat::FLOAT32, 0.f), std::pair(SampleFormat::FLOAT64, 0.f)}) {
+		writeWav(path, interleaved, 48000, format, channels);
+		for (int c = 0; c < channels; ++c) {
+			SignalReader reader(path, c);
+			passed &= assertEqual_UT(reader.frames(), (long long)frames);
+			passed &= assertEqual_UT(reader.info().sampleRate, 48000);
+			vector<float> expected(frames);
+			for (int i = 0; i < frames; ++i)
+				expected[i] = interleaved[i*channels + c];
+			passed &= assertLessOrEqual_UT(maxDifference(reader.readAll(), expected), step);
+		}
+	}
+
+	// chunked reads give the same samples as one read
+	writeWav(path, interleaved, 44100, SampleFormat::PCM_S16, channels);
+	SignalReader reader(path, 2);
+	auto all = reader.readAll();
+	reader.seek(0);
+	vector<float> chunked, chunk(777);
+	while (size_t n = reader.read(chunk))
+		chunked.insert(chunked.end(), chunk.begin(), chunk.begin() + n);
+	passed &= assertEqual_UT(chunked, all);
+	passed &= assertEqual_UT(reader.remaining(), 0LL);
+
+	auto f = loadSignal(path, 1);
+	passed &= assertEqual_UT(f.samples(), frames);
+	passed &= assertLessOrEqual_UT(abs(f.getDomain().y - frames/44100.f), 1e-6f);
+
+	bool threw = false;
+	try { SignalReader(path, channels); }
+	catch (const IllegalArgumentError &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+	std::filesystem::remove(path);
+	return passed;
+}
+
+
+inline bool npyAndRawRoundTripTest()
+{
+	bool passed = true;
+	auto signal = testSignal(10000);
+	Path dir = std::filesystem::temp_directory_path();
+
+	writeNpy(dir / "signalIOTest.npy", signal);
+	passed &= assertEqual_UT(SignalReader(dir / "signalIOTest.npy").readAll(), signal);
+	writeRaw(dir / "signalIOTest.f32", signal);
+	passed &= assertEqual_UT(SignalReader(dir / "signalIOTest.f32").readAll(), signal);
+	writeRaw(dir / "signalIOTest.f64", signal, SampleFormat::FLOAT64);
+	passed &= assertEqual_UT(SignalReader(dir / "signalIOTest.f64").readAll(), signal);
+	// two interleaved channels read as headerless 16 bit PCM
+	writeRaw(dir / "signalIOTest.pcm", signal, SampleFormat::PCM_S16);
+	SignalReader pcm(dir / "signalIOTest.pcm", SampleFormat::PCM_S16, 2, 1);
+	passed &= assertEqual_UT(pcm.frames(), 5000LL);
+	auto odd = pcm.readAll();
+	passed &= assertLessOrEqual_UT(abs(odd[1234] - signal[2*1234 + 1]), 1/32768.f);
+
+	Spectrogram spectra(37, 129);
+	for (int t = 0; t < spectra.frames(); ++t)
+		for (int k = 0; k < spectra.bins(); ++k)
+			spectra(t, k) = Complex(randomFloat(-1, 1), randomFloat(-1, 1));
+	writeNpy(dir / "signalIOSpectra.npy", spectra);
+	auto loaded = loadSpectrogram(dir / "signalIOSpectra.npy");
+	passed &= assertEqual_UT(loaded.frames(), 37);
+	passed &= assertEqual_UT(loaded.bins(), 129);
+	passed &= assertTrue_UT(std::memcmp(loaded.frame(0), spectra.frame(0), spectra.bytes()) == 0);
+
+	// a spectrogram is not a signal
+	bool threw = false;
+	try { SignalReader(dir / "signalIOSpectra.npy"); }
+	catch (const InvalidFileError &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+
+	for (auto name : {"signalIOTest.npy", "signalIOTest.f32", "signalIOTest.f64", "signalIOTest.pcm", "signalIOSpectra.npy"})
+		std::filesystem::remove(dir / name);
+	return passed;
+}
+
+
+inline bool loadSequenceFallbackTest()
+{
+	bool passed = true;
+	Path dir = std::filesystem::temp_directory_path();
+	std::ofstream(dir / "signalIOTest.txt") << "# comment\n0.5\n\n-1.25\n// another\n2\n";
+	auto text = loadSequence(CodeFileDescriptor(dir / "signalIOTest.txt", false), vec2(0, 3));
+	passed &= assertEqual_UT(text.samples(), 3);
+	passed &= assertEqual_UT(text[1], -1.25f);
+
+	vector<float> values = {.5f, -1.25f, 2};
+	writeRaw(dir / "signalIOTest.f32", values);
+	auto binary = loadSequence(CodeFileDescriptor(dir / "signalIOTest.f32", false), vec2(0, 3));
+	passed &= assertEqual_UT(binary.getVector().vec(), values);
+
+	bool threw = false;
+	std::ofstream(dir / "signalIOTest.wav") << "RIFF....WAVEjunk";
+	try { SignalReader(dir / "signalIOTest.wav"); }
+	catch (const InvalidFileError &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+
+	for (auto name : {"signalIOTest.txt", "signalIOTest.f32", "signalIOTest.wav"})
+		std::filesystem::remove(dir / name);
+	return passed;
+}
+
+
+inline UnitTestResult signalIOTests__all()
+{
+	UnitTestResult result;
+	result.runTest(wavRoundTripTest);
+	result.runTest(npyAndRawRoundTripTest);
+	result.runTest(loadSequenceFallbackTest);
+	return result;
+}
@@ -0,0 +1,247 @@
+#pragma once
+#include "unittests.hpp"
+#include "../utils/sparse.hpp"
+#include "../utils/randomUtils.hpp"
+
+using namespace glm;
+
+
+// 5-point Laplacian of a k x k grid with Dirichlet boundary plus shift*I, symmetric positive definite
+inline SparseMatrix sparseTestLaplacian(int k, float shift=0, float convection=0)
+{
+	vector<SparseEntry> triplets;
+	for (int i = 0; i < k; ++i)
+		for (int j = 0; j < k; ++j) {
+			int v = i*k + j;
+			triplets.push_back({v, v, 4 + shift});
+			if (i > 0) triplets.push_back({v, v - k, -1});
+			if (i < k - 1) triplets.push_back({v, v + k, -1});
+			if (j > 0) triplets.push_back({v, v - 1, -1 - convection});
+			if (j < k - 1) triplets.push_back({v, v + 1, -1 + convection});
+		}
+	return SparseMatrix(k*k, k*k, triplets);
+}
+
+inline float sparseTestResidual(const SparseMatrix &A, std::span<const float> x, std::span<const float> b)
+{
+	auto Ax = A*x;
+	double r = 0, bb = 0;
+	for (size_t i = 0; i < b.size(); ++i) {
+		r += (Ax[i] - b[i])*(Ax[i] - b[i]);
+		bb += b[i]*b[i];
+	}
+	return std::sqrt(r/bb);
+}
+
+
+inline bool sparseAssemblyTest()
+{
+	bool passed = true;
+	// duplicates are summed, rows come out sorted
+	vector<SparseEntry> triplets = {{1, 2, 1}, {0, 0, 2}, {1, 0, -1}, {1, 2, 2.5f}, {2, 1, 4}, {0, 3, 1}};
+	SparseMatrix A(3, 4, triplets);
+	passed &= assertEqual_UT(A.nonZeros(), 5);
+	passed &= assertEqual_UT(A.get(1, 2), 3.5f);
+	passed &= assertEqual_UT(A(2, 2), 0.f);
+	passed &= assertEqual_UT(vector<int>(A.rowColumns(1).begin(), A.rowColumns(1).end()), vector<int>{0, 2});
+
+	auto At = A.transpose();
+	passed &= assertEqual_UT(At.size(), ivec2(4, 3));
+	for (int i = 0; i < 3; ++i)
+		for (int j = 0; j < 4; ++j)
+			passed &= assertEqual_UT(At(j, i), A(i, j));
+
+	// products against the dense definition
+	vector<float> x = {1, -2, .5f, 3};
+	auto y = A*x;
+	passed &= assertEqual_UT(y, vector<float>{5, .75f, -8});
+	auto AAt = A*At;
+	passed &= assertEqual_UT(AAt.size(), ivec2(3, 3));
+	passed &= assertTrue_UT(AAt.symmetric());
+	passed &= assertEqual_UT(AAt(1, 1), 1 + 3.5f*3.5f);
+	passed &= assertEqual_UT(AAt(0, 1), -2.f);
+
+	auto D = (A - A*2.f) + A;
+	for (float v: D.rowValues(1))
+		passed &= assertEqual_UT(v, 0.f);
+	passed &= assertEqual_UT((SparseMatrix::identity(4)*x)[3], 3.f);
+
+	// parallel product equals the sequential one
+	auto L = sparseTestLaplacian(300, .1f);
+	vector<float> u(L.cols()), serial(L.rows()), parallel(L.rows());
+	for (float &ui: u)
+		ui = randomFloat(-1, 1);
+	L.multiply(u, serial, 1);
+	L.multiply(u, parallel, 4);
+	passed &= assertEqual_UT(serial, parallel);
+
+	bool threw = false;
+	try { SparseMatrix(2, 2, vector<SparseEntry>{{2, 0, 1}}); }
+	catch (const IndexOutOfBounds &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+	return passed;
+}
+
+
+inline bool iterativeSolversTest()
+{
+	bool passed = true;
+	auto A = sparseTestLaplacian(60);
+	vector<float> b(A.rows());
+	for (float &bi: b)
+		bi = randomFloat(-1, 1);
+
+	int iterations[3];
+	for (auto preconditioner: {SparsePreconditioner::NONE, SparsePreconditioner::JACOBI, SparsePreconditioner::ILU0}) {
+		vector<float> x(A.rows(), 0.f);
+		auto report = conjugateGradient(A, b, x, {.tolerance = 1e-6f, .maxIterations = 2000, .preconditioner = preconditioner});
+		passed &= assertTrue_UT(report.converged);
+		passed &= assertLessOrEqual_UT(sparseTestResidual(A, x, b), 1e-5f);
+		iterations[(int)preconditioner] = report.iterations;
+	}
+	// incomplete factorisation needs far fewer iterations than plain CG on a Laplacian
+	passed &= assertLess_UT(iterations[2]*3, iterations[0]*2);
+
+	// nonsymmetric convection-diffusion system
+	auto C = sparseTestLaplacian(60, 0, .4f);
+	passed &= assertFalse_UT(C.symmetric());
+	for (auto preconditioner: {SparsePreconditioner::JACOBI, SparsePreconditioner::ILU0}) {
+		vector<float> x(C.rows(), 0.f);
+		auto report = biCGSTAB(C, b, x, {.tolerance = 1e-6f, .maxIterations = 2000, .preconditioner = preconditioner});
+		passed &= assertTrue_UT(report.converged);
+		passed &= assertLessOrEqual_UT(sparseTestResidual(C, x, b), 1e-5f);
+	}
+
+	// a zero right hand side is solved by zero without iterating
+	vector<float> zero(A.rows(), 0.f), x(A.rows(), 1.f);
+	auto report = conjugateGradient(A, zero, x);
+	passed &= assertEqual_UT(report.iterations, 0);
+	passed &= assertEqual_UT(x, zero);
+	return passed;
+}
+
+
+inline bool sparseLDLTTest()
+{
+	bool passed = true;
+	auto A = sparseTestLaplacian(50, .05f);
+	vector<float> b(A.rows());
+	for (float &bi: b)
+		bi = randomFloat(-1, 1);
+
+	SparseLDLT natural(A, FillReducingOrdering::NATURAL);
+	SparseLDLT minimumDegree(A, FillReducingOrdering::MINIMUM_DEGREE);
+	SparseLDLT ordered(A);
+	passed &= assertLessOrEqual_UT(sparseTestResidual(A, natural.solve(b), b), 1e-5f);
+	passed &= assertLessOrEqual_UT(sparseTestResidual(A, minimumDegree.solve(b), b), 1e-5f);
+	passed &= assertLessOrEqual_UT(sparseTestResidual(A, ordered.solve(b), b), 1e-5f);
+	// natural order fills the whole band of width 50
+	passed &= assertLess_UT(minimumDegree.factorNonZeros()*2, natural.factorNonZeros());
+	passed &= assertLess_UT(ordered.factorNonZeros()*2, natural.factorNonZeros());
+	auto permutation = ordered.ordering();
+	std::sort(permutation.begin(), permutation.end());
+	for (int k = 0; k < A.rows(); ++k)
+		passed &= assertEqual_UT(permutation[k], k);
+
+	// new values on the same pattern reuse the analysis
+	auto B = A*3.f;
+	ordered.factorize(B);
+	passed &= assertLessOrEqual_UT(sparseTestResidual(B, ordered.solve(b), b), 1e-5f);
+	bool threw = false;
+	try { ordered.factorize(SparseMatrix::identity(2500)); }
+	catch (const IllegalArgumentError &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+
+	// one stored triangle stands for the symmetric matrix under any ordering
+	vector<SparseEntry> lowerTriplets, upperTriplets;
+	for (int i = 0; i < A.rows(); ++i)
+		for (int j: A.rowColumns(i)) {
+			if (j <= i) lowerTriplets.push_back({i, j, A(i, j)});
+			if (j >= i) upperTriplets.push_back({i, j, A(i, j)});
+		}
+	SparseMatrix lower(A.rows(), A.cols(), lowerTriplets), upper(A.rows(), A.cols(), upperTriplets);
+	SparseLDLT fromLower(lower);
+	SparseLDLT fromUpper(upper, FillReducingOrdering::MINIMUM_DEGREE);
+	passed &= assertLessOrEqual_UT(sparseTestResidual(A, fromLower.solve(b), b), 1e-5f);
+	passed &= assertLessOrEqual_UT(sparseTestResidual(A, fromUpper.solve(b), b), 1e-5f);
+	passed &= assertEqual_UT(fromLower.factorNonZeros(), ordered.factorNonZeros());
+	fromLower.factorize(lower*3.f);
+	passed &= assertLessOrEqual_UT(sparseTestResidual(B, fromLower.solve(b), b), 1e-5f);
+
+	threw = false;
+	try { SparseLDLT(sparseTestLaplacian(10, 0, .1f)); }
+	catch (const IllegalArgumentError &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+
+	// symmetric indefinite matrix with nonzero pivots, determinant against dense LU
+	vector<SparseEntry> triplets;
+	int n = 7;
+	Matrix<float> dense(n, n);
+	for (int i = 0; i < n; ++i) {
+		triplets.push_back({i, i, i % 2 ? -3.f : 4.f});
+		dense.at(i, i) = i % 2 ? -3.f : 4.f;
+		if (i + 2 < n) {
+			triplets.push_back({i, i + 2, 1});
+			triplets.push_back({i + 2, i, 1});
+			dense.at(i, i + 2) = dense.at(i + 2, i) = 1;
+		}
+	}
+	SparseLDLT indefinite(SparseMatrix(n, n, triplets));
+	auto [logDet, sign] = indefinite.logDeterminant();
+	float det = dense.det();
+	passed &= assertEqual_UT(sign, det < 0 ? -1 : 1);
+	passed &= assertLessOrEqual_UT(abs(float(std::exp(logDet)) - abs(det))/abs(det), 1e-5f);
+	return passed;
+}
+
+
+inline bool denseLUTest()
+{
+	bool passed = true;
+	int n = 9;
+	Matrix<float> M(n, n);
+	MATR$X rows(n, vector<float>(n));
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < n; ++j)
+			rows[i][j] = M.at(i, j) = randomFloat(-1, 1) + (i == j ? 3.f : 0.f);
+	FloatMatrix F(rows);
+
+	// cofactor expansion along the first row, fine for a 9x9 matrix
+	float expanded = 0;
+	for (int j = 0; j < n; ++j)
+		expanded += M.at(0, j)*M.minor(0, j)*(j % 2 ? -1.f : 1.f);
+	passed &= assertLessOrEqual_UT(abs(M.det() - expanded)/abs(expanded), 1e-4f);
+	passed &= assertLessOrEqual_UT(abs(F.det() - expanded)/abs(expanded), 1e-4f);
+
+	auto Minv = M.inv();
+	auto Finv = F.inv();
+	auto P = M*Minv;
+	auto Q = F*Finv;
+	float maxError = 0;
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < n; ++j) {
+			maxError = max(maxError, abs(P.at(i, j) - (i == j ? 1.f : 0.f)));
+			maxError = max(maxError, abs(Q.get(i, j) - (i == j ? 1.f : 0.f)));
+		}
+	passed &= assertLessOrEqual_UT(maxError, 1e-5f);
+
+	// rank deficient matrices
+	rows[3] = rows[5];
+	passed &= assertEqual_UT(FloatMatrix(rows).det(), 0.f);
+	bool threw = false;
+	try { FloatMatrix(rows).inv(); }
+	catch (const std::invalid_argument &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+	return passed;
+}
+
+
+inline UnitTestResult sparseTests__all()
+{
+	UnitTestResult result;
+	result.runTest(sparseAssemblyTest);
+	result.runTest(iterativeSolversTest);
+	result.runTest(sparseLDLTTest);
+	result.runTest(denseLUTest);
+	return result;
+}
@@ -0,0 +1,260 @@
+#pragma once
+#include <set>
+
+#include "unittests.hpp"
+#include "../geometry/uniformGrid.hpp"
+#include "../geometry/sph.hpp"
+#include "../utils/randomUtils.hpp"
+#include "../utils/logging.hpp"
+
+using namespace glm;
+
+
+inline bool gridNeighbourSearchMatchesBruteForceTest()
+{
+	bool passed = true;
+	vec3 a = vec3(-1, -1, -2);
+	vec3 b = vec3(1, 1, 2);
+	vector<vec3> pts;
+	for (int i = 0; i < 2000; ++i)
+		pts.push_back(random_vec3(a - vec3(.2f), b + vec3(.2f)));
+
+	auto grid = UniformGridIndex(a, b, .3f);
+	grid.rebuild(pts);
+	passed &= assertEqual_UT(grid.size(), 2000);
+
+	for (int q = 0; q < 50; ++q)
+	{
+		vec3 x = random_vec3(a, b);
+		float r = randomFloat(.05f, .6f);
+		std::set<int> expected, found;
+		for (int j = 0; j < pts.size(); ++j)
+			if (dot(x - pts[j], x - pts[j]) <= r*r)
+				expected.insert(j);
+		grid.forEachNeighbour(x, r, [&](int j, vec3 delta, float d2) {
+			found.insert(j);
+			passed &= assertNearlyEqual_UT(delta, x - pts[j]);
+		});
+		passed &= assertTrue_UT(expected == found);
+	}
+	return passed;
+}
+
+
+// finds the same pairs as the string-keyed std::map chunking FluidParticleSystem used before the grid index, timings are in the benchmarks target
+inline bool gridNeighbourSearchMatchesChunkMapTest()
+{
+	vec3 a = vec3(-1, -1, -2);
+	vec3 b = vec3(1, 1, 2);
+	float d = .1f;
+	vector<vec3> pts;
+	for (int i = 0; i < 20000; ++i)
+		pts.push_back(random_vec3(a, b));
+
+	auto key = [](ivec3 v) { return std::to_string(v.x) + "," + std::to_string(v.y) + "," + std::to_string(v.z); };
+	std::map<string, std::set<int>> chunks;
+	for (int i = 0; i < pts.size(); ++i)
+		chunks[key(ivec3((pts[i] - a) / d))].insert(i);
+	long map_pairs = 0;
+	for (int i = 0; i < pts.size(); ++i)
+	{
+		ivec3 c = ivec3((pts[i] - a) / d);
+		for (int x = -1; x <= 1; x++)
+			for (int y = -1; y <= 1; y++)
+				for (int z = -1; z <= 1; z++)
+					if (chunks.contains(key(c + ivec3(x, y, z))))
+						for (int j : chunks.at(key(c + ivec3(x, y, z))))
+							map_pairs += dot(pts[i] - pts[j], pts[i] - pts[j]) <= d*d;
+	}
+
+	auto grid = UniformGridIndex(a, b, d);
+	grid.rebuild(pts);
+	long grid_pairs = 0;
+	for (int i = 0; i < pts.size(); ++i)
+		grid.forEachNeighbour(i, d, [&](int, vec3, float) { grid_pairs++; });
+	return assertEqual_UT(map_pairs, grid_pairs);
+}
+
+
+// radial midpoint quadrature of 4 pi r^2 W(r) over the support
+template<typename K>
+float sphKernelIntegral(const K &kernel)
+{
+	int n = 20000;
+	double sum = 0;
+	for (int k = 0; k < n; k++) {
+		float r = (k + .5f) * kernel.h / n;
+		sum += 4 * PI * r * r * kernel.W(r * r) * kernel.h / n;
+	}
+	return sum;
+}
+
+
+template<typename K>
+bool sphKernelTest(const K &kernel)
+{
+	bool passed = assertLessOrEqual_UT(std::abs(sphKernelIntegral(kernel) - 1.f), 1e-3f);
+
+	// gradient against central differences, type-erased wrapper against the static kernel
+	auto wrapped = SmoothingKernel(kernel);
+	float eps = 1e-3f * kernel.h;
+	for (vec3 p : {vec3(.1f, .2f, -.3f), vec3(.45f, 0, .1f), vec3(-.3f, .6f, .5f)}) {
+		p *= kernel.h;
+		float r2 = dot(p, p);
+		vec3 fd = vec3(0);
+		for (int c = 0; c < 3; c++) {
+			vec3 e = vec3(0);
+			e[c] = eps;
+			fd[c] = (kernel.W(dot(p + e, p + e)) - kernel.W(dot(p - e, p - e))) / (2 * eps);
+		}
+		vec3 g = kernel.grad(p, r2);
+		passed &= assertLessOrEqual_UT(length(g - fd), 1e-2f * length(g) + 1e-3f);
+		passed &= assertNearlyEqual_UT(wrapped(p), kernel.W(r2));
+		passed &= assertNearlyEqual_UT(wrapped.grad(p), g);
+	}
+	passed &= assertNearlyEqual_UT(wrapped(vec3(kernel.h, kernel.h, 0)), 0.f);
+
+	float r2[5] = {0, .1f, .3f, .7f, 2};
+	float w[5];
+	for (float &x : r2)
+		x *= kernel.h2;
+	kernel.W(r2, w, 5);
+	for (int i = 1; i < 4; i++)
+		passed &= assertNearlyEqual_UT(w[i], kernel.W(r2[i]));
+	passed &= assertNearlyEqual_UT(w[4], 0.f);
+	return passed;
+}
+
+
+inline bool sphKernelsNormalisedTest()
+{
+	bool passed = true;
+	for (float h : {.3f, 1.f, 2.5f}) {
+		passed &= sphKernelTest(sph::Poly6(h));
+		passed &= sphKernelTest(sph::Spiky(h));
+		passed &= sphKernelTest(sph::Viscosity(h));
+		passed &= sphKernelTest(sph::CubicSpline(h));
+		passed &= sphKernelTest(sph::WendlandC2(h));
+		passed &= sphKernelTest(sph::WendlandC4(h));
+	}
+
+	// laplacian of Poly6 against the radial formula f'' + 2f'/r
+	auto poly6 = sph::Poly6(1);
+	float r = .4f, e = 1e-2f;
+	auto f = [&](float x) { return poly6.W(x * x); };
+	float lap = (f(r + e) - 2 * f(r) + f(r - e)) / (e * e) + (f(r + e) - f(r - e)) / (e * r);
+	passed &= assertLessOrEqual_UT(std::abs(poly6.laplacian(r * r) - lap), 1e-2f * std::abs(lap));
+	return passed;
+}
+
+
+// deterministic particles, randomFloat is seeded from the clock
+inline shared_ptr<FluidParticleSystem> testFluid(int n, unsigned seed) {
+	std::mt19937 gen(seed);
+	std::uniform_real_distribution<float> u(-.4f, .4f);
+	SPH_SETTINGS params = SPH_SETTINGS(4.5f, .3f, 1.3f, .2f);
+	vector<FluidParticle> particles;
+	for (int i = 0; i < n; i++)
+		particles.emplace_back(vec3(u(gen), u(gen), 2*u(gen)), 1.f, params.viscosity);
+	return make_shared<FluidParticleSystem>(particles, [](vec3) { return vec3(0, 0, -4.f); }, implicitVolumeEllipsoid(1, 1, 2), Poly6Kernel(.3), params);
+}
+
+
+inline bool particleStorageKeepsIdsThroughPermutationTest()
+{
+	bool passed = true;
+	vector<FluidParticle> particles;
+	for (int i = 0; i < 5; i++)
+		particles.emplace_back(vec3(i), 1.f + i, .1f);
+	FluidParticleStorage storage = FluidParticleStorage(particles);
+	auto &tag = storage.channel<int>("tag");
+	for (int k = 0; k < 5; k++)
+		tag[k] = 10*k;
+
+	storage.permute({3, 0, 4, 1, 2});
+	passed &= assertEqual_UT(storage.channel<int>("tag")[0], 30);
+	for (int id = 0; id < 5; id++) {
+		int slot = storage.slotOf(id);
+		passed &= assertEqual_UT(storage.idOf(slot), id);
+		passed &= assertNearlyEqual_UT(storage.position[slot], vec3(id));
+		passed &= assertNearlyEqual_UT(storage.mass[slot], 1.f + id);
+		passed &= assertEqual_UT(storage.channel<int>("tag")[slot], 10*id);
+	}
+
+	bool threw = false;
+	try { storage.channel<float>("tag"); }
+	catch (const IllegalArgumentError &) { threw = true; }
+	passed &= assertEqual_UT(threw, true);
+	return passed;
+}
+
+
+inline bool fluidDensityMatchesBruteForceTest()
+{
+	bool passed = true;
+	auto fluid = testFluid(500, 7);
+	fluid->calculate_densities();
+	auto kernel = Poly6Kernel(.3);
+	for (int i = 0; i < 500; i += 25) {
+		float rho = 0;
+		for (int j = 0; j < 500; j++) {
+			vec3 delta = fluid->particle(i).pos() - fluid->particle(j).pos();
+			if (dot(delta, delta) <= .09f)
+				rho += fluid->particle(j).m() * kernel(delta);
+		}
+		passed &= assertLessOrEqual_UT(std::abs((*fluid)[i].rho() - rho), 1e-3f*rho);
+	}
+	return passed;
+}
+
+
+inline bool fluidStepIndependentOfThreadCountTest()
+{
+	bool passed = true;
+	auto serial = testFluid(1000, 3);
+	auto parallel = testFluid(1000, 3);
+	serial->set_threads(1);
+	parallel->set_threads(4);
+	for (int step = 0; step < 5; step++) {
+		serial->update(.002f);
+		parallel->update(.002f);
+	}
+	for (int i = 0; i < 1000; i++)
+		passed &= assertTrue_UT(serial->particle(i).pos() == parallel->particle(i).pos());
+	return passed;
+}
+
+
+inline bool particleInstancesFollowFluidTest()
+{
+	bool passed = true;
+	auto fluid = testFluid(300, 5);
+	auto instanced = fluid->particle_instances(.05f, 1);
+	size_t sphereIndices = icosphere(.05f, 1, ORIGIN, 0).bufferIndexSize();
+	passed &= assertEqual_UT(instanced.getShape()->bufferIndexSize(), sphereIndices);
+	passed &= assertEqual_UT(instanced.instanceCount(), 300);
+
+	for (int step = 0; step < 3; step++)
+		fluid->update(.002f);
+	fluid->update_particle_instances(instanced.instances());
+	for (int i = 0; i < 300; i++) {
+		vec3 x = fluid->particle(i).pos();
+		passed &= assertTrue_UT(instanced.instances().get(INSTANCE_OFFSET, i) == vec4(x, 1));
+		passed &= assertTrue_UT(instanced.instances().get(INSTANCE_COLOR, i) == vec4(fluid->particle(i).p(), x));
+	}
+	return passed;
+}
+
+
+inline UnitTestResult sphTests__all()
+{
+	UnitTestResult result;
+	result.runTest(gridNeighbourSearchMatchesBruteForceTest);
+	result.runTest(gridNeighbourSearchMatchesChunkMapTest);
+	result.runTest(sphKernelsNormalisedTest);
+	result.runTest(particleStorageKeepsIdsThroughPermutationTest);
+	result.runTest(fluidDensityMatchesBruteForceTest);
+	result.runTest(fluidStepIndependentOfThreadCountTest);
+	result.runTest(particleInstancesFollowFluidTest);
+	return result;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "unittests.hpp"
+#include "../utils/integralTransforms.hpp"
+#include "../utils/stft.hpp"
+#include "../utils/logging.hpp"
+
+using namespace glm;
+
+
+inline bool gaborTransformMatchesFrameLoopTest()
+{
+	bool passed = true;
+	int window = 128, step = 16;
+	auto f = DiscreteRealFunction(Vector<float>(testSignal(1000)), vec2(0, 1));
+	auto gabor = DiscreteGaborTransform(window, step);
+	auto spectrum = gabor.transform(f);
+
+	// the original loop, one slice, product and transform per frame
+	auto kernel = DiscreteRealFunction(EXP_R&(-X_R*X_R*PI), vec2(-1.91, 1.91), window);
+	auto padded = f.two_sided_zero_padding(f.samples() + window);
+	int t = 0;
+	float error = 0;
+	for (int i = 0; i < padded.samples() - window; i += step, ++t) {
+		auto piece = (padded.slice(i, i + window)*kernel).fft();
+		auto frame = spectrum[t];
+		for (int k = 0; k < window; ++k)
+			error = max(error, norm(frame[k].z - piece[k].z));
+	}
+	passed &= assertEqual_UT(spectrum.samples_t(), t);
+	passed &= assertEqual_UT(spectrum.samples_x(), window);
+	passed &= assertLessOrEqual_UT(error, 1e-4f);
+	return passed;
+}
+
+
+inline bool stftStreamMatchesBatchTest()
+{
+	bool passed = true;
+	auto signal = testSignal(20000);
+	STFTEngine engine(STFTEngine::hannWindow(512), 128, 1024);
+	Spectrogram batch = engine.analyse(signal);
+	passed &= assertEqual_UT(batch.frames(), engine.frameCount(signal.size()));
+	passed &= assertEqual_UT(batch.bins(), 513);
+
+	for (int threads : {1, 3}) {
+		int expected = 0;
+		float error = 0;
+		bool ordered = true;
+		STFTStream stream(engine, [&](int frame, std::span<const Complex> spectrum) {
+			ordered &= frame == expected++;
+			error = max(error, maxDifference(spectrum, std::span(batch.frame(frame), batch.bins())));
+		}, threads, 16);
+
+		int pushed = 0, maxBuffered = 0;
+		while (pushed < signal.size()) {
+			int chunk = min((int)signal.size() - pushed, 1 + randomInt() % 3000);
+			stream.push(std::span<const float>(signal).subspan(pushed, chunk));
+			pushed += chunk;
+			maxBuffered = max(maxBuffered, stream.bufferedSamples());
+			// every frame whose samples all arrived is out
+			int complete = pushed < 512 - 256 ? 0 : min(engine.frameCount(pushed), (pushed - 512 + 256)/128 + 1);
+			passed &= assertEqual_UT(stream.framesEmitted(), complete);
+		}
+		stream.finish();
+		passed &= assertEqual_UT(stream.framesEmitted(), batch.frames());
+		passed &= assertTrue_UT(ordered);
+		// frames are paired differently in batches, bins of magnitude ~100 agree up to rounding
+		passed &= assertLessOrEqual_UT(error, 1e-4f);
+		passed &= assertLessOrEqual_UT(maxBuffered, 512);
+
+		bool threw = false;
+		try { stream.push(signal); }
+		catch (const ValueError &) { threw = true; }
+		passed &= assertTrue_UT(threw);
+	}
+	return passed;
+}
+
+
+inline bool stftResynthesisTest()
+{
+	bool passed = true;
+	auto signal = testSignal(30000);
+	for (auto engine : {STFTEngine(STFTEngine::hannWindow(1024), 256), STFTEngine(STFTEngine::gaussianWindow(1000), 125, 1500)}) {
+		auto resynthesised = engine.synthesise(engine.analyse(signal), signal.size());
+		passed &= assertLessOrEqual_UT(maxDifference(resynthesised, signal), 1e-4f);
+	}
+
+	bool threw = false;
+	try { STFTEngine(STFTEngine::hannWindow(64), 0); }
+	catch (const IllegalArgumentError &) { threw = true; }
+	passed &= assertTrue_UT(threw);
+	return passed;
+}
+
+
+inline UnitTestResult stftTests__all()
+{
+	UnitTestResult result;
+	result.runTest(gaborTransformMatchesFrameLoopTest);
+	result.runTest(stftStreamMatchesBatchTest);
+	result.runTest(stftResynthesisTest);
+	return result;
+}
@@ -0,0 +1,174 @@
+#pragma once
+#include "unittests.hpp"
+#include "../engine/uniforms.hpp"
+#include "../utils/logging.hpp"
+
+
+// GL calls replaced by counters, uploaded bytes are recorded for the buffer block
+struct CountedUniformCalls {
+	int uniformCalls = 0, bufferCreations = 0, bufferUploads = 0;
+	vector<std::pair<GLintptr, GLsizeiptr>> uploadedRanges;
+
+	UniformCalls calls() {
+		UniformCalls c;
+		c.uniform = [this](GLint, GLSLType, int, const void *) { ++uniformCalls; };
+		c.createBuffer = [this](GLsizeiptr, GLuint, const void *) { ++bufferCreations; return (GLuint)1; };
+		c.bufferSubData = [this](GLuint, GLintptr offset, GLsizeiptr bytes, const void *) {
+			++bufferUploads;
+			uploadedRanges.emplace_back(offset, bytes);
+		};
+		c.deleteBuffer = [](GLuint) {};
+		return c;
+	}
+};
+
+
+inline bool uniformShadowBlockTest()
+{
+	bool passed = true;
+	CountedUniformCalls gl;
+	UniformShadowBlock block(gl.calls());
+	auto time = UniformHandle<float>(&block, block.add("time", 0, FLOAT));
+	auto mvp = UniformHandle<mat4>(&block, block.add("mvp", 1, MAT4));
+	auto params = UniformHandle<vec3>(&block, block.add("params", 2, VEC3, 4));
+	auto removed = UniformHandle<vec4>(&block, block.add("unused", -1, VEC4));
+	vector<vec3> p = {vec3(1), vec3(2), vec3(3), vec3(4)};
+
+	auto frame = [&](float t) {
+		time.set(t);
+		mvp.set(mat4(1));
+		params.set(p.data(), 4);
+		removed.set(vec4(t));
+		block.flush();
+	};
+
+	frame(0);
+	passed &= assertEqual_UT(gl.uniformCalls, 3);
+
+	// steady state frame, nothing changed
+	gl.uniformCalls = 0;
+	frame(0);
+	passed &= assertEqual_UT(gl.uniformCalls, 0);
+	passed &= assertEqual_UT(block.pending(), false);
+
+	gl.uniformCalls = 0;
+	frame(.5f);
+	passed &= assertEqual_UT(gl.uniformCalls, 1);
+
+	gl.uniformCalls = 0;
+	p[2].y = 7;
+	frame(.5f);
+	passed &= assertEqual_UT(gl.uniformCalls, 1);
+
+	bool threw = false;
+	try { UniformHandle<vec3>(&block, 0); }
+	catch (const IllegalArgumentError &) { threw = true; }
+	passed &= assertEqual_UT(threw, true);
+	return passed;
+}
+
+
+// two steps drawing with copies of one program, each has to find its own values in the program when it draws
+inline bool sharedProgramUniformsTest()
+{
+	bool passed = true;
+	vector<std::pair<GLint, vec4>> uploads;
+	UniformCalls calls;
+	calls.uniform = [&uploads](GLint location, GLSLType, int, const void *data) { uploads.emplace_back(location, *static_cast<const vec4 *>(data)); };
+
+	GLuint programID = 1000;
+	auto blockA = UniformShadowBlock::ofProgram(programID, calls);
+	auto blockB = UniformShadowBlock::ofProgram(programID, calls);
+	passed &= assertEqual_UT(blockA == blockB, true);
+
+	auto intensitiesA = UniformHandle<vec4>(blockA.get(), blockA->add("intencities", 3, VEC4));
+	auto intensitiesB = UniformHandle<vec4>(blockB.get(), blockB->add("intencities", 3, VEC4));
+	auto colourB = UniformHandle<vec4>(blockB.get(), blockB->add("color", 4, VEC4));
+	passed &= assertEqual_UT(blockA->find("intencities"), blockB->find("intencities"));
+
+	for (int frame = 0; frame < 3; ++frame)
+	{
+		uploads.clear();
+		intensitiesA.set(vec4(.1f, .6f, .3f, 8));
+		blockA->flush();
+		passed &= assertEqual_UT((int)uploads.size(), 1);
+		passed &= assertEqual_UT(uploads.back().second, vec4(.1f, .6f, .3f, 8));
+
+		uploads.clear();
+		intensitiesB.set(vec4(.2f, .4f, .9f, 32));
+		colourB.set(vec4(1));
+		blockB->flush();
+		// the colour only changes on the first frame
+		passed &= assertEqual_UT((int)uploads.size(), frame == 0 ? 2 : 1);
+		passed &= assertEqual_UT(uploads.front().first, 3);
+		passed &= assertEqual_UT(uploads.front().second, vec4(.2f, .4f, .9f, 32));
+	}
+
+	bool threw = false;
+	try { blockB->add("color", 4, VEC4, 2); }
+	catch (const IllegalArgumentError &) { threw = true; }
+	passed &= assertEqual_UT(threw, true);
+
+	// handles of both declarations would copy values of different sizes through one slot
+	threw = false;
+	try { blockB->add("color", 4, MAT4); }
+	catch (const IllegalArgumentError &) { threw = true; }
+	passed &= assertEqual_UT(threw, true);
+
+	// the block lives as long as the copies of the program
+	blockA.reset();
+	blockB.reset();
+	passed &= assertEqual_UT(UniformShadowBlock::ofProgram(programID, calls)->find("intencities"), -1);
+	return passed;
+}
+
+
+inline bool uniformBufferBlockTest()
+{
+	bool passed = true;
+	CountedUniformCalls gl;
+	UniformBufferBlock block(gl.calls());
+	block.add("scale", FLOAT);
+	block.add("center", VEC3);
+	block.add("rotation", MAT3);
+	block.add("colors", VEC2, 3);
+	block.add("count", INT);
+
+	// std140 offsets
+	passed &= assertEqual_UT(block.offset("scale"), 0);
+	passed &= assertEqual_UT(block.offset("center"), 16);
+	passed &= assertEqual_UT(block.offset("rotation"), 32);
+	passed &= assertEqual_UT(block.offset("colors"), 80);
+	passed &= assertEqual_UT(block.offset("count"), 128);
+	passed &= assertEqual_UT(block.bytes(), 144);
+
+	auto scale = block.handle<float>("scale");
+	auto rotation = block.handle<mat3>("rotation");
+	scale.set(2);
+	rotation.set(mat3(1));
+	block.flush();
+	passed &= assertEqual_UT(gl.bufferCreations, 1);
+	passed &= assertEqual_UT(gl.bufferUploads, 0);
+
+	scale.set(2);
+	rotation.set(mat3(1));
+	block.flush();
+	passed &= assertEqual_UT(gl.bufferUploads, 0);
+
+	rotation.set(mat3(2));
+	block.flush();
+	passed &= assertEqual_UT(gl.bufferUploads, 1);
+	passed &= assertEqual_UT((int)gl.uploadedRanges.back().first, 32);
+	passed &= assertEqual_UT((int)gl.uploadedRanges.back().second, 48);
+	return passed;
+}
+
+
+inline UnitTestResult uniformTests__all()
+{
+	UnitTestResult result;
+	result.runTest(uniformShadowBlockTest);
+	result.runTest(sharedProgramUniformsTest);
+	result.runTest(uniformBufferBlockTest);
+	return result;
+}
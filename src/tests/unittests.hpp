@@ -2,6 +2,7 @@
 #include <cassert>
 
 #include "logging.hpp"
+#include "randomUtils.hpp"
 
 template <typename T, typename... Args>
 bool assertEqual_UT_(const T& A0, const Args&... args) {
@@ -90,6 +91,27 @@ inline bool assertFalse_UT_(bool x) {
 };
 
 
+// chirp plus a tone and a little noise, samples stay within [-1, 1]
+inline vector<float> testSignal(int n)
+{
+	vector<float> signal(n);
+	for (int i = 0; i < n; ++i)
+		signal[i] = .6f*sin(.3f*i*i/n) + .2f*cos(.9f*i) + .1f*randomFloat(-1, 1);
+	return signal;
+}
+
+// largest |a[i] - b[i]| over the common length of two sequences of floats or Complex
+template <typename A, typename B>
+float maxDifference(const A &a, const B &b)
+{
+	using std::abs;
+	float d = 0;
+	for (size_t i = 0; i < std::min(std::size(a), std::size(b)); ++i)
+		d = std::max(d, (float)abs(a[i] - b[i]));
+	return d;
+}
+
+
 // purely for better highlighting in IDE
 #define assertEqual_UT(...) assertEqual_UT_(__VA_ARGS__)
 #define assertNearlyEqual_UT(...) assertNearlyEqual_UT_(__VA_ARGS__)